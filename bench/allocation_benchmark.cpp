@@ -0,0 +1,78 @@
+#include "allocation_sampler.h"
+#include "context_storage.h"
+#include "splunk_config.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+/*
+ * A new and delete of 64 bytes, without the sampler and with one sampling on average every
+ * sampleBytes. In builds without SPLUNK_CPP_ALLOCATION_HOOKS only the baseline runs.
+ */
+void BM_NewDelete(benchmark::State& state) {
+  std::unique_ptr<splunk::AllocationSampler> sampler;
+
+  if (state.range(0) != 0) {
+    if (!SPLUNK_HAS_ALLOCATION_HOOKS) {
+      state.SkipWithError("Built without SPLUNK_CPP_ALLOCATION_HOOKS");
+      return;
+    }
+
+    splunk::ContextStorage::Install();
+    /* Nothing listens on the endpoint, the benchmark never runs long enough to export. */
+    sampler.reset(new splunk::AllocationSampler(
+      "localhost:4317", opentelemetry::sdk::resource::Resource::Create({}),
+      static_cast<size_t>(state.range(0)), std::chrono::minutes(10), false));
+  }
+
+  for (auto _ : state) {
+    char* bytes = new char[64];
+    benchmark::DoNotOptimize(bytes);
+    delete[] bytes;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_NewDelete)
+  ->ArgName("sampleBytes")
+  ->Arg(0)
+  ->Arg(4 * 1024)
+  ->Arg(64 * 1024)
+  ->Arg(512 * 1024);
+
+/* Frees of allocations which weren't sampled, while the live table holds sampled ones. */
+void BM_DeleteWithLiveSamples(benchmark::State& state) {
+  if (!SPLUNK_HAS_ALLOCATION_HOOKS) {
+    state.SkipWithError("Built without SPLUNK_CPP_ALLOCATION_HOOKS");
+    return;
+  }
+
+  splunk::ContextStorage::Install();
+  std::unique_ptr<splunk::AllocationSampler> sampler(new splunk::AllocationSampler(
+    "localhost:4317", opentelemetry::sdk::resource::Resource::Create({}), 4 * 1024,
+    std::chrono::minutes(10), false));
+  std::vector<std::unique_ptr<char[]>> kept;
+
+  for (int i = 0; i < 100000; i++) {
+    kept.emplace_back(new char[256]);
+  }
+
+  for (auto _ : state) {
+    char* bytes = new char[64];
+    benchmark::DoNotOptimize(bytes);
+    delete[] bytes;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_DeleteWithLiveSamples);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,96 @@
+#include "pooled_recordable.h"
+#include "recordable.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+
+#include <string>
+
+namespace otlp = opentelemetry::exporter::otlp;
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace {
+
+/* Attributes of a typical HTTP server span. */
+void SetAttributes(sdktrace::Recordable& recordable) {
+  recordable.SetAttribute("http.method", "GET");
+  recordable.SetAttribute("http.scheme", "http");
+  recordable.SetAttribute("http.host", "localhost:8080");
+  recordable.SetAttribute("http.target", "/api/v1/items?page=2");
+  recordable.SetAttribute("http.flavor", "1.1");
+  recordable.SetAttribute("http.user_agent", "curl/7.79.1");
+  recordable.SetAttribute("http.status_code", 200);
+  recordable.SetAttribute("net.peer.ip", "127.0.0.1");
+}
+
+const splunk::DynamicSettings& Settings() {
+  static splunk::DynamicSettings settings{splunk::DynamicConfig()};
+  return settings;
+}
+
+splunk::SpanLimitCounters& Counters() {
+  static splunk::SpanLimitCounters counters;
+  return counters;
+}
+
+/* The SDK's own recordable, keeping attributes in a hash map. */
+void BM_SpanDataSetAttribute(benchmark::State& state) {
+  for (auto _ : state) {
+    sdktrace::SpanData recordable;
+    SetAttributes(recordable);
+    benchmark::DoNotOptimize(recordable.GetAttributes().size());
+  }
+}
+
+BENCHMARK(BM_SpanDataSetAttribute);
+
+void BM_PooledSetAttribute(benchmark::State& state) {
+  for (auto _ : state) {
+    splunk::PooledRecordable* recordable =
+      splunk::PooledRecordable::Acquire(Settings(), Counters());
+    SetAttributes(*recordable);
+    recordable->Release();
+  }
+}
+
+BENCHMARK(BM_PooledSetAttribute);
+
+/* Default mode: attributes go straight into the OTLP message. */
+void BM_OtlpExportDefault(benchmark::State& state) {
+  std::string buffer;
+
+  for (auto _ : state) {
+    auto* otlpRecordable = new otlp::OtlpRecordable();
+    splunk::SpanRecordable recordable(
+      std::unique_ptr<sdktrace::Recordable>(otlpRecordable), Settings(), Counters());
+    SetAttributes(recordable);
+    otlpRecordable->span().SerializeToString(&buffer);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+}
+
+BENCHMARK(BM_OtlpExportDefault);
+
+/* Pooled mode: attributes are stored flat and replayed into the OTLP message on export. */
+void BM_OtlpExportPooled(benchmark::State& state) {
+  std::string buffer;
+
+  for (auto _ : state) {
+    splunk::PooledRecordable* recordable =
+      splunk::PooledRecordable::Acquire(Settings(), Counters());
+    SetAttributes(*recordable);
+
+    otlp::OtlpRecordable otlpRecordable;
+    recordable->Replay(otlpRecordable);
+    recordable->Release();
+    otlpRecordable.span().SerializeToString(&buffer);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+}
+
+BENCHMARK(BM_OtlpExportPooled);
+
+} // namespace
+
+BENCHMARK_MAIN();
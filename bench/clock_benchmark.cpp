@@ -0,0 +1,105 @@
+#include "batch_span_processor.h"
+#include "span_clock.h"
+
+#include <splunk/tracing.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+
+#include <mutex>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace {
+
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new sdktrace::SpanData());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+nostd::shared_ptr<opentelemetry::trace::Tracer> GetTracer() {
+  static sdktrace::TracerProvider* provider = [] {
+    auto settings = std::make_shared<splunk::DynamicSettings>(splunk::DynamicConfig());
+    auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+      std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()), settings, 1));
+
+    return new sdktrace::TracerProvider(
+      std::move(processor), opentelemetry::sdk::resource::Resource::Create({}),
+      std::unique_ptr<sdktrace::Sampler>(new sdktrace::AlwaysOnSampler()));
+  }();
+
+  return provider->GetTracer("clock_benchmark");
+}
+
+/* Called by every thread of a benchmark, only the first one installs the clock. */
+bool UseClock(splunk::SpanClock clock) {
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  return splunk::InstalledSpanClock() == clock || splunk::InstallSpanClock(clock) == clock;
+}
+
+/* What the SDK reads per span timestamp: the system and the steady clock. */
+void BM_ReadDefaultClock(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(splunk::ReadDefaultClock());
+  }
+}
+
+BENCHMARK(BM_ReadDefaultClock)->Threads(1)->Threads(8);
+
+void BM_ReadTscClock(benchmark::State& state) {
+  if (!UseClock(splunk::SpanClock_Tsc)) {
+    state.SkipWithError("no invariant TSC");
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(splunk::ReadTscClock());
+  }
+}
+
+BENCHMARK(BM_ReadTscClock)->Threads(1)->Threads(8);
+
+void BM_ReadCoarseClock(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(splunk::ReadCoarseClock());
+  }
+}
+
+BENCHMARK(BM_ReadCoarseClock)->Threads(1)->Threads(8);
+
+/* A whole span through ScopedSpan, two clock readings each, with the clock given as argument. */
+void BM_ScopedSpan(benchmark::State& state) {
+  auto tracer = GetTracer();
+
+  if (!UseClock(static_cast<splunk::SpanClock>(state.range(0)))) {
+    state.SkipWithError("clock not available");
+  }
+
+  for (auto _ : state) {
+    splunk::ScopedSpan span(*tracer, "request");
+  }
+}
+
+BENCHMARK(BM_ScopedSpan)
+  ->ArgName("clock")
+  ->Arg(splunk::SpanClock_Default)
+  ->Arg(splunk::SpanClock_Tsc)
+  ->Arg(splunk::SpanClock_Coarse)
+  ->Threads(1)
+  ->Threads(8);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,74 @@
+#include "context_storage.h"
+
+#include <splunk/context.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/trace/default_span.h>
+
+namespace context = opentelemetry::context;
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+nostd::shared_ptr<trace::Span> MakeSpan() {
+  return nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(trace::SpanContext::GetInvalid()));
+}
+
+/* Attach and Detach on a storage directly, as RuntimeContext::Attach does. */
+template <typename Storage>
+void AttachNested(Storage& storage, const context::Context& base, int depth) {
+  if (depth == 0) {
+    benchmark::DoNotOptimize(storage.GetCurrent());
+    return;
+  }
+
+  auto token = storage.Attach(base);
+  AttachNested(storage, base, depth - 1);
+  storage.Detach(*token);
+}
+
+void BM_DefaultStorageNested(benchmark::State& state) {
+  context::ThreadLocalContextStorage storage;
+  context::Context base = context::Context().SetValue(trace::kSpanKey, MakeSpan());
+
+  for (auto _ : state) {
+    AttachNested(storage, base, static_cast<int>(state.range(0)));
+  }
+}
+
+void BM_SplunkStorageNested(benchmark::State& state) {
+  splunk::ContextStorage storage;
+  context::Context base = context::Context().SetValue(trace::kSpanKey, MakeSpan());
+
+  for (auto _ : state) {
+    AttachNested(storage, base, static_cast<int>(state.range(0)));
+  }
+}
+
+void ScopeNested(const nostd::shared_ptr<trace::Span>& span, int depth) {
+  if (depth == 0) {
+    benchmark::DoNotOptimize(context::RuntimeContext::GetCurrent());
+    return;
+  }
+
+  splunk::ContextScope scope(span);
+  ScopeNested(span, depth - 1);
+}
+
+void BM_ContextScopeNested(benchmark::State& state) {
+  splunk::ContextStorage::Install();
+  auto span = MakeSpan();
+
+  for (auto _ : state) {
+    ScopeNested(span, static_cast<int>(state.range(0)));
+  }
+}
+
+} // namespace
+
+BENCHMARK(BM_DefaultStorageNested)->Arg(1)->Arg(8)->Arg(64);
+BENCHMARK(BM_SplunkStorageNested)->Arg(1)->Arg(8)->Arg(64);
+BENCHMARK(BM_ContextScopeNested)->Arg(1)->Arg(8)->Arg(64);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,105 @@
+#include "context_storage.h"
+
+#include <splunk/coroutine.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/trace/default_span.h>
+
+#include <coroutine>
+
+namespace context = opentelemetry::context;
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+/* Lazily started coroutine, resumed by hand to stand in for an executor. */
+template <typename Base>
+struct Task {
+  struct promise_type : Base {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+
+  ~Task() { handle.destroy(); }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+struct PlainPromise {
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  std::suspend_always final_suspend() noexcept { return {}; }
+};
+
+std::coroutine_handle<> pending;
+
+struct Hop {
+  bool await_ready() noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) noexcept { pending = handle; }
+  void await_resume() noexcept {}
+};
+
+/* The active span follows the coroutine through the promise. */
+Task<splunk::ContextPromise> ContextAwareHops(size_t hops) {
+  for (size_t i = 0; i < hops; i++) {
+    co_await Hop();
+    benchmark::DoNotOptimize(context::RuntimeContext::GetCurrent());
+  }
+}
+
+/* Baseline: the context is passed in and carried by hand. */
+Task<PlainPromise> ManualContextHops(context::Context parent, size_t hops) {
+  for (size_t i = 0; i < hops; i++) {
+    co_await Hop();
+    benchmark::DoNotOptimize(parent);
+  }
+}
+
+const size_t kHops = 1000;
+
+template <typename TaskType>
+void Drive(TaskType& task) {
+  task.handle.resume();
+
+  while (!task.handle.done()) {
+    pending.resume();
+  }
+}
+
+void BM_ContextPromiseHop(benchmark::State& state) {
+  splunk::ContextStorage::Install();
+  auto span =
+    nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(trace::SpanContext::GetInvalid()));
+  splunk::ContextScope scope(span);
+
+  for (auto _ : state) {
+    auto task = ContextAwareHops(kHops);
+    Drive(task);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kHops);
+}
+
+void BM_ManualContextHop(benchmark::State& state) {
+  auto span =
+    nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(trace::SpanContext::GetInvalid()));
+  context::Context parent = context::Context().SetValue(trace::kSpanKey, span);
+
+  for (auto _ : state) {
+    auto task = ManualContextHops(parent, kHops);
+    Drive(task);
+  }
+
+  state.SetItemsProcessed(state.iterations() * kHops);
+}
+
+} // namespace
+
+BENCHMARK(BM_ContextPromiseHop);
+BENCHMARK(BM_ManualContextHop);
+
+BENCHMARK_MAIN();
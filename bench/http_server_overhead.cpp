@@ -0,0 +1,537 @@
+#include "latency_histogram.h"
+#include "../test/mock_collector/mock_collector.h"
+
+#include <splunk/opentelemetry.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/*
+ * Measures what tracing costs examples/http_server per request. The server is started once per
+ * configuration, first with --no-tracing and then with each exporter and propagator, and driven
+ * by closed-loop clients: every connection sends its next request as soon as the previous one
+ * was answered. Requests carry the headers of every propagator, so each configuration extracts
+ * a parent. Spans go to a MockCollector in this process. The server inherits the environment,
+ * so batch parameters come from the config file of SPLUNK_CONFIG_FILE as usual.
+ */
+
+extern char** environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string server = HTTP_SERVER_PATH;
+  unsigned connections = 4;
+  std::chrono::seconds warmup{1};
+  std::chrono::seconds duration{5};
+  unsigned repetitions = 3;
+  /* Comma separated configuration names, empty for all. */
+  std::string configurations;
+  std::string out;
+};
+
+const char* kUsage =
+  "usage: http_server_overhead [--server=http_server] [--connections=4] [--warmup=1]\n"
+  "                            [--duration=5] [--repetitions=3] [--configurations=] [--out=]\n"
+  "\n"
+  "  --server          the http_server example to measure\n"
+  "  --connections     closed-loop clients, 2 or more keep the server busy\n"
+  "  --warmup          seconds of load before measuring each configuration\n"
+  "  --duration        seconds of measured load per configuration\n"
+  "  --repetitions     rounds over all configurations, the median throughput is reported\n"
+  "  --configurations  comma separated names to run, e.g. disabled,otlp/b3, default all\n"
+  "  --out             also writes the results as JSON to this file\n";
+
+struct Configuration {
+  std::string name;
+  /* Empty runs the server with --no-tracing. */
+  std::string exporter;
+  std::string propagators;
+};
+
+/* Of all repetitions, the latencies merged. */
+struct Result {
+  std::string name;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  std::vector<double> throughputs;
+  double throughput = 0;
+  LatencyHistogram latencies;
+  uint64_t spans = 0;
+};
+
+/* The baseline comes first, the deltas are relative to it. */
+std::vector<Configuration> Configurations() {
+  std::vector<Configuration> configurations = {{"disabled", "", ""}};
+  std::vector<std::string> exporters = {"otlp"};
+#if SPLUNK_HAS_JAEGER
+  exporters.push_back("jaeger");
+#endif
+
+  for (const std::string& exporter : exporters) {
+    for (const char* propagators : {"tracecontext", "tracecontext,baggage", "b3", "b3multi"}) {
+      configurations.push_back({exporter + "/" + propagators, exporter, propagators});
+    }
+  }
+
+  return configurations;
+}
+
+bool ParseOption(const char* arg, const char* name, std::string* value) {
+  size_t length = strlen(name);
+
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+
+  *value = arg + length + 1;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    std::string value;
+
+    if (ParseOption(argv[i], "--server", &value)) {
+      options->server = value;
+    } else if (ParseOption(argv[i], "--connections", &value)) {
+      options->connections =
+        static_cast<unsigned>(std::max(1L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--warmup", &value)) {
+      options->warmup = std::chrono::seconds(std::max(0L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--duration", &value)) {
+      options->duration = std::chrono::seconds(std::max(1L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--repetitions", &value)) {
+      options->repetitions =
+        static_cast<unsigned>(std::max(1L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--configurations", &value)) {
+      options->configurations = value;
+    } else if (ParseOption(argv[i], "--out", &value)) {
+      options->out = value;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Selected(const Options& options, const std::string& name) {
+  if (options.configurations.empty()) {
+    return true;
+  }
+
+  std::string list = "," + options.configurations + ",";
+  return list.find("," + name + ",") != std::string::npos;
+}
+
+/* Binds port 0 to find a free port for the server, which binds it again right after. */
+int FreePort() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address = {0};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+
+  if (fd == -1 || bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      getsockname(fd, (struct sockaddr*)&address, &length) != 0) {
+    throw std::system_error(errno, std::generic_category(), "bind");
+  }
+
+  close(fd);
+  return ntohs(address.sin_port);
+}
+
+int Connect(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (fd == -1) {
+    return -1;
+  }
+
+  struct sockaddr_in address = {0};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/*
+ * The environment is built before fork, so the child only makes async-signal-safe calls until
+ * exec: the collector's threads may hold locks.
+ */
+pid_t StartServer(
+  const Options& options, const Configuration& configuration, int port,
+  const MockCollector& collector) {
+  std::vector<std::string> overrides;
+
+  if (!configuration.exporter.empty()) {
+    overrides = {
+      "OTEL_TRACES_EXPORTER=" +
+        std::string(configuration.exporter == "jaeger" ? "jaeger-thrift-splunk" : "otlp"),
+      "OTEL_EXPORTER_OTLP_ENDPOINT=127.0.0.1:" + std::to_string(collector.OtlpPort()),
+      "OTEL_EXPORTER_JAEGER_ENDPOINT=http://127.0.0.1:" + std::to_string(collector.JaegerPort()) +
+        "/api/traces",
+      "OTEL_PROPAGATORS=" + configuration.propagators,
+    };
+  }
+
+  std::vector<std::string> environment = overrides;
+
+  for (char** variable = environ; *variable; variable++) {
+    std::string name(*variable, strcspn(*variable, "="));
+    bool overridden =
+      std::any_of(overrides.begin(), overrides.end(), [&name](const std::string& value) {
+        return value.compare(0, name.size() + 1, name + "=") == 0;
+      });
+
+    if (!overridden) {
+      environment.push_back(*variable);
+    }
+  }
+
+  std::string portArg = "--port=" + std::to_string(port);
+  std::vector<char*> args = {const_cast<char*>(options.server.c_str()),
+                             const_cast<char*>(portArg.c_str())};
+
+  if (configuration.exporter.empty()) {
+    args.push_back(const_cast<char*>("--no-tracing"));
+  }
+
+  args.push_back(nullptr);
+  std::vector<char*> envp;
+
+  for (std::string& variable : environment) {
+    envp.push_back(&variable[0]);
+  }
+
+  envp.push_back(nullptr);
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+    execve(args[0], args.data(), envp.data());
+    _exit(127);
+  }
+
+  return pid;
+}
+
+void StopServer(pid_t pid) {
+  kill(pid, SIGTERM);
+  waitpid(pid, nullptr, 0);
+}
+
+/* Waits until the server accepts connections, false if it exited or took too long. */
+bool WaitForServer(pid_t pid, int port) {
+  for (int i = 0; i < 500; i++) {
+    int fd = Connect(port);
+
+    if (fd != -1) {
+      /* An empty request, the server closes it without a span. */
+      close(fd);
+      return true;
+    }
+
+    if (waitpid(pid, nullptr, WNOHANG) == pid) {
+      return false;
+    }
+
+    usleep(10000);
+  }
+
+  return false;
+}
+
+/* One header of each propagator, all of the same sampled parent. */
+std::string MakeRequest(int port) {
+  return "GET / HTTP/1.1\r\n"
+         "Host: 127.0.0.1:" +
+         std::to_string(port) +
+         "\r\n"
+         "traceparent: 00-5e086555d0afe8b4b5c2a65430d4e78a-32e23db8a8133506-01\r\n"
+         "b3: 5e086555d0afe8b4b5c2a65430d4e78a-32e23db8a8133506-1\r\n"
+         "X-B3-TraceId: 5e086555d0afe8b4b5c2a65430d4e78a\r\n"
+         "X-B3-SpanId: 32e23db8a8133506\r\n"
+         "X-B3-Sampled: 1\r\n"
+         "baggage: user.id=42,tenant=acme\r\n"
+         "\r\n";
+}
+
+/* Sends the request and reads until the server closes the connection. */
+bool DoRequest(int port, const std::string& request) {
+  int fd = Connect(port);
+
+  if (fd == -1) {
+    return false;
+  }
+
+  bool ok = write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size());
+  char response[64] = {0};
+  char rest[256];
+  ssize_t bytes = ok ? read(fd, response, sizeof(response)) : -1;
+  ok = ok && bytes > 0 && strncmp(response, "HTTP/1.1 200", 12) == 0;
+
+  while (ok && (bytes = read(fd, rest, sizeof(rest))) > 0) {
+  }
+
+  close(fd);
+  return ok && bytes == 0;
+}
+
+/*
+ * Requests started during the warmup aren't measured. Counts locally and publishes at the end,
+ * not to share cache lines with the other connections.
+ */
+void RunConnection(
+  int port, const std::string& request, Clock::time_point measureStart, Clock::time_point end,
+  LatencyHistogram* latencies, uint64_t* requests, uint64_t* errors, uint64_t* sent) {
+  LatencyHistogram localLatencies;
+  uint64_t localRequests = 0;
+  uint64_t localErrors = 0;
+  uint64_t localSent = 0;
+
+  for (;;) {
+    auto start = Clock::now();
+
+    if (start >= end) {
+      break;
+    }
+
+    bool ok = DoRequest(port, request);
+    auto duration = Clock::now() - start;
+    localSent++;
+
+    if (start < measureStart) {
+      continue;
+    }
+
+    if (!ok) {
+      localErrors++;
+      continue;
+    }
+
+    localLatencies.Record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+    localRequests++;
+  }
+
+  *latencies = std::move(localLatencies);
+  *requests = localRequests;
+  *errors = localErrors;
+  *sent = localSent;
+}
+
+bool Measure(
+  const Options& options, const Configuration& configuration, MockCollector& collector,
+  Result* result) {
+  int port = FreePort();
+  uint64_t spansBefore = collector.GetStats().spans;
+  pid_t pid = StartServer(options, configuration, port, collector);
+
+  if (pid == -1 || !WaitForServer(pid, port)) {
+    fprintf(stderr, "http_server_overhead: %s didn't start\n", options.server.c_str());
+
+    if (pid != -1) {
+      StopServer(pid);
+    }
+
+    return false;
+  }
+
+  std::string request = MakeRequest(port);
+  std::vector<LatencyHistogram> latencies(options.connections);
+  std::vector<uint64_t> requests(options.connections);
+  std::vector<uint64_t> errors(options.connections);
+  std::vector<uint64_t> sent(options.connections);
+  std::vector<std::thread> threads;
+
+  auto measureStart = Clock::now() + options.warmup;
+  auto end = measureStart + options.duration;
+
+  for (unsigned i = 0; i < options.connections; i++) {
+    threads.emplace_back(
+      RunConnection, port, std::cref(request), measureStart, end, &latencies[i], &requests[i],
+      &errors[i], &sent[i]);
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  uint64_t measured = 0;
+  uint64_t total = 0;
+
+  for (unsigned i = 0; i < options.connections; i++) {
+    result->latencies.Merge(latencies[i]);
+    result->errors += errors[i];
+    measured += requests[i];
+    total += sent[i];
+  }
+
+  result->requests += measured;
+  result->throughputs.push_back(
+    static_cast<double>(measured) / std::chrono::duration<double>(options.duration).count());
+
+  /* Gives the batch a schedule delay to arrive, the server is stopped without flushing. */
+  if (!configuration.exporter.empty()) {
+    collector.WaitForSpans(spansBefore + total, std::chrono::seconds(6));
+  }
+
+  StopServer(pid);
+  result->spans += collector.GetStats().spans - spansBefore;
+  return true;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  size_t middle = values.size() / 2;
+  return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+double Micros(uint64_t nanos) {
+  return static_cast<double>(nanos) / 1000;
+}
+
+void PrintResults(const std::vector<Result>& results) {
+  printf(
+    "%-24s %10s %9s %9s %9s %9s %9s %9s %12s %9s\n", "configuration", "req/s", "p50 us", "p99 us",
+    "p999 us", "d req/s", "d p50 us", "d p99 us", "d us/req", "spans");
+
+  const Result& baseline = results.front();
+
+  for (const Result& result : results) {
+    double throughputDelta = 100 * (result.throughput / baseline.throughput - 1);
+    /* With the single threaded server kept busy, the time it spends per request. */
+    double costDelta = 1e6 / result.throughput - 1e6 / baseline.throughput;
+
+    printf(
+      "%-24s %10.0f %9.1f %9.1f %9.1f %+8.1f%% %+9.1f %+9.1f %+12.2f %9llu\n", result.name.c_str(),
+      result.throughput, Micros(result.latencies.Quantile(0.5)),
+      Micros(result.latencies.Quantile(0.99)), Micros(result.latencies.Quantile(0.999)),
+      throughputDelta,
+      Micros(result.latencies.Quantile(0.5)) - Micros(baseline.latencies.Quantile(0.5)),
+      Micros(result.latencies.Quantile(0.99)) - Micros(baseline.latencies.Quantile(0.99)),
+      costDelta, static_cast<unsigned long long>(result.spans));
+
+    if (result.errors != 0) {
+      printf(
+        "%-24s %llu failed requests\n", "", static_cast<unsigned long long>(result.errors));
+    }
+  }
+}
+
+bool WriteResults(const Options& options, const std::vector<Result>& results) {
+  FILE* file = fopen(options.out.c_str(), "w");
+
+  if (!file) {
+    return false;
+  }
+
+  fprintf(
+    file,
+    "{\n  \"connections\": %u,\n  \"duration_seconds\": %lld,\n  \"repetitions\": %u,\n"
+    "  \"results\": [\n",
+    options.connections, static_cast<long long>(options.duration.count()), options.repetitions);
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    fprintf(
+      file,
+      "    {\"configuration\": \"%s\", \"requests\": %llu, \"errors\": %llu, "
+      "\"requests_per_second\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+      "\"max_ns\": %llu, \"spans\": %llu}%s\n",
+      result.name.c_str(), static_cast<unsigned long long>(result.requests),
+      static_cast<unsigned long long>(result.errors), result.throughput,
+      static_cast<unsigned long long>(result.latencies.Quantile(0.5)),
+      static_cast<unsigned long long>(result.latencies.Quantile(0.99)),
+      static_cast<unsigned long long>(result.latencies.Quantile(0.999)),
+      static_cast<unsigned long long>(result.latencies.Max()),
+      static_cast<unsigned long long>(result.spans), i + 1 < results.size() ? "," : "");
+  }
+
+  fputs("  ]\n}\n", file);
+  return fclose(file) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+
+  if (!ParseOptions(argc, argv, &options)) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  /* The server closes each connection, a client may write into one it already closed. */
+  signal(SIGPIPE, SIG_IGN);
+
+  std::vector<Configuration> configurations;
+
+  for (const Configuration& configuration : Configurations()) {
+    if (configuration.exporter.empty() || Selected(options, configuration.name)) {
+      configurations.push_back(configuration);
+    }
+  }
+
+  std::vector<Result> results(configurations.size());
+
+  /* Round-robin, so drift of the machine spreads over all configurations alike. */
+  try {
+    MockCollectorOptions collectorOptions;
+    collectorOptions.keepTraces = false;
+    MockCollector collector(collectorOptions);
+
+    for (unsigned repetition = 0; repetition < options.repetitions; repetition++) {
+      for (size_t i = 0; i < configurations.size(); i++) {
+        if (!Measure(options, configurations[i], collector, &results[i])) {
+          return 1;
+        }
+      }
+    }
+  } catch (const std::system_error& error) {
+    fprintf(stderr, "http_server_overhead: %s\n", error.what());
+    return 1;
+  }
+
+  for (size_t i = 0; i < configurations.size(); i++) {
+    results[i].name = configurations[i].name;
+    results[i].throughput = Median(results[i].throughputs);
+  }
+
+  PrintResults(results);
+
+  if (!options.out.empty() && !WriteResults(options, results)) {
+    fprintf(stderr, "http_server_overhead: can't write %s\n", options.out.c_str());
+    return 1;
+  }
+
+  return 0;
+}
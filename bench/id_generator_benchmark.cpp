@@ -0,0 +1,36 @@
+#include "id_generator.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/random_id_generator.h>
+
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace {
+
+/* The IDs of a root span: one trace ID and one span ID. */
+void GenerateIds(benchmark::State& state, sdktrace::IdGenerator& generator) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(generator.GenerateTraceId());
+    benchmark::DoNotOptimize(generator.GenerateSpanId());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_SdkRandomIdGenerator(benchmark::State& state) {
+  static sdktrace::RandomIdGenerator generator;
+  GenerateIds(state, generator);
+}
+
+BENCHMARK(BM_SdkRandomIdGenerator)->Threads(1)->Threads(8);
+
+void BM_ThreadLocalIdGenerator(benchmark::State& state) {
+  static splunk::ThreadLocalIdGenerator generator;
+  GenerateIds(state, generator);
+}
+
+BENCHMARK(BM_ThreadLocalIdGenerator)->Threads(1)->Threads(8);
+
+} // namespace
+
+BENCHMARK_MAIN();
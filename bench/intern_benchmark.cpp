@@ -0,0 +1,65 @@
+#include "intern_table.h"
+#include "pooled_recordable.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace nostd = opentelemetry::nostd;
+
+namespace {
+
+const char* const kKeys[] = {
+  "http.method", "http.host", "http.status_code", "http.url", "http.user_agent"};
+
+/* What a recordable owning its keys does per attribute. */
+void BM_CopyKeys(benchmark::State& state) {
+  std::string copies[5];
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < 5; i++) {
+      copies[i] = kKeys[i];
+    }
+
+    benchmark::DoNotOptimize(copies);
+  }
+}
+
+BENCHMARK(BM_CopyKeys)->Threads(1)->Threads(8);
+
+void BM_InternKeys(benchmark::State& state) {
+  splunk::InternTable& table = splunk::InternTable::Names();
+  uint32_t ids[5];
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < 5; i++) {
+      ids[i] = table.Intern(kKeys[i]);
+    }
+
+    benchmark::DoNotOptimize(ids);
+  }
+}
+
+BENCHMARK(BM_InternKeys)->Threads(1)->Threads(8);
+
+void BM_PooledSetAttributes(benchmark::State& state) {
+  splunk::DynamicSettings settings{splunk::DynamicConfig()};
+  splunk::SpanLimitCounters counters;
+
+  for (auto _ : state) {
+    splunk::PooledRecordable* recordable = splunk::PooledRecordable::Acquire(settings, counters);
+    recordable->SetName("GET /api/v1/items");
+    recordable->SetAttribute(kKeys[0], "GET");
+    recordable->SetAttribute(kKeys[1], "localhost:8080");
+    recordable->SetAttribute(kKeys[2], 200);
+    recordable->SetAttribute(kKeys[3], "http://localhost:8080/api/v1/items?page=2");
+    recordable->SetAttribute(kKeys[4], "curl/7.79.1");
+    recordable->Release();
+  }
+}
+
+BENCHMARK(BM_PooledSetAttributes)->Threads(1)->Threads(8);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Log-linear histogram of nanoseconds: exact below 64, then 64 buckets per power of two, so
+ * percentiles are within 1.6% of the recorded values.
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram() : counts_(kBuckets) {}
+
+  void Record(uint64_t nanos) {
+    counts_[Bucket(nanos)]++;
+    max_ = std::max(max_, nanos);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBuckets; i++) {
+      counts_[i] += other.counts_[i];
+    }
+
+    max_ = std::max(max_, other.max_);
+  }
+
+  /* Lower bound of the bucket holding the quantile. */
+  uint64_t Quantile(double quantile) const {
+    uint64_t total = 0;
+
+    for (uint64_t count : counts_) {
+      total += count;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < kBuckets; i++) {
+      seen += counts_[i];
+
+      if (seen > rank) {
+        return LowerBound(i);
+      }
+    }
+
+    return max_;
+  }
+
+  uint64_t Max() const { return max_; }
+
+private:
+  static const size_t kSubBits = 6;
+  static const size_t kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+  static size_t Bucket(uint64_t nanos) {
+    if (nanos < (1u << kSubBits)) {
+      return static_cast<size_t>(nanos);
+    }
+
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(nanos));
+    size_t sub = static_cast<size_t>(nanos >> (exponent - kSubBits)) & ((1u << kSubBits) - 1);
+    return ((exponent - kSubBits + 1) << kSubBits) + sub;
+  }
+
+  static uint64_t LowerBound(size_t bucket) {
+    if (bucket < (1u << kSubBits)) {
+      return bucket;
+    }
+
+    size_t exponent = (bucket >> kSubBits) + kSubBits - 1;
+    uint64_t sub = bucket & ((1u << kSubBits) - 1);
+    return ((uint64_t(1) << kSubBits) | sub) << (exponent - kSubBits);
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t max_ = 0;
+};
@@ -0,0 +1,78 @@
+#include "context_storage.h"
+#include "log_processor.h"
+
+#include <splunk/context.h>
+#include <splunk/logs.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/trace/default_span.h>
+
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+splunk::Logger GetLogger() {
+  /*
+   * Never destroyed, the export thread keeps draining between benchmarks. Nothing listens on
+   * the endpoint: records are collected and encoded, then the export fails.
+   */
+  static splunk::BatchLogProcessor* processor = [] {
+    splunk::ContextStorage::Install();
+    return new splunk::BatchLogProcessor(
+      "localhost:4317", opentelemetry::sdk::resource::Resource::Create({}),
+      std::chrono::milliseconds(100), 8192, 512, false);
+  }();
+
+  benchmark::DoNotOptimize(processor);
+  return splunk::LoggerProvider::Get().GetLogger("logs_benchmark");
+}
+
+nostd::shared_ptr<trace::Span> MakeSpan() {
+  const uint8_t traceId[trace::TraceId::kSize] = {1, 2, 3, 4, 5, 6, 7, 8,
+                                                  9, 10, 11, 12, 13, 14, 15, 16};
+  const uint8_t spanId[trace::SpanId::kSize] = {1, 2, 3, 4, 5, 6, 7, 8};
+  return nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(trace::SpanContext(
+    trace::TraceId(traceId), trace::SpanId(spanId), trace::TraceFlags(1), false)));
+}
+
+/* Records per second a thread can emit, with or without an active span to stamp. */
+void BM_Emit(benchmark::State& state) {
+  splunk::Logger logger = GetLogger();
+  auto span = MakeSpan();
+  std::unique_ptr<splunk::ContextScope> scope;
+
+  if (state.range(0) != 0) {
+    scope.reset(new splunk::ContextScope(span));
+  }
+
+  uint64_t droppedBefore = splunk::LoggerProvider::Get().DroppedRecords();
+
+  for (auto _ : state) {
+    logger.Emit(
+      splunk::LogSeverity::Info, "request handled",
+      {{"http.method", "GET"}, {"http.route", "/items"}});
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["dropped"] = benchmark::Counter(
+    static_cast<double>(splunk::LoggerProvider::Get().DroppedRecords() - droppedBefore),
+    benchmark::Counter::kAvgThreads);
+}
+
+BENCHMARK(BM_Emit)->ArgName("in_span")->Arg(0)->Arg(1)->Threads(1)->Threads(8)->UseRealTime();
+
+/* What a disabled severity check costs on the request path. */
+void BM_IsEnabled(benchmark::State& state) {
+  splunk::Logger logger;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(logger.IsEnabled(splunk::LogSeverity::Debug));
+  }
+}
+
+BENCHMARK(BM_IsEnabled);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,87 @@
+#include "batch_span_processor.h"
+
+#include <splunk/tracing.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+
+/*
+ * Built twice, as macro_benchmark and as macro_benchmark_disabled with SPLUNK_TRACING_ENABLED=0.
+ * In the latter BM_Instrumented should match BM_Uninstrumented, and HandleRequest should
+ * disassemble to the same code as HandleRequestUninstrumented.
+ */
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace {
+
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new sdktrace::SpanData());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+nostd::shared_ptr<opentelemetry::trace::Tracer> GetTracer() {
+  static sdktrace::TracerProvider* provider = [] {
+    auto settings = std::make_shared<splunk::DynamicSettings>(splunk::DynamicConfig());
+    auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+      std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()), settings, 1));
+
+    return new sdktrace::TracerProvider(
+      std::move(processor), opentelemetry::sdk::resource::Resource::Create({}),
+      std::unique_ptr<sdktrace::Sampler>(new sdktrace::AlwaysOnSampler()));
+  }();
+
+  return provider->GetTracer("macro_benchmark");
+}
+
+__attribute__((noinline)) int HandleRequestUninstrumented(int status) {
+  benchmark::ClobberMemory();
+  return status + 1;
+}
+
+__attribute__((noinline)) int
+HandleRequest(const nostd::shared_ptr<opentelemetry::trace::Tracer>& tracer, int status) {
+  SPLUNK_SCOPED_SPAN(span, tracer, "HandleRequest", opentelemetry::trace::SpanKind::kServer);
+  SPLUNK_SPAN_ATTRIBUTE(span, splunk::semconv::kHttpMethod, "GET");
+  SPLUNK_SPAN_ATTRIBUTE(span, splunk::semconv::kHttpTarget, "/api/v1/items");
+  SPLUNK_SPAN_ATTRIBUTE(span, splunk::semconv::kHttpStatusCode, status);
+  benchmark::ClobberMemory();
+  return status + 1;
+}
+
+void BM_Uninstrumented(benchmark::State& state) {
+  int status = 200;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HandleRequestUninstrumented(status));
+  }
+}
+
+BENCHMARK(BM_Uninstrumented);
+
+void BM_Instrumented(benchmark::State& state) {
+  auto tracer = GetTracer();
+  int status = 200;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HandleRequest(tracer, status));
+  }
+}
+
+BENCHMARK(BM_Instrumented);
+
+} // namespace
+
+BENCHMARK_MAIN();
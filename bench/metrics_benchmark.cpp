@@ -0,0 +1,59 @@
+#include <splunk/metrics.h>
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace {
+
+splunk::Meter& GetMeter() {
+  static splunk::Meter meter = splunk::MeterProvider::Get().GetMeter("metrics_benchmark");
+  return meter;
+}
+
+/* What recording costs when every thread adds to one shared value under a lock. */
+void BM_MutexCounter(benchmark::State& state) {
+  static std::mutex mutex;
+  static uint64_t value = 0;
+
+  for (auto _ : state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    value++;
+  }
+
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_MutexCounter)->Threads(1)->Threads(8);
+
+void BM_CounterAdd(benchmark::State& state) {
+  static splunk::Counter counter = GetMeter().CreateCounter("requests");
+
+  for (auto _ : state) {
+    counter.Add(1);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_CounterAdd)->Threads(1)->Threads(8);
+
+void BM_HistogramRecord(benchmark::State& state) {
+  static splunk::Histogram histogram =
+    GetMeter().CreateHistogram("latency", {1, 5, 10, 25, 50, 100, 250, 500, 1000}, "", "ms");
+  double value = 0;
+
+  for (auto _ : state) {
+    histogram.Record(value);
+    value = value < 1000 ? value + 7 : 0;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_HistogramRecord)->Threads(1)->Threads(8);
+
+} // namespace
+
+BENCHMARK_MAIN();
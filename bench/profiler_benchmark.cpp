@@ -0,0 +1,39 @@
+#include "context_storage.h"
+#include "cpu_profiler.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+namespace {
+
+/* A CPU bound loop, slower by the profiler's overhead while it samples. */
+void BM_Busy(benchmark::State& state) {
+  std::unique_ptr<splunk::CpuProfiler> profiler;
+
+  if (state.range(0) != 0) {
+    splunk::ContextStorage::Install();
+    /* Nothing listens on the endpoint, the benchmark never runs long enough to export. */
+    profiler.reset(new splunk::CpuProfiler(
+      "localhost:4317", opentelemetry::sdk::resource::Resource::Create({}),
+      std::chrono::milliseconds(10), std::chrono::minutes(10), false));
+  }
+
+  double sum = 0;
+
+  for (auto _ : state) {
+    for (int i = 1; i < 1000; i++) {
+      sum += 1.0 / i;
+    }
+
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Busy)->ArgName("profiler")->Arg(0)->Arg(1)->MinTime(2.0)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,92 @@
+#include "batch_span_processor.h"
+#include "resource_usage.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/samplers/always_off.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new sdktrace::SpanData());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+sdktrace::TracerProvider* MakeProvider(bool sampled, splunk::SpanResourceUsage resourceUsage) {
+  splunk::DynamicConfig config;
+  config.maxQueueSize = 65536;
+  config.scheduleDelayMillis = 100;
+  auto settings = std::make_shared<splunk::DynamicSettings>(config);
+
+  auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+    std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()), settings, 1, true, nullptr,
+    nullptr, nullptr, nullptr, resourceUsage));
+
+  std::unique_ptr<sdktrace::Sampler> sampler(
+    sampled ? static_cast<sdktrace::Sampler*>(new sdktrace::AlwaysOnSampler())
+            : new sdktrace::AlwaysOffSampler());
+
+  return new sdktrace::TracerProvider(
+    std::move(processor), opentelemetry::sdk::resource::Resource::Create({}), std::move(sampler));
+}
+
+nostd::shared_ptr<trace::Tracer> GetTracer(bool sampled, bool resourceUsage) {
+  /* Never destroyed, the export threads keep running between benchmarks. */
+  static sdktrace::TracerProvider* providers[2][2] = {
+    {MakeProvider(false, splunk::SpanResourceUsage_Disabled),
+     MakeProvider(false, splunk::SpanResourceUsage_Enabled)},
+    {MakeProvider(true, splunk::SpanResourceUsage_Disabled),
+     MakeProvider(true, splunk::SpanResourceUsage_Enabled)},
+  };
+
+  return providers[sampled][resourceUsage]->GetTracer("resource_usage_benchmark");
+}
+
+/* What measuring adds to a span, two readings for sampled spans and none for the others. */
+void BM_StartEndSpan(benchmark::State& state) {
+  auto tracer = GetTracer(state.range(0) != 0, state.range(1) != 0);
+
+  for (auto _ : state) {
+    auto span = tracer->StartSpan("GET /users");
+    span->End();
+  }
+}
+
+BENCHMARK(BM_StartEndSpan)
+  ->ArgNames({"sampled", "resource_usage"})
+  ->Args({0, 0})
+  ->Args({0, 1})
+  ->Args({1, 0})
+  ->Args({1, 1})
+  ->UseRealTime();
+
+/* A single reading, one getrusage(RUSAGE_THREAD). */
+void BM_ReadThreadUsage(benchmark::State& state) {
+  splunk::ThreadUsage usage;
+
+  for (auto _ : state) {
+    splunk::ReadThreadUsage(&usage);
+    benchmark::DoNotOptimize(usage);
+  }
+}
+
+BENCHMARK(BM_ReadThreadUsage)->Threads(1)->Threads(8);
+
+} // namespace
+
+BENCHMARK_MAIN();
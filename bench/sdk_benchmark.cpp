@@ -0,0 +1,332 @@
+#include "batch_span_processor.h"
+#include "config.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/baggage/baggage_context.h>
+#include <opentelemetry/baggage/propagation/baggage_propagator.h>
+#include <opentelemetry/context/propagation/composite_propagator.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable_utils.h>
+#include <opentelemetry/proto/collector/trace/v1/trace_service.grpc.pb.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+#include <opentelemetry/trace/context.h>
+#include <opentelemetry/trace/default_span.h>
+#include <opentelemetry/trace/propagation/b3_propagator.h>
+#include <opentelemetry/trace/propagation/http_trace_context.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace baggage = opentelemetry::baggage;
+namespace context = opentelemetry::context;
+namespace nostd = opentelemetry::nostd;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace sdkresource = opentelemetry::sdk::resource;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+namespace traceservice = opentelemetry::proto::collector::trace::v1;
+
+namespace {
+
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new otlp::OtlpRecordable());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+nostd::shared_ptr<trace::Tracer> GetTracer() {
+  /* Never destroyed, the export thread keeps running between benchmarks. */
+  static sdktrace::TracerProvider* provider = [] {
+    splunk::DynamicConfig config;
+    config.maxQueueSize = 65536;
+    config.scheduleDelayMillis = 100;
+
+    auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+      std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()),
+      std::make_shared<splunk::DynamicSettings>(config), 1));
+
+    return new sdktrace::TracerProvider(
+      std::move(processor), sdkresource::Resource::Create({}),
+      std::unique_ptr<sdktrace::Sampler>(new sdktrace::AlwaysOnSampler()));
+  }();
+
+  return provider->GetTracer("sdk_benchmark");
+}
+
+/* Keys of the attributes set on spans, built once so only the SDK's work is measured. */
+const std::vector<std::string>& AttributeKeys() {
+  static std::vector<std::string> keys = [] {
+    std::vector<std::string> keys;
+
+    for (int i = 0; i < 20; i++) {
+      keys.push_back("attribute." + std::to_string(i));
+    }
+
+    return keys;
+  }();
+
+  return keys;
+}
+
+/* A sampled span with as many attributes as the argument, half strings and half integers. */
+void BM_StartEndSpan(benchmark::State& state) {
+  auto tracer = GetTracer();
+  const auto& keys = AttributeKeys();
+  size_t attributes = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    auto span = tracer->StartSpan("GET /items");
+
+    for (size_t i = 0; i < attributes; i++) {
+      if (i & 1) {
+        span->SetAttribute(keys[i], static_cast<int64_t>(i));
+      } else {
+        span->SetAttribute(keys[i], "value");
+      }
+    }
+
+    span->End();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_StartEndSpan)->ArgName("attributes")->Arg(0)->Arg(5)->Arg(20);
+
+/* A parent and a child span, each made active for its lifetime. */
+void BM_StartEndNestedSpans(benchmark::State& state) {
+  auto tracer = GetTracer();
+
+  for (auto _ : state) {
+    auto parent = tracer->StartSpan("GET /items");
+
+    {
+      auto parentScope = tracer->WithActiveSpan(parent);
+      auto child = tracer->StartSpan("SELECT items");
+
+      {
+        auto childScope = tracer->WithActiveSpan(child);
+        benchmark::DoNotOptimize(trace::Tracer::GetCurrentSpan().get());
+      }
+
+      child->End();
+    }
+
+    parent->End();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_StartEndNestedSpans);
+
+trace::SpanContext SampledSpanContext(bool remote) {
+  const uint8_t traceId[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+  const uint8_t spanId[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  return trace::SpanContext(
+    trace::TraceId(traceId), trace::SpanId(spanId),
+    trace::TraceFlags(trace::TraceFlags::kIsSampled), remote);
+}
+
+class MapCarrier final : public context::propagation::TextMapCarrier {
+public:
+  nostd::string_view Get(nostd::string_view key) const noexcept override {
+    auto it = headers_.find(std::string(key.data(), key.size()));
+    return it == headers_.end() ? nostd::string_view() : nostd::string_view(it->second);
+  }
+
+  void Set(nostd::string_view key, nostd::string_view value) noexcept override {
+    headers_[std::string(key.data(), key.size())] = std::string(value.data(), value.size());
+  }
+
+  void Clear() { headers_.clear(); }
+
+private:
+  std::map<std::string, std::string> headers_;
+};
+
+/* The same composite InitOpentelemetry installs for these flags. */
+std::unique_ptr<context::propagation::TextMapPropagator> MakePropagator(
+  splunk::PropagatorType flags) {
+  std::vector<std::unique_ptr<context::propagation::TextMapPropagator>> propagators;
+
+  if (flags & splunk::PropagatorType_TraceContext) {
+    propagators.emplace_back(new trace::propagation::HttpTraceContext());
+  }
+
+  if (flags & splunk::PropagatorType_B3) {
+    propagators.emplace_back(new trace::propagation::B3Propagator());
+  }
+
+  if (flags & splunk::PropagatorType_B3Multi) {
+    propagators.emplace_back(new trace::propagation::B3PropagatorMultiHeader());
+  }
+
+  if (flags & splunk::PropagatorType_Baggage) {
+    propagators.emplace_back(new baggage::propagation::BaggagePropagator());
+  }
+
+  return std::unique_ptr<context::propagation::TextMapPropagator>(
+    new context::propagation::CompositePropagator(std::move(propagators)));
+}
+
+/* A context with a remote sampled span and three baggage entries, so every propagator has work. */
+context::Context MakeContext() {
+  context::Context ctx;
+  ctx = trace::SetSpan(
+    ctx, nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(SampledSpanContext(true))));
+  return baggage::SetBaggage(
+    ctx, baggage::Baggage::FromHeader("user.id=1234,tenant=acme,region=eu-west-1"));
+}
+
+const char* PropagatorName(splunk::PropagatorType flags) {
+  switch (flags) {
+    case splunk::PropagatorType_TraceContext:
+      return "tracecontext";
+    case splunk::PropagatorType_B3:
+      return "b3";
+    case splunk::PropagatorType_B3Multi:
+      return "b3multi";
+    case splunk::PropagatorType_Baggage:
+      return "baggage";
+    default:
+      return "composite";
+  }
+}
+
+const int64_t kAllPropagators = splunk::PropagatorType_TraceContext | splunk::PropagatorType_B3 |
+                                splunk::PropagatorType_B3Multi | splunk::PropagatorType_Baggage;
+
+void PropagatorArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("propagator")
+    ->Arg(splunk::PropagatorType_TraceContext)
+    ->Arg(splunk::PropagatorType_B3)
+    ->Arg(splunk::PropagatorType_B3Multi)
+    ->Arg(splunk::PropagatorType_Baggage)
+    ->Arg(kAllPropagators);
+}
+
+void BM_Inject(benchmark::State& state) {
+  auto flags = static_cast<splunk::PropagatorType>(state.range(0));
+  auto propagator = MakePropagator(flags);
+  context::Context ctx = MakeContext();
+  MapCarrier carrier;
+
+  for (auto _ : state) {
+    carrier.Clear();
+    propagator->Inject(carrier, ctx);
+  }
+
+  state.SetLabel(PropagatorName(flags));
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Inject)->Apply(PropagatorArgs);
+
+void BM_Extract(benchmark::State& state) {
+  auto flags = static_cast<splunk::PropagatorType>(state.range(0));
+  auto propagator = MakePropagator(flags);
+  MapCarrier carrier;
+  propagator->Inject(carrier, MakeContext());
+
+  for (auto _ : state) {
+    context::Context ctx;
+    ctx = propagator->Extract(carrier, ctx);
+    benchmark::DoNotOptimize(ctx.HasKey(trace::kSpanKey));
+  }
+
+  state.SetLabel(PropagatorName(flags));
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Extract)->Apply(PropagatorArgs);
+
+/* Detecting the resource dominates, the argument selects whether it comes from a cache file. */
+void BM_ApplyDefaults(benchmark::State& state) {
+  splunk::OpenTelemetryOptions options;
+  std::string cacheFile;
+
+  if (state.range(0) != 0) {
+    cacheFile = "/tmp/splunk_sdk_benchmark_resource_cache.json";
+    options.resourceCacheFile = cacheFile;
+    splunk::ApplyDefaults(options, splunk::FileConfig());
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(splunk::ApplyDefaults(options, splunk::FileConfig()));
+  }
+
+  if (!cacheFile.empty()) {
+    std::remove(cacheFile.c_str());
+  }
+}
+
+BENCHMARK(BM_ApplyDefaults)->ArgName("cached")->Arg(0)->Arg(1);
+
+/*
+ * InitOpentelemetry with the default options, then a shutdown with nothing to export. The OTLP
+ * channel connects lazily so no collector is needed.
+ */
+void BM_InitShutdown(benchmark::State& state) {
+  for (auto _ : state) {
+    auto handle = splunk::InitOpentelemetry(
+      splunk::OpenTelemetryOptions().WithServiceName("sdk_benchmark"));
+    handle.Shutdown(std::chrono::milliseconds(100));
+  }
+}
+
+BENCHMARK(BM_InitShutdown)->Unit(benchmark::kMicrosecond);
+
+/* Batches of typical HTTP server spans, converted to an export request and serialized. */
+void BM_OtlpSerialize(benchmark::State& state) {
+  static auto resource = sdkresource::Resource::Create({{"service.name", "sdk_benchmark"}});
+  trace::SpanContext spanContext = SampledSpanContext(false);
+  std::vector<std::unique_ptr<sdktrace::Recordable>> spans;
+
+  for (int64_t i = 0; i < state.range(0); i++) {
+    std::unique_ptr<otlp::OtlpRecordable> span(new otlp::OtlpRecordable());
+    span->SetIdentity(spanContext, trace::SpanId());
+    span->SetName("GET /items");
+    span->SetSpanKind(trace::SpanKind::kServer);
+    span->SetStartTime(opentelemetry::common::SystemTimestamp(std::chrono::system_clock::now()));
+    span->SetDuration(std::chrono::milliseconds(12));
+    span->SetAttribute("http.method", "GET");
+    span->SetAttribute("http.target", "/api/v1/items?page=2");
+    span->SetAttribute("http.user_agent", "curl/7.79.1");
+    span->SetAttribute("http.status_code", 200);
+    span->SetAttribute("net.peer.ip", "127.0.0.1");
+    span->SetResource(resource);
+    spans.emplace_back(std::move(span));
+  }
+
+  std::string buffer;
+  int64_t bytes = 0;
+
+  for (auto _ : state) {
+    traceservice::ExportTraceServiceRequest request;
+    otlp::OtlpRecordableUtils::PopulateRequest(
+      nostd::span<std::unique_ptr<sdktrace::Recordable>>(spans.data(), spans.size()), &request);
+    request.SerializeToString(&buffer);
+    bytes += static_cast<int64_t>(buffer.size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_OtlpSerialize)->ArgName("spans")->Arg(1)->Arg(64)->Arg(512);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,311 @@
+#include <splunk/opentelemetry.h>
+
+#include "latency_histogram.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/proto/collector/trace/v1/trace_service.grpc.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Starts and ends spans as fast as asked from many threads through the pipeline of
+ * InitOpentelemetry, and reports what it costs the calling threads and what the pipeline
+ * keeps up with. Unless --endpoint is given the spans go to an OTLP sink in this process which
+ * only counts them, so nothing leaves the host. Batch parameters come from the config file
+ * of SPLUNK_CONFIG_FILE.
+ */
+
+namespace nostd = opentelemetry::nostd;
+namespace traceservice = opentelemetry::proto::collector::trace::v1;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  unsigned threads = 4;
+  /* Spans per second of all threads together, 0 for as fast as they go. */
+  uint64_t rate = 0;
+  std::chrono::seconds duration{10};
+  std::string attributes = "http";
+  std::string exporter = "otlp";
+  /* Empty for the in-process sink. */
+  std::string endpoint;
+};
+
+const char* kUsage =
+  "usage: span_firehose [--threads=4] [--rate=0] [--duration=10] [--attributes=http]\n"
+  "                     [--exporter=otlp] [--endpoint=]\n"
+  "\n"
+  "  --threads     threads starting and ending spans\n"
+  "  --rate        spans per second of all threads together, 0 for unlimited\n"
+  "  --duration    seconds of load\n"
+  "  --attributes  none, http (8 short attributes) or wide (32 attributes of 64 bytes)\n"
+  "  --exporter    otlp or jaeger, which needs --endpoint\n"
+  "  --endpoint    OTLP endpoint or Jaeger URL, defaults to an OTLP sink in this process\n";
+
+bool ParseOption(const char* arg, const char* name, std::string* value) {
+  size_t length = strlen(name);
+
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+
+  *value = arg + length + 1;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; i++) {
+    std::string value;
+
+    if (ParseOption(argv[i], "--threads", &value)) {
+      options->threads = static_cast<unsigned>(std::max(1L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--rate", &value)) {
+      options->rate = strtoull(value.c_str(), nullptr, 10);
+    } else if (ParseOption(argv[i], "--duration", &value)) {
+      options->duration = std::chrono::seconds(std::max(1L, strtol(value.c_str(), nullptr, 10)));
+    } else if (ParseOption(argv[i], "--attributes", &value)) {
+      options->attributes = value;
+    } else if (ParseOption(argv[i], "--exporter", &value)) {
+      options->exporter = value;
+    } else if (ParseOption(argv[i], "--endpoint", &value)) {
+      options->endpoint = value;
+    } else {
+      return false;
+    }
+  }
+
+  return options->attributes == "none" || options->attributes == "http" ||
+         options->attributes == "wide";
+}
+
+/* Accepts every export and counts what it received. */
+class CountingTraceService final : public traceservice::TraceService::Service {
+public:
+  grpc::Status Export(
+    grpc::ServerContext*, const traceservice::ExportTraceServiceRequest* request,
+    traceservice::ExportTraceServiceResponse*) override {
+    uint64_t spans = 0;
+
+    for (const auto& resourceSpans : request->resource_spans()) {
+      for (const auto& librarySpans : resourceSpans.instrumentation_library_spans()) {
+        spans += static_cast<uint64_t>(librarySpans.spans_size());
+      }
+    }
+
+    spans_.fetch_add(spans, std::memory_order_relaxed);
+    bytes_.fetch_add(request->ByteSizeLong(), std::memory_order_relaxed);
+    return grpc::Status::OK;
+  }
+
+  uint64_t Spans() const { return spans_.load(std::memory_order_relaxed); }
+  uint64_t Bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> spans_{0};
+  std::atomic<uint64_t> bytes_{0};
+};
+
+struct Attribute {
+  std::string key;
+  std::string value;
+};
+
+std::vector<Attribute> MakeAttributes(const std::string& shape) {
+  if (shape == "http") {
+    return {
+      {"http.method", "GET"},
+      {"http.scheme", "http"},
+      {"http.host", "localhost:8080"},
+      {"http.target", "/api/v1/items?page=2"},
+      {"http.flavor", "1.1"},
+      {"http.user_agent", "curl/7.79.1"},
+      {"http.route", "/api/v1/items"},
+      {"net.peer.ip", "127.0.0.1"},
+    };
+  }
+
+  std::vector<Attribute> attributes;
+
+  if (shape == "wide") {
+    for (int i = 0; i < 32; i++) {
+      char fill = static_cast<char>('a' + i % 26);
+      attributes.push_back({"attribute." + std::to_string(i), std::string(64, fill)});
+    }
+  }
+
+  return attributes;
+}
+
+/*
+ * Paces its spans to start at regular times, so a slow End() doesn't lower the offered rate.
+ * Counts locally and publishes at the end, not to share cache lines with the other threads.
+ */
+void RunThread(
+  const Options& options, const std::vector<Attribute>& attributes, Clock::time_point start,
+  LatencyHistogram* latencies, uint64_t* spans) {
+  auto tracer = opentelemetry::trace::Provider::GetTracerProvider()->GetTracer("span_firehose");
+  Clock::time_point end = start + options.duration;
+  std::chrono::nanoseconds interval(0);
+
+  if (options.rate != 0) {
+    interval = std::chrono::nanoseconds(1000000000ull * options.threads / options.rate);
+  }
+
+  LatencyHistogram endLatencies;
+  uint64_t count = 0;
+  Clock::time_point next = start;
+
+  for (;;) {
+    auto now = Clock::now();
+
+    if (now >= end) {
+      break;
+    }
+
+    if (now < next) {
+      std::this_thread::sleep_until(std::min(next, end));
+      continue;
+    }
+
+    auto span = tracer->StartSpan("GET /api/v1/items");
+
+    for (const Attribute& attribute : attributes) {
+      span->SetAttribute(attribute.key, nostd::string_view(attribute.value));
+    }
+
+    auto endStart = Clock::now();
+    span->End();
+    endLatencies.Record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - endStart).count()));
+
+    count++;
+    next += interval;
+  }
+
+  *latencies = std::move(endLatencies);
+  *spans = count;
+}
+
+std::string Rate(uint64_t count, Clock::duration elapsed) {
+  double perSecond = static_cast<double>(count) / std::chrono::duration<double>(elapsed).count();
+  return std::to_string(static_cast<uint64_t>(perSecond));
+}
+
+void Print(const char* name, const std::string& value) {
+  printf("%-26s%s\n", name, value.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+
+  if (!ParseOptions(argc, argv, &options)) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  splunk::OpenTelemetryOptions otelOptions = splunk::OpenTelemetryOptions()
+                                               .WithServiceName("span_firehose")
+                                               .WithMetricsExporter(splunk::MetricsExporter_None)
+                                               .WithLogsExporter(splunk::LogsExporter_None);
+
+  CountingTraceService sink;
+  std::unique_ptr<grpc::Server> server;
+
+  if (options.exporter == "otlp") {
+    std::string endpoint = options.endpoint;
+
+    if (endpoint.empty()) {
+      int port = 0;
+      grpc::ServerBuilder builder;
+      builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+      builder.RegisterService(&sink);
+      server = builder.BuildAndStart();
+
+      if (!server) {
+        fputs("span_firehose: could not start the OTLP sink\n", stderr);
+        return 1;
+      }
+
+      endpoint = "127.0.0.1:" + std::to_string(port);
+    }
+
+    otelOptions.WithExporter(splunk::ExporterType_Otlp).WithOtlpEndpoint(endpoint);
+#if SPLUNK_HAS_JAEGER
+  } else if (options.exporter == "jaeger" && !options.endpoint.empty()) {
+    otelOptions.WithExporter(splunk::ExporterType_JaegerThriftHttp)
+      .WithJaegerEndpoint(options.endpoint);
+#endif
+  } else {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  auto handle = splunk::InitOpentelemetry(otelOptions);
+  std::vector<Attribute> attributes = MakeAttributes(options.attributes);
+  std::vector<LatencyHistogram> latencies(options.threads);
+  std::vector<uint64_t> spans(options.threads);
+  std::vector<std::thread> threads;
+
+  auto start = Clock::now();
+
+  for (unsigned i = 0; i < options.threads; i++) {
+    threads.emplace_back(
+      RunThread, std::cref(options), std::cref(attributes), start, &latencies[i], &spans[i]);
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  auto loadEnd = Clock::now();
+  splunk::PipelineStats duringLoad = handle.GetPipelineStats();
+  splunk::FlushResult shutdown = handle.Shutdown(std::chrono::seconds(30));
+  auto drainEnd = Clock::now();
+  splunk::PipelineStats stats = handle.GetPipelineStats();
+
+  LatencyHistogram total;
+  uint64_t generated = 0;
+
+  for (unsigned i = 0; i < options.threads; i++) {
+    total.Merge(latencies[i]);
+    generated += spans[i];
+  }
+
+  Print("threads", std::to_string(options.threads));
+  Print("attributes", options.attributes);
+  Print("exporter", options.exporter);
+  Print("spans generated", std::to_string(generated));
+  Print("generated spans/s", Rate(generated, loadEnd - start));
+  Print("end() p50 ns", std::to_string(total.Quantile(0.5)));
+  Print("end() p99 ns", std::to_string(total.Quantile(0.99)));
+  Print("end() p999 ns", std::to_string(total.Quantile(0.999)));
+  Print("end() max ns", std::to_string(total.Max()));
+  Print("dropped queue full", std::to_string(stats.spansDroppedQueueFull));
+  Print("dropped on shutdown", std::to_string(stats.spansDroppedShutdown));
+  Print("export failed", std::to_string(stats.spansExportFailed));
+  Print("exported during load/s", Rate(duringLoad.spansExported, loadEnd - start));
+  Print("exported spans/s", Rate(stats.spansExported, drainEnd - start));
+  Print("exported bytes/s", Rate(stats.bytesSent, drainEnd - start));
+  Print("drained before deadline", shutdown.completed ? "yes" : "no");
+
+  if (server) {
+    Print("sink received spans", std::to_string(sink.Spans()));
+    Print("sink received bytes", std::to_string(sink.Bytes()));
+    server->Shutdown();
+  }
+
+  return 0;
+}
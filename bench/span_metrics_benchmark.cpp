@@ -0,0 +1,119 @@
+#include "batch_span_processor.h"
+#include "intern_table.h"
+#include "sampler.h"
+#include "span_metrics.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/samplers/always_off.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new sdktrace::SpanData());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+sdktrace::TracerProvider* MakeProvider(bool sampled, bool spanMetrics) {
+  splunk::DynamicConfig config;
+  config.maxQueueSize = 65536;
+  config.scheduleDelayMillis = 100;
+  auto settings = std::make_shared<splunk::DynamicSettings>(config);
+
+  std::shared_ptr<splunk::SpanMetricsAggregator> aggregator;
+
+  if (spanMetrics) {
+    aggregator = std::make_shared<splunk::SpanMetricsAggregator>("span_metrics_benchmark");
+  }
+
+  auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+    std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()), settings, 1, false,
+    nullptr, aggregator));
+
+  std::unique_ptr<sdktrace::Sampler> sampler(
+    sampled ? static_cast<sdktrace::Sampler*>(new sdktrace::AlwaysOnSampler())
+            : new sdktrace::AlwaysOffSampler());
+
+  if (spanMetrics) {
+    sampler.reset(new splunk::RecordUnsampledSampler(std::move(sampler)));
+  }
+
+  return new sdktrace::TracerProvider(
+    std::move(processor), opentelemetry::sdk::resource::Resource::Create({}), std::move(sampler));
+}
+
+nostd::shared_ptr<trace::Tracer> GetTracer(bool sampled, bool spanMetrics) {
+  /* Never destroyed, the export threads keep running between benchmarks. */
+  static sdktrace::TracerProvider* providers[2][2] = {
+    {MakeProvider(false, false), MakeProvider(false, true)},
+    {MakeProvider(true, false), MakeProvider(true, true)},
+  };
+
+  return providers[sampled][spanMetrics]->GetTracer("span_metrics_benchmark");
+}
+
+/* Span names cycle through a few routes, like a server's. */
+const char* kNames[] = {"GET /users", "GET /items", "POST /items", "GET /health"};
+
+void BM_StartEndSpan(benchmark::State& state) {
+  auto tracer = GetTracer(state.range(0) != 0, state.range(1) != 0);
+  size_t i = 0;
+
+  for (auto _ : state) {
+    auto span = tracer->StartSpan(kNames[i++ & 3]);
+    span->SetAttribute("http.status_code", 200);
+    span->End();
+  }
+}
+
+BENCHMARK(BM_StartEndSpan)
+  ->ArgNames({"sampled", "span_metrics"})
+  ->Args({0, 0})
+  ->Args({0, 1})
+  ->Args({1, 0})
+  ->Args({1, 1})
+  ->Threads(1)
+  ->Threads(8)
+  ->UseRealTime();
+
+/* Aggregation alone, what span metrics add to ending a span. */
+void BM_Record(benchmark::State& state) {
+  static splunk::SpanMetricsAggregator* aggregator =
+    new splunk::SpanMetricsAggregator("span_metrics_benchmark");
+  uint32_t nameIds[4];
+
+  for (size_t i = 0; i < 4; i++) {
+    nameIds[i] = splunk::InternTable::Names().Intern(kNames[i]);
+  }
+
+  size_t i = 0;
+
+  for (auto _ : state) {
+    size_t route = i & 3;
+    aggregator->Record(splunk::SpanSummary{
+      kNames[route], nameIds[route], trace::SpanKind::kServer, trace::StatusCode::kUnset,
+      std::chrono::microseconds(50 + i % 1000), true});
+    i++;
+  }
+}
+
+BENCHMARK(BM_Record)->Threads(1)->Threads(8)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
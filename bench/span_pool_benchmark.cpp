@@ -0,0 +1,138 @@
+#include "batch_span_processor.h"
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/sdk/trace/samplers/always_on.h>
+#include <opentelemetry/sdk/trace/span_data.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace {
+
+/* Heap operations made by the current thread. */
+thread_local size_t threadAllocations = 0;
+thread_local size_t threadFrees = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+  threadAllocations++;
+
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  if (p) {
+    threadFrees++;
+  }
+
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace {
+
+/* Builds the same recordables as the SDK's in-memory exporter and drops them after export. */
+class DiscardingExporter final : public sdktrace::SpanExporter {
+public:
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new sdktrace::SpanData());
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    return opentelemetry::sdk::common::ExportResult::kSuccess;
+  }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+sdktrace::TracerProvider* MakeProvider(bool pooledSpans) {
+  splunk::DynamicConfig config;
+  config.maxQueueSize = 65536;
+  config.scheduleDelayMillis = 100;
+  auto settings = std::make_shared<splunk::DynamicSettings>(config);
+
+  auto processor = std::unique_ptr<sdktrace::SpanProcessor>(new splunk::BatchSpanProcessor(
+    std::unique_ptr<sdktrace::SpanExporter>(new DiscardingExporter()), settings, 1,
+    pooledSpans));
+
+  return new sdktrace::TracerProvider(
+    std::move(processor), opentelemetry::sdk::resource::Resource::Create({}),
+    std::unique_ptr<sdktrace::Sampler>(new sdktrace::AlwaysOnSampler()));
+}
+
+nostd::shared_ptr<opentelemetry::trace::Tracer> GetTracer(bool pooled) {
+  /* Never destroyed, the export threads keep running between benchmarks. */
+  static sdktrace::TracerProvider* defaultProvider = MakeProvider(false);
+  static sdktrace::TracerProvider* pooledProvider = MakeProvider(true);
+
+  return (pooled ? pooledProvider : defaultProvider)->GetTracer("span_pool_benchmark");
+}
+
+double ResidentMegabytes() {
+  long pages = 0;
+  long resident = 0;
+  FILE* statm = std::fopen("/proc/self/statm", "r");
+
+  if (statm) {
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+
+    std::fclose(statm);
+  }
+
+  return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+/*
+ * Sustained load: every thread keeps ending spans while the processor exports them in the
+ * background. allocs/span and frees/span count heap operations on the request threads, the
+ * difference is memory left for the export thread to free.
+ */
+void BM_StartEndSpan(benchmark::State& state) {
+  auto tracer = GetTracer(state.range(0) != 0);
+  size_t allocations = threadAllocations;
+  size_t frees = threadFrees;
+
+  for (auto _ : state) {
+    auto span = tracer->StartSpan("request");
+    span->SetAttribute("http.method", "GET");
+    span->SetAttribute("http.url", "http://localhost:8080/api/v1/items?page=2");
+    span->SetAttribute("http.status_code", 200);
+    span->End();
+  }
+
+  double iterations = static_cast<double>(state.iterations());
+  state.counters["allocs/span"] = benchmark::Counter(
+    (threadAllocations - allocations) / iterations, benchmark::Counter::kAvgThreads);
+  state.counters["frees/span"] =
+    benchmark::Counter((threadFrees - frees) / iterations, benchmark::Counter::kAvgThreads);
+  state.counters["rss_mb"] =
+    benchmark::Counter(ResidentMegabytes(), benchmark::Counter::kAvgThreads);
+}
+
+BENCHMARK(BM_StartEndSpan)
+  ->ArgName("pooled")
+  ->Arg(0)
+  ->Arg(1)
+  ->Threads(1)
+  ->Threads(8)
+  ->MinTime(2.0)
+  ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
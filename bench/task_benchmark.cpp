@@ -0,0 +1,58 @@
+#include "context_storage.h"
+
+#include <splunk/task.h>
+
+#include <benchmark/benchmark.h>
+#include <opentelemetry/trace/default_span.h>
+
+#include <functional>
+
+namespace context = opentelemetry::context;
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+namespace {
+
+/* A hop is wrapping a microtask on the submitting side and running it on the worker side. */
+void Work() { benchmark::DoNotOptimize(context::RuntimeContext::GetCurrent()); }
+
+class ActiveSpanFixture : public benchmark::Fixture {
+public:
+  void SetUp(const benchmark::State&) override {
+    splunk::ContextStorage::Install();
+    span_ =
+      nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(trace::SpanContext::GetInvalid()));
+    scope_ = new splunk::ContextScope(span_);
+  }
+
+  void TearDown(const benchmark::State&) override { delete scope_; }
+
+private:
+  nostd::shared_ptr<trace::Span> span_;
+  splunk::ContextScope* scope_ = nullptr;
+};
+
+BENCHMARK_F(ActiveSpanFixture, PlainFunctionHop)(benchmark::State& state) {
+  for (auto _ : state) {
+    std::function<void()> task(&Work);
+    task();
+  }
+}
+
+BENCHMARK_F(ActiveSpanFixture, BindContextHop)(benchmark::State& state) {
+  for (auto _ : state) {
+    std::function<void()> task(splunk::BindContext(&Work));
+    task();
+  }
+}
+
+BENCHMARK_F(ActiveSpanFixture, ContextTaskHop)(benchmark::State& state) {
+  for (auto _ : state) {
+    splunk::ContextTask task(&Work);
+    task();
+  }
+}
+
+} // namespace
+
+BENCHMARK_MAIN();
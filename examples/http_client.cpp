@@ -5,6 +5,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <splunk/context.h>
 #include <splunk/opentelemetry.h>
 #include <opentelemetry/context/propagation/global_propagator.h>
 #include <string>
@@ -51,7 +52,7 @@ int main(int argc, char** argv) {
   span->SetAttribute("http.host", kHost);
   span->SetAttribute("http.flavor", "1.1");
 
-  auto scope = tracer->WithActiveSpan(span);
+  splunk::ContextScope scope(span);
   auto currentContext = opentelemetry::context::RuntimeContext::GetCurrent();
 
   /* Inject propagation headers */
@@ -2,12 +2,17 @@
 #include <error.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include <splunk/opentelemetry.h>
 #include <opentelemetry/context/propagation/global_propagator.h>
 #include <opentelemetry/trace/context.h>
+#include <algorithm>
+#include <cctype>
+#include <map>
 #include <string>
 
 #include "http_common.h"
@@ -15,50 +20,88 @@
 /*
  * A minimal server to be used with the http_client example to demonstrate
  * extracting parent context from request headers.
+ *
+ * usage: http_server [--port=9123] [--no-tracing]
+ *
+ * --no-tracing leaves OpenTelemetry uninitialized, so the spans are the API's no-ops. The
+ * overhead harness in bench/ compares both.
  */
 
 namespace nostd = opentelemetry::nostd;
 
 const int kPort = 9123;
-const char* kHost = "127.0.0.1";
 
-std::string ParsePropagationHeader(const std::string& request) {
-  const std::string prefix = "traceparent: ";
-  /* Finds the following header with structure:
-   * traceparent: 00-5e086555d0afe8b4b5c2a65430d4e78a-32e23db8a8133506-01
-   */
-  size_t headerBegin = request.find(prefix);
+/*
+ * Collects the request headers with lowercase names, so any of the configured propagators
+ * (tracecontext, b3, b3multi, baggage) finds its own, e.g.
+ * traceparent: 00-5e086555d0afe8b4b5c2a65430d4e78a-32e23db8a8133506-01
+ */
+struct HeaderCarrier : opentelemetry::context::propagation::TextMapCarrier {
+  explicit HeaderCarrier(const std::string& request) {
+    size_t lineBegin = request.find("\r\n");
 
-  if (headerBegin == std::string::npos) {
-    return {};
-  }
+    while (lineBegin != std::string::npos) {
+      lineBegin += 2;
+      size_t lineEnd = request.find("\r\n", lineBegin);
 
-  size_t headerEnd = request.find("\r\n", headerBegin);
-  size_t valueBegin = headerBegin + prefix.size();
-  return std::string(&request[valueBegin], headerEnd - valueBegin);
-}
+      if (lineEnd == std::string::npos || lineEnd == lineBegin) {
+        break;
+      }
+
+      size_t colon = request.find(':', lineBegin);
+
+      if (colon < lineEnd) {
+        size_t valueBegin = request.find_first_not_of(' ', colon + 1);
+        std::string name = request.substr(lineBegin, colon - lineBegin);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        headers[name] = request.substr(valueBegin, lineEnd - std::min(valueBegin, lineEnd));
+      }
+
+      lineBegin = lineEnd;
+    }
+  }
 
-struct HeaderCarrier : opentelemetry::context::propagation::TextMapCarrier {
   nostd::string_view Get(nostd::string_view key) const noexcept override {
-    if (key == "traceparent") {
-      return traceparent;
+    /* b3multi asks for X-B3-TraceId and the like. */
+    std::string name(key.data(), key.size());
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    auto header = headers.find(name);
+
+    if (header == headers.end()) {
+      return nostd::string_view();
     }
 
-    return nostd::string_view();
+    return header->second;
   }
 
   void Set(nostd::string_view key, nostd::string_view value) noexcept override {
     /* Not used in the server example */
   }
 
-  std::string traceparent;
+  std::map<std::string, std::string> headers;
 };
 
 int main(int argc, char** argv) {
+  int port = kPort;
+  bool tracing = true;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--port=", 7) == 0) {
+      port = atoi(argv[i] + 7);
+    } else if (strcmp(argv[i], "--no-tracing") == 0) {
+      tracing = false;
+    } else {
+      fprintf(stderr, "usage: http_server [--port=%d] [--no-tracing]\n", kPort);
+      return 2;
+    }
+  }
+
   /* Initialize OpenTelemetry */
-  splunk::OpenTelemetryOptions otelOptions =
-    splunk::OpenTelemetryOptions().WithServiceName("my-service");
-  splunk::InitOpentelemetry(otelOptions);
+  if (tracing) {
+    splunk::OpenTelemetryOptions otelOptions =
+      splunk::OpenTelemetryOptions().WithServiceName("my-service");
+    splunk::InitOpentelemetry(otelOptions);
+  }
 
   /* Server setup */
   int sfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -75,7 +118,7 @@ int main(int argc, char** argv) {
 
   struct sockaddr_in serverAddr = {0};
   serverAddr.sin_family = AF_INET;
-  serverAddr.sin_port = htons(kPort);
+  serverAddr.sin_port = htons(port);
   serverAddr.sin_addr.s_addr = INADDR_ANY;
 
   if (bind(sfd, (struct sockaddr*)&serverAddr, sizeof(struct sockaddr)) == -1) {
@@ -107,8 +150,7 @@ int main(int argc, char** argv) {
     }
 
     /* Parse the parent span context */
-    HeaderCarrier carrier;
-    carrier.traceparent = ParsePropagationHeader(std::string(requestBuffer, bytesRead));
+    HeaderCarrier carrier(std::string(requestBuffer, bytesRead));
 
     auto currentContext = opentelemetry::context::RuntimeContext::GetCurrent();
     auto parentContext =
@@ -134,9 +176,13 @@ int main(int argc, char** argv) {
        {"http.host", "localhost"}},
       startOptions);
 
-    const std::string response = "HTTP/1.1 200 OK\r\n\r\n";
+    const std::string response = "HTTP/1.1 200 OK\r\n"
+                                 "Content-Length: 0\r\n"
+                                 "Connection: close\r\n"
+                                 "\r\n";
 
     SocketWrite(clientFd, response.data(), response.size());
+    close(clientFd);
 
     span->End();
   }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "splunk_export.h"
+#include <opentelemetry/trace/tracer.h>
+
+namespace splunk {
+
+/*
+ * Take span timestamps from the clock chosen with OpenTelemetryOptions::WithSpanClock:
+ *
+ *   opentelemetry::trace::StartSpanOptions startOptions;
+ *   splunk::SetStartTime(startOptions);
+ *   auto span = tracer->StartSpan("operation", startOptions);
+ *   ...
+ *   opentelemetry::trace::EndSpanOptions endOptions;
+ *   splunk::SetEndTime(endOptions);
+ *   span->End(endOptions);
+ *
+ * With the default clock the options are left unset and the SDK reads the clocks itself.
+ * splunk::ScopedSpan does this for every span it starts.
+ */
+SPLUNK_EXPORT void SetStartTime(opentelemetry::trace::StartSpanOptions& options) noexcept;
+SPLUNK_EXPORT void SetEndTime(opentelemetry::trace::EndSpanOptions& options) noexcept;
+
+} // namespace splunk
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "splunk_export.h"
+#include <opentelemetry/context/runtime_context.h>
+#include <opentelemetry/trace/span.h>
+
+#include <cstddef>
+
+namespace splunk {
+
+/*
+ * Makes a context, or a span, current until the scope is destroyed. Equivalent to
+ * opentelemetry::context::RuntimeContext::Attach and Tracer::WithActiveSpan, but with the
+ * context storage installed by InitOpentelemetry it allocates neither a Token nor, for spans,
+ * a Context until something reads the current context.
+ *
+ * Scopes must be destroyed on the thread which created them, in reverse order of creation.
+ */
+class SPLUNK_EXPORT ContextScope {
+public:
+  explicit ContextScope(const opentelemetry::context::Context& context) noexcept;
+  explicit ContextScope(
+    const opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span>& span) noexcept;
+  ~ContextScope();
+
+  ContextScope(const ContextScope&) = delete;
+  ContextScope& operator=(const ContextScope&) = delete;
+
+private:
+  /* Depth of the thread's context stack before this scope, unused with the fallback. */
+  size_t depth_ = 0;
+  /* Set when a different context storage is installed. */
+  opentelemetry::nostd::unique_ptr<opentelemetry::context::Token> token_;
+};
+
+} // namespace splunk
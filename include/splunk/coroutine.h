@@ -0,0 +1,144 @@
+#pragma once
+
+/*
+ * C++20 only. Keeps the active context with a coroutine instead of with the thread that
+ * happens to be running it, so it survives a co_await which resumes on another thread.
+ */
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <splunk/context.h>
+
+#include <opentelemetry/context/runtime_context.h>
+#include <opentelemetry/trace/span.h>
+
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace splunk {
+
+/* co_await inside a coroutine using ContextPromise to make span active for the rest of it. */
+struct ActivateSpan {
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span;
+};
+
+namespace detail {
+
+template <typename Awaitable>
+decltype(auto) GetAwaiter(Awaitable&& awaitable) {
+  if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+    return std::forward<Awaitable>(awaitable).operator co_await();
+  } else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); }) {
+    return operator co_await(std::forward<Awaitable>(awaitable));
+  } else {
+    return std::forward<Awaitable>(awaitable);
+  }
+}
+
+} // namespace detail
+
+class ContextPromise;
+
+/*
+ * Wraps an awaiter: leaves the coroutine's context on the suspending thread and enters it
+ * again on the resuming one. References are kept as references, the awaitable of a co_await
+ * expression lives in the coroutine frame until it resumes.
+ */
+template <typename Awaiter>
+class ContextAwaiter {
+public:
+  ContextAwaiter(ContextPromise& promise, Awaiter&& awaiter) noexcept
+    : promise_(promise), awaiter_(std::forward<Awaiter>(awaiter)) {}
+
+  bool await_ready() noexcept(noexcept(awaiter_.await_ready())) { return awaiter_.await_ready(); }
+
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) noexcept(
+    noexcept(awaiter_.await_suspend(handle)));
+
+  decltype(auto) await_resume() noexcept(noexcept(awaiter_.await_resume()));
+
+private:
+  ContextPromise& promise_;
+  Awaiter awaiter_;
+};
+
+/*
+ * Mixin for coroutine promise types. The context current when the coroutine is created is
+ * made current whenever the coroutine runs, on whichever thread, and removed when it
+ * suspends. Entering it is a push onto the thread's context stack, no allocation is made per
+ * resume once InitOpentelemetry has installed the Splunk context storage.
+ *
+ * initial_suspend and final_suspend suspend always; promises which need other awaiters
+ * should return them through WrapAwaiter. A promise defining its own await_transform must
+ * pass the result through ContextPromise::await_transform.
+ *
+ * Within the coroutine, change the active span with co_await splunk::ActivateSpan{span}
+ * rather than ContextScope or Tracer::WithActiveSpan, which are bound to a thread.
+ */
+class ContextPromise {
+public:
+  ContextPromise() : context_(opentelemetry::context::RuntimeContext::GetCurrent()) {}
+
+  template <typename Awaiter>
+  ContextAwaiter<Awaiter> WrapAwaiter(Awaiter&& awaiter) noexcept {
+    return ContextAwaiter<Awaiter>(*this, std::forward<Awaiter>(awaiter));
+  }
+
+  auto initial_suspend() noexcept { return WrapAwaiter(std::suspend_always()); }
+  auto final_suspend() noexcept { return WrapAwaiter(std::suspend_always()); }
+
+  template <typename Awaitable>
+  auto await_transform(Awaitable&& awaitable) {
+    using Awaiter = decltype(detail::GetAwaiter(std::forward<Awaitable>(awaitable)));
+    return ContextAwaiter<Awaiter>(
+      *this, detail::GetAwaiter(std::forward<Awaitable>(awaitable)));
+  }
+
+  std::suspend_never await_transform(ActivateSpan activate) {
+    context_ = context_.SetValue(opentelemetry::trace::kSpanKey, activate.span);
+
+    if (scope_) {
+      scope_.reset();
+      scope_.emplace(context_);
+    }
+
+    return {};
+  }
+
+  const opentelemetry::context::Context& GetContext() const { return context_; }
+
+  void Enter() noexcept {
+    if (!scope_) {
+      scope_.emplace(context_);
+    }
+  }
+
+  void Leave() noexcept { scope_.reset(); }
+
+private:
+  opentelemetry::context::Context context_;
+  std::optional<ContextScope> scope_;
+};
+
+template <typename Awaiter>
+template <typename Promise>
+decltype(auto) ContextAwaiter<Awaiter>::await_suspend(
+  std::coroutine_handle<Promise> handle) noexcept(noexcept(awaiter_.await_suspend(handle))) {
+  /* Once the inner awaiter has the handle, the coroutine may already be running elsewhere. */
+  promise_.Leave();
+  return awaiter_.await_suspend(handle);
+}
+
+template <typename Awaiter>
+decltype(auto) ContextAwaiter<Awaiter>::await_resume() noexcept(
+  noexcept(awaiter_.await_resume())) {
+  promise_.Enter();
+  return awaiter_.await_resume();
+}
+
+} // namespace splunk
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "splunk_export.h"
+#include <opentelemetry/nostd/string_view.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace splunk {
+
+struct LogScope;
+
+/* Severity numbers of the OpenTelemetry log data model. */
+enum class LogSeverity : uint8_t {
+  Trace = 1,
+  Debug = 5,
+  Info = 9,
+  Warn = 13,
+  Error = 17,
+  Fatal = 21,
+};
+
+/* Key and value are only read during Emit. */
+struct LogAttribute {
+  opentelemetry::nostd::string_view key;
+  opentelemetry::nostd::string_view value;
+};
+
+/*
+ * Emits log records stamped with the trace and span IDs of the active span. Emit copies the
+ * record into a buffer of the calling thread, reusing the memory of records already exported,
+ * and never blocks: when the export thread falls behind and the buffer is full the record is
+ * dropped. Default constructed loggers, and all loggers while no logs exporter is set, ignore
+ * what is emitted.
+ */
+class SPLUNK_EXPORT Logger {
+public:
+  Logger() = default;
+
+  /* A relaxed load, check it before formatting an expensive body. */
+  bool IsEnabled(LogSeverity severity) const noexcept;
+
+  void Emit(
+    LogSeverity severity, opentelemetry::nostd::string_view body,
+    std::initializer_list<LogAttribute> attributes = {}) noexcept;
+
+private:
+  friend class LoggerProvider;
+
+  explicit Logger(const LogScope* scope) : scope_(scope) {}
+
+  const LogScope* scope_ = nullptr;
+};
+
+/*
+ * Process-wide. Its loggers are exported by the batch log processor installed by
+ * InitOpentelemetry when a logs exporter is set.
+ */
+class SPLUNK_EXPORT LoggerProvider {
+public:
+  static LoggerProvider& Get();
+
+  /* Loggers of the same name and version share their scope. Takes a lock, keep the result. */
+  Logger GetLogger(const std::string& name, const std::string& version = "");
+
+  /* Records dropped because their thread's buffer was full. */
+  uint64_t DroppedRecords() const;
+
+private:
+  LoggerProvider() = default;
+};
+
+} // namespace splunk
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "splunk_export.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace splunk {
+
+class CounterStorage;
+class HistogramStorage;
+class MetricRegistry;
+
+/* Attributes of every data point an instrument records. */
+using MetricAttributes = std::map<std::string, std::string>;
+
+/*
+ * Monotonic sum. Add is lock-free: each thread adds to its own cache line of the counter and
+ * the cells are only summed when metrics are exported. Default constructed counters ignore
+ * what is added.
+ */
+class SPLUNK_EXPORT Counter {
+public:
+  Counter() = default;
+
+  void Add(uint64_t value) noexcept;
+
+private:
+  friend class Meter;
+
+  explicit Counter(CounterStorage* storage) : storage_(storage) {}
+
+  CounterStorage* storage_ = nullptr;
+};
+
+/* Distribution over fixed bucket boundaries, recorded lock-free like Counter. */
+class SPLUNK_EXPORT Histogram {
+public:
+  Histogram() = default;
+
+  void Record(double value) noexcept;
+
+private:
+  friend class Meter;
+
+  explicit Histogram(HistogramStorage* storage) : storage_(storage) {}
+
+  HistogramStorage* storage_ = nullptr;
+};
+
+/*
+ * Creates the instruments of one instrumentation library. Attributes are bound when an
+ * instrument is created: each distinct set is its own instrument and becomes one data point
+ * of the metric named by name. Creating an instrument takes a lock, keep the result.
+ * Instruments live for the rest of the process.
+ */
+class SPLUNK_EXPORT Meter {
+public:
+  Counter CreateCounter(
+    const std::string& name, const std::string& description = "", const std::string& unit = "",
+    const MetricAttributes& attributes = {});
+
+  /* boundaries are sorted on creation, values above the last one go into an overflow bucket. */
+  Histogram CreateHistogram(
+    const std::string& name, const std::vector<double>& boundaries,
+    const std::string& description = "", const std::string& unit = "",
+    const MetricAttributes& attributes = {});
+
+private:
+  friend class MeterProvider;
+
+  Meter(MetricRegistry* registry, std::string library, std::string version)
+    : registry_(registry), library_(std::move(library)), version_(std::move(version)) {}
+
+  MetricRegistry* registry_;
+  std::string library_;
+  std::string version_;
+};
+
+/*
+ * Process-wide. Its instruments are exported by the metric reader installed by
+ * InitOpentelemetry when metrics are enabled, and recorded without being exported otherwise.
+ */
+class SPLUNK_EXPORT MeterProvider {
+public:
+  static MeterProvider& Get();
+
+  Meter GetMeter(const std::string& library, const std::string& version = "");
+
+private:
+  MeterProvider() = default;
+};
+
+} // namespace splunk
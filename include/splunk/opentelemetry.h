@@ -2,10 +2,18 @@
 
 #include "splunk_config.h"
 #include "splunk_export.h"
+#include <splunk/logs.h>
+#include <splunk/metrics.h>
 #include <opentelemetry/exporters/otlp/otlp_grpc_exporter.h>
 #include <opentelemetry/sdk/resource/resource.h>
 #include <opentelemetry/trace/provider.h>
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace splunk {
 
 enum PropagatorType {
@@ -24,6 +32,130 @@ enum ExporterType {
 #endif
 };
 
+/* What happens to the pipeline in the child of a fork(). */
+enum ForkMode {
+  /* Not fork-safe, only the parent exports spans. */
+  ForkMode_None,
+  /* Each child restarts the export thread and opens its own connection to the collector. */
+  ForkMode_Reinitialize,
+  /*
+   * Children send spans to the parent, which exports them over its connection. OTLP only. A
+   * child's FlushResult counts the spans it handed to the parent, the parent's Shutdown and
+   * pipeline stats count the children's spans it exported or dropped.
+   */
+  ForkMode_ParentExporter,
+};
+
+/* Where span data is recorded until it is exported. */
+enum SpanAllocation {
+  /* Directly into a recordable of the exporter, allocated when the span starts. */
+  SpanAllocation_Default,
+  /* Into buffers taken from a pool of the thread starting the span and reused after export. */
+  SpanAllocation_Pooled,
+};
+
+/* Clock read for the start and end of spans, see <splunk/clock.h>. */
+enum SpanClock {
+  /* std::chrono::system_clock and steady_clock, read by the SDK. */
+  SpanClock_Default,
+  /*
+   * The CPU's invariant timestamp counter, calibrated against the kernel clocks at startup and
+   * every second after. Falls back to the default where the counter isn't invariant.
+   */
+  SpanClock_Tsc,
+  /* CLOCK_REALTIME_COARSE and CLOCK_MONOTONIC_COARSE, only as precise as the kernel tick. */
+  SpanClock_Coarse,
+};
+
+/* Where the instruments of splunk::MeterProvider are exported, see <splunk/metrics.h>. */
+enum MetricsExporter {
+  /* $OTEL_METRICS_EXPORTER, none when unset. */
+  MetricsExporter_Default,
+  /* Instruments record but nothing is exported. */
+  MetricsExporter_None,
+  /* Periodically to otlpEndpoint, with the resource of the spans. */
+  MetricsExporter_Otlp,
+};
+
+/*
+ * Whether every span, sampled or not, is counted in call count and duration metrics per span
+ * name, kind and status. Requires the OTLP endpoint, the metrics are exported with the other
+ * metrics every metricExportInterval.
+ */
+enum SpanMetrics {
+  /* $SPLUNK_SPAN_METRICS, disabled when unset. */
+  SpanMetrics_Default,
+  SpanMetrics_Disabled,
+  SpanMetrics_Enabled,
+};
+
+/* Whether the PipelineStats of the span pipeline are also exported as metrics. */
+enum PipelineMetrics {
+  /* $SPLUNK_PIPELINE_METRICS, disabled when unset. */
+  PipelineMetrics_Default,
+  PipelineMetrics_Disabled,
+  /* With the other metrics every metricExportInterval, to otlpEndpoint. */
+  PipelineMetrics_Enabled,
+};
+
+/* Where the records of splunk::LoggerProvider are exported, see <splunk/logs.h>. */
+enum LogsExporter {
+  /* $OTEL_LOGS_EXPORTER, none when unset. */
+  LogsExporter_Default,
+  /* Loggers are disabled. */
+  LogsExporter_None,
+  /* In batches to otlpEndpoint, with the resource of the spans. */
+  LogsExporter_Otlp,
+};
+
+/* Whether the call stacks of the process are sampled and exported, see CPU profiling in README. */
+enum CpuProfiler {
+  /* $SPLUNK_PROFILER_ENABLED, disabled when unset. */
+  CpuProfiler_Default,
+  CpuProfiler_Disabled,
+  /* Profiles are exported as OTLP log records to otlpEndpoint. */
+  CpuProfiler_Enabled,
+};
+
+/* What sampled spans record of their thread's resource usage, see Span resource usage in README. */
+enum SpanResourceUsage {
+  /* $SPLUNK_SPAN_RESOURCE_USAGE, disabled when unset. */
+  SpanResourceUsage_Default,
+  SpanResourceUsage_Disabled,
+  /* CPU time and context switches. */
+  SpanResourceUsage_Enabled,
+  /*
+   * Also bytes allocated through operator new. Requires a build with SPLUNK_CPP_ALLOCATION_HOOKS,
+   * otherwise the same as SpanResourceUsage_Enabled.
+   */
+  SpanResourceUsage_Allocations,
+};
+
+/* Whether allocations made through operator new are sampled, see Memory profiling in README. */
+enum MemoryProfiler {
+  /* $SPLUNK_PROFILER_MEMORY_ENABLED, disabled when unset. */
+  MemoryProfiler_Default,
+  MemoryProfiler_Disabled,
+  /* Requires a build with SPLUNK_CPP_ALLOCATION_HOOKS, otherwise nothing is sampled. */
+  MemoryProfiler_Enabled,
+};
+
+/*
+ * Caps on what a single span records, enforced as it is recorded. Unset limits fall back to the
+ * config file, then to the OTEL_SPAN_*_LIMIT variables, then to the defaults of the
+ * OpenTelemetry specification: 128 attributes, events and links and no value length limit.
+ * UINT32_MAX or more means unlimited.
+ */
+struct SpanLimits {
+  static const int64_t kUnset = -1;
+
+  int64_t attributeCount = kUnset;
+  /* String values, and each string of an array, are truncated to this many bytes. */
+  int64_t attributeValueLength = kUnset;
+  int64_t eventCount = kUnset;
+  int64_t linkCount = kUnset;
+};
+
 struct SPLUNK_EXPORT OpenTelemetryOptions {
   opentelemetry::sdk::resource::ResourceAttributes resourceAttributes;
   ExporterType exporterType = ExporterType_None;
@@ -33,6 +165,40 @@ struct SPLUNK_EXPORT OpenTelemetryOptions {
   std::string jaegerEndpoint;
   /* Access token is only required when not using Splunk OpenTelemetry Connector */
   std::string accessToken;
+  /* JSON config file, see README for the format. Defaults to $SPLUNK_CONFIG_FILE. */
+  std::string configFile;
+  /* Defaults to $SPLUNK_FORK_MODE. */
+  ForkMode forkMode = ForkMode_None;
+  /* Caches detected host and container attributes across launches. Defaults to
+   * $SPLUNK_RESOURCE_CACHE_FILE. */
+  std::string resourceCacheFile;
+  /* Resource detectors still running after this long are ignored. */
+  std::chrono::milliseconds resourceDetectionTimeout = std::chrono::milliseconds(200);
+  /* Defaults to $SPLUNK_SPAN_ALLOCATION. */
+  SpanAllocation spanAllocation = SpanAllocation_Default;
+  SpanLimits spanLimits;
+  /* Defaults to $SPLUNK_SPAN_CLOCK. */
+  SpanClock spanClock = SpanClock_Default;
+  MetricsExporter metricsExporter = MetricsExporter_Default;
+  /* Defaults to $OTEL_METRIC_EXPORT_INTERVAL, then 60 seconds. */
+  std::chrono::milliseconds metricExportInterval = std::chrono::milliseconds(0);
+  SpanMetrics spanMetrics = SpanMetrics_Default;
+  PipelineMetrics pipelineMetrics = PipelineMetrics_Default;
+  LogsExporter logsExporter = LogsExporter_Default;
+  /* Defaults to $OTEL_BLRP_SCHEDULE_DELAY, then 1 second. */
+  std::chrono::milliseconds logScheduleDelay = std::chrono::milliseconds(0);
+  /* Records buffered per thread. Defaults to $OTEL_BLRP_MAX_QUEUE_SIZE, then 2048. */
+  uint32_t logBufferSize = 0;
+  CpuProfiler cpuProfiler = CpuProfiler_Default;
+  /* CPU time between samples. Defaults to $SPLUNK_PROFILER_CALL_STACK_INTERVAL, then 10ms. */
+  std::chrono::milliseconds profilerSamplingInterval = std::chrono::milliseconds(0);
+  MemoryProfiler memoryProfiler = MemoryProfiler_Default;
+  /*
+   * Mean bytes allocated between two samples. Defaults to $SPLUNK_PROFILER_MEMORY_SAMPLE_BYTES,
+   * then 512 KiB.
+   */
+  uint32_t memoryProfilerSampleBytes = 0;
+  SpanResourceUsage spanResourceUsage = SpanResourceUsage_Default;
 
   OpenTelemetryOptions& WithServiceName(const std::string& serviceName);
   OpenTelemetryOptions& WithDeploymentEnvironment(const std::string& deploymentEnvironment);
@@ -41,10 +207,138 @@ struct SPLUNK_EXPORT OpenTelemetryOptions {
   OpenTelemetryOptions& WithOtlpEndpoint(const std::string& endpoint);
   OpenTelemetryOptions& WithJaegerEndpoint(const std::string& endpoint);
   OpenTelemetryOptions& WithPropagators(PropagatorType flags);
+  OpenTelemetryOptions& WithConfigFile(const std::string& path);
+  OpenTelemetryOptions& WithForkMode(ForkMode mode);
+  OpenTelemetryOptions& WithResourceCacheFile(const std::string& path);
+  OpenTelemetryOptions& WithResourceDetectionTimeout(std::chrono::milliseconds timeout);
+  OpenTelemetryOptions& WithSpanAllocation(SpanAllocation allocation);
+  OpenTelemetryOptions& WithSpanLimits(const SpanLimits& limits);
+  OpenTelemetryOptions& WithSpanClock(SpanClock clock);
+  OpenTelemetryOptions& WithMetricsExporter(MetricsExporter exporter);
+  OpenTelemetryOptions& WithMetricExportInterval(std::chrono::milliseconds interval);
+  OpenTelemetryOptions& WithSpanMetrics(SpanMetrics mode);
+  OpenTelemetryOptions& WithPipelineMetrics(PipelineMetrics mode);
+  OpenTelemetryOptions& WithLogsExporter(LogsExporter exporter);
+  OpenTelemetryOptions& WithLogScheduleDelay(std::chrono::milliseconds delay);
+  OpenTelemetryOptions& WithLogBufferSize(uint32_t size);
+  OpenTelemetryOptions& WithCpuProfiler(CpuProfiler mode);
+  OpenTelemetryOptions& WithProfilerSamplingInterval(std::chrono::milliseconds interval);
+  OpenTelemetryOptions& WithMemoryProfiler(MemoryProfiler mode);
+  OpenTelemetryOptions& WithMemoryProfilerSampleBytes(uint32_t bytes);
+  OpenTelemetryOptions& WithSpanResourceUsage(SpanResourceUsage mode);
+};
+
+struct FlushResult {
+  /* Everything queued before the call was exported before the deadline. */
+  bool completed = false;
+  size_t exportedSpans = 0;
+  /* Spans lost to export failures or, on shutdown, still queued when the deadline expired. */
+  size_t droppedSpans = 0;
+  /* Flush only: spans left in the queue for the background exporter. */
+  size_t pendingSpans = 0;
+};
+
+/* Totals since InitOpentelemetry of what the span limits cut. */
+struct SpanLimitStats {
+  uint64_t droppedAttributes = 0;
+  /* Attributes whose value was shortened to the length limit. */
+  uint64_t truncatedAttributes = 0;
+  uint64_t droppedEvents = 0;
+  uint64_t droppedLinks = 0;
+};
+
+/* Distribution in PipelineStats, counts[i] counts values in (boundaries[i - 1], boundaries[i]]. */
+struct PipelineHistogram {
+  std::vector<double> boundaries;
+  std::vector<uint64_t> counts;
+  uint64_t count = 0;
+  double sum = 0;
+};
+
+/*
+ * Totals since InitOpentelemetry of what went through the span pipeline, to tell whether
+ * missing spans were not sampled, dropped by a full queue or lost to failed exports.
+ */
+struct PipelineStats {
+  /* Spans the sampler decided on, that is every span started. */
+  uint64_t spansStarted = 0;
+  /* Started spans the sampler didn't sample, never exported. */
+  uint64_t spansNotSampled = 0;
+  /* Ended spans which reached the processor, including unsampled ones with span metrics. */
+  uint64_t spansEnded = 0;
+  uint64_t spansDroppedQueueFull = 0;
+  /* Ended after shutdown, or still queued when the shutdown deadline expired. */
+  uint64_t spansDroppedShutdown = 0;
+  uint64_t spansExported = 0;
+  /* Spans of export calls which failed. */
+  uint64_t spansExportFailed = 0;
+  /* Serialized size of the spans exported over OTLP, without the request envelope. */
+  uint64_t bytesSent = 0;
+  /* Spans waiting for export when the stats were read, and the current queue limit. */
+  uint64_t queueSize = 0;
+  uint64_t queueCapacity = 0;
+  /* Spans per export call. */
+  PipelineHistogram batchSize;
+  /* Milliseconds per export call, failed or not. */
+  PipelineHistogram exportDuration;
+};
+
+/*
+ * Returned by InitOpentelemetry. Dereferences to the installed TracerProvider and allows
+ * flushing and shutting down the pipeline within a deadline. Queued spans are exported oldest
+ * first, using parallel export calls when the exporter supports it.
+ *
+ * A default constructed handle has no pipeline, to be assigned one later: it is false, its
+ * provider is a no-op one, its stats are zero and Flush and Shutdown return completed=false.
+ */
+class SPLUNK_EXPORT OpenTelemetryHandle {
+public:
+  struct State;
+
+  OpenTelemetryHandle() = default;
+  explicit OpenTelemetryHandle(std::shared_ptr<State> state);
+
+  explicit operator bool() const { return state_ != nullptr; }
+
+  opentelemetry::trace::TracerProvider* operator->() const;
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::TracerProvider> GetTracerProvider() const;
+  operator opentelemetry::nostd::shared_ptr<opentelemetry::trace::TracerProvider>() const {
+    return GetTracerProvider();
+  }
+
+  const opentelemetry::sdk::resource::Resource& GetResource() const;
+
+  SpanLimitStats GetSpanLimitStats() const;
+
+  /* Reads a few relaxed atomics per counter, cheap enough to poll. */
+  PipelineStats GetPipelineStats() const;
+
+  FlushResult Flush(std::chrono::steady_clock::time_point deadline);
+  FlushResult Flush(std::chrono::milliseconds timeout) {
+    return Flush(std::chrono::steady_clock::now() + timeout);
+  }
+
+  /* Always available, its instruments are only exported when a metrics exporter is set. */
+  MeterProvider& GetMeterProvider() const;
+
+  /* Always available, its loggers are disabled unless a logs exporter is set. */
+  LoggerProvider& GetLoggerProvider() const;
+
+  /*
+   * Stops accepting spans, exports what is queued until the deadline and drops the rest. Metrics
+   * are exported one last time, buffered log records are exported and loggers disabled, the CPU
+   * profiler stops and exports its last profile.
+   */
+  FlushResult Shutdown(std::chrono::steady_clock::time_point deadline);
+  FlushResult Shutdown(std::chrono::milliseconds timeout) {
+    return Shutdown(std::chrono::steady_clock::now() + timeout);
+  }
+
+private:
+  std::shared_ptr<State> state_;
 };
 
 SPLUNK_EXPORT
-opentelemetry::nostd::shared_ptr<opentelemetry::trace::TracerProvider>
-InitOpentelemetry(const OpenTelemetryOptions& options = {});
+OpenTelemetryHandle InitOpentelemetry(const OpenTelemetryOptions& options = {});
 
 } // namespace splunk
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <splunk/context.h>
+
+#include <opentelemetry/context/runtime_context.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace splunk {
+
+/*
+ * Callable which runs f with the context that was current when it was created, see
+ * BindContext. Copyable when F is; holds F and the context by value, so binding allocates
+ * nothing beyond what copying F does.
+ */
+template <typename F>
+class ContextBound {
+public:
+  explicit ContextBound(F f)
+    : f_(std::move(f)), context_(opentelemetry::context::RuntimeContext::GetCurrent()) {}
+
+  template <typename... Args>
+  auto operator()(Args&&... args) -> decltype(std::declval<F&>()(std::forward<Args>(args)...)) {
+    ContextScope scope(context_);
+    return f_(std::forward<Args>(args)...);
+  }
+
+private:
+  F f_;
+  opentelemetry::context::Context context_;
+};
+
+/* Captures the current context, for callables which run later or on another thread. */
+template <typename F>
+ContextBound<typename std::decay<F>::type> BindContext(F&& f) {
+  return ContextBound<typename std::decay<F>::type>(std::forward<F>(f));
+}
+
+/*
+ * Move-only void() task for thread pool queues, running its callable with the context that
+ * was current when the task was created. Callables up to kInlineSize bytes are stored inside
+ * the task, larger ones are moved to the heap.
+ */
+class ContextTask {
+public:
+  static const size_t kInlineSize = 4 * sizeof(void*);
+
+  ContextTask() noexcept = default;
+
+  template <
+    typename F, typename Callable = typename std::decay<F>::type,
+    typename = typename std::enable_if<!std::is_same<Callable, ContextTask>::value>::type>
+  ContextTask(F&& f) : context_(opentelemetry::context::RuntimeContext::GetCurrent()) {
+    Construct<Callable>(std::forward<F>(f), IsInline<Callable>());
+  }
+
+  ContextTask(ContextTask&& other) noexcept : context_(std::move(other.context_)) {
+    MoveFrom(other);
+  }
+
+  ContextTask& operator=(ContextTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      context_ = std::move(other.context_);
+      MoveFrom(other);
+    }
+
+    return *this;
+  }
+
+  ContextTask(const ContextTask&) = delete;
+  ContextTask& operator=(const ContextTask&) = delete;
+
+  ~ContextTask() { Reset(); }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+  void operator()() {
+    ContextScope scope(context_);
+    ops_->invoke(&storage_);
+  }
+
+private:
+  struct Ops {
+    void (*invoke)(void* storage);
+    /* Moves the callable from one storage to another and destroys the source. */
+    void (*relocate)(void* from, void* to);
+    void (*destroy)(void* storage);
+  };
+
+  typedef typename std::aligned_storage<kInlineSize, alignof(void*)>::type Storage;
+
+  template <typename Callable>
+  using IsInline = std::integral_constant<
+    bool, sizeof(Callable) <= sizeof(Storage) && alignof(Callable) <= alignof(Storage) &&
+            std::is_nothrow_move_constructible<Callable>::value>;
+
+  template <typename Callable>
+  struct InlineOps {
+    static Callable& Get(void* storage) { return *static_cast<Callable*>(storage); }
+
+    static void Invoke(void* storage) { Get(storage)(); }
+
+    static void Relocate(void* from, void* to) {
+      new (to) Callable(std::move(Get(from)));
+      Get(from).~Callable();
+    }
+
+    static void Destroy(void* storage) { Get(storage).~Callable(); }
+
+    static const Ops ops;
+  };
+
+  template <typename Callable>
+  struct HeapOps {
+    static Callable*& Get(void* storage) { return *static_cast<Callable**>(storage); }
+
+    static void Invoke(void* storage) { (*Get(storage))(); }
+
+    static void Relocate(void* from, void* to) { new (to) Callable*(Get(from)); }
+
+    static void Destroy(void* storage) { delete Get(storage); }
+
+    static const Ops ops;
+  };
+
+  template <typename Callable, typename F>
+  void Construct(F&& f, std::true_type) {
+    new (&storage_) Callable(std::forward<F>(f));
+    ops_ = &InlineOps<Callable>::ops;
+  }
+
+  template <typename Callable, typename F>
+  void Construct(F&& f, std::false_type) {
+    new (&storage_) Callable*(new Callable(std::forward<F>(f)));
+    ops_ = &HeapOps<Callable>::ops;
+  }
+
+  void MoveFrom(ContextTask& other) noexcept {
+    ops_ = other.ops_;
+
+    if (ops_) {
+      ops_->relocate(&other.storage_, &storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  void Reset() noexcept {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  const Ops* ops_ = nullptr;
+  Storage storage_;
+  opentelemetry::context::Context context_;
+};
+
+template <typename Callable>
+const ContextTask::Ops ContextTask::InlineOps<Callable>::ops = {
+  &ContextTask::InlineOps<Callable>::Invoke, &ContextTask::InlineOps<Callable>::Relocate,
+  &ContextTask::InlineOps<Callable>::Destroy};
+
+template <typename Callable>
+const ContextTask::Ops ContextTask::HeapOps<Callable>::ops = {
+  &ContextTask::HeapOps<Callable>::Invoke, &ContextTask::HeapOps<Callable>::Relocate,
+  &ContextTask::HeapOps<Callable>::Destroy};
+
+/*
+ * Adapts an executor, anything callable with a task, so every submitted function runs with
+ * the context current at submission:
+ *
+ *   auto executor = splunk::MakeContextExecutor([&pool](std::function<void()> f) {
+ *     pool.Submit(std::move(f));
+ *   });
+ *   executor([] { tracer->StartSpan("child"); });
+ */
+template <typename Executor>
+class ContextExecutor {
+public:
+  explicit ContextExecutor(Executor executor) : executor_(std::move(executor)) {}
+
+  template <typename F>
+  void operator()(F&& f) {
+    executor_(BindContext(std::forward<F>(f)));
+  }
+
+private:
+  Executor executor_;
+};
+
+template <typename Executor>
+ContextExecutor<typename std::decay<Executor>::type> MakeContextExecutor(Executor&& executor) {
+  return ContextExecutor<typename std::decay<Executor>::type>(std::forward<Executor>(executor));
+}
+
+} // namespace splunk
@@ -0,0 +1,169 @@
+#pragma once
+
+/*
+ * Instrumentation macros which compile to nothing when SPLUNK_TRACING_ENABLED is 0, either
+ * for the whole build (-DSPLUNK_CPP_TRACING=OFF) or for single translation units defining it
+ * before this header is included. The macros then declare a splunk::disabled::ScopedSpan, a
+ * class of its own, so both kinds of translation units link into one program:
+ *
+ *   void HandleRequest(const Request& request) {
+ *     SPLUNK_SCOPED_SPAN(span, tracer, "HandleRequest");
+ *     SPLUNK_SPAN_ATTRIBUTE(span, splunk::semconv::kHttpMethod, request.method);
+ *     ...
+ *   }
+ *
+ * With tracing disabled, none of the macro arguments are evaluated.
+ */
+
+#include "splunk_config.h"
+
+#include <cstddef>
+
+#if SPLUNK_TRACING_ENABLED
+#include <splunk/clock.h>
+#include <splunk/context.h>
+
+#include <opentelemetry/trace/tracer.h>
+#endif
+
+namespace splunk {
+
+/*
+ * Attribute key known at compile time. Its length is computed by the compiler, nothing is
+ * measured or copied when it is passed to a span.
+ */
+class AttributeKey {
+public:
+  template <size_t N>
+  constexpr AttributeKey(const char (&key)[N]) : data_(key), size_(N - 1) {}
+
+  constexpr const char* data() const { return data_; }
+  constexpr size_t size() const { return size_; }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+/* Keys from the OpenTelemetry semantic conventions. */
+namespace semconv {
+
+constexpr AttributeKey kHttpMethod("http.method");
+constexpr AttributeKey kHttpUrl("http.url");
+constexpr AttributeKey kHttpTarget("http.target");
+constexpr AttributeKey kHttpHost("http.host");
+constexpr AttributeKey kHttpScheme("http.scheme");
+constexpr AttributeKey kHttpStatusCode("http.status_code");
+constexpr AttributeKey kHttpFlavor("http.flavor");
+constexpr AttributeKey kHttpUserAgent("http.user_agent");
+constexpr AttributeKey kHttpRoute("http.route");
+constexpr AttributeKey kHttpClientIp("http.client_ip");
+constexpr AttributeKey kNetTransport("net.transport");
+constexpr AttributeKey kNetPeerIp("net.peer.ip");
+constexpr AttributeKey kNetPeerName("net.peer.name");
+constexpr AttributeKey kNetPeerPort("net.peer.port");
+constexpr AttributeKey kNetHostName("net.host.name");
+constexpr AttributeKey kNetHostPort("net.host.port");
+constexpr AttributeKey kPeerService("peer.service");
+constexpr AttributeKey kDbSystem("db.system");
+constexpr AttributeKey kDbName("db.name");
+constexpr AttributeKey kDbStatement("db.statement");
+constexpr AttributeKey kDbOperation("db.operation");
+constexpr AttributeKey kRpcSystem("rpc.system");
+constexpr AttributeKey kRpcService("rpc.service");
+constexpr AttributeKey kRpcMethod("rpc.method");
+constexpr AttributeKey kMessagingSystem("messaging.system");
+constexpr AttributeKey kMessagingDestination("messaging.destination");
+constexpr AttributeKey kExceptionType("exception.type");
+constexpr AttributeKey kExceptionMessage("exception.message");
+constexpr AttributeKey kExceptionStacktrace("exception.stacktrace");
+constexpr AttributeKey kThreadId("thread.id");
+constexpr AttributeKey kThreadName("thread.name");
+constexpr AttributeKey kCodeFunction("code.function");
+constexpr AttributeKey kCodeNamespace("code.namespace");
+constexpr AttributeKey kCodeFilepath("code.filepath");
+constexpr AttributeKey kCodeLineno("code.lineno");
+constexpr AttributeKey kEnduserId("enduser.id");
+
+} // namespace semconv
+
+#if SPLUNK_TRACING_ENABLED
+
+/*
+ * Span which is active from construction until it is ended by the destructor. Its timestamps
+ * come from the clock chosen with OpenTelemetryOptions::WithSpanClock.
+ */
+class ScopedSpan {
+public:
+  ScopedSpan(
+    opentelemetry::trace::Tracer& tracer, opentelemetry::nostd::string_view name,
+    opentelemetry::trace::SpanKind kind = opentelemetry::trace::SpanKind::kInternal)
+    : span_(tracer.StartSpan(name, Options(kind))), scope_(span_) {}
+
+  ~ScopedSpan() {
+    opentelemetry::trace::EndSpanOptions options;
+    SetEndTime(options);
+    span_->End(options);
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+  void SetAttribute(const AttributeKey& key, const opentelemetry::common::AttributeValue& value) {
+    span_->SetAttribute(opentelemetry::nostd::string_view(key.data(), key.size()), value);
+  }
+
+  void AddEvent(opentelemetry::nostd::string_view name) { span_->AddEvent(name); }
+
+  void SetStatus(
+    opentelemetry::trace::StatusCode code, opentelemetry::nostd::string_view description = "") {
+    span_->SetStatus(code, description);
+  }
+
+  opentelemetry::trace::Span& GetSpan() { return *span_; }
+
+private:
+  static opentelemetry::trace::StartSpanOptions Options(opentelemetry::trace::SpanKind kind) {
+    opentelemetry::trace::StartSpanOptions options;
+    options.kind = kind;
+    SetStartTime(options);
+    return options;
+  }
+
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span_;
+  ContextScope scope_;
+};
+
+#endif
+
+/* What the macros declare with tracing disabled, never the same class as ScopedSpan. */
+namespace disabled {
+
+class ScopedSpan {
+public:
+  ScopedSpan() {}
+};
+
+} // namespace disabled
+
+} // namespace splunk
+
+#if SPLUNK_TRACING_ENABLED
+
+/* tracer points to a Tracer, followed by the span name and optionally a SpanKind. */
+#define SPLUNK_SCOPED_SPAN(var, tracer, ...) ::splunk::ScopedSpan var(*(tracer), __VA_ARGS__)
+#define SPLUNK_SPAN_ATTRIBUTE(var, key, value) (var).SetAttribute((key), (value))
+#define SPLUNK_SPAN_EVENT(var, name) (var).AddEvent(name)
+
+#else
+
+#define SPLUNK_SCOPED_SPAN(var, tracer, ...) ::splunk::disabled::ScopedSpan var
+/* sizeof keeps variables only used for the span from being reported as unused. */
+#define SPLUNK_SPAN_ATTRIBUTE(var, key, value)                                                     \
+  do {                                                                                             \
+    (void)(var);                                                                                   \
+    (void)sizeof((value), 0);                                                                      \
+  } while (false)
+#define SPLUNK_SPAN_EVENT(var, name) (void)(var)
+
+#endif
@@ -0,0 +1,147 @@
+#include "allocation_hooks.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+/*
+ * Replacements of every operator new and delete, built with SPLUNK_CPP_ALLOCATION_HOOKS so the
+ * allocation sampler sees them. malloc itself isn't hooked: glibc no longer has __malloc_hook
+ * and interposing malloc would take over the allocator of the whole process. The sized and
+ * aligned variants exist in the standards which have them.
+ */
+
+namespace {
+
+void* Allocate(size_t size) {
+  if (size == 0) {
+    size = 1;
+  }
+
+  void* address;
+
+  while (!(address = malloc(size))) {
+    std::new_handler handler = std::get_new_handler();
+
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+
+    handler();
+  }
+
+  splunk::OnAllocation(address, size);
+  return address;
+}
+
+#if __cpp_aligned_new
+void* AllocateAligned(size_t size, std::align_val_t alignment) {
+  if (size == 0) {
+    size = 1;
+  }
+
+  size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+  void* address;
+
+  while (posix_memalign(&address, align, size) != 0) {
+    std::new_handler handler = std::get_new_handler();
+
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+
+    handler();
+  }
+
+  splunk::OnAllocation(address, size);
+  return address;
+}
+#endif
+
+void Free(void* address) noexcept {
+  splunk::OnFree(address);
+  free(address);
+}
+
+} // namespace
+
+void* operator new(size_t size) { return Allocate(size); }
+
+void* operator new[](size_t size) { return Allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return Allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return Allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+#if __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return AllocateAligned(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  try {
+    return AllocateAligned(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  try {
+    return AllocateAligned(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+#endif
+
+void operator delete(void* address) noexcept { Free(address); }
+
+void operator delete[](void* address) noexcept { Free(address); }
+
+void operator delete(void* address, const std::nothrow_t&) noexcept { Free(address); }
+
+void operator delete[](void* address, const std::nothrow_t&) noexcept { Free(address); }
+
+#if __cpp_sized_deallocation
+void operator delete(void* address, size_t) noexcept { Free(address); }
+
+void operator delete[](void* address, size_t) noexcept { Free(address); }
+#endif
+
+#if __cpp_aligned_new
+void operator delete(void* address, std::align_val_t) noexcept { Free(address); }
+
+void operator delete[](void* address, std::align_val_t) noexcept { Free(address); }
+
+void operator delete(void* address, std::align_val_t, const std::nothrow_t&) noexcept {
+  Free(address);
+}
+
+void operator delete[](void* address, std::align_val_t, const std::nothrow_t&) noexcept {
+  Free(address);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void* address, size_t, std::align_val_t) noexcept { Free(address); }
+
+void operator delete[](void* address, size_t, std::align_val_t) noexcept { Free(address); }
+#endif
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace splunk {
+
+/* What the operator new replacements of allocation_hooks.cpp do besides allocating. */
+enum AllocationHook : uint32_t {
+  /* Set by AllocationSampler. */
+  AllocationHook_Sample = 1,
+  /* Set while spans record the bytes allocated in them, see resource_usage.h. */
+  AllocationHook_Count = 2,
+};
+
+/* Read by the replacements on every call. */
+extern std::atomic<uint32_t> allocationHooks;
+extern std::atomic<int64_t> sampledAllocationsLive;
+
+void SampleAllocation(void* address, size_t size) noexcept;
+void ForgetAllocation(void* address) noexcept;
+void CountAllocation(size_t size) noexcept;
+
+/* A relaxed load each while no hook is set. */
+inline void OnAllocation(void* address, size_t size) noexcept {
+  uint32_t hooks = allocationHooks.load(std::memory_order_relaxed);
+
+  if (hooks != 0) {
+    if (hooks & AllocationHook_Count) {
+      CountAllocation(size);
+    }
+
+    if (hooks & AllocationHook_Sample) {
+      SampleAllocation(address, size);
+    }
+  }
+}
+
+inline void OnFree(void* address) noexcept {
+  if (address && sampledAllocationsLive.load(std::memory_order_relaxed) > 0) {
+    ForgetAllocation(address);
+  }
+}
+
+} // namespace splunk
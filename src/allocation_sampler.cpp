@@ -0,0 +1,587 @@
+#include "allocation_sampler.h"
+
+#include "context_storage.h"
+#include "frame_walk.h"
+
+#include <opentelemetry/proto/metrics/v1/metrics.pb.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace proto = opentelemetry::proto;
+namespace sdkresource = opentelemetry::sdk::resource;
+
+namespace splunk {
+
+std::atomic<uint32_t> allocationHooks{0};
+std::atomic<int64_t> sampledAllocationsLive{0};
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+const size_t kMaxFrames = 64;
+const auto kExportTimeout = std::chrono::seconds(10);
+
+/* Sampled allocations in use at the same time, past half of it new samples aren't tracked. */
+const size_t kLiveCapacity = 1 << 15;
+const size_t kLiveProbes = 16;
+/* Address of a slot whose allocation was freed, probes continue past it. */
+const uintptr_t kTombstone = 1;
+
+/* Distinct stacks between two exports, the rest are counted in kOverflowStack. */
+const size_t kMaxStacks = 16384;
+const uint32_t kOverflowStack = 0;
+/* Spans with sampled allocations which haven't ended, and span names with a metric series. */
+const size_t kMaxPendingSpans = 4096;
+const size_t kMaxSpanNames = 1024;
+
+struct LiveRecord {
+  uint32_t stackId;
+  uint64_t count;
+  uint64_t bytes;
+};
+
+/*
+ * A slot is taken under the sampler's mutex, its record written before its address is
+ * published. Frees only swap a slot's address for kTombstone, without a lock.
+ */
+std::atomic<uintptr_t> liveAddresses[kLiveCapacity];
+LiveRecord liveRecords[kLiveCapacity];
+
+struct StackStats {
+  /* The hasSpan flag, span IDs and frames as raw bytes, empty for kOverflowStack. */
+  std::string key;
+  uint64_t allocatedCount;
+  uint64_t allocatedBytes;
+};
+
+struct Sampler {
+  std::mutex mutex;
+  /* Everything below is guarded by mutex. */
+  std::unordered_map<std::string, uint32_t> stackIds;
+  std::vector<StackStats> stacks{StackStats{std::string(), 0, 0}};
+  /* Estimated bytes allocated in each span not ended yet, by span ID. */
+  std::unordered_map<uint64_t, uint64_t> pendingSpans;
+  std::unordered_map<std::string, uint64_t> bytesBySpanName;
+  uint64_t overflowBytes = 0;
+  uint64_t unattributedBytes = 0;
+  std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+};
+
+/* Never destroyed, operator delete may look at the live table from static destructors. */
+Sampler& GetSampler() {
+  static Sampler* sampler = new Sampler();
+  return *sampler;
+}
+
+std::atomic<uint64_t> meanSampleBytes{512 * 1024};
+std::atomic<size_t> pendingSpanCount{0};
+
+/* Plain thread-local data, so reading it from operator new needs no initialization guard. */
+struct ThreadSampler {
+  int64_t bytesUntilSample;
+  uint64_t random;
+  /* Set while the thread holds the mutex, its own allocations are then not sampled. */
+  bool busy;
+};
+
+thread_local ThreadSampler threadSampler;
+
+/* Holds the sampler's mutex with sampling of the thread's allocations suspended. */
+class SamplerLock {
+public:
+  SamplerLock() : busy_(threadSampler.busy) {
+    threadSampler.busy = true;
+    GetSampler().mutex.lock();
+  }
+
+  ~SamplerLock() {
+    GetSampler().mutex.unlock();
+    threadSampler.busy = busy_;
+  }
+
+private:
+  const bool busy_;
+};
+
+/* Set while the thread which forks holds the mutex. */
+bool busyBeforeFork = false;
+
+/* Exponentially distributed with the given mean, from the thread's xorshift64* generator. */
+int64_t NextInterval(ThreadSampler& thread, double mean) {
+  thread.random ^= thread.random >> 12;
+  thread.random ^= thread.random << 25;
+  thread.random ^= thread.random >> 27;
+  double uniform =
+    static_cast<double>(((thread.random * 0x2545f4914f6cdd1dULL) >> 11) + 1) / 9007199254740992.0;
+  return static_cast<int64_t>(-std::log(uniform) * mean) + 1;
+}
+
+size_t LiveSlot(uintptr_t address) {
+  return static_cast<size_t>(((address >> 4) * 0x9e3779b97f4a7c15ULL) >> 49) & (kLiveCapacity - 1);
+}
+
+void TrackLive(uintptr_t address, const LiveRecord& record) {
+  if (sampledAllocationsLive.load(std::memory_order_relaxed) >=
+      static_cast<int64_t>(kLiveCapacity / 2)) {
+    return;
+  }
+
+  size_t slot = LiveSlot(address);
+
+  for (size_t probe = 0; probe < kLiveProbes; probe++, slot = (slot + 1) & (kLiveCapacity - 1)) {
+    uintptr_t current = liveAddresses[slot].load(std::memory_order_relaxed);
+
+    if (current == 0 || current == kTombstone) {
+      liveRecords[slot] = record;
+      sampledAllocationsLive.fetch_add(1, std::memory_order_relaxed);
+      liveAddresses[slot].store(address, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+uint32_t InternStack(Sampler& sampler, const std::string& key) {
+  auto it = sampler.stackIds.find(key);
+
+  if (it != sampler.stackIds.end()) {
+    return it->second;
+  }
+
+  if (sampler.stacks.size() >= kMaxStacks) {
+    return kOverflowStack;
+  }
+
+  uint32_t id = static_cast<uint32_t>(sampler.stacks.size());
+  sampler.stacks.push_back(StackStats{key, 0, 0});
+  sampler.stackIds.emplace(key, id);
+  return id;
+}
+
+/* Empties the live table, once nothing is sampled anymore. */
+void ClearLive() {
+  for (auto& address : liveAddresses) {
+    address.store(0, std::memory_order_relaxed);
+  }
+
+  sampledAllocationsLive.store(0, std::memory_order_relaxed);
+}
+
+void AddAttribute(
+  google::protobuf::RepeatedPtrField<proto::common::v1::KeyValue>* attributes, const char* key,
+  const std::string& value) {
+  proto::common::v1::KeyValue* keyValue = attributes->Add();
+  keyValue->set_key(key);
+  keyValue->mutable_value()->set_string_value(value);
+}
+
+} // namespace
+
+/* Not inlined, so the walk starts at the frame of operator new. */
+__attribute__((noinline)) void SampleAllocation(void* address, size_t size) noexcept {
+  ThreadSampler& thread = threadSampler;
+  thread.bytesUntilSample -= static_cast<int64_t>(size);
+
+  if (thread.bytesUntilSample > 0 || thread.busy) {
+    return;
+  }
+
+  double mean = static_cast<double>(meanSampleBytes.load(std::memory_order_relaxed));
+
+  /* The thread's first allocation only seeds its generator. */
+  if (thread.random == 0) {
+    thread.random =
+      (reinterpret_cast<uintptr_t>(&thread) ^
+       static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())) |
+      1;
+    thread.bytesUntilSample = NextInterval(thread, mean);
+    return;
+  }
+
+  thread.bytesUntilSample = NextInterval(thread, mean);
+
+  /*
+   * Callers built without frame pointers leave anything in the chain above operator new, the
+   * walk only reads the records it found readable.
+   */
+  uintptr_t frames[kMaxFrames];
+  uintptr_t fp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  size_t depth = WalkFrames(fp, fp, frames, 0, kMaxFrames);
+
+  ContextStorage::ActiveSpanIds span;
+  bool hasSpan = ContextStorage::ReadActiveSpanIds(&span);
+
+  if (!hasSpan) {
+    span = ContextStorage::ActiveSpanIds();
+  }
+
+  /* Each byte is sampled with probability 1 / mean, an allocation with at least one of them. */
+  double probability = 1 - std::exp(-static_cast<double>(size) / mean);
+  LiveRecord record{
+    kOverflowStack, static_cast<uint64_t>(std::llround(1 / probability)),
+    static_cast<uint64_t>(std::llround(static_cast<double>(size) / probability))};
+
+  SamplerLock lock;
+
+  if (!(allocationHooks.load(std::memory_order_relaxed) & AllocationHook_Sample)) {
+    return;
+  }
+
+  Sampler& sampler = GetSampler();
+
+  try {
+    std::string key(1, hasSpan ? 1 : 0);
+    key.append(reinterpret_cast<const char*>(&span), sizeof(span));
+    key.append(reinterpret_cast<const char*>(frames), depth * sizeof(frames[0]));
+    record.stackId = InternStack(sampler, key);
+
+    uint64_t spanKey;
+    memcpy(&spanKey, span.spanId, sizeof(spanKey));
+    auto it = hasSpan ? sampler.pendingSpans.find(spanKey) : sampler.pendingSpans.end();
+
+    if (it != sampler.pendingSpans.end()) {
+      it->second += record.bytes;
+    } else if (hasSpan && sampler.pendingSpans.size() < kMaxPendingSpans) {
+      sampler.pendingSpans.emplace(spanKey, record.bytes);
+      pendingSpanCount.store(sampler.pendingSpans.size(), std::memory_order_relaxed);
+    } else {
+      sampler.unattributedBytes += record.bytes;
+    }
+  } catch (const std::bad_alloc&) {
+    record.stackId = kOverflowStack;
+  }
+
+  StackStats& stats = sampler.stacks[record.stackId];
+  stats.allocatedCount += record.count;
+  stats.allocatedBytes += record.bytes;
+
+  TrackLive(reinterpret_cast<uintptr_t>(address), record);
+}
+
+void ForgetAllocation(void* address) noexcept {
+  uintptr_t target = reinterpret_cast<uintptr_t>(address);
+  size_t slot = LiveSlot(target);
+
+  for (size_t probe = 0; probe < kLiveProbes; probe++, slot = (slot + 1) & (kLiveCapacity - 1)) {
+    uintptr_t current = liveAddresses[slot].load(std::memory_order_relaxed);
+
+    if (current == 0) {
+      return;
+    }
+
+    if (current == target) {
+      if (liveAddresses[slot].compare_exchange_strong(
+            current, kTombstone, std::memory_order_relaxed)) {
+        sampledAllocationsLive.fetch_sub(1, std::memory_order_relaxed);
+      }
+
+      return;
+    }
+  }
+}
+
+AllocationSampler::AllocationSampler(
+  const std::string& otlpEndpoint, const sdkresource::Resource& resource, size_t sampleBytes,
+  std::chrono::milliseconds exportInterval, bool exportFromChildren)
+  : exportInterval_(exportInterval), exportFromChildren_(exportFromChildren),
+    exporter_(new ProfileExporter(otlpEndpoint, resource)) {
+  meanSampleBytes.store(std::max<size_t>(sampleBytes, 1), std::memory_order_relaxed);
+
+  {
+    SamplerLock lock;
+    GetSampler().start = std::chrono::system_clock::now();
+  }
+
+  worker_.Start(exportInterval_, [this] { Tick(); });
+  StartSampling();
+  RegisterForkHandler(this);
+}
+
+AllocationSampler::~AllocationSampler() {
+  UnregisterForkHandler(this);
+  StopSampling();
+  worker_.Stop();
+
+  SamplerLock lock;
+  ClearLive();
+}
+
+void AllocationSampler::StartSampling() {
+  if (!sampling_) {
+    ContextStorage::TrackActiveSpanIds(true);
+    sampling_ = true;
+  }
+
+  allocationHooks.fetch_or(AllocationHook_Sample, std::memory_order_relaxed);
+}
+
+void AllocationSampler::StopSampling() {
+  if (!sampling_) {
+    return;
+  }
+
+  allocationHooks.fetch_and(~AllocationHook_Sample, std::memory_order_relaxed);
+  ContextStorage::TrackActiveSpanIds(false);
+  sampling_ = false;
+}
+
+bool AllocationSampler::Shutdown(Deadline deadline) {
+  if (isShutdown_) {
+    return true;
+  }
+
+  isShutdown_ = true;
+  StopSampling();
+
+  /* An export in progress at the deadline is cancelled, the last one then fails too. */
+  worker_.Stop(deadline, [this] {
+    if (exporter_) {
+      exporter_->Cancel();
+    }
+  });
+
+  bool exported = Export(deadline);
+
+  {
+    SamplerLock lock;
+    ClearLive();
+  }
+
+  return exported;
+}
+
+void AllocationSampler::OnSpanEnd(const SpanSummary& span) noexcept {
+  if (pendingSpanCount.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  uint64_t spanKey;
+  memcpy(&spanKey, span.spanId.Id().data(), sizeof(spanKey));
+
+  SamplerLock lock;
+  Sampler& sampler = GetSampler();
+  auto it = sampler.pendingSpans.find(spanKey);
+
+  if (it == sampler.pendingSpans.end()) {
+    return;
+  }
+
+  uint64_t bytes = it->second;
+  sampler.pendingSpans.erase(it);
+  pendingSpanCount.store(sampler.pendingSpans.size(), std::memory_order_relaxed);
+
+  try {
+    std::string name(span.name.data(), span.name.size());
+    auto series = sampler.bytesBySpanName.find(name);
+
+    if (series != sampler.bytesBySpanName.end()) {
+      series->second += bytes;
+    } else if (sampler.bytesBySpanName.size() < kMaxSpanNames) {
+      sampler.bytesBySpanName.emplace(std::move(name), bytes);
+    } else {
+      sampler.overflowBytes += bytes;
+    }
+  } catch (const std::bad_alloc&) {
+    sampler.overflowBytes += bytes;
+  }
+}
+
+void AllocationSampler::Collect(
+  uint64_t startNanos, uint64_t nowNanos, proto::metrics::v1::ResourceMetrics* metrics) {
+  SamplerLock lock;
+  Sampler& sampler = GetSampler();
+
+  if (sampler.bytesBySpanName.empty() && sampler.overflowBytes == 0 &&
+      sampler.unattributedBytes == 0) {
+    return;
+  }
+
+  auto* library = metrics->add_instrumentation_library_metrics();
+  library->mutable_instrumentation_library()->set_name("splunk.allocation_sampler");
+
+  proto::metrics::v1::Metric* allocated = library->add_metrics();
+  allocated->set_name("memory.allocated");
+  allocated->set_description("Estimated bytes allocated through operator new, by span name");
+  allocated->set_unit("By");
+  allocated->mutable_sum()->set_aggregation_temporality(
+    proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+  allocated->mutable_sum()->set_is_monotonic(true);
+
+  auto addPoint = [&](const char* key, const std::string& value, uint64_t bytes) {
+    proto::metrics::v1::NumberDataPoint* point = allocated->mutable_sum()->add_data_points();
+
+    if (key) {
+      AddAttribute(point->mutable_attributes(), key, value);
+    }
+
+    point->set_start_time_unix_nano(startNanos);
+    point->set_time_unix_nano(nowNanos);
+    point->set_as_int(static_cast<int64_t>(bytes));
+  };
+
+  for (const auto& series : sampler.bytesBySpanName) {
+    addPoint("span.name", series.first, series.second);
+  }
+
+  if (sampler.overflowBytes > 0) {
+    addPoint("otel.metric.overflow", "true", sampler.overflowBytes);
+  }
+
+  /* Allocations outside of spans, or in spans still running at an export. */
+  if (sampler.unattributedBytes > 0) {
+    addPoint(nullptr, std::string(), sampler.unattributedBytes);
+  }
+}
+
+void AllocationSampler::Reset() {
+  SamplerLock lock;
+  Sampler& sampler = GetSampler();
+  sampler.bytesBySpanName.clear();
+  sampler.overflowBytes = 0;
+  sampler.unattributedBytes = 0;
+}
+
+void AllocationSampler::Tick() {
+  /* The profile's own encoding and sending isn't what anyone wants to see in it. */
+  threadSampler.busy = true;
+  Export(std::chrono::steady_clock::now() + kExportTimeout);
+}
+
+bool AllocationSampler::Export(Deadline deadline) {
+  struct Stack {
+    std::string key;
+    std::vector<uint64_t> values;
+  };
+
+  std::vector<Stack> stacks;
+  std::chrono::system_clock::time_point start;
+  auto end = std::chrono::system_clock::now();
+
+  {
+    SamplerLock lock;
+    Sampler& sampler = GetSampler();
+    std::vector<uint64_t> inUseCount(sampler.stacks.size());
+    std::vector<uint64_t> inUseBytes(sampler.stacks.size());
+
+    for (size_t slot = 0; slot < kLiveCapacity; slot++) {
+      if (liveAddresses[slot].load(std::memory_order_acquire) > kTombstone) {
+        inUseCount[liveRecords[slot].stackId] += liveRecords[slot].count;
+        inUseBytes[liveRecords[slot].stackId] += liveRecords[slot].bytes;
+      }
+    }
+
+    /*
+     * Only the stacks of allocations still in use are kept, renumbered, so the table doesn't
+     * fill up with the stacks of spans long gone.
+     */
+    std::vector<uint32_t> ids(sampler.stacks.size(), kOverflowStack);
+    std::vector<StackStats> kept{StackStats{std::string(), 0, 0}};
+    sampler.stackIds.clear();
+
+    for (size_t id = 0; id < sampler.stacks.size(); id++) {
+      StackStats& stats = sampler.stacks[id];
+
+      if (stats.allocatedCount > 0 || inUseCount[id] > 0) {
+        stacks.push_back(Stack{
+          stats.key, {stats.allocatedCount, stats.allocatedBytes, inUseCount[id], inUseBytes[id]}});
+      }
+
+      if (id != kOverflowStack && inUseCount[id] > 0) {
+        ids[id] = static_cast<uint32_t>(kept.size());
+        sampler.stackIds.emplace(stats.key, ids[id]);
+        kept.push_back(StackStats{std::move(stats.key), 0, 0});
+      }
+    }
+
+    for (size_t slot = 0; slot < kLiveCapacity; slot++) {
+      if (liveAddresses[slot].load(std::memory_order_relaxed) > kTombstone) {
+        liveRecords[slot].stackId = ids[liveRecords[slot].stackId];
+      }
+    }
+
+    sampler.stacks.swap(kept);
+
+    /* Spans which outlive an export are no longer charged, or they'd never leave the map. */
+    for (const auto& span : sampler.pendingSpans) {
+      sampler.unattributedBytes += span.second;
+    }
+
+    sampler.pendingSpans.clear();
+    pendingSpanCount.store(0, std::memory_order_relaxed);
+
+    start = sampler.start;
+    sampler.start = end;
+  }
+
+  /* Null in a child which doesn't profile. */
+  if (stacks.empty() || !exporter_) {
+    return true;
+  }
+
+  const size_t header = 1 + sizeof(ContextStorage::ActiveSpanIds);
+  PprofBuilder profile(
+    {{"alloc_objects", "count"},
+     {"alloc_space", "bytes"},
+     {"inuse_objects", "count"},
+     {"inuse_space", "bytes"}},
+    {"space", "bytes"}, meanSampleBytes.load(std::memory_order_relaxed));
+
+  for (const Stack& stack : stacks) {
+    if (stack.key.size() < header) {
+      profile.AddSample(nullptr, 0, nullptr, stack.values);
+      continue;
+    }
+
+    std::vector<uintptr_t> frames((stack.key.size() - header) / sizeof(uintptr_t));
+    memcpy(frames.data(), stack.key.data() + header, frames.size() * sizeof(uintptr_t));
+    ContextStorage::ActiveSpanIds span;
+    memcpy(&span, stack.key.data() + 1, sizeof(span));
+    profile.AddSample(frames.data(), frames.size(), stack.key[0] ? &span : nullptr, stack.values);
+  }
+
+  return exporter_->Export(profile.Build(start, end), "allocation", end, deadline);
+}
+
+void AllocationSampler::PrepareFork() noexcept {
+  busyBeforeFork = threadSampler.busy;
+  threadSampler.busy = true;
+  GetSampler().mutex.lock();
+}
+
+void AllocationSampler::AfterForkParent() noexcept {
+  GetSampler().mutex.unlock();
+  threadSampler.busy = busyBeforeFork;
+}
+
+void AllocationSampler::AfterForkChild() noexcept {
+  /*
+   * The parent exports what it sampled. Allocations it had in use are still in use in the
+   * child's copy of its heap, so the live table stays.
+   */
+  Sampler& sampler = GetSampler();
+
+  for (StackStats& stats : sampler.stacks) {
+    stats.allocatedCount = 0;
+    stats.allocatedBytes = 0;
+  }
+
+  sampler.pendingSpans.clear();
+  pendingSpanCount.store(0, std::memory_order_relaxed);
+  sampler.start = std::chrono::system_clock::now();
+  sampler.mutex.unlock();
+  threadSampler.busy = busyBeforeFork;
+
+  if (!RestartInChild(
+        &worker_, &exporter_, exportFromChildren_ && !isShutdown_,
+        [](const ProfileExporter& parent) { return parent.Reconnect(); })) {
+    StopSampling();
+  }
+}
+
+} // namespace splunk
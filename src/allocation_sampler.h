@@ -0,0 +1,80 @@
+#pragma once
+
+#include "allocation_hooks.h"
+#include "fork_handler.h"
+#include "metrics.h"
+#include "periodic_worker.h"
+#include "profile_exporter.h"
+#include "span_metrics.h"
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace splunk {
+
+/*
+ * Samples the allocations made through operator new, on average one every sampleBytes bytes:
+ * each thread counts down its allocated bytes from an exponentially distributed interval, so
+ * every byte has the same chance of being sampled (Poisson sampling) whatever the allocation
+ * pattern. A sample records the frame pointer call stack and the span active on the thread,
+ * and is weighted by the inverse of its probability so the profile estimates the real totals.
+ *
+ * Sampled allocations which are still live are kept in a fixed open addressed table, operator
+ * delete looks them up without a lock and only while the table isn't empty. Samples which
+ * don't fit are counted as allocated but never as in use.
+ *
+ * Every exportInterval the sampler sends a pprof heap profile with the allocations since the
+ * last export and those still in use, through the OTLP endpoint in the format of AlwaysOn
+ * Profiling. As a MetricProducer it reports the estimated bytes allocated in spans of each
+ * name, from the spans the processor passes to OnSpanEnd.
+ *
+ * The hooks only exist in builds with SPLUNK_CPP_ALLOCATION_HOOKS, without them nothing is
+ * ever sampled. Only one sampler may exist at a time.
+ */
+class AllocationSampler final : public MetricProducer, private ForkHandler {
+public:
+  AllocationSampler(
+    const std::string& otlpEndpoint, const opentelemetry::sdk::resource::Resource& resource,
+    size_t sampleBytes, std::chrono::milliseconds exportInterval, bool exportFromChildren);
+  ~AllocationSampler() override;
+
+  /*
+   * Stops sampling, cancels an export of the export thread still in progress at the deadline and
+   * exports the profile of what was sampled so far.
+   */
+  bool Shutdown(std::chrono::steady_clock::time_point deadline);
+
+  /* Charges the span's name with the allocations sampled in it, cheap when there were none. */
+  void OnSpanEnd(const SpanSummary& span) noexcept;
+
+  /* Emits the estimated bytes allocated per span name, and outside of any ended span. */
+  void Collect(
+    uint64_t startNanos, uint64_t nowNanos,
+    opentelemetry::proto::metrics::v1::ResourceMetrics* metrics) override;
+  void Reset() override;
+
+private:
+  void StartSampling();
+  void StopSampling();
+  void Tick();
+  bool Export(std::chrono::steady_clock::time_point deadline);
+
+  void PrepareFork() noexcept override;
+  void AfterForkParent() noexcept override;
+  void AfterForkChild() noexcept override;
+
+  const std::chrono::milliseconds exportInterval_;
+  const bool exportFromChildren_;
+  std::unique_ptr<ProfileExporter> exporter_;
+  PeriodicWorker worker_;
+  bool sampling_ = false;
+  bool isShutdown_ = false;
+};
+
+} // namespace splunk
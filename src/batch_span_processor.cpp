@@ -0,0 +1,552 @@
+#include "batch_span_processor.h"
+
+#include <algorithm>
+#include <system_error>
+#include <vector>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+
+namespace splunk {
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+Deadline DeadlineFromTimeout(std::chrono::microseconds timeout) {
+  auto now = std::chrono::steady_clock::now();
+
+  if (timeout >= std::chrono::duration_cast<std::chrono::microseconds>(Deadline::max() - now)) {
+    return Deadline::max();
+  }
+
+  return now + timeout;
+}
+
+/* Deadline::max() is waited for without a timeout, converting it can overflow. */
+template <typename Predicate>
+bool WaitUntil(
+  std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Deadline deadline,
+  Predicate predicate) {
+  if (deadline == Deadline::max()) {
+    cv.wait(lock, predicate);
+    return true;
+  }
+
+  return cv.wait_until(lock, deadline, predicate);
+}
+
+} // namespace
+
+BatchSpanProcessor::BatchSpanProcessor(
+  std::unique_ptr<sdktrace::SpanExporter> exporter,
+  std::shared_ptr<const DynamicSettings> settings, size_t exportConcurrency, bool pooledSpans,
+  ExporterFactory childExporterFactory, std::shared_ptr<SpanMetricsAggregator> spanMetrics,
+  std::shared_ptr<PipelineCounters> pipelineCounters,
+  std::shared_ptr<AllocationSampler> allocationSampler, SpanResourceUsage resourceUsage)
+  : exporter_(std::move(exporter)), settings_(std::move(settings)),
+    exportConcurrency_(std::max<size_t>(1, exportConcurrency)), pooledSpans_(pooledSpans),
+    childExporterFactory_(std::move(childExporterFactory)), spanMetrics_(std::move(spanMetrics)),
+    pipelineCounters_(
+      pipelineCounters ? std::move(pipelineCounters) : std::make_shared<PipelineCounters>()),
+    allocationSampler_(std::move(allocationSampler)), resourceUsage_(resourceUsage),
+    queue_(new BoundedQueue<sdktrace::Recordable*>(
+      settings_->Load().maxQueueSize)),
+    exportMutex_(new std::mutex()), worker_(new Worker()) {
+  worker_->threads = 1;
+  worker_->thread = std::thread(&BatchSpanProcessor::Run, this);
+
+  if (childExporterFactory_) {
+    RegisterForkHandler(this);
+  }
+
+  if (resourceUsage_ == SpanResourceUsage_Allocations) {
+    CountAllocations(true);
+  }
+}
+
+BatchSpanProcessor::~BatchSpanProcessor() {
+  if (childExporterFactory_) {
+    UnregisterForkHandler(this);
+  }
+
+  ShutdownUntil(Deadline::max());
+
+  /*
+   * An OnEnd which passed its shutdown check may push after ShutdownUntil drained the queue,
+   * nothing else would ever pop it.
+   */
+  DropQueued();
+
+  if (resourceUsage_ == SpanResourceUsage_Allocations) {
+    CountAllocations(false);
+  }
+
+  if (abandoned_) {
+    exporter_.release();
+    exportMutex_.release();
+    worker_.release();
+  }
+}
+
+std::unique_ptr<sdktrace::Recordable> BatchSpanProcessor::MakeRecordable() noexcept {
+  if (pooledSpans_) {
+    return std::unique_ptr<sdktrace::Recordable>(
+      PooledRecordable::Acquire(*settings_, limitCounters_));
+  }
+
+  return std::unique_ptr<sdktrace::Recordable>(new SpanRecordable(
+    exporter_->MakeRecordable(), *settings_, limitCounters_,
+    spanMetrics_ != nullptr || allocationSampler_ != nullptr));
+}
+
+void BatchSpanProcessor::OnStart(
+  sdktrace::Recordable& span, const opentelemetry::trace::SpanContext& parentContext) noexcept {
+  if (resourceUsage_ == SpanResourceUsage_Disabled) {
+    return;
+  }
+
+  if (pooledSpans_) {
+    static_cast<PooledRecordable&>(span).StartUsage();
+  } else {
+    static_cast<SpanRecordable&>(span).StartUsage();
+  }
+}
+
+void BatchSpanProcessor::OnEnd(std::unique_ptr<sdktrace::Recordable>&& span) noexcept {
+  sdktrace::Recordable* recordable = span.release();
+  pipelineCounters_->spansEnded.Add(1);
+
+  if (resourceUsage_ != SpanResourceUsage_Disabled) {
+    if (pooledSpans_) {
+      static_cast<PooledRecordable*>(recordable)->EndUsage();
+    } else {
+      static_cast<SpanRecordable*>(recordable)->EndUsage();
+    }
+  }
+
+  if (spanMetrics_ || allocationSampler_) {
+    SpanSummary summary = pooledSpans_ ? static_cast<PooledRecordable*>(recordable)->Summary()
+                                       : static_cast<SpanRecordable*>(recordable)->Summary();
+
+    if (allocationSampler_) {
+      allocationSampler_->OnSpanEnd(summary);
+    }
+
+    if (spanMetrics_) {
+      spanMetrics_->Record(summary);
+
+      if (!summary.sampled) {
+        Discard(recordable);
+        return;
+      }
+    }
+  }
+
+  if (isShutdown_.load(std::memory_order_acquire)) {
+    pipelineCounters_->spansDroppedShutdown.Add(1);
+    Discard(recordable);
+    return;
+  }
+
+  const SettingsSnapshot& settings = settings_->Load();
+
+  /* The ring is sized for the initial queue limit, a reload can only lower it. */
+  if (queue_->Size() >= settings.maxQueueSize ||
+      !queue_->Push(recordable)) {
+    pipelineCounters_->spansDroppedQueueFull.Add(1);
+    Discard(recordable);
+    return;
+  }
+
+  if (queue_->Size() >= settings.maxExportBatchSize &&
+      !wakeupPending_.load(std::memory_order_relaxed) &&
+      !wakeupPending_.exchange(true, std::memory_order_relaxed)) {
+    worker_->wakeCv.notify_one();
+  }
+}
+
+bool BatchSpanProcessor::ForceFlush(std::chrono::microseconds timeout) noexcept {
+  if (isShutdown_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  return FlushUntil(DeadlineFromTimeout(timeout)).completed;
+}
+
+bool BatchSpanProcessor::Shutdown(std::chrono::microseconds timeout) noexcept {
+  return ShutdownUntil(DeadlineFromTimeout(timeout)).completed;
+}
+
+FlushResult BatchSpanProcessor::FlushUntil(Deadline deadline) noexcept {
+  /* Shutdown dropped the queue, and helpers started now could outlive the processor. */
+  if (isShutdown_.load(std::memory_order_acquire)) {
+    return FlushResult();
+  }
+
+  std::shared_ptr<FlushJob> job = StartFlush(deadline);
+  Worker& worker = *worker_;
+  bool idle;
+
+  {
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    idle = WaitUntil(worker.idleCv, lock, deadline, [&worker, &job] {
+      return job->helpers == 0 && !worker.exporting;
+    });
+  }
+
+  FlushResult result;
+  result.exportedSpans = job->counts.exported.load();
+  result.droppedSpans = job->counts.failed.load();
+  /* Exports still running at the deadline are left to finish in the background. */
+  result.pendingSpans =
+    std::min(job->limit.load(), queue_->Size()) + job->counts.exporting.load();
+  result.completed = idle && result.pendingSpans == 0 && result.droppedSpans == 0;
+  return result;
+}
+
+FlushResult BatchSpanProcessor::ShutdownUntil(Deadline deadline) noexcept {
+  if (isShutdown_.exchange(true)) {
+    FlushResult result;
+    result.completed = true;
+    return result;
+  }
+
+  Worker& worker = *worker_;
+
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.stop = true;
+  }
+
+  worker.wakeCv.notify_one();
+
+  std::shared_ptr<FlushJob> job = StartFlush(deadline);
+  size_t abandonedSpans = 0;
+
+  {
+    /* The worker stops after the batch it is exporting, if any. */
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    if (!WaitUntil(worker.idleCv, lock, deadline, [&worker] { return worker.threads == 0; })) {
+      /* A thread which isn't in an export is about to start one or to exit, neither blocks. */
+      worker.idleCv.wait(lock, [&worker] { return worker.threads == worker.exports; });
+      worker.abandoned = true;
+      abandonedSpans = worker.exportingSpans;
+      abandoned_ = true;
+    }
+  }
+
+  if (abandoned_) {
+    if (worker.thread.joinable()) {
+      worker.thread.detach();
+    }
+  } else if (worker.thread.joinable()) {
+    worker.thread.join();
+  }
+
+  pipelineCounters_->spansDroppedShutdown.Add(abandonedSpans);
+
+  /* Whatever is left missed the deadline, including spans which raced with shutdown. */
+  FlushResult result;
+  result.exportedSpans = job->counts.exported.load();
+  result.droppedSpans = job->counts.failed.load() + abandonedSpans + DropQueued();
+  result.completed = result.droppedSpans == 0;
+
+  /* The exporter is busy with the abandoned exports, past the deadline anyway. */
+  if (!abandoned_) {
+    auto now = std::chrono::steady_clock::now();
+    exporter_->Shutdown(
+      deadline > now ? std::chrono::duration_cast<std::chrono::microseconds>(deadline - now)
+                     : std::chrono::microseconds(0));
+  }
+
+  return result;
+}
+
+std::shared_ptr<BatchSpanProcessor::FlushJob> BatchSpanProcessor::StartFlush(Deadline deadline) {
+  /* Spans ended after this point are left to the background worker. */
+  std::shared_ptr<FlushJob> job = std::make_shared<FlushJob>();
+  job->limit.store(queue_->Size());
+
+  size_t batchSize =
+    std::max<uint32_t>(1, settings_->Load().maxExportBatchSize);
+  size_t threadCount =
+    std::min(exportConcurrency_, (job->limit.load() + batchSize - 1) / batchSize);
+  Worker* worker = worker_.get();
+
+  /*
+   * Exports run on helpers so the caller can stop waiting at the deadline, an Export call can't
+   * be interrupted. The queue is FIFO, so the oldest batches are claimed first by whichever
+   * helper is free.
+   */
+  size_t started = 0;
+  for (; started < threadCount; started++) {
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->threads++;
+      job->helpers++;
+    }
+
+    try {
+      std::thread(&BatchSpanProcessor::RunHelper, this, worker, job, deadline).detach();
+    } catch (const std::system_error&) {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->threads--;
+      job->helpers--;
+      break;
+    }
+  }
+
+  /* Without any helper the caller exports, at the risk of overrunning the deadline. */
+  if (started == 0 && threadCount > 0) {
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->threads++;
+      job->helpers++;
+    }
+
+    RunHelper(worker, job, deadline);
+  }
+
+  return job;
+}
+
+void BatchSpanProcessor::RunHelper(
+  Worker* worker, std::shared_ptr<FlushJob> job, Deadline deadline) {
+  ExportFromQueue(job->limit, deadline, job->counts, false);
+
+  /* The processor may be gone if the export was abandoned, only the worker is left. */
+  std::lock_guard<std::mutex> lock(worker->mutex);
+  job->helpers--;
+  worker->threads--;
+  worker->idleCv.notify_all();
+}
+
+void BatchSpanProcessor::Run() {
+  Worker& worker = *worker_;
+  std::unique_lock<std::mutex> lock(worker.mutex);
+
+  for (;;) {
+    auto delay =
+      std::chrono::milliseconds(settings_->Load().scheduleDelayMillis);
+    worker.wakeCv.wait_for(lock, delay, [this, &worker] {
+      return worker.stop || wakeupPending_.load(std::memory_order_relaxed);
+    });
+
+    if (worker.stop) {
+      worker.threads--;
+      worker.idleCv.notify_all();
+      return;
+    }
+
+    worker.exporting = true;
+    lock.unlock();
+
+    wakeupPending_.store(false, std::memory_order_relaxed);
+
+    /* Only drain what was queued when we started, so a steady stream of spans can't keep the
+     * worker exporting forever. */
+    std::atomic<size_t> limit(queue_->Size());
+    ExportCounts counts;
+
+    if (!ExportFromQueue(limit, Deadline::max(), counts, true)) {
+      return;
+    }
+
+    lock.lock();
+    worker.exporting = false;
+    worker.idleCv.notify_all();
+  }
+}
+
+bool BatchSpanProcessor::ExportFromQueue(
+  std::atomic<size_t>& limit, Deadline deadline, ExportCounts& counts, bool isWorker) {
+  std::vector<std::unique_ptr<sdktrace::Recordable>> batch;
+
+  while (std::chrono::steady_clock::now() < deadline) {
+    /* On shutdown the caller takes over the queue, the worker gives up between batches. */
+    if (isWorker && isShutdown_.load(std::memory_order_acquire)) {
+      return true;
+    }
+
+    if (!PopBatch(limit, batch)) {
+      return true;
+    }
+
+    if (!ExportBatch(batch, counts)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BatchSpanProcessor::PopBatch(
+  std::atomic<size_t>& limit, std::vector<std::unique_ptr<sdktrace::Recordable>>& batch) {
+  size_t batchSize = settings_->Load().maxExportBatchSize;
+  batch.clear();
+
+  while (batch.size() < batchSize) {
+    size_t available = limit.load(std::memory_order_relaxed);
+
+    do {
+      if (available == 0) {
+        return !batch.empty();
+      }
+    } while (!limit.compare_exchange_weak(available, available - 1, std::memory_order_relaxed));
+
+    sdktrace::Recordable* recordable;
+    if (!queue_->Pop(&recordable)) {
+      limit.store(0, std::memory_order_relaxed);
+      return !batch.empty();
+    }
+
+    batch.push_back(TakeExportable(recordable));
+  }
+
+  return true;
+}
+
+bool BatchSpanProcessor::ExportBatch(
+  std::vector<std::unique_ptr<sdktrace::Recordable>>& batch, ExportCounts& counts) {
+  nostd::span<std::unique_ptr<sdktrace::Recordable>> spans(batch.data(), batch.size());
+  opentelemetry::sdk::common::ExportResult result;
+
+  /* Shutdown may abandon the export and the processor be destroyed before it returns. */
+  Worker& worker = *worker_;
+  sdktrace::SpanExporter& exporter = *exporter_;
+  std::mutex* exportMutex = exportConcurrency_ > 1 ? nullptr : exportMutex_.get();
+
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.exports++;
+    worker.exportingSpans += batch.size();
+    worker.idleCv.notify_all();
+  }
+
+  counts.exporting.fetch_add(batch.size(), std::memory_order_relaxed);
+  auto start = std::chrono::steady_clock::now();
+
+  if (exportMutex) {
+    std::lock_guard<std::mutex> lock(*exportMutex);
+    result = exporter.Export(spans);
+  } else {
+    result = exporter.Export(spans);
+  }
+
+  auto duration = std::chrono::steady_clock::now() - start;
+  bool success = result == opentelemetry::sdk::common::ExportResult::kSuccess;
+  (success ? counts.exported : counts.failed).fetch_add(batch.size(), std::memory_order_relaxed);
+  counts.exporting.fetch_sub(batch.size(), std::memory_order_relaxed);
+
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.exports--;
+    worker.exportingSpans -= batch.size();
+
+    if (worker.abandoned) {
+      return false;
+    }
+  }
+
+  pipelineCounters_->exportDuration.Record(
+    std::chrono::duration<double, std::milli>(duration).count());
+  pipelineCounters_->batchSize.Record(static_cast<double>(batch.size()));
+
+  if (success) {
+    pipelineCounters_->spansExported.Add(batch.size());
+  } else {
+    pipelineCounters_->spansExportFailed.Add(batch.size());
+  }
+
+  return true;
+}
+
+PipelineStats BatchSpanProcessor::GetPipelineStats() const {
+  PipelineStats stats = pipelineCounters_->Load();
+  stats.queueSize = queue_->Size();
+  stats.queueCapacity = std::min<uint64_t>(
+    queue_->Capacity(), settings_->Load().maxQueueSize);
+  return stats;
+}
+
+std::unique_ptr<sdktrace::Recordable> BatchSpanProcessor::TakeExportable(
+  sdktrace::Recordable* span) {
+  if (!pooledSpans_) {
+    std::unique_ptr<SpanRecordable> recordable(static_cast<SpanRecordable*>(span));
+    return recordable->ReleaseDelegate();
+  }
+
+  PooledRecordable* pooled = static_cast<PooledRecordable*>(span);
+  std::unique_ptr<sdktrace::Recordable> recordable = exporter_->MakeRecordable();
+  pooled->Replay(*recordable);
+  pooled->Release();
+  return recordable;
+}
+
+void BatchSpanProcessor::Discard(sdktrace::Recordable* span) {
+  if (pooledSpans_) {
+    static_cast<PooledRecordable*>(span)->Release();
+  } else {
+    delete static_cast<SpanRecordable*>(span);
+  }
+}
+
+size_t BatchSpanProcessor::DropQueued() {
+  size_t dropped = 0;
+  sdktrace::Recordable* recordable;
+
+  while (queue_->Pop(&recordable)) {
+    Discard(recordable);
+    dropped++;
+  }
+
+  pipelineCounters_->spansDroppedShutdown.Add(dropped);
+  return dropped;
+}
+
+void BatchSpanProcessor::PrepareFork() noexcept {
+  /* Keeps the worker from being halfway through a state change at the time of the fork. */
+  worker_->mutex.lock();
+}
+
+void BatchSpanProcessor::AfterForkParent() noexcept { worker_->mutex.unlock(); }
+
+void BatchSpanProcessor::AfterForkChild() noexcept {
+  /*
+   * The exporter, worker and export mutex belong to threads which only exist in the parent.
+   * Destroying them here could block forever, so they are intentionally leaked.
+   */
+  exporter_.release();
+  worker_.release();
+  exportMutex_.release();
+
+  /* Spans queued before the fork are the parent's to export, drop our copies. */
+  sdktrace::Recordable* recordable;
+  while (queue_->Pop(&recordable)) {
+    Discard(recordable);
+  }
+
+  /* A push interrupted by the fork may have left a slot half written, start from scratch. */
+  queue_.reset(new BoundedQueue<sdktrace::Recordable*>(queue_->Capacity()));
+  wakeupPending_.store(false, std::memory_order_relaxed);
+
+  exporter_ = childExporterFactory_();
+  exportMutex_.reset(new std::mutex());
+  worker_.reset(new Worker());
+  abandoned_ = false;
+
+  if (isShutdown_.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  try {
+    worker_->threads = 1;
+    worker_->thread = std::thread(&BatchSpanProcessor::Run, this);
+  } catch (const std::system_error&) {
+    /* Without a worker spans are still exported by Flush and Shutdown. */
+    worker_->threads = 0;
+  }
+}
+
+} // namespace splunk
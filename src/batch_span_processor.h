@@ -0,0 +1,181 @@
+#pragma once
+
+#include "allocation_sampler.h"
+#include "bounded_queue.h"
+#include "config.h"
+#include "fork_handler.h"
+#include "pipeline_stats.h"
+#include "pooled_recordable.h"
+#include "recordable.h"
+#include "span_metrics.h"
+
+#include <splunk/opentelemetry.h>
+
+#include <opentelemetry/sdk/trace/exporter.h>
+#include <opentelemetry/sdk/trace/processor.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace splunk {
+
+/*
+ * Batching span processor whose queue limit, schedule delay and batch size are read from
+ * DynamicSettings, so they can be changed at runtime. Ended spans are pushed to a lock-free
+ * queue; the request path never takes a lock.
+ *
+ * exportConcurrency is the number of Export calls allowed to run at the same time when
+ * flushing against a deadline, 1 for exporters which are not thread-safe.
+ *
+ * With pooledSpans, spans are recorded into PooledRecordables taken from per-thread pools and
+ * only copied into recordables of the exporter when their batch is popped, so everything the
+ * exporter allocates is also freed on the export thread.
+ *
+ * When childExporterFactory is set the processor survives fork(): the child discards the
+ * spans queued by the parent (the parent still exports them), starts its own worker thread and
+ * exports through a new exporter created by the factory.
+ *
+ * With spanMetrics every ended span is recorded there first. Spans which were recorded
+ * without being sampled, which the sampler only does for span metrics, are then discarded.
+ * With allocationSampler every ended span is first charged the allocations sampled in it.
+ *
+ * With resourceUsage sampled spans get attributes with the CPU time, context switches and,
+ * with SpanResourceUsage_Allocations, bytes allocated by their thread between start and end.
+ *
+ * What happens to each span is counted in pipelineCounters, or in counters of the processor's
+ * own when none are given.
+ */
+class BatchSpanProcessor final : public opentelemetry::sdk::trace::SpanProcessor,
+                                 private ForkHandler {
+public:
+  using ExporterFactory = std::function<std::unique_ptr<opentelemetry::sdk::trace::SpanExporter>()>;
+
+  BatchSpanProcessor(
+    std::unique_ptr<opentelemetry::sdk::trace::SpanExporter> exporter,
+    std::shared_ptr<const DynamicSettings> settings, size_t exportConcurrency,
+    bool pooledSpans = false, ExporterFactory childExporterFactory = nullptr,
+    std::shared_ptr<SpanMetricsAggregator> spanMetrics = nullptr,
+    std::shared_ptr<PipelineCounters> pipelineCounters = nullptr,
+    std::shared_ptr<AllocationSampler> allocationSampler = nullptr,
+    SpanResourceUsage resourceUsage = SpanResourceUsage_Disabled);
+  ~BatchSpanProcessor() override;
+
+  std::unique_ptr<opentelemetry::sdk::trace::Recordable> MakeRecordable() noexcept override;
+
+  void OnStart(
+    opentelemetry::sdk::trace::Recordable& span,
+    const opentelemetry::trace::SpanContext& parentContext) noexcept override;
+
+  void OnEnd(std::unique_ptr<opentelemetry::sdk::trace::Recordable>&& span) noexcept override;
+
+  bool ForceFlush(
+    std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
+
+  bool Shutdown(
+    std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
+
+  FlushResult FlushUntil(std::chrono::steady_clock::time_point deadline) noexcept;
+  FlushResult ShutdownUntil(std::chrono::steady_clock::time_point deadline) noexcept;
+
+  const SpanLimitCounters& GetLimitCounters() const { return limitCounters_; }
+  PipelineStats GetPipelineStats() const;
+
+private:
+  /*
+   * The background worker and the books on every thread exporting from the queue, which are
+   * the worker and flush helpers. A thread still exporting when a shutdown deadline passes is
+   * abandoned: it may outlive the processor, and from then on only uses its Worker.
+   */
+  struct Worker {
+    std::mutex mutex;
+    std::condition_variable wakeCv;
+    std::condition_variable idleCv;
+    /* Guarded by mutex. */
+    bool stop = false;
+    bool exporting = false;
+    size_t threads = 0;
+    /* Threads inside or waiting for an Export call, and the spans they export. */
+    size_t exports = 0;
+    size_t exportingSpans = 0;
+    bool abandoned = false;
+    std::thread thread;
+  };
+
+  struct ExportCounts {
+    std::atomic<size_t> exported{0};
+    std::atomic<size_t> failed{0};
+    /* In exports which haven't returned yet. */
+    std::atomic<size_t> exporting{0};
+  };
+
+  /* A flush, shared with its helper threads which may outlive the call. */
+  struct FlushJob {
+    std::atomic<size_t> limit{0};
+    ExportCounts counts;
+    /* Guarded by the worker mutex. */
+    size_t helpers = 0;
+  };
+
+  void Run();
+  /* Starts exporting what is queued on helper threads, which stop at the deadline. */
+  std::shared_ptr<FlushJob> StartFlush(std::chrono::steady_clock::time_point deadline);
+  void RunHelper(
+    Worker* worker, std::shared_ptr<FlushJob> job, std::chrono::steady_clock::time_point deadline);
+  /*
+   * Pops and exports up to `limit` spans, stops early once the deadline has passed. Returns false
+   * when an export was abandoned, the processor must not be used anymore then.
+   */
+  bool ExportFromQueue(
+    std::atomic<size_t>& limit, std::chrono::steady_clock::time_point deadline,
+    ExportCounts& counts, bool isWorker);
+  bool PopBatch(
+    std::atomic<size_t>& limit,
+    std::vector<std::unique_ptr<opentelemetry::sdk::trace::Recordable>>& batch);
+  bool ExportBatch(
+    std::vector<std::unique_ptr<opentelemetry::sdk::trace::Recordable>>& batch,
+    ExportCounts& counts);
+
+  /* Returns the exporter's recordable for a queued span, consuming the span. */
+  std::unique_ptr<opentelemetry::sdk::trace::Recordable> TakeExportable(
+    opentelemetry::sdk::trace::Recordable* span);
+  void Discard(opentelemetry::sdk::trace::Recordable* span);
+  /* Discards everything queued as dropped on shutdown, returns how many. */
+  size_t DropQueued();
+
+  void PrepareFork() noexcept override;
+  void AfterForkParent() noexcept override;
+  void AfterForkChild() noexcept override;
+
+  /*
+   * Everything below is owned by pointer so the child of a fork can abandon the parent's
+   * copies, which may be mid-use by threads that don't exist in the child.
+   */
+  std::unique_ptr<opentelemetry::sdk::trace::SpanExporter> exporter_;
+  std::shared_ptr<const DynamicSettings> settings_;
+  const size_t exportConcurrency_;
+  /* Queued spans are PooledRecordables rather than SpanRecordables. */
+  const bool pooledSpans_;
+  ExporterFactory childExporterFactory_;
+  std::shared_ptr<SpanMetricsAggregator> spanMetrics_;
+  std::shared_ptr<PipelineCounters> pipelineCounters_;
+  std::shared_ptr<AllocationSampler> allocationSampler_;
+  const SpanResourceUsage resourceUsage_;
+  std::unique_ptr<BoundedQueue<opentelemetry::sdk::trace::Recordable*>> queue_;
+  std::atomic<bool> wakeupPending_{false};
+  std::atomic<bool> isShutdown_{false};
+  /* Set when shutdown abandoned exports, which still use the exporter, mutex and worker. */
+  bool abandoned_ = false;
+  SpanLimitCounters limitCounters_;
+
+  /* Serializes Export calls when the exporter is not thread-safe. */
+  std::unique_ptr<std::mutex> exportMutex_;
+  std::unique_ptr<Worker> worker_;
+};
+
+} // namespace splunk
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace splunk {
+
+/*
+ * Bounded multi-producer multi-consumer queue based on Dmitry Vyukov's
+ * sequenced ring buffer. Push and Pop never take a lock, Push fails when the
+ * queue is full. T should be cheap to copy (the processors store pointers).
+ */
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t minCapacity)
+    : capacity_(RoundUpPowerOfTwo(minCapacity)), mask_(capacity_ - 1),
+      cells_(new Cell[capacity_]) {
+    for (size_t i = 0; i < capacity_; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  bool Push(const T& value) {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool Pop(T* value) {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Cell& cell = cells_[pos & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          *value = cell.value;
+          cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /* Approximate while producers or consumers are running. */
+  size_t Size() const {
+    size_t enqueued = enqueuePos_.load(std::memory_order_relaxed);
+    size_t dequeued = dequeuePos_.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  size_t Capacity() const { return capacity_; }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUpPowerOfTwo(size_t v) {
+    size_t result = 2;
+    while (result < v) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> enqueuePos_{0};
+  alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
+
+} // namespace splunk
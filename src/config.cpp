@@ -0,0 +1,255 @@
+#include "config.h"
+
+#include <nlohmann/json.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <system_error>
+
+namespace splunk {
+
+namespace {
+
+using json = nlohmann::json;
+
+void ReadString(const json& object, const char* key, std::string* out) {
+  auto it = object.find(key);
+
+  if (it != object.end() && it->is_string()) {
+    *out = it->get<std::string>();
+  }
+}
+
+void ReadUint(const json& object, const char* key, uint32_t* out) {
+  auto it = object.find(key);
+
+  if (it != object.end() && it->is_number_unsigned()) {
+    *out = static_cast<uint32_t>(std::min<uint64_t>(it->get<uint64_t>(), kUnlimited));
+  }
+}
+
+void ReadDouble(const json& object, const char* key, double* out) {
+  auto it = object.find(key);
+
+  if (it != object.end() && it->is_number()) {
+    *out = it->get<double>();
+  }
+}
+
+const json* FindObject(const json& object, const char* key) {
+  auto it = object.find(key);
+
+  if (it != object.end() && it->is_object()) {
+    return &*it;
+  }
+
+  return nullptr;
+}
+
+void ReadDynamicConfig(const json& root, DynamicConfig* config) {
+  if (const json* sampler = FindObject(root, "sampler")) {
+    ReadDouble(*sampler, "ratio", &config->samplerRatio);
+  }
+
+  if (const json* limits = FindObject(root, "span_limits")) {
+    ReadUint(*limits, "attribute_count", &config->attributeCountLimit);
+    ReadUint(*limits, "attribute_value_length", &config->attributeValueLengthLimit);
+    ReadUint(*limits, "event_count", &config->eventCountLimit);
+    ReadUint(*limits, "link_count", &config->linkCountLimit);
+  }
+
+  if (const json* batch = FindObject(root, "batch")) {
+    ReadUint(*batch, "max_queue_size", &config->maxQueueSize);
+    ReadUint(*batch, "schedule_delay_millis", &config->scheduleDelayMillis);
+    ReadUint(*batch, "max_export_batch_size", &config->maxExportBatchSize);
+  }
+
+  config->samplerRatio = std::max(0.0, std::min(1.0, config->samplerRatio));
+  config->maxQueueSize = std::max<uint32_t>(1, config->maxQueueSize);
+  config->maxExportBatchSize =
+    std::max<uint32_t>(1, std::min(config->maxExportBatchSize, config->maxQueueSize));
+}
+
+struct FileVersion {
+  bool exists = false;
+  ino_t inode = 0;
+  off_t size = 0;
+  int64_t modifiedNanos = 0;
+
+  bool operator==(const FileVersion& other) const {
+    return exists == other.exists && inode == other.inode && size == other.size &&
+           modifiedNanos == other.modifiedNanos;
+  }
+};
+
+FileVersion StatFile(const std::string& path) {
+  FileVersion version;
+  struct stat st;
+
+  if (stat(path.c_str(), &st) != 0) {
+    return version;
+  }
+
+  version.exists = true;
+  version.inode = st.st_ino;
+  version.size = st.st_size;
+  version.modifiedNanos = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  return version;
+}
+
+} // namespace
+
+DynamicSettings::~DynamicSettings() {
+  const SettingsSnapshot* snapshot = current_.load(std::memory_order_relaxed);
+
+  while (snapshot) {
+    const SettingsSnapshot* previous = snapshot->previous;
+    delete snapshot;
+    snapshot = previous;
+  }
+}
+
+void DynamicSettings::Apply(const DynamicConfig& config) {
+  /* Reloads are rare, the replaced snapshots are small enough to keep. */
+  current_.store(
+    new SettingsSnapshot{
+      SamplerThreshold(config.samplerRatio), config.attributeCountLimit,
+      config.attributeValueLengthLimit, config.eventCountLimit, config.linkCountLimit,
+      config.maxQueueSize, config.scheduleDelayMillis, config.maxExportBatchSize,
+      current_.load(std::memory_order_relaxed)},
+    std::memory_order_release);
+}
+
+SpanLimitStats SpanLimitCounters::Load() const {
+  SpanLimitStats stats;
+  stats.droppedAttributes = droppedAttributes.load(std::memory_order_relaxed);
+  stats.truncatedAttributes = truncatedAttributes.load(std::memory_order_relaxed);
+  stats.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+  stats.droppedLinks = droppedLinks.load(std::memory_order_relaxed);
+  return stats;
+}
+
+uint64_t SamplerThreshold(double ratio) {
+  if (ratio <= 0.0) {
+    return 0;
+  }
+
+  if (ratio >= 1.0) {
+    return UINT64_MAX;
+  }
+
+  double threshold = std::ldexp(ratio, 64);
+
+  if (threshold >= std::ldexp(1.0, 64)) {
+    return UINT64_MAX;
+  }
+
+  return static_cast<uint64_t>(threshold);
+}
+
+bool LoadConfigFile(const std::string& path, FileConfig* config) {
+  std::ifstream file(path);
+
+  if (!file) {
+    return false;
+  }
+
+  json root = json::parse(file, nullptr, false);
+
+  if (root.is_discarded() || !root.is_object()) {
+    return false;
+  }
+
+  FileConfig result;
+  result.dynamic = config->dynamic;
+  ReadString(root, "service_name", &result.serviceName);
+  ReadString(root, "traces_exporter", &result.tracesExporter);
+  ReadString(root, "otlp_endpoint", &result.otlpEndpoint);
+  ReadString(root, "jaeger_endpoint", &result.jaegerEndpoint);
+  ReadString(root, "access_token", &result.accessToken);
+  ReadUint(root, "reload_interval_millis", &result.reloadIntervalMillis);
+
+  auto propagators = root.find("propagators");
+  if (propagators != root.end() && propagators->is_array()) {
+    for (const auto& propagator : *propagators) {
+      if (propagator.is_string()) {
+        result.propagators += propagator.get<std::string>() + ",";
+      }
+    }
+  } else {
+    ReadString(root, "propagators", &result.propagators);
+  }
+
+  if (const json* attributes = FindObject(root, "resource_attributes")) {
+    for (auto it = attributes->begin(); it != attributes->end(); ++it) {
+      if (it.value().is_string()) {
+        result.resourceAttributes[it.key()] = it.value().get<std::string>();
+      }
+    }
+  }
+
+  ReadDynamicConfig(root, &result.dynamic);
+
+  *config = std::move(result);
+  return true;
+}
+
+void ApplySpanLimits(const SpanLimits& limits, DynamicConfig* config) {
+  auto apply = [](int64_t limit, uint32_t* out) {
+    if (limit >= 0) {
+      *out = static_cast<uint32_t>(std::min<int64_t>(limit, kUnlimited));
+    }
+  };
+
+  apply(limits.attributeCount, &config->attributeCountLimit);
+  apply(limits.attributeValueLength, &config->attributeValueLengthLimit);
+  apply(limits.eventCount, &config->eventCountLimit);
+  apply(limits.linkCount, &config->linkCountLimit);
+}
+
+ConfigWatcher::ConfigWatcher(
+  std::string path, std::chrono::milliseconds interval, std::shared_ptr<DynamicSettings> settings,
+  const DynamicConfig& defaults, const SpanLimits& limits)
+  : path_(std::move(path)), interval_(interval), settings_(std::move(settings)),
+    defaults_(defaults), limits_(limits) {
+  /* A child restarting the worker may load the file once more, applying it again is harmless. */
+  FileVersion lastVersion = StatFile(path_);
+  worker_.Start(interval_, [this, lastVersion]() mutable {
+    FileVersion version = StatFile(path_);
+
+    if (version == lastVersion) {
+      return;
+    }
+
+    lastVersion = version;
+
+    FileConfig config;
+    config.dynamic = defaults_;
+
+    if (version.exists && LoadConfigFile(path_, &config)) {
+      ApplySpanLimits(limits_, &config.dynamic);
+      settings_->Apply(config.dynamic);
+    }
+  });
+  RegisterForkHandler(this);
+}
+
+ConfigWatcher::~ConfigWatcher() {
+  UnregisterForkHandler(this);
+  worker_.Stop();
+}
+
+void ConfigWatcher::AfterForkChild() noexcept {
+  worker_.AfterForkChild();
+
+  try {
+    worker_.Restart();
+  } catch (const std::system_error&) {
+    /* The child keeps running with the settings it inherited. */
+  }
+}
+
+} // namespace splunk
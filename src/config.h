@@ -0,0 +1,128 @@
+#pragma once
+
+#include "fork_handler.h"
+#include "periodic_worker.h"
+
+#include <splunk/opentelemetry.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace splunk {
+
+const uint32_t kUnlimited = UINT32_MAX;
+
+/* Settings which can be changed by editing the config file while the process is running. */
+struct DynamicConfig {
+  double samplerRatio = 1.0;
+  uint32_t attributeCountLimit = 128;
+  uint32_t attributeValueLengthLimit = kUnlimited;
+  uint32_t eventCountLimit = 128;
+  uint32_t linkCountLimit = 128;
+  uint32_t maxQueueSize = 2048;
+  uint32_t scheduleDelayMillis = 5000;
+  uint32_t maxExportBatchSize = 512;
+};
+
+/* One consistent set of the live values of DynamicConfig, never modified once published. */
+struct SettingsSnapshot {
+  uint64_t samplerThreshold;
+  uint32_t attributeCountLimit;
+  uint32_t attributeValueLengthLimit;
+  uint32_t eventCountLimit;
+  uint32_t linkCountLimit;
+  uint32_t maxQueueSize;
+  uint32_t scheduleDelayMillis;
+  uint32_t maxExportBatchSize;
+  /* The snapshot this one replaced. */
+  const SettingsSnapshot* previous;
+};
+
+/*
+ * The live values of DynamicConfig. Everything on the span path reads them with one acquire
+ * load of the current snapshot, a reload publishes a new one without ever blocking the readers.
+ * Snapshots are only freed with the settings, so a reader may keep one as long as the settings
+ * live: a span applies the limits of the snapshot current when it started.
+ */
+class DynamicSettings {
+public:
+  explicit DynamicSettings(const DynamicConfig& config) { Apply(config); }
+  ~DynamicSettings();
+
+  DynamicSettings(const DynamicSettings&) = delete;
+  DynamicSettings& operator=(const DynamicSettings&) = delete;
+
+  const SettingsSnapshot& Load() const { return *current_.load(std::memory_order_acquire); }
+
+  /* Called by one thread at a time, the config watcher's. */
+  void Apply(const DynamicConfig& config);
+
+private:
+  std::atomic<const SettingsSnapshot*> current_{nullptr};
+};
+
+/* What the span limits cut, incremented by the recordables. */
+struct SpanLimitCounters {
+  std::atomic<uint64_t> droppedAttributes{0};
+  std::atomic<uint64_t> truncatedAttributes{0};
+  std::atomic<uint64_t> droppedEvents{0};
+  std::atomic<uint64_t> droppedLinks{0};
+
+  SpanLimitStats Load() const;
+};
+
+struct FileConfig {
+  std::string serviceName;
+  std::map<std::string, std::string> resourceAttributes;
+  std::string tracesExporter;
+  std::string propagators;
+  std::string otlpEndpoint;
+  std::string jaegerEndpoint;
+  std::string accessToken;
+  uint32_t reloadIntervalMillis = 0;
+  DynamicConfig dynamic;
+};
+
+/*
+ * Returns false if the file can't be read or is not a valid JSON object. Settings of the dynamic
+ * section which the file doesn't have keep the values config->dynamic had before the call.
+ */
+bool LoadConfigFile(const std::string& path, FileConfig* config);
+
+/* Fills in the options left to their defaults, from the config file and the environment. */
+OpenTelemetryOptions ApplyDefaults(OpenTelemetryOptions options, const FileConfig& fileConfig);
+
+/* Overrides the limits which are set. */
+void ApplySpanLimits(const SpanLimits& limits, DynamicConfig* config);
+
+uint64_t SamplerThreshold(double ratio);
+
+/*
+ * Polls the config file for modifications and applies the dynamic part of it on top of
+ * defaults, with limits taking precedence over the file. Invalid files are ignored and the
+ * previous settings are kept. The polling thread is restarted in the child of a fork.
+ */
+class ConfigWatcher final : private ForkHandler {
+public:
+  ConfigWatcher(
+    std::string path, std::chrono::milliseconds interval,
+    std::shared_ptr<DynamicSettings> settings, const DynamicConfig& defaults,
+    const SpanLimits& limits);
+  ~ConfigWatcher() override;
+
+private:
+  void AfterForkChild() noexcept override;
+
+  const std::string path_;
+  const std::chrono::milliseconds interval_;
+  std::shared_ptr<DynamicSettings> settings_;
+  const DynamicConfig defaults_;
+  const SpanLimits limits_;
+  PeriodicWorker worker_;
+};
+
+} // namespace splunk
@@ -0,0 +1,295 @@
+#include "context_storage.h"
+
+#include <splunk/context.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace context = opentelemetry::context;
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+/* Enough for any realistic nesting of scopes, deeper ones go to the overflow vector. */
+const size_t kInlineDepth = 32;
+
+struct Slot {
+  /* For span slots this is only built once something asks for the current context. */
+  context::Context context;
+  nostd::shared_ptr<trace::Span> span;
+  bool hasContext = false;
+};
+
+class Stack {
+public:
+  size_t Size() const { return size_; }
+
+  Slot& Emplace() {
+    if (size_ >= kInlineDepth && overflow_.size() <= size_ - kInlineDepth) {
+      overflow_.emplace_back();
+    }
+
+    return At(size_++);
+  }
+
+  void PopTo(size_t depth) {
+    while (size_ > depth) {
+      Slot& slot = At(--size_);
+      slot.context = context::Context();
+      slot.span = nostd::shared_ptr<trace::Span>();
+      slot.hasContext = false;
+    }
+  }
+
+  /* Builds the contexts of span slots up to index, returns the one at index. */
+  const context::Context& Materialize(size_t index) {
+    size_t first = index;
+    while (first > 0 && !At(first).hasContext) {
+      first--;
+    }
+
+    for (size_t i = first; i <= index; i++) {
+      Slot& slot = At(i);
+
+      if (slot.hasContext) {
+        continue;
+      }
+
+      context::Context parent = i > 0 ? At(i - 1).context : context::Context();
+      slot.context = parent.SetValue(trace::kSpanKey, slot.span);
+      slot.hasContext = true;
+    }
+
+    return At(index).context;
+  }
+
+  const Slot& Top() { return At(size_ - 1); }
+
+  /* Finds the slot holding context from the top, returns Size() if there is none. */
+  size_t Find(const context::Token& token) {
+    for (size_t i = size_; i > 0; i--) {
+      Slot& slot = At(i - 1);
+
+      if (slot.hasContext && token == slot.context) {
+        return i - 1;
+      }
+    }
+
+    return size_;
+  }
+
+private:
+  Slot& At(size_t index) {
+    return index < kInlineDepth ? inline_[index] : overflow_[index - kInlineDepth];
+  }
+
+  size_t size_ = 0;
+  Slot inline_[kInlineDepth];
+  std::vector<Slot> overflow_;
+};
+
+thread_local Stack stack;
+
+std::atomic<bool> installed{false};
+
+/* Number of TrackActiveSpanIds(true) calls not yet undone. */
+std::atomic<int> spanIdReaders{0};
+
+/*
+ * Mirrors the depth of the stack and the span IDs of its preallocated slots. Trivially
+ * constructible, so a signal handler touching it runs no thread-local initializer. The depth is
+ * only published once the IDs below it are written.
+ */
+struct SpanIdStack {
+  std::atomic<size_t> depth;
+  bool valid[kInlineDepth];
+  ContextStorage::ActiveSpanIds ids[kInlineDepth];
+};
+
+thread_local SpanIdStack spanIds;
+
+/*
+ * The thread's spanIds once it pushed anything, what signal handlers read instead: in a shared
+ * library spanIds is global-dynamic TLS, whose first access on a thread may allocate through
+ * __tls_get_addr. Initial-exec TLS sits at a fixed offset of the thread pointer and only takes
+ * the size of a pointer from the static TLS block.
+ */
+__attribute__((tls_model("initial-exec"))) thread_local SpanIdStack* publishedSpanIds = nullptr;
+
+void RecordSpanIds(size_t depth, const trace::SpanContext& span) {
+  if (depth >= kInlineDepth) {
+    return;
+  }
+
+  spanIds.valid[depth] = span.IsValid();
+
+  if (spanIds.valid[depth]) {
+    span.trace_id().CopyBytesTo(
+      nostd::span<uint8_t, trace::TraceId::kSize>(spanIds.ids[depth].traceId));
+    span.span_id().CopyBytesTo(
+      nostd::span<uint8_t, trace::SpanId::kSize>(spanIds.ids[depth].spanId));
+  }
+}
+
+void PublishDepth(size_t depth) {
+  std::atomic_signal_fence(std::memory_order_release);
+  spanIds.depth.store(depth, std::memory_order_relaxed);
+  publishedSpanIds = &spanIds;
+}
+
+trace::SpanContext SpanContextOf(const context::Context& context) {
+  context::ContextValue value = context.GetValue(trace::kSpanKey);
+
+  if (!nostd::holds_alternative<nostd::shared_ptr<trace::Span>>(value)) {
+    return trace::SpanContext::GetInvalid();
+  }
+
+  return nostd::get<nostd::shared_ptr<trace::Span>>(value)->GetContext();
+}
+
+} // namespace
+
+context::Context ContextStorage::GetCurrent() noexcept {
+  if (stack.Size() == 0) {
+    return context::Context();
+  }
+
+  return stack.Materialize(stack.Size() - 1);
+}
+
+nostd::unique_ptr<context::Token> ContextStorage::Attach(const context::Context& context) noexcept {
+  Push(context);
+  return CreateToken(context);
+}
+
+bool ContextStorage::Detach(context::Token& token) noexcept {
+  size_t index = stack.Find(token);
+
+  if (index == stack.Size()) {
+    return false;
+  }
+
+  PublishDepth(std::min(index, kInlineDepth));
+  stack.PopTo(index);
+  return true;
+}
+
+void ContextStorage::Install() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    context::RuntimeContext::SetRuntimeContextStorage(
+      nostd::shared_ptr<context::RuntimeContextStorage>(new ContextStorage()));
+    installed.store(true, std::memory_order_release);
+  });
+}
+
+bool ContextStorage::IsInstalled() noexcept { return installed.load(std::memory_order_acquire); }
+
+size_t ContextStorage::Push(const context::Context& context) noexcept {
+  size_t depth = stack.Size();
+
+  if (depth < kInlineDepth) {
+    spanIds.valid[depth] = false;
+
+    if (spanIdReaders.load(std::memory_order_relaxed) > 0) {
+      RecordSpanIds(depth, SpanContextOf(context));
+    }
+
+    PublishDepth(depth + 1);
+  }
+
+  Slot& slot = stack.Emplace();
+  slot.context = context;
+  slot.hasContext = true;
+  return depth;
+}
+
+size_t ContextStorage::Push(const nostd::shared_ptr<trace::Span>& span) noexcept {
+  size_t depth = stack.Size();
+
+  if (depth < kInlineDepth) {
+    spanIds.valid[depth] = false;
+
+    if (spanIdReaders.load(std::memory_order_relaxed) > 0) {
+      RecordSpanIds(depth, span->GetContext());
+    }
+
+    PublishDepth(depth + 1);
+  }
+
+  stack.Emplace().span = span;
+  return depth;
+}
+
+void ContextStorage::PopTo(size_t depth) noexcept {
+  PublishDepth(std::min(depth, kInlineDepth));
+  stack.PopTo(depth);
+}
+
+trace::SpanContext ContextStorage::CurrentSpanContext() noexcept {
+  if (!IsInstalled()) {
+    return SpanContextOf(context::RuntimeContext::GetCurrent());
+  }
+
+  if (stack.Size() == 0) {
+    return trace::SpanContext::GetInvalid();
+  }
+
+  const Slot& top = stack.Top();
+  return top.span ? top.span->GetContext() : SpanContextOf(top.context);
+}
+
+void ContextStorage::TrackActiveSpanIds(bool enabled) noexcept {
+  spanIdReaders.fetch_add(enabled ? 1 : -1, std::memory_order_relaxed);
+}
+
+bool ContextStorage::ReadActiveSpanIds(ActiveSpanIds* ids) noexcept {
+  /* Null on threads which never pushed, they have no active span. */
+  const SpanIdStack* published = publishedSpanIds;
+
+  if (!published) {
+    return false;
+  }
+
+  size_t depth = published->depth.load(std::memory_order_relaxed);
+  std::atomic_signal_fence(std::memory_order_acquire);
+
+  if (depth == 0 || !published->valid[depth - 1]) {
+    return false;
+  }
+
+  *ids = published->ids[depth - 1];
+  return true;
+}
+
+ContextScope::ContextScope(const context::Context& context) noexcept {
+  if (ContextStorage::IsInstalled()) {
+    depth_ = ContextStorage::Push(context);
+  } else {
+    token_ = context::RuntimeContext::Attach(context);
+  }
+}
+
+ContextScope::ContextScope(const nostd::shared_ptr<trace::Span>& span) noexcept {
+  if (ContextStorage::IsInstalled()) {
+    depth_ = ContextStorage::Push(span);
+  } else {
+    token_ = context::RuntimeContext::Attach(
+      context::RuntimeContext::GetCurrent().SetValue(trace::kSpanKey, span));
+  }
+}
+
+ContextScope::~ContextScope() {
+  if (token_) {
+    context::RuntimeContext::Detach(*token_);
+  } else {
+    ContextStorage::PopTo(depth_);
+  }
+}
+
+} // namespace splunk
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opentelemetry/context/runtime_context.h>
+#include <opentelemetry/trace/span.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace splunk {
+
+/*
+ * Runtime context storage backed by a thread-local stack with a fixed number of preallocated
+ * slots, deeper nesting spills to a heap allocated overflow. Slots are only ever touched by
+ * their own thread, so pushing and popping involves no atomics besides the reference count of
+ * the Context itself.
+ */
+class ContextStorage final : public opentelemetry::context::RuntimeContextStorage {
+public:
+  opentelemetry::context::Context GetCurrent() noexcept override;
+
+  opentelemetry::nostd::unique_ptr<opentelemetry::context::Token> Attach(
+    const opentelemetry::context::Context& context) noexcept override;
+
+  bool Detach(opentelemetry::context::Token& token) noexcept override;
+
+  /* Installs the storage as the global runtime context storage. */
+  static void Install();
+
+  /* Whether Install was called, ContextScope falls back to RuntimeContext otherwise. */
+  static bool IsInstalled() noexcept;
+
+  /* Push the context, or a span on top of the current context, returns the previous depth. */
+  static size_t Push(const opentelemetry::context::Context& context) noexcept;
+  static size_t Push(
+    const opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span>& span) noexcept;
+  /* Pops everything above depth. */
+  static void PopTo(size_t depth) noexcept;
+
+  /*
+   * Context of the active span, invalid when there is none. Unlike GetCurrent it builds no
+   * Context for the slots pushed by spans.
+   */
+  static opentelemetry::trace::SpanContext CurrentSpanContext() noexcept;
+
+  struct ActiveSpanIds {
+    uint8_t traceId[opentelemetry::trace::TraceId::kSize];
+    uint8_t spanId[opentelemetry::trace::SpanId::kSize];
+  };
+
+  /*
+   * While enabled, each push also copies the IDs of the active span to a plain thread-local
+   * array, which ReadActiveSpanIds reads. Only pushes made while enabled have IDs. Calls nest,
+   * each reader enables it once and disables it once.
+   */
+  static void TrackActiveSpanIds(bool enabled) noexcept;
+  /*
+   * Async-signal-safe, for signal handlers interrupting the thread. Returns false when no span is
+   * active. Scopes nested deeper than the preallocated slots report their outermost ancestors.
+   */
+  static bool ReadActiveSpanIds(ActiveSpanIds* ids) noexcept;
+};
+
+} // namespace splunk
@@ -0,0 +1,308 @@
+#include "cpu_profiler.h"
+
+#include "context_storage.h"
+#include "frame_walk.h"
+#include "profile_exporter.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace sdkresource = opentelemetry::sdk::resource;
+
+namespace splunk {
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+const size_t kMaxFrames = 64;
+/* At 100 Hz, holds the samples of 80 busy cores between two drains. */
+const size_t kRingSize = 2048;
+const auto kDrainInterval = std::chrono::milliseconds(250);
+const auto kExportTimeout = std::chrono::seconds(10);
+
+enum SampleState : uint32_t {
+  SampleState_Free,
+  SampleState_Writing,
+  SampleState_Ready,
+};
+
+struct Sample {
+  std::atomic<uint32_t> state;
+  bool hasSpan;
+  ContextStorage::ActiveSpanIds span;
+  size_t depth;
+  /* Leaf first. */
+  uintptr_t frames[kMaxFrames];
+};
+
+/* Written by signal handlers on any thread, in whichever free slot comes next. */
+struct Ring {
+  Sample samples[kRingSize];
+  std::atomic<size_t> next;
+};
+
+/* Allocated with the handler and never freed, a signal may be pending at any time. */
+Ring* ring = nullptr;
+std::atomic<bool> sampling{false};
+std::atomic<uint64_t> droppedSamples{0};
+
+size_t Unwind(const ucontext_t* context, uintptr_t* frames, size_t maxFrames) {
+#if defined(__x86_64__)
+  uintptr_t pc = context->uc_mcontext.gregs[REG_RIP];
+  uintptr_t fp = context->uc_mcontext.gregs[REG_RBP];
+  uintptr_t sp = context->uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+  uintptr_t pc = context->uc_mcontext.pc;
+  uintptr_t fp = context->uc_mcontext.regs[29];
+  uintptr_t sp = context->uc_mcontext.sp;
+#else
+  (void)context;
+  (void)frames;
+  (void)maxFrames;
+  return 0;
+#endif
+
+  frames[0] = pc;
+  return WalkFrames(fp, sp, frames, 1, maxFrames);
+}
+
+void OnSigprof(int, siginfo_t*, void* context) {
+  int savedErrno = errno;
+
+  if (sampling.load(std::memory_order_relaxed)) {
+    Sample& sample = ring->samples[ring->next.fetch_add(1, std::memory_order_relaxed) % kRingSize];
+    uint32_t expected = SampleState_Free;
+
+    if (sample.state.compare_exchange_strong(
+          expected, SampleState_Writing, std::memory_order_acquire, std::memory_order_relaxed)) {
+      sample.hasSpan = ContextStorage::ReadActiveSpanIds(&sample.span);
+      sample.depth = Unwind(static_cast<const ucontext_t*>(context), sample.frames, kMaxFrames);
+      sample.state.store(SampleState_Ready, std::memory_order_release);
+    } else {
+      droppedSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  errno = savedErrno;
+}
+
+/* Installs the handler once, returns false when someone else handles SIGPROF. */
+bool InstallHandler() {
+  static bool installed = [] {
+    struct sigaction previous;
+
+    if (sigaction(SIGPROF, nullptr, &previous) != 0 ||
+        (previous.sa_flags & SA_SIGINFO) ||
+        (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)) {
+      return false;
+    }
+
+    ring = new Ring();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = OnSigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(SIGPROF, &action, nullptr) == 0;
+  }();
+
+  return installed;
+}
+
+void SetTimer(std::chrono::microseconds interval) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000);
+  timer.it_interval.tv_usec = static_cast<suseconds_t>(interval.count() % 1000000);
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+/* A stack key is a sample's hasSpan flag, span IDs and frames as raw bytes. */
+const size_t kStackKeyHeader = 1 + sizeof(ContextStorage::ActiveSpanIds);
+
+void StackKey(const Sample& sample, std::string* key) {
+  ContextStorage::ActiveSpanIds span =
+    sample.hasSpan ? sample.span : ContextStorage::ActiveSpanIds();
+  key->assign(1, sample.hasSpan ? 1 : 0);
+  key->append(reinterpret_cast<const char*>(&span), sizeof(span));
+  key->append(
+    reinterpret_cast<const char*>(sample.frames), sample.depth * sizeof(sample.frames[0]));
+}
+
+} // namespace
+
+struct CpuProfiler::Profile {
+  /* Sample counts of each distinct StackKey. */
+  std::unordered_map<std::string, uint64_t> stacks;
+  std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+};
+
+CpuProfiler::CpuProfiler(
+  const std::string& otlpEndpoint, const sdkresource::Resource& resource,
+  std::chrono::milliseconds samplingInterval, std::chrono::milliseconds exportInterval,
+  bool exportFromChildren)
+  : samplingInterval_(std::max(samplingInterval, std::chrono::milliseconds(1))),
+    exportInterval_(exportInterval), exportFromChildren_(exportFromChildren),
+    exporter_(new ProfileExporter(otlpEndpoint, resource)), profile_(new Profile()),
+    nextExport_(std::chrono::steady_clock::now() + exportInterval_) {
+  worker_.Start(kDrainInterval, [this] { Tick(); });
+  StartSampling();
+  RegisterForkHandler(this);
+}
+
+CpuProfiler::~CpuProfiler() {
+  UnregisterForkHandler(this);
+  StopSampling();
+  worker_.Stop();
+}
+
+uint64_t CpuProfiler::DroppedSamples() { return droppedSamples.load(std::memory_order_relaxed); }
+
+void CpuProfiler::StartSampling() {
+  if (!sampling_ && InstallHandler()) {
+    ContextStorage::TrackActiveSpanIds(true);
+    sampling_ = true;
+  }
+
+  if (sampling_) {
+    sampling.store(true, std::memory_order_relaxed);
+    SetTimer(samplingInterval_);
+  }
+}
+
+void CpuProfiler::StopSampling() {
+  if (!sampling_) {
+    return;
+  }
+
+  SetTimer(std::chrono::microseconds(0));
+  sampling.store(false, std::memory_order_relaxed);
+  ContextStorage::TrackActiveSpanIds(false);
+  sampling_ = false;
+}
+
+bool CpuProfiler::Shutdown(Deadline deadline) {
+  if (isShutdown_) {
+    return true;
+  }
+
+  isShutdown_ = true;
+  StopSampling();
+
+  /* An export in progress at the deadline is cancelled, the last one then fails too. */
+  worker_.Stop(deadline, [this] {
+    if (exporter_) {
+      exporter_->Cancel();
+    }
+  });
+
+  return Export(deadline);
+}
+
+void CpuProfiler::Tick() {
+  auto now = std::chrono::steady_clock::now();
+
+  if (now >= nextExport_) {
+    Export(now + kExportTimeout);
+    nextExport_ = now + exportInterval_;
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Drain();
+  }
+}
+
+void CpuProfiler::Drain() {
+  if (!ring) {
+    return;
+  }
+
+  std::string key;
+
+  for (Sample& sample : ring->samples) {
+    if (sample.state.load(std::memory_order_acquire) != SampleState_Ready) {
+      continue;
+    }
+
+    StackKey(sample, &key);
+    sample.state.store(SampleState_Free, std::memory_order_release);
+
+    profile_->stacks[key]++;
+  }
+}
+
+bool CpuProfiler::Export(Deadline deadline) {
+  std::unordered_map<std::string, uint64_t> stacks;
+  std::chrono::system_clock::time_point start;
+  auto end = std::chrono::system_clock::now();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Drain();
+    stacks.swap(profile_->stacks);
+    start = profile_->start;
+    profile_->start = end;
+  }
+
+  /* Null in a child which doesn't profile. */
+  if (stacks.empty() || !exporter_) {
+    return true;
+  }
+
+  uint64_t period = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(samplingInterval_).count());
+  PprofBuilder profile(
+    {{"samples", "count"}, {"cpu", "nanoseconds"}}, {"cpu", "nanoseconds"}, period);
+
+  for (const auto& stack : stacks) {
+    const std::string& key = stack.first;
+    std::vector<uintptr_t> frames((key.size() - kStackKeyHeader) / sizeof(uintptr_t));
+    memcpy(frames.data(), key.data() + kStackKeyHeader, frames.size() * sizeof(uintptr_t));
+    ContextStorage::ActiveSpanIds span;
+    memcpy(&span, key.data() + 1, sizeof(span));
+    profile.AddSample(
+      frames.data(), frames.size(), key[0] ? &span : nullptr,
+      {stack.second, stack.second * period});
+  }
+
+  return exporter_->Export(profile.Build(start, end), "cpu", end, deadline);
+}
+
+void CpuProfiler::PrepareFork() noexcept { mutex_.lock(); }
+
+void CpuProfiler::AfterForkParent() noexcept { mutex_.unlock(); }
+
+void CpuProfiler::AfterForkChild() noexcept {
+  /* The parent exports what it sampled, samples mid-write belong to threads gone in the child. */
+  if (ring) {
+    for (Sample& sample : ring->samples) {
+      sample.state.store(SampleState_Free, std::memory_order_relaxed);
+    }
+  }
+
+  profile_->stacks.clear();
+  profile_->start = std::chrono::system_clock::now();
+  mutex_.unlock();
+
+  nextExport_ = std::chrono::steady_clock::now() + exportInterval_;
+
+  /* Interval timers aren't inherited, sampling starts again in a child which exports. */
+  if (RestartInChild(
+        &worker_, &exporter_, exportFromChildren_ && !isShutdown_,
+        [](const ProfileExporter& parent) { return parent.Reconnect(); })) {
+    StartSampling();
+  } else {
+    StopSampling();
+  }
+}
+
+} // namespace splunk
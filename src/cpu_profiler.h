@@ -0,0 +1,77 @@
+#pragma once
+
+#include "fork_handler.h"
+#include "periodic_worker.h"
+#include "profile_exporter.h"
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace splunk {
+
+/*
+ * Samples the call stack of whichever thread is on the CPU every samplingInterval of CPU time,
+ * through ITIMER_PROF and a SIGPROF handler. The handler walks the frame pointer chain, so only
+ * frames of code built with frame pointers are seen, and tags the sample with the span active
+ * on the interrupted thread. It takes no lock and doesn't allocate: samples go to a fixed ring
+ * and are dropped when it is full.
+ *
+ * A thread of the profiler drains the ring, counts identical stacks and every exportInterval
+ * sends the counts as a gzipped pprof profile in an OTLP log record, in the format of Splunk
+ * AlwaysOn Profiling.
+ *
+ * ITIMER_PROF and SIGPROF are process-wide: only one profiler runs at a time, and none when
+ * another SIGPROF handler is installed. Interval timers don't survive fork, the child only
+ * profiles itself when exportFromChildren is set.
+ */
+class CpuProfiler final : private ForkHandler {
+public:
+  CpuProfiler(
+    const std::string& otlpEndpoint, const opentelemetry::sdk::resource::Resource& resource,
+    std::chrono::milliseconds samplingInterval, std::chrono::milliseconds exportInterval,
+    bool exportFromChildren);
+  ~CpuProfiler() override;
+
+  /*
+   * Stops sampling, cancels an export of the profiler thread still in progress at the deadline
+   * and exports the profile of what was sampled so far.
+   */
+  bool Shutdown(std::chrono::steady_clock::time_point deadline);
+
+  /* Samples lost to a full ring, or interrupting the profiler while it was stopping. */
+  static uint64_t DroppedSamples();
+
+private:
+  struct Profile;
+
+  void StartSampling();
+  void StopSampling();
+  void Tick();
+  void Drain();
+  bool Export(std::chrono::steady_clock::time_point deadline);
+
+  void PrepareFork() noexcept override;
+  void AfterForkParent() noexcept override;
+  void AfterForkChild() noexcept override;
+
+  const std::chrono::milliseconds samplingInterval_;
+  const std::chrono::milliseconds exportInterval_;
+  const bool exportFromChildren_;
+  /* Guards profile_, the profiler thread and Shutdown both drain and export. */
+  std::mutex mutex_;
+  std::unique_ptr<ProfileExporter> exporter_;
+  std::unique_ptr<Profile> profile_;
+  /* Only touched by the worker's thread, or before it starts. */
+  std::chrono::steady_clock::time_point nextExport_;
+  PeriodicWorker worker_;
+  /* Whether this profiler armed the timer, the handler may belong to someone else. */
+  bool sampling_ = false;
+  bool isShutdown_ = false;
+};
+
+} // namespace splunk
@@ -0,0 +1,84 @@
+#include "fork_handler.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace splunk {
+
+namespace {
+
+struct Registry {
+  /* Held from prepare until the parent or child handler runs. */
+  std::mutex mutex;
+  std::vector<ForkHandler*> handlers;
+};
+
+/* Never destroyed, handlers may unregister from static destructors. */
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+std::atomic<uint64_t> forkGeneration{0};
+
+void Prepare() {
+  Registry& registry = GetRegistry();
+  registry.mutex.lock();
+
+  for (auto it = registry.handlers.rbegin(); it != registry.handlers.rend(); ++it) {
+    (*it)->PrepareFork();
+  }
+}
+
+void Parent() {
+  Registry& registry = GetRegistry();
+
+  for (ForkHandler* handler : registry.handlers) {
+    handler->AfterForkParent();
+  }
+
+  registry.mutex.unlock();
+}
+
+void Child() {
+  forkGeneration.fetch_add(1, std::memory_order_relaxed);
+
+  Registry& registry = GetRegistry();
+
+  for (ForkHandler* handler : registry.handlers) {
+    handler->AfterForkChild();
+  }
+
+  registry.mutex.unlock();
+}
+
+} // namespace
+
+void TrackForks() {
+  static std::once_flag installed;
+  std::call_once(installed, [] { pthread_atfork(&Prepare, &Parent, &Child); });
+}
+
+void RegisterForkHandler(ForkHandler* handler) {
+  TrackForks();
+
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.handlers.push_back(handler);
+}
+
+void UnregisterForkHandler(ForkHandler* handler) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.handlers.erase(
+    std::remove(registry.handlers.begin(), registry.handlers.end(), handler),
+    registry.handlers.end());
+}
+
+uint64_t ForkGeneration() { return forkGeneration.load(std::memory_order_relaxed); }
+
+} // namespace splunk
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+namespace splunk {
+
+/*
+ * Components owning threads or sockets implement this to survive fork(). Handlers run from
+ * pthread_atfork: prepare in reverse registration order, parent and child in registration
+ * order. In the child only the forking thread exists, so AfterForkChild must not wait on
+ * anything owned by another thread.
+ */
+class ForkHandler {
+public:
+  virtual ~ForkHandler() = default;
+
+  virtual void PrepareFork() noexcept {}
+  virtual void AfterForkParent() noexcept {}
+  virtual void AfterForkChild() noexcept = 0;
+};
+
+void RegisterForkHandler(ForkHandler* handler);
+void UnregisterForkHandler(ForkHandler* handler);
+
+/* Starts counting forks without registering a handler, RegisterForkHandler implies it. */
+void TrackForks();
+
+/*
+ * Incremented in the child on every fork after the first TrackForks, cheap enough to poll on
+ * hot paths.
+ */
+uint64_t ForkGeneration();
+
+} // namespace splunk
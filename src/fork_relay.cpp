@@ -0,0 +1,318 @@
+#include "fork_relay.h"
+
+#include "grpc_deadline.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable_utils.h>
+#include <opentelemetry/proto/collector/trace/v1/trace_service.grpc.pb.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <vector>
+
+namespace nostd = opentelemetry::nostd;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace traceservice = opentelemetry::proto::collector::trace::v1;
+
+namespace splunk {
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+using ExportResult = opentelemetry::sdk::common::ExportResult;
+
+/* Asked for on both ends, the kernel caps it at net.core.{w,r}mem_max. */
+const int kSocketBufferSize = 4 << 20;
+const size_t kSpansPerMessage = 64;
+const auto kExportTimeout = std::chrono::seconds(10);
+
+/*
+ * Moves about half of the spans in request to other, keeping the resource and
+ * instrumentation library they belong to. Returns false if request holds a single span.
+ */
+bool SplitRequest(
+  traceservice::ExportTraceServiceRequest* request,
+  traceservice::ExportTraceServiceRequest* other) {
+  auto* resourceSpans = request->mutable_resource_spans();
+
+  if (resourceSpans->size() > 1) {
+    int half = resourceSpans->size() / 2;
+
+    for (int i = half; i < resourceSpans->size(); i++) {
+      resourceSpans->Mutable(i)->Swap(other->add_resource_spans());
+    }
+
+    resourceSpans->DeleteSubrange(half, resourceSpans->size() - half);
+    return true;
+  }
+
+  if (resourceSpans->empty()) {
+    return false;
+  }
+
+  auto* libSpans = resourceSpans->Mutable(0)->mutable_instrumentation_library_spans();
+  auto* otherResourceSpans = other->add_resource_spans();
+  *otherResourceSpans->mutable_resource() = resourceSpans->Get(0).resource();
+
+  if (libSpans->size() > 1) {
+    int half = libSpans->size() / 2;
+
+    for (int i = half; i < libSpans->size(); i++) {
+      libSpans->Mutable(i)->Swap(otherResourceSpans->add_instrumentation_library_spans());
+    }
+
+    libSpans->DeleteSubrange(half, libSpans->size() - half);
+    return true;
+  }
+
+  if (libSpans->empty() || libSpans->Get(0).spans_size() < 2) {
+    other->Clear();
+    return false;
+  }
+
+  auto* spans = libSpans->Mutable(0)->mutable_spans();
+  auto* otherLibSpans = otherResourceSpans->add_instrumentation_library_spans();
+  *otherLibSpans->mutable_instrumentation_library() = libSpans->Get(0).instrumentation_library();
+
+  int half = spans->size() / 2;
+
+  for (int i = half; i < spans->size(); i++) {
+    spans->Mutable(i)->Swap(otherLibSpans->add_spans());
+  }
+
+  spans->DeleteSubrange(half, spans->size() - half);
+  return true;
+}
+
+uint64_t CountSpans(const traceservice::ExportTraceServiceRequest& request) {
+  uint64_t spans = 0;
+
+  for (const auto& resourceSpans : request.resource_spans()) {
+    for (const auto& librarySpans : resourceSpans.instrumentation_library_spans()) {
+      spans += static_cast<uint64_t>(librarySpans.spans_size());
+    }
+  }
+
+  return spans;
+}
+
+/* Exporter used by children, each Export call sends one or more datagrams to the parent. */
+class ForwardingSpanExporter final : public sdktrace::SpanExporter {
+public:
+  explicit ForwardingSpanExporter(int fd) : fd_(fd) {}
+
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new otlp::OtlpRecordable());
+  }
+
+  ExportResult Export(
+    const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    if (isShutdown_.load(std::memory_order_acquire)) {
+      return ExportResult::kFailure;
+    }
+
+    /* Bounds the whole batch, in case the parent stopped reading. */
+    Deadline deadline = std::chrono::steady_clock::now() + kExportTimeout;
+    bool ok = true;
+
+    for (size_t offset = 0; offset < spans.size(); offset += kSpansPerMessage) {
+      size_t count = std::min(kSpansPerMessage, spans.size() - offset);
+      traceservice::ExportTraceServiceRequest request;
+      otlp::OtlpRecordableUtils::PopulateRequest(
+        nostd::span<std::unique_ptr<sdktrace::Recordable>>(spans.data() + offset, count),
+        &request);
+
+      ok = Send(&request, deadline) && ok;
+    }
+
+    return ok ? ExportResult::kSuccess : ExportResult::kFailure;
+  }
+
+  bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+    isShutdown_.store(true, std::memory_order_release);
+    return true;
+  }
+
+private:
+  /* Fails when the parent's socket buffer has no room for the message before the deadline. */
+  bool Send(traceservice::ExportTraceServiceRequest* request, Deadline deadline) {
+    std::string message;
+
+    if (!request->SerializeToString(&message)) {
+      return false;
+    }
+
+    for (;;) {
+      if (send(fd_, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT) >= 0) {
+        return true;
+      }
+
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if ((errno != EAGAIN && errno != EWOULDBLOCK) || !WaitWritable(deadline)) {
+        break;
+      }
+    }
+
+    /* Larger than the socket buffer allows, retry in halves. */
+    traceservice::ExportTraceServiceRequest other;
+    if (errno != EMSGSIZE || !SplitRequest(request, &other)) {
+      return false;
+    }
+
+    bool ok = Send(request, deadline);
+    return Send(&other, deadline) && ok;
+  }
+
+  bool WaitWritable(Deadline deadline) {
+    pollfd fd = {fd_, POLLOUT, 0};
+
+    for (;;) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+
+      if (remaining.count() <= 0) {
+        return false;
+      }
+
+      int ready = poll(&fd, 1, static_cast<int>(remaining.count()));
+
+      if (ready > 0) {
+        return true;
+      }
+
+      if (ready < 0 && errno != EINTR) {
+        return false;
+      }
+    }
+  }
+
+  const int fd_;
+  std::atomic<bool> isShutdown_{false};
+};
+
+} // namespace
+
+struct ForkRelay::Channel {
+  std::unique_ptr<traceservice::TraceService::Stub> stub;
+};
+
+std::shared_ptr<ForkRelay> ForkRelay::Create(const std::string& otlpEndpoint) {
+  int fds[2];
+
+  if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    return nullptr;
+  }
+
+  setsockopt(fds[0], SOL_SOCKET, SO_RCVBUF, &kSocketBufferSize, sizeof(kSocketBufferSize));
+  setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &kSocketBufferSize, sizeof(kSocketBufferSize));
+
+  try {
+    return std::shared_ptr<ForkRelay>(new ForkRelay(fds[0], fds[1], otlpEndpoint));
+  } catch (const std::system_error&) {
+    close(fds[0]);
+    close(fds[1]);
+    return nullptr;
+  }
+}
+
+ForkRelay::ForkRelay(int parentFd, int childFd, const std::string& otlpEndpoint)
+  : parentFd_(parentFd), childFd_(childFd), channel_(new Channel()),
+    deadline_(Deadline::max().time_since_epoch().count()) {
+  channel_->stub = traceservice::TraceService::NewStub(
+    grpc::CreateChannel(otlpEndpoint, grpc::InsecureChannelCredentials()));
+  thread_.reset(new std::thread(&ForkRelay::Run, this));
+
+  RegisterForkHandler(this);
+}
+
+ForkRelay::~ForkRelay() {
+  UnregisterForkHandler(this);
+
+  if (!isChild_) {
+    Shutdown(Deadline::max());
+    close(parentFd_);
+  }
+
+  close(childFd_);
+}
+
+std::unique_ptr<sdktrace::SpanExporter> ForkRelay::MakeChildExporter() {
+  return std::unique_ptr<sdktrace::SpanExporter>(new ForwardingSpanExporter(childFd_));
+}
+
+void ForkRelay::Shutdown(Deadline deadline) {
+  if (isChild_ || !thread_) {
+    return;
+  }
+
+  deadline_.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+
+  /* Queued datagrams are still received, new sends from children fail with EPIPE. */
+  shutdown(parentFd_, SHUT_RD);
+
+  thread_->join();
+  thread_.reset();
+}
+
+void ForkRelay::Run() {
+  std::vector<char> buffer(kSocketBufferSize);
+
+  for (;;) {
+    ssize_t received = recv(parentFd_, buffer.data(), buffer.size(), 0);
+
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (received <= 0) {
+      return;
+    }
+
+    /* Children serialized it themselves, only a bug would make it unparsable. */
+    traceservice::ExportTraceServiceRequest request;
+    if (!request.ParseFromArray(buffer.data(), static_cast<int>(received))) {
+      continue;
+    }
+
+    uint64_t spans = CountSpans(request);
+    Deadline deadline(Deadline::duration(deadline_.load(std::memory_order_relaxed)));
+    grpc::ClientContext context;
+
+    /* Past the shutdown deadline, keep draining the socket without exporting. */
+    if (!SetGrpcDeadline(&context, deadline, kExportTimeout)) {
+      droppedSpans_.fetch_add(spans, std::memory_order_relaxed);
+      continue;
+    }
+
+    traceservice::ExportTraceServiceResponse response;
+    grpc::Status status = channel_->stub->Export(&context, request, &response);
+    (status.ok() ? exportedSpans_ : droppedSpans_).fetch_add(spans, std::memory_order_relaxed);
+  }
+}
+
+ForkRelay::Stats ForkRelay::GetStats() const {
+  Stats stats;
+  stats.exportedSpans = exportedSpans_.load(std::memory_order_relaxed);
+  stats.droppedSpans = droppedSpans_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void ForkRelay::AfterForkChild() noexcept {
+  /* The relay thread and channel only exist in the parent. */
+  isChild_ = true;
+  thread_.release();
+  channel_.release();
+  close(parentFd_);
+}
+
+} // namespace splunk
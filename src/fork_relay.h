@@ -0,0 +1,68 @@
+#pragma once
+
+#include "fork_handler.h"
+
+#include <opentelemetry/sdk/trace/exporter.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace splunk {
+
+/*
+ * Lets forked children export through a single gRPC channel owned by the parent. Children
+ * serialize OTLP requests and send them over a datagram socket pair created before the fork;
+ * a thread in the parent receives them and exports them to the OTLP endpoint.
+ */
+class ForkRelay final : private ForkHandler {
+public:
+  /* Returns null when the socket pair can't be created. */
+  static std::shared_ptr<ForkRelay> Create(const std::string& otlpEndpoint);
+
+  ~ForkRelay() override;
+
+  /*
+   * Exporter for use in a child, sends spans to the parent's relay thread. An export fails when
+   * the parent doesn't make room for it within the export timeout.
+   */
+  std::unique_ptr<opentelemetry::sdk::trace::SpanExporter> MakeChildExporter();
+
+  /*
+   * Stops accepting requests from children and exports the ones already received until the
+   * deadline. Only has an effect in the process which created the relay.
+   */
+  void Shutdown(std::chrono::steady_clock::time_point deadline);
+
+  /* Totals of the spans received from children. */
+  struct Stats {
+    uint64_t exportedSpans = 0;
+    /* Lost to failed exports, or received past the shutdown deadline. */
+    uint64_t droppedSpans = 0;
+  };
+
+  Stats GetStats() const;
+
+private:
+  struct Channel;
+
+  ForkRelay(int parentFd, int childFd, const std::string& otlpEndpoint);
+
+  void Run();
+
+  void AfterForkChild() noexcept override;
+
+  const int parentFd_;
+  const int childFd_;
+  std::unique_ptr<Channel> channel_;
+  std::atomic<std::chrono::steady_clock::rep> deadline_;
+  std::unique_ptr<std::thread> thread_;
+  std::atomic<uint64_t> exportedSpans_{0};
+  std::atomic<uint64_t> droppedSpans_{0};
+  bool isChild_ = false;
+};
+
+} // namespace splunk
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace splunk {
+
+/* Frames further apart than this end the walk, the frame pointer is likely garbage. */
+const uintptr_t kMaxFrameSize = 1 << 20;
+/* The smallest page size, readability is checked once per page of it. */
+const uintptr_t kFrameWalkPage = 4096;
+
+/*
+ * Whether the 8 bytes at address can be read, without faulting: the kernel reads them as the
+ * new signal mask and fails with EFAULT where they aren't readable, the invalid how makes the
+ * call change nothing otherwise. Async-signal-safe, preserves errno.
+ */
+inline bool IsReadable(uintptr_t address) {
+  int savedErrno = errno;
+  bool readable = syscall(SYS_rt_sigprocmask, ~0, address, nullptr, 8) == 0 || errno != EFAULT;
+  errno = savedErrno;
+  return readable;
+}
+
+/*
+ * Appends the return addresses of the frame pointer chain starting at fp to frames, until
+ * maxFrames. Each frame record must be above the previous one and sp, which keeps the walk on
+ * the current stack. Async-signal-safe, frames of code built without frame pointers are skipped
+ * or end the walk.
+ *
+ * Such code uses the frame pointer register for anything, so a record in range may still point
+ * past the top of the thread's stack: records are only read once IsReadable confirmed their
+ * page, which costs a system call for each page the walk enters above the one of sp.
+ */
+inline size_t WalkFrames(
+  uintptr_t fp, uintptr_t sp, uintptr_t* frames, size_t depth, size_t maxFrames) {
+  uintptr_t low = sp;
+  /* The page of sp is on the stack the thread runs on. */
+  uintptr_t readablePage = sp & ~(kFrameWalkPage - 1);
+
+  while (depth < maxFrames) {
+    if (fp < low || fp - low > kMaxFrameSize || fp % sizeof(uintptr_t) != 0) {
+      break;
+    }
+
+    uintptr_t recordEnd = fp + 2 * sizeof(uintptr_t) - 1;
+
+    if ((fp & ~(kFrameWalkPage - 1)) != readablePage ||
+        (recordEnd & ~(kFrameWalkPage - 1)) != readablePage) {
+      if (!IsReadable(fp) || !IsReadable(fp + sizeof(uintptr_t))) {
+        break;
+      }
+
+      readablePage = recordEnd & ~(kFrameWalkPage - 1);
+    }
+
+    const uintptr_t* record = reinterpret_cast<const uintptr_t*>(fp);
+    uintptr_t returnAddress = record[1];
+
+    if (returnAddress == 0) {
+      break;
+    }
+
+    frames[depth++] = returnAddress;
+    low = fp + 2 * sizeof(uintptr_t);
+    fp = record[0];
+  }
+
+  return depth;
+}
+
+} // namespace splunk
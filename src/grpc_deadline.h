@@ -0,0 +1,65 @@
+#pragma once
+
+#include <grpcpp/client_context.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace splunk {
+
+/*
+ * Sets the deadline of context to deadline, or timeout from now if that is earlier. gRPC only
+ * takes system_clock deadlines, the remaining time is converted. Returns false without setting
+ * anything when deadline has passed.
+ */
+inline bool SetGrpcDeadline(
+  grpc::ClientContext* context, std::chrono::steady_clock::time_point deadline,
+  std::chrono::steady_clock::duration timeout) {
+  auto now = std::chrono::steady_clock::now();
+
+  if (now >= deadline) {
+    return false;
+  }
+
+  context->set_deadline(
+    std::chrono::system_clock::now() +
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::min(deadline - now, timeout)));
+  return true;
+}
+
+/*
+ * Lets another thread cancel the RPC in progress, for a shutdown which can't wait for a periodic
+ * export past its deadline. Calls started after Cancel fail right away. For one call at a time.
+ */
+class RpcCanceller {
+public:
+  /* Makes context cancellable until End, returns false without doing so when cancelled. */
+  bool Begin(grpc::ClientContext* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    context_ = cancelled_ ? nullptr : context;
+    return !cancelled_;
+  }
+
+  void End() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    context_ = nullptr;
+  }
+
+  void Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_ = true;
+
+    if (context_) {
+      context_->TryCancel();
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  grpc::ClientContext* context_ = nullptr;
+  bool cancelled_ = false;
+};
+
+} // namespace splunk
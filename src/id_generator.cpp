@@ -0,0 +1,84 @@
+#include "id_generator.h"
+
+#include "fork_handler.h"
+
+#include <sys/random.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+struct Generator {
+  uint64_t state = 0;
+  uint64_t forkGeneration = 0;
+  bool seeded = false;
+};
+
+uint64_t Seed() {
+  uint64_t seed;
+
+  if (getrandom(&seed, sizeof(seed), 0) == static_cast<ssize_t>(sizeof(seed))) {
+    return seed;
+  }
+
+  /* Before the entropy pool is initialized, or without the system call. */
+  std::random_device device;
+  return (static_cast<uint64_t>(device()) << 32) ^ device();
+}
+
+uint64_t Next() {
+  static thread_local Generator generator;
+  uint64_t forkGeneration = ForkGeneration();
+
+  if (!generator.seeded || generator.forkGeneration != forkGeneration) {
+    generator.state = Seed();
+    generator.forkGeneration = forkGeneration;
+    generator.seeded = true;
+  }
+
+  /* wyrand, see https://github.com/wangyi-fudan/wyhash. */
+  generator.state += 0xa0761d6478bd642full;
+  unsigned __int128 product =
+    static_cast<unsigned __int128>(generator.state) * (generator.state ^ 0xe7037ed1a0b428dbull);
+  return static_cast<uint64_t>(product >> 64) ^ static_cast<uint64_t>(product);
+}
+
+} // namespace
+
+ThreadLocalIdGenerator::ThreadLocalIdGenerator() { TrackForks(); }
+
+trace::SpanId ThreadLocalIdGenerator::GenerateSpanId() noexcept {
+  uint64_t id;
+
+  /* All zeros is the invalid span ID. */
+  do {
+    id = Next();
+  } while (id == 0);
+
+  uint8_t bytes[trace::SpanId::kSize];
+  std::memcpy(bytes, &id, sizeof(bytes));
+  return trace::SpanId(bytes);
+}
+
+trace::TraceId ThreadLocalIdGenerator::GenerateTraceId() noexcept {
+  uint64_t high;
+  uint64_t low;
+
+  do {
+    high = Next();
+    low = Next();
+  } while (high == 0 && low == 0);
+
+  uint8_t bytes[trace::TraceId::kSize];
+  std::memcpy(bytes, &high, sizeof(high));
+  std::memcpy(bytes + sizeof(high), &low, sizeof(low));
+  return trace::TraceId(bytes);
+}
+
+} // namespace splunk
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <opentelemetry/sdk/trace/id_generator.h>
+
+namespace splunk {
+
+/*
+ * Generates IDs with a wyrand generator per thread, one multiplication per 8 bytes written
+ * straight into the ID. Each thread seeds its generator from getrandom() on first use and
+ * again after fork(), so parent and child never continue the same sequence.
+ */
+class ThreadLocalIdGenerator final : public opentelemetry::sdk::trace::IdGenerator {
+public:
+  ThreadLocalIdGenerator();
+
+  opentelemetry::trace::SpanId GenerateSpanId() noexcept override;
+  opentelemetry::trace::TraceId GenerateTraceId() noexcept override;
+};
+
+} // namespace splunk
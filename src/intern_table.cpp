@@ -0,0 +1,131 @@
+#include "intern_table.h"
+
+namespace nostd = opentelemetry::nostd;
+
+namespace splunk {
+
+namespace {
+
+size_t Hash(nostd::string_view text) {
+  uint64_t hash = 14695981039346656037ull;
+
+  for (char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+
+  return static_cast<size_t>(hash);
+}
+
+/* Keeps the table at most half full, so probe sequences stay short. */
+size_t SlotCount(size_t maxEntries) {
+  size_t count = 16;
+
+  while (count < maxEntries * 2) {
+    count *= 2;
+  }
+
+  return count;
+}
+
+} // namespace
+
+const uint32_t InternTable::kNotInterned;
+
+InternTable::InternTable(size_t maxEntries, size_t maxLength)
+  : maxEntries_(maxEntries), maxLength_(maxLength), slotCount_(SlotCount(maxEntries)),
+    slots_(new std::atomic<const Entry*>[slotCount_]),
+    seen_(new std::atomic<uint32_t>[slotCount_]) {
+  for (size_t i = 0; i < slotCount_; i++) {
+    slots_[i].store(nullptr, std::memory_order_relaxed);
+    seen_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+InternTable::~InternTable() {
+  for (size_t i = 0; i < slotCount_; i++) {
+    delete slots_[i].load(std::memory_order_relaxed);
+  }
+}
+
+uint32_t InternTable::Intern(nostd::string_view text) {
+  if (text.size() > maxLength_) {
+    return kNotInterned;
+  }
+
+  return Find(text, Hash(text), true);
+}
+
+uint32_t InternTable::InternRepeated(nostd::string_view text) {
+  if (text.size() > maxLength_) {
+    return kNotInterned;
+  }
+
+  size_t hash = Hash(text);
+  uint32_t id = Find(text, hash, false);
+
+  if (id != kNotInterned) {
+    return id;
+  }
+
+  /* Never 0, which marks a free filter slot. */
+  uint32_t fingerprint = static_cast<uint32_t>(static_cast<uint64_t>(hash) >> 32) | 1;
+  std::atomic<uint32_t>& seen = seen_[hash & (slotCount_ - 1)];
+
+  if (seen.exchange(fingerprint, std::memory_order_relaxed) != fingerprint) {
+    return kNotInterned;
+  }
+
+  return Find(text, hash, true);
+}
+
+uint32_t InternTable::Find(nostd::string_view text, size_t hash, bool insert) {
+  size_t mask = slotCount_ - 1;
+  std::unique_ptr<Entry> created;
+
+  for (size_t i = hash & mask, probes = 0; probes < slotCount_; i = (i + 1) & mask, probes++) {
+    const Entry* entry = slots_[i].load(std::memory_order_acquire);
+
+    if (!entry) {
+      if (!insert) {
+        return kNotInterned;
+      }
+
+      /* Racing inserts may overshoot maxEntries slightly, the slots are sized with room. */
+      if (size_.load(std::memory_order_relaxed) >= maxEntries_) {
+        return kNotInterned;
+      }
+
+      if (!created) {
+        created.reset(new Entry{hash, std::string(text.data(), text.size())});
+      }
+
+      if (slots_[i].compare_exchange_strong(
+            entry, created.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+        created.release();
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<uint32_t>(i);
+      }
+
+      /* Another thread took the slot, entry is now theirs. */
+    }
+
+    if (entry->hash == hash && nostd::string_view(entry->text) == text) {
+      return static_cast<uint32_t>(i);
+    }
+  }
+
+  return kNotInterned;
+}
+
+InternTable& InternTable::Names() {
+  /* Leaked, spans may still be exported while static destructors run. */
+  static InternTable* table = new InternTable(4096, 256);
+  return *table;
+}
+
+InternTable& InternTable::Values() {
+  static InternTable* table = new InternTable(1024, 64);
+  return *table;
+}
+
+} // namespace splunk
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <opentelemetry/nostd/string_view.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace splunk {
+
+/*
+ * Insert-only table of strings shared by all threads, handing out small integer ids. Neither
+ * interning nor lookups take a lock: an entry is published with a compare-and-swap into an
+ * open addressed slot and is never changed or freed afterwards, so an id stays valid for the
+ * life of the process.
+ *
+ * The table is bounded. Strings longer than maxLength, and new strings once maxEntries are
+ * interned, get kNotInterned and the caller keeps its own copy.
+ */
+class InternTable {
+public:
+  static const uint32_t kNotInterned = UINT32_MAX;
+
+  InternTable(size_t maxEntries, size_t maxLength);
+  ~InternTable();
+
+  InternTable(const InternTable&) = delete;
+  InternTable& operator=(const InternTable&) = delete;
+
+  uint32_t Intern(opentelemetry::nostd::string_view text);
+  /*
+   * Like Intern, but a string not in the table yet is only added on its second call, so strings
+   * seen once, like span names built from URLs, never take an entry. First calls are remembered
+   * in a small lossy filter, a string may take a few more calls when others collide with it.
+   */
+  uint32_t InternRepeated(opentelemetry::nostd::string_view text);
+
+  /* id must have been returned by Intern. */
+  opentelemetry::nostd::string_view Get(uint32_t id) const {
+    const std::string& text = slots_[id].load(std::memory_order_acquire)->text;
+    return opentelemetry::nostd::string_view(text.data(), text.size());
+  }
+
+  size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+  /* Attribute keys, and span and event names through InternRepeated. */
+  static InternTable& Names();
+  /* Short string values of attributes whose keys have few distinct values, like http.method. */
+  static InternTable& Values();
+
+private:
+  struct Entry {
+    size_t hash;
+    std::string text;
+  };
+
+  /* Returns the id of text, adding it when insert is set and the table has room. */
+  uint32_t Find(opentelemetry::nostd::string_view text, size_t hash, bool insert);
+
+  const size_t maxEntries_;
+  const size_t maxLength_;
+  const size_t slotCount_;
+  std::unique_ptr<std::atomic<const Entry*>[]> slots_;
+  /* Fingerprints of strings InternRepeated saw once, indexed like slots_. */
+  std::unique_ptr<std::atomic<uint32_t>[]> seen_;
+  std::atomic<size_t> size_{0};
+};
+
+/* A string held as an id of an InternTable, or as a copy when the table can't take it. */
+class InternedString {
+public:
+  void Assign(InternTable& table, opentelemetry::nostd::string_view text) {
+    Assign(table, table.Intern(text), text);
+  }
+
+  /* id is table.Intern(text), for callers which already looked it up. */
+  void Assign(const InternTable& table, uint32_t id, opentelemetry::nostd::string_view text) {
+    table_ = &table;
+    id_ = id;
+
+    if (id == InternTable::kNotInterned) {
+      copy_.assign(text.data(), text.size());
+    }
+  }
+
+  void Clear() {
+    id_ = InternTable::kNotInterned;
+    copy_.clear();
+  }
+
+  uint32_t Id() const { return id_; }
+
+  opentelemetry::nostd::string_view View() const {
+    return id_ == InternTable::kNotInterned
+             ? opentelemetry::nostd::string_view(copy_.data(), copy_.size())
+             : table_->Get(id_);
+  }
+
+private:
+  const InternTable* table_ = nullptr;
+  uint32_t id_ = InternTable::kNotInterned;
+  std::string copy_;
+};
+
+} // namespace splunk
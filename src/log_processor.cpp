@@ -0,0 +1,537 @@
+#include "log_processor.h"
+
+#include "context_storage.h"
+#include "grpc_deadline.h"
+#include "span_clock.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable_utils.h>
+#include <opentelemetry/proto/collector/logs/v1/logs_service.grpc.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace logsservice = opentelemetry::proto::collector::logs::v1;
+namespace nostd = opentelemetry::nostd;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace proto = opentelemetry::proto;
+namespace sdkresource = opentelemetry::sdk::resource;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+const auto kExportTimeout = std::chrono::seconds(10);
+/* Above every severity, loggers are disabled while no processor runs. */
+const int kDisabled = 0xff;
+/* Attributes of a record past this many are dropped and counted. */
+const size_t kMaxAttributes = 32;
+/* Bodies longer than this don't keep their memory in the buffer once exported. */
+const size_t kMaxRetainedBody = 4096;
+
+std::atomic<int> threshold{kDisabled};
+/* Size of buffers created from now on, those of running threads keep theirs. */
+std::atomic<size_t> bufferCapacity{2048};
+std::atomic<uint64_t> droppedRecords{0};
+
+/* Leaked, like everything threads may touch while static destructors run. */
+WorkerWakeup& GetWakeup() {
+  static WorkerWakeup* wakeup = new WorkerWakeup();
+  return *wakeup;
+}
+
+const char* SeverityText(LogSeverity severity) {
+  switch (severity) {
+  case LogSeverity::Trace:
+    return "TRACE";
+  case LogSeverity::Debug:
+    return "DEBUG";
+  case LogSeverity::Info:
+    return "INFO";
+  case LogSeverity::Warn:
+    return "WARN";
+  case LogSeverity::Error:
+    return "ERROR";
+  default:
+    return "FATAL";
+  }
+}
+
+/* Record as written by Emit. The strings keep their capacity, so a warm buffer never allocates. */
+struct LogSlot {
+  uint64_t timeNanos;
+  const LogScope* scope;
+  LogSeverity severity;
+  bool hasSpan;
+  uint8_t traceFlags;
+  uint8_t traceId[trace::TraceId::kSize];
+  uint8_t spanId[trace::SpanId::kSize];
+  std::string body;
+  /* Only the first attributeCount are the record's. */
+  std::vector<std::pair<std::string, std::string>> attributes;
+  size_t attributeCount;
+  uint32_t droppedAttributes;
+};
+
+/* Single producer single consumer ring, written by its thread and read under Buffers::mutex. */
+class LogBuffer {
+public:
+  explicit LogBuffer(size_t minCapacity) : capacity_(RoundUpPowerOfTwo(minCapacity)),
+    mask_(capacity_ - 1), slots_(new LogSlot[capacity_]) {}
+
+  bool Write(
+    const LogScope* scope, LogSeverity severity, nostd::string_view body,
+    std::initializer_list<LogAttribute> attributes) noexcept {
+    size_t head = head_.load(std::memory_order_relaxed);
+    /* Acquire, the consumer is done with a slot once the tail moves past it. */
+    size_t tail = tail_.load(std::memory_order_acquire);
+
+    if (head - tail >= capacity_) {
+      droppedRecords.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    LogSlot& slot = slots_[head & mask_];
+
+    try {
+      slot.body.assign(body.data(), body.size());
+      size_t count = 0;
+
+      for (const LogAttribute& attribute : attributes) {
+        if (count == kMaxAttributes) {
+          break;
+        }
+
+        if (slot.attributes.size() == count) {
+          slot.attributes.emplace_back();
+        }
+
+        slot.attributes[count].first.assign(attribute.key.data(), attribute.key.size());
+        slot.attributes[count].second.assign(attribute.value.data(), attribute.value.size());
+        count++;
+      }
+
+      slot.attributeCount = count;
+      slot.droppedAttributes = static_cast<uint32_t>(attributes.size() - count);
+    } catch (const std::bad_alloc&) {
+      droppedRecords.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    slot.timeNanos = static_cast<uint64_t>(ReadSpanClock().systemNanos);
+    slot.scope = scope;
+    slot.severity = severity;
+
+    trace::SpanContext span = ContextStorage::CurrentSpanContext();
+    slot.hasSpan = span.IsValid();
+
+    if (slot.hasSpan) {
+      span.trace_id().CopyBytesTo(nostd::span<uint8_t, trace::TraceId::kSize>(slot.traceId));
+      span.span_id().CopyBytesTo(nostd::span<uint8_t, trace::SpanId::kSize>(slot.spanId));
+      slot.traceFlags = span.trace_flags().flags();
+    }
+
+    head_.store(head + 1, std::memory_order_release);
+
+    if (head + 1 - tail >= capacity_ / 2) {
+      GetWakeup().Notify();
+    }
+
+    return true;
+  }
+
+  /* Passes at most max records to read, returns how many. */
+  template <typename F>
+  size_t Read(size_t max, F read) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t count = std::min(head - tail, max);
+
+    for (size_t i = 0; i < count; i++) {
+      LogSlot& slot = slots_[(tail + i) & mask_];
+      read(slot);
+
+      if (slot.body.capacity() > kMaxRetainedBody) {
+        std::string().swap(slot.body);
+      }
+    }
+
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_relaxed);
+  }
+
+  void Clear() { tail_.store(head_.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+  /* Set when the thread exits with records left, the consumer frees the buffer once empty. */
+  std::atomic<bool> closed{false};
+
+private:
+  static size_t RoundUpPowerOfTwo(size_t v) {
+    size_t result = 2;
+    while (result < v) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<LogSlot[]> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+struct Buffers {
+  std::mutex mutex;
+  std::vector<LogBuffer*> buffers;
+  /* Where the next collection starts, so one busy thread can't starve the others. */
+  size_t next = 0;
+};
+
+Buffers& GetBuffers() {
+  static Buffers* buffers = new Buffers();
+  return *buffers;
+}
+
+/*
+ * Set once the thread's buffer is gone. Trivially destructible, so it can still be read by
+ * thread_local destructors which run after the one of the buffer and log.
+ */
+thread_local bool threadExited = false;
+
+struct ThreadBuffer {
+  LogBuffer* buffer = nullptr;
+
+  ~ThreadBuffer() {
+    threadExited = true;
+
+    if (!buffer) {
+      return;
+    }
+
+    Buffers& buffers = GetBuffers();
+    std::lock_guard<std::mutex> lock(buffers.mutex);
+
+    if (buffer->Empty()) {
+      buffers.buffers.erase(std::find(buffers.buffers.begin(), buffers.buffers.end(), buffer));
+      delete buffer;
+    } else {
+      buffer->closed.store(true, std::memory_order_release);
+    }
+
+    buffer = nullptr;
+  }
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+LogBuffer* BufferForThread() noexcept {
+  /* Logged from a later thread_local destructor, a new buffer would never be freed. */
+  if (threadExited) {
+    droppedRecords.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  if (threadBuffer.buffer) {
+    return threadBuffer.buffer;
+  }
+
+  try {
+    std::unique_ptr<LogBuffer> buffer(
+      new LogBuffer(bufferCapacity.load(std::memory_order_relaxed)));
+    Buffers& buffers = GetBuffers();
+    std::lock_guard<std::mutex> lock(buffers.mutex);
+    buffers.buffers.push_back(buffer.get());
+    threadBuffer.buffer = buffer.release();
+  } catch (const std::exception&) {
+    droppedRecords.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return threadBuffer.buffer;
+}
+
+/* Moves at most max records from the buffers into request, returns how many. */
+size_t CollectRecords(
+  size_t max, const proto::resource::v1::Resource& resource,
+  logsservice::ExportLogsServiceRequest* request) {
+  proto::logs::v1::ResourceLogs* resourceLogs = nullptr;
+  std::map<const LogScope*, proto::logs::v1::InstrumentationLibraryLogs*> libraries;
+
+  auto convert = [&](const LogSlot& slot) {
+    if (!resourceLogs) {
+      resourceLogs = request->add_resource_logs();
+      *resourceLogs->mutable_resource() = resource;
+    }
+
+    auto*& library = libraries[slot.scope];
+
+    if (!library) {
+      library = resourceLogs->add_instrumentation_library_logs();
+      library->mutable_instrumentation_library()->set_name(slot.scope->name);
+      library->mutable_instrumentation_library()->set_version(slot.scope->version);
+    }
+
+    proto::logs::v1::LogRecord* record = library->add_logs();
+    record->set_time_unix_nano(slot.timeNanos);
+    record->set_severity_number(static_cast<proto::logs::v1::SeverityNumber>(slot.severity));
+    record->set_severity_text(SeverityText(slot.severity));
+    record->mutable_body()->set_string_value(slot.body);
+
+    for (size_t i = 0; i < slot.attributeCount; i++) {
+      proto::common::v1::KeyValue* attribute = record->add_attributes();
+      attribute->set_key(slot.attributes[i].first);
+      attribute->mutable_value()->set_string_value(slot.attributes[i].second);
+    }
+
+    record->set_dropped_attributes_count(slot.droppedAttributes);
+
+    if (slot.hasSpan) {
+      record->set_trace_id(reinterpret_cast<const char*>(slot.traceId), sizeof(slot.traceId));
+      record->set_span_id(reinterpret_cast<const char*>(slot.spanId), sizeof(slot.spanId));
+      record->set_flags(slot.traceFlags);
+    }
+  };
+
+  Buffers& buffers = GetBuffers();
+  std::lock_guard<std::mutex> lock(buffers.mutex);
+  size_t size = buffers.buffers.size();
+  size_t count = 0;
+
+  for (size_t i = 0; i < size && count < max; i++) {
+    count += buffers.buffers[(buffers.next + i) % size]->Read(max - count, convert);
+  }
+
+  buffers.next = size > 0 ? (buffers.next + 1) % size : 0;
+
+  /* Buffers of exited threads go once everything they held is collected. */
+  auto exited = std::remove_if(buffers.buffers.begin(), buffers.buffers.end(), [](LogBuffer* b) {
+    if (!b->closed.load(std::memory_order_acquire) || !b->Empty()) {
+      return false;
+    }
+
+    delete b;
+    return true;
+  });
+  buffers.buffers.erase(exited, buffers.buffers.end());
+
+  return count;
+}
+
+} // namespace
+
+struct BatchLogProcessor::Channel {
+  std::unique_ptr<logsservice::LogsService::Stub> stub;
+  proto::resource::v1::Resource resource;
+  RpcCanceller canceller;
+};
+
+BatchLogProcessor::BatchLogProcessor(
+  const std::string& otlpEndpoint, const sdkresource::Resource& resource,
+  std::chrono::milliseconds scheduleDelay, size_t bufferSize, size_t maxExportBatchSize,
+  bool exportFromChildren)
+  : otlpEndpoint_(otlpEndpoint), scheduleDelay_(scheduleDelay),
+    maxExportBatchSize_(std::max<size_t>(1, maxExportBatchSize)),
+    exportFromChildren_(exportFromChildren), channel_(new Channel()), worker_(&GetWakeup()),
+    exportMutex_(new std::timed_mutex()) {
+  /* Shares the connection of the span exporter, like the metric reader. */
+  channel_->stub = logsservice::LogsService::NewStub(
+    grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+
+  for (const auto& attribute : resource.GetAttributes()) {
+    otlp::OtlpRecordableUtils::PopulateAttribute(
+      channel_->resource.add_attributes(), attribute.first, attribute.second);
+  }
+
+  bufferCapacity.store(std::max<size_t>(1, bufferSize), std::memory_order_relaxed);
+  worker_.Start(scheduleDelay_, [this] { Tick(); });
+  RegisterForkHandler(this);
+  threshold.store(static_cast<int>(LogSeverity::Trace), std::memory_order_relaxed);
+}
+
+BatchLogProcessor::~BatchLogProcessor() {
+  UnregisterForkHandler(this);
+  threshold.store(kDisabled, std::memory_order_relaxed);
+  worker_.Stop();
+}
+
+bool BatchLogProcessor::Flush(Deadline deadline) {
+  std::unique_lock<std::timed_mutex> lock(*exportMutex_, deadline);
+
+  if (!lock.owns_lock()) {
+    return false;
+  }
+
+  bool exported = Export(deadline) && !exportFailed_;
+  exportFailed_ = false;
+  return exported;
+}
+
+bool BatchLogProcessor::Shutdown(Deadline deadline) {
+  if (isShutdown_) {
+    return true;
+  }
+
+  isShutdown_ = true;
+  threshold.store(kDisabled, std::memory_order_relaxed);
+
+  /* An export in progress at the deadline is cancelled, the last one then fails too. */
+  worker_.Stop(deadline, [this] {
+    if (channel_) {
+      channel_->canceller.Cancel();
+    }
+  });
+
+  return Flush(deadline);
+}
+
+void BatchLogProcessor::Tick() {
+  std::lock_guard<std::timed_mutex> lock(*exportMutex_);
+
+  if (!Export(std::chrono::steady_clock::now() + kExportTimeout)) {
+    exportFailed_ = true;
+  }
+}
+
+bool BatchLogProcessor::Export(Deadline deadline) {
+  /* Null in a child which doesn't export. */
+  if (!channel_) {
+    return false;
+  }
+
+  for (;;) {
+    logsservice::ExportLogsServiceRequest request;
+    size_t count = CollectRecords(maxExportBatchSize_, channel_->resource, &request);
+
+    if (count == 0) {
+      return true;
+    }
+
+    grpc::ClientContext context;
+
+    if (!SetGrpcDeadline(&context, deadline, kExportTimeout) ||
+        !channel_->canceller.Begin(&context)) {
+      return false;
+    }
+
+    logsservice::ExportLogsServiceResponse response;
+    bool exported = channel_->stub->Export(&context, request, &response).ok();
+    channel_->canceller.End();
+
+    if (!exported) {
+      return false;
+    }
+
+    if (count < maxExportBatchSize_) {
+      return true;
+    }
+  }
+}
+
+void BatchLogProcessor::PrepareFork() noexcept {
+  /* No buffer is being collected or registered while forking. */
+  GetWakeup().mutex.lock();
+  GetBuffers().mutex.lock();
+}
+
+void BatchLogProcessor::AfterForkParent() noexcept {
+  GetBuffers().mutex.unlock();
+  GetWakeup().mutex.unlock();
+}
+
+void BatchLogProcessor::AfterForkChild() noexcept {
+  /* The parent exports the records buffered before the fork, the other threads are gone. */
+  Buffers& buffers = GetBuffers();
+
+  for (LogBuffer* buffer : buffers.buffers) {
+    if (buffer == threadBuffer.buffer) {
+      buffer->Clear();
+    } else {
+      delete buffer;
+    }
+  }
+
+  buffers.buffers.clear();
+
+  if (threadBuffer.buffer) {
+    buffers.buffers.push_back(threadBuffer.buffer);
+  }
+
+  buffers.next = 0;
+  buffers.mutex.unlock();
+  GetWakeup().pending.store(false, std::memory_order_relaxed);
+  GetWakeup().mutex.unlock();
+
+  /* Held if the parent's thread was exporting. */
+  exportMutex_.release();
+  exportMutex_.reset(new std::timed_mutex());
+  exportFailed_ = false;
+
+  /* Without a channel nothing would drain the buffers. */
+  if (!RestartInChild(
+        &worker_, &channel_, exportFromChildren_ && !isShutdown_, [this](const Channel& parent) {
+          std::unique_ptr<Channel> channel(new Channel());
+          channel->stub = logsservice::LogsService::NewStub(
+            grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+          channel->resource = parent.resource;
+          return channel;
+        })) {
+    threshold.store(kDisabled, std::memory_order_relaxed);
+  }
+}
+
+bool Logger::IsEnabled(LogSeverity severity) const noexcept {
+  return scope_ && static_cast<int>(severity) >= threshold.load(std::memory_order_relaxed);
+}
+
+void Logger::Emit(
+  LogSeverity severity, nostd::string_view body,
+  std::initializer_list<LogAttribute> attributes) noexcept {
+  if (!IsEnabled(severity)) {
+    return;
+  }
+
+  if (LogBuffer* buffer = BufferForThread()) {
+    buffer->Write(scope_, severity, body, attributes);
+  }
+}
+
+LoggerProvider& LoggerProvider::Get() {
+  static LoggerProvider* provider = new LoggerProvider();
+  return *provider;
+}
+
+Logger LoggerProvider::GetLogger(const std::string& name, const std::string& version) {
+  struct Scopes {
+    std::mutex mutex;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<LogScope>> scopes;
+  };
+
+  /* Leaked, loggers may emit while static destructors run. */
+  static Scopes* scopes = new Scopes();
+  std::lock_guard<std::mutex> lock(scopes->mutex);
+  std::unique_ptr<LogScope>& scope = scopes->scopes[std::make_pair(name, version)];
+
+  if (!scope) {
+    scope.reset(new LogScope{name, version});
+  }
+
+  return Logger(scope.get());
+}
+
+uint64_t LoggerProvider::DroppedRecords() const {
+  return droppedRecords.load(std::memory_order_relaxed);
+}
+
+} // namespace splunk
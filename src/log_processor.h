@@ -0,0 +1,79 @@
+#pragma once
+
+#include "fork_handler.h"
+#include "periodic_worker.h"
+
+#include <splunk/logs.h>
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace splunk {
+
+/* Instrumentation scope of a Logger, created once per name and version and never freed. */
+struct LogScope {
+  std::string name;
+  std::string version;
+};
+
+/*
+ * Exports the records emitted by every thread to the OTLP endpoint, every scheduleDelay or as
+ * soon as a thread's buffer is half full. Each thread writes to its own single producer single
+ * consumer ring of bufferSize records, so Emit takes no lock and never waits on the export:
+ * records which find their buffer full are dropped. Buffers of exited threads are freed once
+ * their records are exported.
+ *
+ * The buffers are process-wide, only one processor should run at a time. In the child of a
+ * fork the parent's records are discarded and, when exportFromChildren is set, the child
+ * exports its own over a new channel; otherwise loggers are disabled in the child.
+ */
+class BatchLogProcessor final : private ForkHandler {
+public:
+  BatchLogProcessor(
+    const std::string& otlpEndpoint, const opentelemetry::sdk::resource::Resource& resource,
+    std::chrono::milliseconds scheduleDelay, size_t bufferSize, size_t maxExportBatchSize,
+    bool exportFromChildren);
+  ~BatchLogProcessor() override;
+
+  /*
+   * Exports what was emitted before the call, after an export of the thread in flight, returns
+   * false when some of it wasn't: also when an export of the thread failed since the last Flush.
+   */
+  bool Flush(std::chrono::steady_clock::time_point deadline);
+  /*
+   * Disables loggers, stops the export thread, cancelling its export if still in progress at the
+   * deadline, and exports what is buffered.
+   */
+  bool Shutdown(std::chrono::steady_clock::time_point deadline);
+
+private:
+  struct Channel;
+
+  void Tick();
+  /* Called with exportMutex_ held. */
+  bool Export(std::chrono::steady_clock::time_point deadline);
+
+  void PrepareFork() noexcept override;
+  void AfterForkParent() noexcept override;
+  void AfterForkChild() noexcept override;
+
+  const std::string otlpEndpoint_;
+  const std::chrono::milliseconds scheduleDelay_;
+  const size_t maxExportBatchSize_;
+  const bool exportFromChildren_;
+  std::unique_ptr<Channel> channel_;
+  /* Woken by the process-wide wakeup of the buffers. */
+  PeriodicWorker worker_;
+  /* Serializes exports, owned by pointer so the child of a fork can abandon the parent's. */
+  std::unique_ptr<std::timed_mutex> exportMutex_;
+  /* Guarded by exportMutex_. */
+  bool exportFailed_ = false;
+  bool isShutdown_ = false;
+};
+
+} // namespace splunk
@@ -0,0 +1,148 @@
+#include "metric_reader.h"
+
+#include "grpc_deadline.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable_utils.h>
+#include <opentelemetry/proto/collector/metrics/v1/metrics_service.grpc.pb.h>
+
+#include <utility>
+
+namespace otlp = opentelemetry::exporter::otlp;
+namespace metricsservice = opentelemetry::proto::collector::metrics::v1;
+namespace sdkresource = opentelemetry::sdk::resource;
+
+namespace splunk {
+
+namespace {
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+const auto kExportTimeout = std::chrono::seconds(10);
+
+uint64_t NowNanos() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count());
+}
+
+} // namespace
+
+struct MetricReader::Channel {
+  std::unique_ptr<metricsservice::MetricsService::Stub> stub;
+  opentelemetry::proto::resource::v1::Resource resource;
+  /* Start of the cumulative values, reset in the child of a fork. */
+  uint64_t startNanos;
+  RpcCanceller canceller;
+};
+
+MetricReader::MetricReader(
+  const std::string& otlpEndpoint, std::chrono::milliseconds interval,
+  const sdkresource::Resource& resource, std::vector<MetricProducer*> producers,
+  bool exportFromChildren)
+  : otlpEndpoint_(otlpEndpoint), interval_(interval), producers_(std::move(producers)),
+    exportFromChildren_(exportFromChildren), channel_(new Channel()) {
+  /*
+   * A channel to the same target and with the same arguments as the span exporter's shares
+   * its subchannel, and so its connection, through gRPC's global subchannel pool.
+   */
+  channel_->stub = metricsservice::MetricsService::NewStub(
+    grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+  channel_->startNanos = NowNanos();
+
+  for (const auto& attribute : resource.GetAttributes()) {
+    otlp::OtlpRecordableUtils::PopulateAttribute(
+      channel_->resource.add_attributes(), attribute.first, attribute.second);
+  }
+
+  worker_.Start(interval_, [this] { Export(std::chrono::steady_clock::now() + kExportTimeout); });
+  RegisterForkHandler(this);
+}
+
+MetricReader::~MetricReader() {
+  UnregisterForkHandler(this);
+  worker_.Stop();
+}
+
+bool MetricReader::Shutdown(Deadline deadline) {
+  if (isShutdown_) {
+    return true;
+  }
+
+  isShutdown_ = true;
+
+  /* An export in progress at the deadline is cancelled, the last one then fails too. */
+  worker_.Stop(deadline, [this] {
+    if (channel_) {
+      channel_->canceller.Cancel();
+    }
+  });
+
+  return Export(deadline);
+}
+
+bool MetricReader::Export(Deadline deadline) {
+  /* Null in a child which doesn't export. */
+  if (!channel_) {
+    return false;
+  }
+
+  metricsservice::ExportMetricsServiceRequest request;
+  auto* resourceMetrics = request.add_resource_metrics();
+  *resourceMetrics->mutable_resource() = channel_->resource;
+  uint64_t nowNanos = NowNanos();
+
+  for (MetricProducer* producer : producers_) {
+    producer->Collect(channel_->startNanos, nowNanos, resourceMetrics);
+  }
+
+  if (resourceMetrics->instrumentation_library_metrics_size() == 0) {
+    return true;
+  }
+
+  grpc::ClientContext context;
+
+  if (!SetGrpcDeadline(&context, deadline, kExportTimeout) ||
+      !channel_->canceller.Begin(&context)) {
+    return false;
+  }
+
+  metricsservice::ExportMetricsServiceResponse response;
+  bool exported = channel_->stub->Export(&context, request, &response).ok();
+  channel_->canceller.End();
+  return exported;
+}
+
+void MetricReader::PrepareFork() noexcept {
+  /* No collection is in progress and no instrument is being created while forking. */
+  for (MetricProducer* producer : producers_) {
+    producer->LockForFork();
+  }
+}
+
+void MetricReader::AfterForkParent() noexcept {
+  for (auto it = producers_.rbegin(); it != producers_.rend(); ++it) {
+    (*it)->UnlockAfterFork();
+  }
+}
+
+void MetricReader::AfterForkChild() noexcept {
+  /* The child starts counting from zero, its values are not the parent's. */
+  for (auto it = producers_.rbegin(); it != producers_.rend(); ++it) {
+    (*it)->UnlockAfterFork();
+    (*it)->Reset();
+  }
+
+  /* Without a channel the child keeps recording without exporting. */
+  RestartInChild(
+    &worker_, &channel_, exportFromChildren_ && !isShutdown_, [this](const Channel& parent) {
+      std::unique_ptr<Channel> channel(new Channel());
+      channel->stub = metricsservice::MetricsService::NewStub(
+        grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+      channel->resource = parent.resource;
+      channel->startNanos = NowNanos();
+      return channel;
+    });
+}
+
+} // namespace splunk
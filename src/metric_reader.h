@@ -0,0 +1,56 @@
+#pragma once
+
+#include "fork_handler.h"
+#include "metrics.h"
+#include "periodic_worker.h"
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace splunk {
+
+/*
+ * Exports what the producers collect to the OTLP endpoint every interval, as cumulative sums
+ * and histograms. Collecting reads the per-thread cells without stopping writers, exporting
+ * happens outside of any lock the producers take. In the child of a fork the producers are
+ * reset and, when exportFromChildren is set, the child exports its own over a new channel.
+ * The producers must outlive the reader.
+ */
+class MetricReader final : private ForkHandler {
+public:
+  MetricReader(
+    const std::string& otlpEndpoint, std::chrono::milliseconds interval,
+    const opentelemetry::sdk::resource::Resource& resource,
+    std::vector<MetricProducer*> producers, bool exportFromChildren);
+  ~MetricReader() override;
+
+  /*
+   * Stops the export thread, cancelling its export if still in progress at the deadline, and
+   * exports the current values one last time.
+   */
+  bool Shutdown(std::chrono::steady_clock::time_point deadline);
+
+private:
+  struct Channel;
+
+  bool Export(std::chrono::steady_clock::time_point deadline);
+
+  void PrepareFork() noexcept override;
+  void AfterForkParent() noexcept override;
+  void AfterForkChild() noexcept override;
+
+  const std::string otlpEndpoint_;
+  const std::chrono::milliseconds interval_;
+  const std::vector<MetricProducer*> producers_;
+  const bool exportFromChildren_;
+  std::unique_ptr<Channel> channel_;
+  PeriodicWorker worker_;
+  bool isShutdown_ = false;
+};
+
+} // namespace splunk
@@ -0,0 +1,308 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace proto = opentelemetry::proto;
+
+namespace splunk {
+
+namespace {
+
+const size_t kMaxCells = 64;
+const size_t kCacheLineSlots = 64 / sizeof(std::atomic<uint64_t>);
+
+std::atomic<size_t> nextCell{0};
+
+std::string Key(const MetricDescriptor& descriptor) {
+  std::string key = descriptor.library + '\0' + descriptor.version + '\0' + descriptor.name;
+
+  for (const auto& attribute : descriptor.attributes) {
+    key += '\0' + attribute.first + '=' + attribute.second;
+  }
+
+  return key;
+}
+
+bool SameMetric(const MetricDescriptor* a, const MetricDescriptor& b) {
+  return a && a->library == b.library && a->version == b.version && a->name == b.name;
+}
+
+void SetAttributes(
+  const MetricAttributes& attributes,
+  google::protobuf::RepeatedPtrField<proto::common::v1::KeyValue>* out) {
+  for (const auto& attribute : attributes) {
+    proto::common::v1::KeyValue* keyValue = out->Add();
+    keyValue->set_key(attribute.first);
+    keyValue->mutable_value()->set_string_value(attribute.second);
+  }
+}
+
+} // namespace
+
+size_t ThreadCell() {
+  static thread_local size_t cell = nextCell.fetch_add(1, std::memory_order_relaxed);
+  return cell;
+}
+
+/* A power of two so the cell index is a mask. */
+size_t CellCount() {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t count = 1;
+
+  while (count < threads && count < kMaxCells) {
+    count *= 2;
+  }
+
+  return count;
+}
+
+CounterStorage::CounterStorage(MetricDescriptor descriptor, size_t cellCount)
+  : descriptor_(std::move(descriptor)), cellMask_(cellCount - 1), cells_(new Cell[cellCount]) {
+  Reset();
+}
+
+void CounterStorage::Add(uint64_t value) noexcept {
+  cells_[ThreadCell() & cellMask_].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t CounterStorage::Sum() const {
+  uint64_t sum = 0;
+
+  for (size_t i = 0; i <= cellMask_; i++) {
+    sum += cells_[i].value.load(std::memory_order_relaxed);
+  }
+
+  return sum;
+}
+
+void CounterStorage::Reset() {
+  for (size_t i = 0; i <= cellMask_; i++) {
+    cells_[i].value.store(0, std::memory_order_relaxed);
+  }
+}
+
+HistogramStorage::HistogramStorage(
+  MetricDescriptor descriptor, std::vector<double> boundaries, size_t cellCount)
+  : descriptor_(std::move(descriptor)), boundaries_(std::move(boundaries)),
+    cellMask_(cellCount - 1),
+    stride_((boundaries_.size() + 2 + kCacheLineSlots - 1) / kCacheLineSlots * kCacheLineSlots),
+    slots_(new std::atomic<uint64_t>[cellCount * stride_]) {
+  Reset();
+}
+
+void HistogramStorage::Record(double value) noexcept {
+  if (value != value) {
+    return;
+  }
+
+  /* Bucket i counts values in (boundaries[i - 1], boundaries[i]]. */
+  size_t bucket =
+    std::lower_bound(boundaries_.begin(), boundaries_.end(), value) - boundaries_.begin();
+  std::atomic<uint64_t>* cell = &slots_[(ThreadCell() & cellMask_) * stride_];
+  cell[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  /* Only contended when threads share the cell, so the loop rarely repeats. */
+  std::atomic<uint64_t>& sumBits = cell[boundaries_.size() + 1];
+  uint64_t bits = sumBits.load(std::memory_order_relaxed);
+  uint64_t updated;
+
+  do {
+    double sum;
+    std::memcpy(&sum, &bits, sizeof(sum));
+    sum += value;
+    std::memcpy(&updated, &sum, sizeof(updated));
+  } while (!sumBits.compare_exchange_weak(bits, updated, std::memory_order_relaxed));
+}
+
+void HistogramStorage::Read(
+  std::vector<uint64_t>* bucketCounts, uint64_t* count, double* sum) const {
+  size_t bucketCount = boundaries_.size() + 1;
+  bucketCounts->assign(bucketCount, 0);
+  *count = 0;
+  *sum = 0;
+
+  for (size_t i = 0; i <= cellMask_; i++) {
+    const std::atomic<uint64_t>* cell = &slots_[i * stride_];
+
+    for (size_t j = 0; j < bucketCount; j++) {
+      uint64_t n = cell[j].load(std::memory_order_relaxed);
+      (*bucketCounts)[j] += n;
+      *count += n;
+    }
+
+    uint64_t bits = cell[bucketCount].load(std::memory_order_relaxed);
+    double cellSum;
+    std::memcpy(&cellSum, &bits, sizeof(cellSum));
+    *sum += cellSum;
+  }
+}
+
+void HistogramStorage::Reset() {
+  /* All zero bits is also 0.0 for the sums. */
+  for (size_t i = 0; i < (cellMask_ + 1) * stride_; i++) {
+    slots_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+MetricRegistry::MetricRegistry() : cellCount_(CellCount()) {}
+
+MetricRegistry& MetricRegistry::Get() {
+  /* Leaked, instruments may be recorded to while static destructors run. */
+  static MetricRegistry* registry = new MetricRegistry();
+  return *registry;
+}
+
+CounterStorage* MetricRegistry::GetCounter(MetricDescriptor descriptor) {
+  std::string key = Key(descriptor);
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<CounterStorage>& counter = counters_[key];
+
+  if (!counter) {
+    counter.reset(new CounterStorage(std::move(descriptor), cellCount_));
+  }
+
+  return counter.get();
+}
+
+HistogramStorage*
+MetricRegistry::GetHistogram(MetricDescriptor descriptor, std::vector<double> boundaries) {
+  std::string key = Key(descriptor);
+  std::sort(boundaries.begin(), boundaries.end());
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<HistogramStorage>& histogram = histograms_[key];
+
+  if (!histogram) {
+    histogram.reset(new HistogramStorage(std::move(descriptor), std::move(boundaries), cellCount_));
+  }
+
+  return histogram.get();
+}
+
+void MetricRegistry::Collect(
+  uint64_t startNanos, uint64_t nowNanos, proto::metrics::v1::ResourceMetrics* metrics) {
+  std::map<std::pair<std::string, std::string>, proto::metrics::v1::InstrumentationLibraryMetrics*>
+    libraries;
+
+  auto addMetric = [&](const MetricDescriptor& descriptor) {
+    auto*& library = libraries[std::make_pair(descriptor.library, descriptor.version)];
+
+    if (!library) {
+      library = metrics->add_instrumentation_library_metrics();
+      library->mutable_instrumentation_library()->set_name(descriptor.library);
+      library->mutable_instrumentation_library()->set_version(descriptor.version);
+    }
+
+    proto::metrics::v1::Metric* metric = library->add_metrics();
+    metric->set_name(descriptor.name);
+    metric->set_description(descriptor.description);
+    metric->set_unit(descriptor.unit);
+    return metric;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const MetricDescriptor* previous = nullptr;
+  proto::metrics::v1::Metric* metric = nullptr;
+
+  for (const auto& entry : counters_) {
+    const MetricDescriptor& descriptor = entry.second->Descriptor();
+
+    if (!SameMetric(previous, descriptor)) {
+      metric = addMetric(descriptor);
+      metric->mutable_sum()->set_aggregation_temporality(
+        proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+      metric->mutable_sum()->set_is_monotonic(true);
+    }
+
+    previous = &descriptor;
+    proto::metrics::v1::NumberDataPoint* point = metric->mutable_sum()->add_data_points();
+    SetAttributes(descriptor.attributes, point->mutable_attributes());
+    point->set_start_time_unix_nano(startNanos);
+    point->set_time_unix_nano(nowNanos);
+    point->set_as_int(static_cast<int64_t>(entry.second->Sum()));
+  }
+
+  previous = nullptr;
+  std::vector<uint64_t> bucketCounts;
+
+  for (const auto& entry : histograms_) {
+    const MetricDescriptor& descriptor = entry.second->Descriptor();
+
+    if (!SameMetric(previous, descriptor)) {
+      metric = addMetric(descriptor);
+      metric->mutable_histogram()->set_aggregation_temporality(
+        proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+    }
+
+    previous = &descriptor;
+    proto::metrics::v1::HistogramDataPoint* point = metric->mutable_histogram()->add_data_points();
+    SetAttributes(descriptor.attributes, point->mutable_attributes());
+    point->set_start_time_unix_nano(startNanos);
+    point->set_time_unix_nano(nowNanos);
+
+    uint64_t count;
+    double sum;
+    entry.second->Read(&bucketCounts, &count, &sum);
+    point->set_count(count);
+    point->set_sum(sum);
+
+    for (uint64_t bucketCount : bucketCounts) {
+      point->add_bucket_counts(bucketCount);
+    }
+
+    for (double boundary : entry.second->Boundaries()) {
+      point->add_explicit_bounds(boundary);
+    }
+  }
+}
+
+void MetricRegistry::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (const auto& entry : counters_) {
+    entry.second->Reset();
+  }
+
+  for (const auto& entry : histograms_) {
+    entry.second->Reset();
+  }
+}
+
+void Counter::Add(uint64_t value) noexcept {
+  if (storage_) {
+    storage_->Add(value);
+  }
+}
+
+void Histogram::Record(double value) noexcept {
+  if (storage_) {
+    storage_->Record(value);
+  }
+}
+
+Counter Meter::CreateCounter(
+  const std::string& name, const std::string& description, const std::string& unit,
+  const MetricAttributes& attributes) {
+  return Counter(registry_->GetCounter(
+    MetricDescriptor{library_, version_, name, description, unit, attributes}));
+}
+
+Histogram Meter::CreateHistogram(
+  const std::string& name, const std::vector<double>& boundaries, const std::string& description,
+  const std::string& unit, const MetricAttributes& attributes) {
+  return Histogram(registry_->GetHistogram(
+    MetricDescriptor{library_, version_, name, description, unit, attributes}, boundaries));
+}
+
+MeterProvider& MeterProvider::Get() {
+  static MeterProvider* provider = new MeterProvider();
+  return *provider;
+}
+
+Meter MeterProvider::GetMeter(const std::string& library, const std::string& version) {
+  return Meter(&MetricRegistry::Get(), library, version);
+}
+
+} // namespace splunk
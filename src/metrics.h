@@ -0,0 +1,124 @@
+#pragma once
+
+#include <splunk/metrics.h>
+
+#include <opentelemetry/proto/metrics/v1/metrics.pb.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace splunk {
+
+struct MetricDescriptor {
+  std::string library;
+  std::string version;
+  std::string name;
+  std::string description;
+  std::string unit;
+  MetricAttributes attributes;
+};
+
+/* Index of the calling thread's cell, assigned round robin as threads first record. */
+size_t ThreadCell();
+/* Cells per instrument: one per hardware thread, rounded up to a power of two. */
+size_t CellCount();
+
+/* Source of the metrics a MetricReader exports. */
+class MetricProducer {
+public:
+  virtual ~MetricProducer() = default;
+
+  /* Adds the cumulative value of every series since startNanos to metrics. */
+  virtual void Collect(
+    uint64_t startNanos, uint64_t nowNanos,
+    opentelemetry::proto::metrics::v1::ResourceMetrics* metrics) = 0;
+
+  /* Zeroes all series, for the child of a fork which exports its own. */
+  virtual void Reset() = 0;
+
+  /* Held across fork() by producers which take a lock while collecting. */
+  virtual void LockForFork() {}
+  virtual void UnlockAfterFork() {}
+};
+
+/*
+ * Cells are striped by thread: threads take cell indices round robin, so until there are more
+ * threads than cells no two threads write to the same cache line.
+ */
+class CounterStorage {
+public:
+  CounterStorage(MetricDescriptor descriptor, size_t cellCount);
+
+  void Add(uint64_t value) noexcept;
+  uint64_t Sum() const;
+  void Reset();
+
+  const MetricDescriptor& Descriptor() const { return descriptor_; }
+
+private:
+  /* 64 bytes apart, so no two values share a cache line. */
+  struct Cell {
+    std::atomic<uint64_t> value;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  const MetricDescriptor descriptor_;
+  const size_t cellMask_;
+  std::unique_ptr<Cell[]> cells_;
+};
+
+class HistogramStorage {
+public:
+  HistogramStorage(MetricDescriptor descriptor, std::vector<double> boundaries, size_t cellCount);
+
+  void Record(double value) noexcept;
+  /* Bucket counts summed over the cells, the total count and the sum of the values. */
+  void Read(std::vector<uint64_t>* bucketCounts, uint64_t* count, double* sum) const;
+  void Reset();
+
+  const MetricDescriptor& Descriptor() const { return descriptor_; }
+  const std::vector<double>& Boundaries() const { return boundaries_; }
+
+private:
+  const MetricDescriptor descriptor_;
+  const std::vector<double> boundaries_;
+  const size_t cellMask_;
+  /* Per cell the bucket counts and the bits of the sum, padded to whole cache lines. */
+  const size_t stride_;
+  std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+};
+
+/* Instruments of all meters, created once and never destroyed. */
+class MetricRegistry final : public MetricProducer {
+public:
+  static MetricRegistry& Get();
+
+  CounterStorage* GetCounter(MetricDescriptor descriptor);
+  HistogramStorage* GetHistogram(MetricDescriptor descriptor, std::vector<double> boundaries);
+
+  void Collect(
+    uint64_t startNanos, uint64_t nowNanos,
+    opentelemetry::proto::metrics::v1::ResourceMetrics* metrics) override;
+  void Reset() override;
+
+  /* The child never inherits a half created instrument. */
+  void LockForFork() override { mutex_.lock(); }
+  void UnlockAfterFork() override { mutex_.unlock(); }
+
+private:
+  MetricRegistry();
+
+  const size_t cellCount_;
+  std::mutex mutex_;
+  /* Keyed by library, version, name and attributes, so a metric's data points are adjacent. */
+  std::map<std::string, std::unique_ptr<CounterStorage>> counters_;
+  std::map<std::string, std::unique_ptr<HistogramStorage>> histograms_;
+};
+
+} // namespace splunk
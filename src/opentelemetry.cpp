@@ -1,11 +1,28 @@
 #include <splunk/opentelemetry.h>
 
+#include "allocation_sampler.h"
+#include "batch_span_processor.h"
+#include "config.h"
+#include "context_storage.h"
+#include "cpu_profiler.h"
+#include "fork_relay.h"
+#include "id_generator.h"
+#include "log_processor.h"
+#include "metric_reader.h"
+#include "pipeline_stats.h"
+#include "resource_detectors.h"
+#include "sampler.h"
+#include "span_clock.h"
+#include "span_metrics.h"
+
 #include <opentelemetry/baggage/propagation/baggage_propagator.h>
 #include <opentelemetry/context/propagation/composite_propagator.h>
 #include <opentelemetry/context/propagation/global_propagator.h>
-#include <opentelemetry/sdk/trace/batch_span_processor.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable.h>
 #include <opentelemetry/sdk/trace/exporter.h>
+#include <opentelemetry/sdk/trace/samplers/parent.h>
 #include <opentelemetry/sdk/trace/tracer_provider.h>
+#include <opentelemetry/trace/noop.h>
 #include <opentelemetry/trace/propagation/b3_propagator.h>
 #include <opentelemetry/trace/propagation/http_trace_context.h>
 
@@ -13,17 +30,23 @@
 #include <opentelemetry/exporters/jaeger/jaeger_exporter.h>
 #endif
 
+#include <algorithm>
 #include <cctype>
 #include <cstdlib>
+#include <memory>
 #include <string>
 
 namespace sdktrace = opentelemetry::sdk::trace;
 namespace sdkresource = opentelemetry::sdk::resource;
 namespace nostd = opentelemetry::nostd;
+namespace otlp = opentelemetry::exporter::otlp;
 
 namespace splunk {
 
 namespace {
+/* Bounds exports of the background worker, Flush and Shutdown stop waiting at their deadline. */
+const auto kSpanExportTimeout = std::chrono::seconds(10);
+
 std::string ToLower(std::string v) {
   for (size_t i = 0; i < v.size(); i++) {
     v[i] = std::tolower(v[i]);
@@ -32,16 +55,19 @@ std::string ToLower(std::string v) {
   return v;
 }
 
-std::string Trim(const std::string& v) {
-  std::string out;
+nostd::string_view Trim(nostd::string_view v) {
+  size_t begin = 0;
+  size_t end = v.size();
 
-  for (char c : v) {
-    if (!std::isblank(c)) {
-      out.append(1, c);
-    }
+  while (begin < end && std::isspace(static_cast<unsigned char>(v[begin]))) {
+    begin++;
+  }
+
+  while (end > begin && std::isspace(static_cast<unsigned char>(v[end - 1]))) {
+    end--;
   }
 
-  return out;
+  return v.substr(begin, end - begin);
 }
 
 std::vector<nostd::string_view> Split(nostd::string_view s, char separator) {
@@ -68,18 +94,85 @@ std::string GetEnv(const std::string& key, const std::string& defaultVal = "") {
     return defaultVal;
   }
 
-  return ToLower(Trim(std::string(envVal)));
+  return std::string(Trim(envVal));
 }
 
-std::unique_ptr<sdktrace::SpanExporter> CreateOtlpExporter(const OpenTelemetryOptions& options) {
-  opentelemetry::exporter::otlp::OtlpGrpcExporterOptions exporterOptions;
+/* Leaves out untouched when the variable is unset or not a number. */
+void ReadEnvNumber(const char* key, uint32_t* out) {
+  std::string value = GetEnv(key, "");
+  char* end = nullptr;
+  unsigned long long limit = std::strtoull(value.c_str(), &end, 10);
+
+  if (value.empty() || value[0] == '-' || *end != '\0') {
+    return;
+  }
+
+  *out = static_cast<uint32_t>(std::min<unsigned long long>(limit, kUnlimited));
+}
+
+/* Dynamic settings before the config file, with the span limits from the environment. */
+DynamicConfig EnvDynamicConfig() {
+  DynamicConfig config;
+  ReadEnvNumber("OTEL_ATTRIBUTE_COUNT_LIMIT", &config.attributeCountLimit);
+  ReadEnvNumber("OTEL_SPAN_ATTRIBUTE_COUNT_LIMIT", &config.attributeCountLimit);
+  ReadEnvNumber("OTEL_ATTRIBUTE_VALUE_LENGTH_LIMIT", &config.attributeValueLengthLimit);
+  ReadEnvNumber("OTEL_SPAN_ATTRIBUTE_VALUE_LENGTH_LIMIT", &config.attributeValueLengthLimit);
+  ReadEnvNumber("OTEL_SPAN_EVENT_COUNT_LIMIT", &config.eventCountLimit);
+  ReadEnvNumber("OTEL_SPAN_LINK_COUNT_LIMIT", &config.linkCountLimit);
+  return config;
+}
+
+/* Counts the serialized size of the spans the OTLP exporter sends successfully. */
+class ByteCountingExporter final : public sdktrace::SpanExporter {
+public:
+  ByteCountingExporter(
+    std::unique_ptr<sdktrace::SpanExporter> delegate, std::shared_ptr<PipelineCounters> counters)
+    : delegate_(std::move(delegate)), counters_(std::move(counters)) {}
+
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return delegate_->MakeRecordable();
+  }
+
+  opentelemetry::sdk::common::ExportResult
+  Export(const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    /* Measured before the delegate, which may consume the recordables. */
+    size_t bytes = 0;
+
+    for (const auto& span : spans) {
+      bytes += static_cast<const otlp::OtlpRecordable&>(*span).span().ByteSizeLong();
+    }
+
+    opentelemetry::sdk::common::ExportResult result = delegate_->Export(spans);
+
+    if (result == opentelemetry::sdk::common::ExportResult::kSuccess) {
+      counters_->bytesSent.Add(bytes);
+    }
+
+    return result;
+  }
+
+  bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+    return delegate_->Shutdown(timeout);
+  }
+
+private:
+  std::unique_ptr<sdktrace::SpanExporter> delegate_;
+  std::shared_ptr<PipelineCounters> counters_;
+};
+
+std::unique_ptr<sdktrace::SpanExporter> CreateOtlpExporter(
+  const OpenTelemetryOptions& options, std::shared_ptr<PipelineCounters> counters) {
+  otlp::OtlpGrpcExporterOptions exporterOptions;
   exporterOptions.endpoint = options.otlpEndpoint;
+  exporterOptions.timeout = kSpanExportTimeout;
 
-  return std::unique_ptr<sdktrace::SpanExporter>(
-    new opentelemetry::exporter::otlp::OtlpGrpcExporter(exporterOptions));
+  return std::unique_ptr<sdktrace::SpanExporter>(new ByteCountingExporter(
+    std::unique_ptr<sdktrace::SpanExporter>(new otlp::OtlpGrpcExporter(exporterOptions)),
+    std::move(counters)));
 }
 
-std::unique_ptr<sdktrace::SpanExporter> CreateExporter(const OpenTelemetryOptions& options) {
+std::unique_ptr<sdktrace::SpanExporter> CreateExporter(
+  const OpenTelemetryOptions& options, std::shared_ptr<PipelineCounters> counters) {
   switch (options.exporterType) {
 #if SPLUNK_HAS_JAEGER
     case ExporterType_JaegerThriftHttp: {
@@ -99,7 +192,7 @@ std::unique_ptr<sdktrace::SpanExporter> CreateExporter(const OpenTelemetryOption
     }
 #endif
     default: {
-      return CreateOtlpExporter(options);
+      return CreateOtlpExporter(options, std::move(counters));
     }
   }
 }
@@ -115,7 +208,7 @@ std::unordered_map<std::string, std::string> GetEnvResourceAttribs() {
     std::vector<nostd::string_view> parts = Split(token, '=');
 
     if (parts.size() == 2) {
-      attributes[std::string(parts[0])] = std::string(parts[1]);
+      attributes[std::string(Trim(parts[0]))] = std::string(Trim(parts[1]));
     }
   }
 
@@ -140,14 +233,15 @@ sdkresource::ResourceAttributes MergeEnvAttributes(
   return target;
 }
 
-PropagatorType EnvPropagatorFlags() {
-  auto envPropagators = GetEnv("OTEL_PROPAGATORS", "tracecontext,baggage");
-
-  std::vector<nostd::string_view> propagators = Split(envPropagators, ',');
+PropagatorType ParsePropagatorFlags(const std::string& value) {
+  std::string lowerValue = ToLower(value);
+  std::vector<nostd::string_view> propagators = Split(lowerValue, ',');
 
   int flags = PropagatorType_None;
 
   for (nostd::string_view propagator : propagators) {
+    propagator = Trim(propagator);
+
     if (propagator == "tracecontext") {
       flags |= PropagatorType_TraceContext;
     } else if (propagator == "b3") {
@@ -193,13 +287,40 @@ void SetupPropagators(PropagatorType flags) {
 
 bool IsSupportedOtlpProtocol(const std::string& proto) { return proto == "grpc"; }
 
-OpenTelemetryOptions ApplyDefaults(OpenTelemetryOptions options) {
+std::string ConfigValue(
+  const std::string& fileValue, const std::string& envKey, const std::string& defaultVal) {
+  return fileValue.empty() ? GetEnv(envKey, defaultVal) : fileValue;
+}
+
+} // namespace
+
+/*
+ * Option precedence: OpenTelemetryOptions, then the config file, then environment variables.
+ */
+OpenTelemetryOptions ApplyDefaults(OpenTelemetryOptions options, const FileConfig& fileConfig) {
+  std::unordered_map<std::string, std::string> fileAttributes(
+    fileConfig.resourceAttributes.begin(), fileConfig.resourceAttributes.end());
+
+  if (!fileConfig.serviceName.empty()) {
+    fileAttributes["service.name"] = fileConfig.serviceName;
+  }
+
+  options.resourceAttributes = MergeEnvAttributes(options.resourceAttributes, fileAttributes);
   options.resourceAttributes =
     MergeEnvAttributes(options.resourceAttributes, GetEnvResourceAttribs());
 
+  options.resourceCacheFile = options.resourceCacheFile.empty()
+                                ? GetEnv("SPLUNK_RESOURCE_CACHE_FILE", "")
+                                : options.resourceCacheFile;
+
+  /* Detected values never override configured ones. */
+  DetectResource(
+    options.resourceCacheFile, options.resourceDetectionTimeout, &options.resourceAttributes);
+
   if (options.exporterType == ExporterType_None) {
 #if SPLUNK_HAS_JAEGER
-    auto envExporter = GetEnv("OTEL_TRACES_EXPORTER", "otlp");
+    auto envExporter =
+      ToLower(ConfigValue(fileConfig.tracesExporter, "OTEL_TRACES_EXPORTER", "otlp"));
 
     if (envExporter == "jaeger-thrift-splunk") {
       options.exporterType = ExporterType_JaegerThriftHttp;
@@ -212,7 +333,8 @@ OpenTelemetryOptions ApplyDefaults(OpenTelemetryOptions options) {
   }
 
   if (options.propagators == PropagatorType_None) {
-    options.propagators = EnvPropagatorFlags();
+    options.propagators = ParsePropagatorFlags(
+      ConfigValue(fileConfig.propagators, "OTEL_PROPAGATORS", "tracecontext,baggage"));
 
     if (options.propagators == PropagatorType_None) {
       options.propagators =
@@ -220,50 +342,411 @@ OpenTelemetryOptions ApplyDefaults(OpenTelemetryOptions options) {
     }
   }
 
-  options.otlpEndpoint = options.otlpEndpoint.empty()
-                           ? GetEnv("OTEL_EXPORTER_OTLP_ENDPOINT", "localhost:4317")
-                           : options.otlpEndpoint;
+  options.otlpEndpoint =
+    options.otlpEndpoint.empty()
+      ? ConfigValue(fileConfig.otlpEndpoint, "OTEL_EXPORTER_OTLP_ENDPOINT", "localhost:4317")
+      : options.otlpEndpoint;
 
   options.otlpProtocol = options.otlpProtocol.empty()
-                           ? GetEnv("OTEL_EXPORTER_OTLP_PROTOCOL", "grpc")
+                           ? ToLower(GetEnv("OTEL_EXPORTER_OTLP_PROTOCOL", "grpc"))
                            : options.otlpProtocol;
 
   if (!IsSupportedOtlpProtocol(options.otlpProtocol)) {
     options.otlpProtocol = "grpc";
   }
 
-  options.jaegerEndpoint =
-    options.jaegerEndpoint.empty()
-      ? GetEnv("OTEL_EXPORTER_JAEGER_ENDPOINT", "http://localhost:9080/v1/trace")
-      : options.jaegerEndpoint;
+  options.jaegerEndpoint = options.jaegerEndpoint.empty()
+                             ? ConfigValue(
+                                 fileConfig.jaegerEndpoint, "OTEL_EXPORTER_JAEGER_ENDPOINT",
+                                 "http://localhost:9080/v1/trace")
+                             : options.jaegerEndpoint;
+
+  options.accessToken = options.accessToken.empty()
+                          ? ConfigValue(fileConfig.accessToken, "SPLUNK_ACCESS_TOKEN", "")
+                          : options.accessToken;
+
+  if (options.forkMode == ForkMode_None) {
+    auto envForkMode = ToLower(GetEnv("SPLUNK_FORK_MODE", "none"));
+
+    if (envForkMode == "reinitialize") {
+      options.forkMode = ForkMode_Reinitialize;
+    } else if (envForkMode == "parent") {
+      options.forkMode = ForkMode_ParentExporter;
+    }
+  }
+
+  if (options.spanAllocation == SpanAllocation_Default &&
+      ToLower(GetEnv("SPLUNK_SPAN_ALLOCATION", "default")) == "pooled") {
+    options.spanAllocation = SpanAllocation_Pooled;
+  }
+
+  if (options.spanClock == SpanClock_Default) {
+    auto envSpanClock = ToLower(GetEnv("SPLUNK_SPAN_CLOCK", "default"));
+
+    if (envSpanClock == "tsc") {
+      options.spanClock = SpanClock_Tsc;
+    } else if (envSpanClock == "coarse") {
+      options.spanClock = SpanClock_Coarse;
+    }
+  }
+
+  if (options.metricsExporter == MetricsExporter_Default) {
+    options.metricsExporter = ToLower(GetEnv("OTEL_METRICS_EXPORTER", "none")) == "otlp"
+                                ? MetricsExporter_Otlp
+                                : MetricsExporter_None;
+  }
+
+  if (options.spanMetrics == SpanMetrics_Default) {
+    options.spanMetrics = ToLower(GetEnv("SPLUNK_SPAN_METRICS", "false")) == "true"
+                            ? SpanMetrics_Enabled
+                            : SpanMetrics_Disabled;
+  }
+
+  if (options.pipelineMetrics == PipelineMetrics_Default) {
+    options.pipelineMetrics = ToLower(GetEnv("SPLUNK_PIPELINE_METRICS", "false")) == "true"
+                                ? PipelineMetrics_Enabled
+                                : PipelineMetrics_Disabled;
+  }
+
+  if (options.logsExporter == LogsExporter_Default) {
+    options.logsExporter = ToLower(GetEnv("OTEL_LOGS_EXPORTER", "none")) == "otlp"
+                             ? LogsExporter_Otlp
+                             : LogsExporter_None;
+  }
+
+  if (options.logScheduleDelay <= std::chrono::milliseconds(0)) {
+    uint32_t delay = 1000;
+    ReadEnvNumber("OTEL_BLRP_SCHEDULE_DELAY", &delay);
+    options.logScheduleDelay = std::chrono::milliseconds(std::max<uint32_t>(delay, 1));
+  }
+
+  if (options.logBufferSize == 0) {
+    options.logBufferSize = 2048;
+    ReadEnvNumber("OTEL_BLRP_MAX_QUEUE_SIZE", &options.logBufferSize);
+  }
+
+  if (options.cpuProfiler == CpuProfiler_Default) {
+    options.cpuProfiler = ToLower(GetEnv("SPLUNK_PROFILER_ENABLED", "false")) == "true"
+                            ? CpuProfiler_Enabled
+                            : CpuProfiler_Disabled;
+  }
+
+  if (options.profilerSamplingInterval <= std::chrono::milliseconds(0)) {
+    uint32_t interval = 10;
+    ReadEnvNumber("SPLUNK_PROFILER_CALL_STACK_INTERVAL", &interval);
+    options.profilerSamplingInterval = std::chrono::milliseconds(std::max<uint32_t>(interval, 1));
+  }
 
-  options.accessToken =
-    options.accessToken.empty() ? GetEnv("SPLUNK_ACCESS_TOKEN", "") : options.accessToken;
+  if (options.memoryProfiler == MemoryProfiler_Default) {
+    options.memoryProfiler = ToLower(GetEnv("SPLUNK_PROFILER_MEMORY_ENABLED", "false")) == "true"
+                               ? MemoryProfiler_Enabled
+                               : MemoryProfiler_Disabled;
+  }
+
+  if (options.memoryProfilerSampleBytes == 0) {
+    options.memoryProfilerSampleBytes = 512 * 1024;
+    ReadEnvNumber("SPLUNK_PROFILER_MEMORY_SAMPLE_BYTES", &options.memoryProfilerSampleBytes);
+  }
+
+  if (options.spanResourceUsage == SpanResourceUsage_Default) {
+    auto envResourceUsage = ToLower(GetEnv("SPLUNK_SPAN_RESOURCE_USAGE", "none"));
+
+    if (envResourceUsage == "rusage") {
+      options.spanResourceUsage = SpanResourceUsage_Enabled;
+    } else if (envResourceUsage == "allocations") {
+      options.spanResourceUsage = SpanResourceUsage_Allocations;
+    } else {
+      options.spanResourceUsage = SpanResourceUsage_Disabled;
+    }
+  }
+
+  /* Without the hooks nothing counts allocations, spans would report 0 bytes allocated. */
+  if (options.spanResourceUsage == SpanResourceUsage_Allocations && !SPLUNK_HAS_ALLOCATION_HOOKS) {
+    options.spanResourceUsage = SpanResourceUsage_Enabled;
+  }
+
+  if (options.metricExportInterval <= std::chrono::milliseconds(0)) {
+    uint32_t interval = 60000;
+    ReadEnvNumber("OTEL_METRIC_EXPORT_INTERVAL", &interval);
+    options.metricExportInterval = std::chrono::milliseconds(std::max<uint32_t>(interval, 1));
+  }
+
+  /* Spans from children can only be relayed as OTLP requests. */
+  if (options.forkMode == ForkMode_ParentExporter && options.exporterType != ExporterType_Otlp) {
+    options.forkMode = ForkMode_Reinitialize;
+  }
 
   return options;
 }
 
+namespace {
+
+std::string ServiceName(const sdkresource::Resource& resource) {
+  const auto& attributes = resource.GetAttributes();
+  auto it = attributes.find("service.name");
+
+  if (it == attributes.end() || !nostd::holds_alternative<std::string>(it->second)) {
+    return "unknown_service";
+  }
+
+  return nostd::get<std::string>(it->second);
+}
+
+/* How often the CPU and memory profilers send what they sampled. */
+const auto kProfileExportInterval = std::chrono::seconds(10);
+
+/* The gRPC stub is thread-safe, the Jaeger sender buffers internally and is not. */
+size_t ExportConcurrency(ExporterType type) { return type == ExporterType_Otlp ? 4 : 1; }
+
 } // namespace
 
-opentelemetry::nostd::shared_ptr<opentelemetry::trace::TracerProvider>
-InitOpentelemetry(const OpenTelemetryOptions& userOptions) {
-  OpenTelemetryOptions options = ApplyDefaults(userOptions);
+struct OpenTelemetryHandle::State {
+  std::shared_ptr<ForkRelay> forkRelay;
+  nostd::shared_ptr<opentelemetry::trace::TracerProvider> provider;
+  sdktrace::TracerProvider* sdkProvider = nullptr;
+  /* Owned by the provider. */
+  BatchSpanProcessor* processor = nullptr;
+  std::unique_ptr<ConfigWatcher> configWatcher;
+  std::shared_ptr<SpanMetricsAggregator> spanMetrics;
+  std::shared_ptr<AllocationSampler> allocationSampler;
+  std::unique_ptr<PipelineMetricProducer> pipelineMetrics;
+  /* Declared last, stops collecting from the producers above before they are destroyed. */
+  std::unique_ptr<MetricReader> metricReader;
+  std::unique_ptr<BatchLogProcessor> logProcessor;
+  std::unique_ptr<CpuProfiler> cpuProfiler;
+};
+
+namespace {
+/* Keeps the most recently initialized pipeline alive even if the handle is discarded. */
+std::shared_ptr<OpenTelemetryHandle::State> currentState;
+} // namespace
+
+OpenTelemetryHandle InitOpentelemetry(const OpenTelemetryOptions& userOptions) {
+  std::string configFile = userOptions.configFile.empty() ? GetEnv("SPLUNK_CONFIG_FILE", "")
+                                                          : userOptions.configFile;
+  DynamicConfig dynamicDefaults = EnvDynamicConfig();
+  FileConfig fileConfig;
+  fileConfig.dynamic = dynamicDefaults;
+
+  if (!configFile.empty()) {
+    LoadConfigFile(configFile, &fileConfig);
+  }
+
+  OpenTelemetryOptions options = ApplyDefaults(userOptions, fileConfig);
+  ApplySpanLimits(options.spanLimits, &fileConfig.dynamic);
+  auto settings = std::make_shared<DynamicSettings>(fileConfig.dynamic);
 
   auto resource = sdkresource::Resource::Create(options.resourceAttributes);
 
-  auto exporter = CreateExporter(options);
-  sdktrace::BatchSpanProcessorOptions processorOptions;
-  auto processor = std::unique_ptr<sdktrace::SpanProcessor>(
-    new sdktrace::BatchSpanProcessor(std::move(exporter), processorOptions));
+  auto state = std::make_shared<OpenTelemetryHandle::State>();
+
+  BatchSpanProcessor::ExporterFactory childExporterFactory;
+
+  if (options.forkMode != ForkMode_None) {
+    /* gRPC only survives fork when this is set before its first use. */
+    setenv("GRPC_ENABLE_FORK_SUPPORT", "true", 0);
+  }
+
+  if (options.forkMode == ForkMode_ParentExporter) {
+    state->forkRelay = ForkRelay::Create(options.otlpEndpoint);
+  }
+
+  auto pipelineCounters = std::make_shared<PipelineCounters>();
+
+  if (state->forkRelay) {
+    auto relay = state->forkRelay;
+    childExporterFactory = [relay] { return relay->MakeChildExporter(); };
+  } else if (options.forkMode != ForkMode_None) {
+    childExporterFactory = [options, pipelineCounters] {
+      return CreateExporter(options, pipelineCounters);
+    };
+  }
+
+  if (options.spanMetrics == SpanMetrics_Enabled) {
+    state->spanMetrics = std::make_shared<SpanMetricsAggregator>(ServiceName(resource));
+  }
+
+  /* Before the metric reader, whose fork handler must run first, and nothing without hooks. */
+  if (options.memoryProfiler == MemoryProfiler_Enabled && SPLUNK_HAS_ALLOCATION_HOOKS) {
+    state->allocationSampler = std::make_shared<AllocationSampler>(
+      options.otlpEndpoint, resource, options.memoryProfilerSampleBytes, kProfileExportInterval,
+      options.forkMode != ForkMode_None);
+  }
+
+  auto exporter = CreateExporter(options, pipelineCounters);
+  state->processor = new BatchSpanProcessor(
+    std::move(exporter), settings, ExportConcurrency(options.exporterType),
+    options.spanAllocation == SpanAllocation_Pooled, std::move(childExporterFactory),
+    state->spanMetrics, pipelineCounters, state->allocationSampler, options.spanResourceUsage);
+  auto processor = std::unique_ptr<sdktrace::SpanProcessor>(state->processor);
+
+  auto sampler = std::unique_ptr<sdktrace::Sampler>(
+    new sdktrace::ParentBasedSampler(std::make_shared<RatioSampler>(settings)));
+
+  if (state->spanMetrics) {
+    sampler.reset(new RecordUnsampledSampler(std::move(sampler)));
+  }
+
+  sampler.reset(new CountingSampler(std::move(sampler), pipelineCounters));
+
+  state->sdkProvider = new sdktrace::TracerProvider(
+    std::move(processor), resource, std::move(sampler),
+    std::unique_ptr<sdktrace::IdGenerator>(new ThreadLocalIdGenerator()));
+  state->provider = nostd::shared_ptr<opentelemetry::trace::TracerProvider>(state->sdkProvider);
+
+  if (!configFile.empty() && fileConfig.reloadIntervalMillis > 0) {
+    state->configWatcher.reset(new ConfigWatcher(
+      configFile, std::chrono::milliseconds(fileConfig.reloadIntervalMillis), settings,
+      dynamicDefaults, options.spanLimits));
+  }
+
+  std::vector<MetricProducer*> producers;
+
+  if (options.metricsExporter == MetricsExporter_Otlp) {
+    producers.push_back(&MetricRegistry::Get());
+  }
+
+  if (state->spanMetrics) {
+    producers.push_back(state->spanMetrics.get());
+  }
+
+  if (state->allocationSampler) {
+    producers.push_back(state->allocationSampler.get());
+  }
 
-  auto provider = nostd::shared_ptr<opentelemetry::trace::TracerProvider>(
-    new sdktrace::TracerProvider(std::move(processor), resource));
+  if (options.pipelineMetrics == PipelineMetrics_Enabled) {
+    BatchSpanProcessor* processor = state->processor;
+    state->pipelineMetrics.reset(new PipelineMetricProducer(
+      pipelineCounters, [processor] { return processor->GetPipelineStats(); }));
+    producers.push_back(state->pipelineMetrics.get());
+  }
 
-  opentelemetry::trace::Provider::SetTracerProvider(provider);
+  if (!producers.empty()) {
+    /* Children export their own metrics, relaying them through the parent is spans only. */
+    state->metricReader.reset(new MetricReader(
+      options.otlpEndpoint, options.metricExportInterval, resource, std::move(producers),
+      options.forkMode != ForkMode_None));
+  }
+
+  if (options.logsExporter == LogsExporter_Otlp) {
+    uint32_t maxExportBatchSize = 512;
+    ReadEnvNumber("OTEL_BLRP_MAX_EXPORT_BATCH_SIZE", &maxExportBatchSize);
+    /* Like metrics, children export their own records. */
+    state->logProcessor.reset(new BatchLogProcessor(
+      options.otlpEndpoint, resource, options.logScheduleDelay, options.logBufferSize,
+      maxExportBatchSize, options.forkMode != ForkMode_None));
+  }
+
+  currentState = state;
+
+  InstallSpanClock(options.spanClock);
+  ContextStorage::Install();
+
+  /* After the context storage, samples are tagged with the spans it holds. */
+  if (options.cpuProfiler == CpuProfiler_Enabled) {
+    state->cpuProfiler.reset(new CpuProfiler(
+      options.otlpEndpoint, resource, options.profilerSamplingInterval, kProfileExportInterval,
+      options.forkMode != ForkMode_None));
+  }
+  opentelemetry::trace::Provider::SetTracerProvider(state->provider);
 
   SetupPropagators(options.propagators);
 
-  return provider;
+  return OpenTelemetryHandle(state);
+}
+
+OpenTelemetryHandle::OpenTelemetryHandle(std::shared_ptr<State> state)
+  : state_(std::move(state)) {}
+
+opentelemetry::trace::TracerProvider* OpenTelemetryHandle::operator->() const {
+  return GetTracerProvider().get();
+}
+
+nostd::shared_ptr<opentelemetry::trace::TracerProvider>
+OpenTelemetryHandle::GetTracerProvider() const {
+  /* Never destroyed, tracers of an empty handle may be used during static destruction. */
+  static auto* noopProvider = new nostd::shared_ptr<opentelemetry::trace::TracerProvider>(
+    new opentelemetry::trace::NoopTracerProvider());
+  return state_ ? state_->provider : *noopProvider;
+}
+
+const sdkresource::Resource& OpenTelemetryHandle::GetResource() const {
+  return state_ ? state_->sdkProvider->GetResource() : sdkresource::Resource::GetEmpty();
+}
+
+SpanLimitStats OpenTelemetryHandle::GetSpanLimitStats() const {
+  return state_ ? state_->processor->GetLimitCounters().Load() : SpanLimitStats();
+}
+
+PipelineStats OpenTelemetryHandle::GetPipelineStats() const {
+  if (!state_) {
+    return PipelineStats();
+  }
+
+  PipelineStats stats = state_->processor->GetPipelineStats();
+
+  if (state_->forkRelay) {
+    ForkRelay::Stats relayed = state_->forkRelay->GetStats();
+    stats.spansExported += relayed.exportedSpans;
+    stats.spansExportFailed += relayed.droppedSpans;
+  }
+
+  return stats;
+}
+
+MeterProvider& OpenTelemetryHandle::GetMeterProvider() const { return MeterProvider::Get(); }
+
+LoggerProvider& OpenTelemetryHandle::GetLoggerProvider() const { return LoggerProvider::Get(); }
+
+FlushResult OpenTelemetryHandle::Flush(std::chrono::steady_clock::time_point deadline) {
+  if (!state_) {
+    return FlushResult();
+  }
+
+  FlushResult result = state_->processor->FlushUntil(deadline);
+
+  if (state_->logProcessor) {
+    state_->logProcessor->Flush(deadline);
+  }
+
+  return result;
+}
+
+FlushResult OpenTelemetryHandle::Shutdown(std::chrono::steady_clock::time_point deadline) {
+  if (!state_) {
+    return FlushResult();
+  }
+
+  state_->configWatcher.reset();
+  FlushResult result = state_->processor->ShutdownUntil(deadline);
+
+  /* Children's spans count once the relay exported them, not when a child handed them over. */
+  if (state_->forkRelay) {
+    ForkRelay::Stats before = state_->forkRelay->GetStats();
+    state_->forkRelay->Shutdown(deadline);
+    ForkRelay::Stats after = state_->forkRelay->GetStats();
+    result.exportedSpans += after.exportedSpans - before.exportedSpans;
+    result.droppedSpans += after.droppedSpans - before.droppedSpans;
+    result.completed = result.completed && after.droppedSpans == before.droppedSpans;
+  }
+
+  if (state_->metricReader) {
+    state_->metricReader->Shutdown(deadline);
+  }
+
+  if (state_->logProcessor) {
+    state_->logProcessor->Shutdown(deadline);
+  }
+
+  if (state_->cpuProfiler) {
+    state_->cpuProfiler->Shutdown(deadline);
+  }
+
+  if (state_->allocationSampler) {
+    state_->allocationSampler->Shutdown(deadline);
+  }
+
+  return result;
 }
 
 OpenTelemetryOptions& OpenTelemetryOptions::WithServiceName(const std::string& serviceName) {
@@ -302,4 +785,102 @@ OpenTelemetryOptions& OpenTelemetryOptions::WithPropagators(PropagatorType flags
   return *this;
 }
 
+OpenTelemetryOptions& OpenTelemetryOptions::WithConfigFile(const std::string& path) {
+  configFile = path;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithForkMode(ForkMode mode) {
+  forkMode = mode;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithResourceCacheFile(const std::string& path) {
+  resourceCacheFile = path;
+  return *this;
+}
+
+OpenTelemetryOptions&
+OpenTelemetryOptions::WithResourceDetectionTimeout(std::chrono::milliseconds timeout) {
+  resourceDetectionTimeout = timeout;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithSpanAllocation(SpanAllocation allocation) {
+  spanAllocation = allocation;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithSpanLimits(const SpanLimits& limits) {
+  spanLimits = limits;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithSpanClock(SpanClock clock) {
+  spanClock = clock;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithMetricsExporter(MetricsExporter exporter) {
+  metricsExporter = exporter;
+  return *this;
+}
+
+OpenTelemetryOptions&
+OpenTelemetryOptions::WithMetricExportInterval(std::chrono::milliseconds interval) {
+  metricExportInterval = interval;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithSpanMetrics(SpanMetrics mode) {
+  spanMetrics = mode;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithPipelineMetrics(PipelineMetrics mode) {
+  pipelineMetrics = mode;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithLogsExporter(LogsExporter exporter) {
+  logsExporter = exporter;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithLogScheduleDelay(std::chrono::milliseconds delay) {
+  logScheduleDelay = delay;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithLogBufferSize(uint32_t size) {
+  logBufferSize = size;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithCpuProfiler(CpuProfiler mode) {
+  cpuProfiler = mode;
+  return *this;
+}
+
+OpenTelemetryOptions&
+OpenTelemetryOptions::WithProfilerSamplingInterval(std::chrono::milliseconds interval) {
+  profilerSamplingInterval = interval;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithMemoryProfiler(MemoryProfiler mode) {
+  memoryProfiler = mode;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithMemoryProfilerSampleBytes(uint32_t bytes) {
+  memoryProfilerSampleBytes = bytes;
+  return *this;
+}
+
+OpenTelemetryOptions& OpenTelemetryOptions::WithSpanResourceUsage(SpanResourceUsage mode) {
+  spanResourceUsage = mode;
+  return *this;
+}
+
 } // namespace splunk
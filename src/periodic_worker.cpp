@@ -0,0 +1,94 @@
+#include "periodic_worker.h"
+
+#include <utility>
+
+namespace splunk {
+
+struct PeriodicWorker::Thread {
+  /* Used when the worker wasn't given one. */
+  WorkerWakeup ownWakeup;
+  WorkerWakeup* wakeup;
+  /* Guarded by the mutex of wakeup. */
+  bool stop = false;
+  bool ticking = false;
+  std::condition_variable idleCv;
+  std::thread thread;
+
+  explicit Thread(WorkerWakeup* sharedWakeup) : wakeup(sharedWakeup ? sharedWakeup : &ownWakeup) {}
+
+  void Run(std::chrono::milliseconds interval, std::function<void()> tick) {
+    std::unique_lock<std::mutex> lock(wakeup->mutex);
+
+    for (;;) {
+      wakeup->cv.wait_for(
+        lock, interval, [this] { return stop || wakeup->pending.load(std::memory_order_relaxed); });
+
+      if (stop) {
+        return;
+      }
+
+      wakeup->pending.store(false, std::memory_order_relaxed);
+      ticking = true;
+      lock.unlock();
+      tick();
+      lock.lock();
+      ticking = false;
+      idleCv.notify_all();
+    }
+  }
+};
+
+PeriodicWorker::PeriodicWorker(WorkerWakeup* wakeup) : wakeup_(wakeup) {}
+
+PeriodicWorker::~PeriodicWorker() { Stop(); }
+
+void PeriodicWorker::Start(std::chrono::milliseconds interval, std::function<void()> tick) {
+  interval_ = interval;
+  tick_ = std::move(tick);
+  Restart();
+}
+
+void PeriodicWorker::Restart() {
+  Stop();
+
+  std::unique_ptr<Thread> thread(new Thread(wakeup_));
+  thread->thread = std::thread(&Thread::Run, thread.get(), interval_, tick_);
+  thread_ = std::move(thread);
+}
+
+void PeriodicWorker::Stop() { Stop(std::chrono::steady_clock::time_point::max(), nullptr); }
+
+void PeriodicWorker::Stop(
+  std::chrono::steady_clock::time_point deadline, const std::function<void()>& cancel) {
+  if (!thread_) {
+    return;
+  }
+
+  Thread& thread = *thread_;
+  std::unique_lock<std::mutex> lock(thread.wakeup->mutex);
+  thread.stop = true;
+  lock.unlock();
+
+  /* Someone else may wait on a shared wakeup. */
+  thread.wakeup->cv.notify_all();
+
+  if (cancel && deadline != std::chrono::steady_clock::time_point::max()) {
+    lock.lock();
+    bool idle = thread.idleCv.wait_until(lock, deadline, [&thread] { return !thread.ticking; });
+    lock.unlock();
+
+    if (!idle) {
+      cancel();
+    }
+  }
+
+  if (thread_->thread.joinable()) {
+    thread_->thread.join();
+  }
+
+  thread_.reset();
+}
+
+void PeriodicWorker::AfterForkChild() noexcept { thread_.release(); }
+
+} // namespace splunk
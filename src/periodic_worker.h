@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace splunk {
+
+/* Wakes a PeriodicWorker before its interval ends. */
+struct WorkerWakeup {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<bool> pending{false};
+
+  /* Takes no lock, cheap while a wakeup is pending. */
+  void Notify() {
+    if (!pending.load(std::memory_order_relaxed) &&
+        !pending.exchange(true, std::memory_order_relaxed)) {
+      cv.notify_one();
+    }
+  }
+};
+
+/*
+ * Thread calling tick every interval, or as soon as its wakeup is notified, until stopped. Ticks
+ * run without any lock held. Components which export in the background use one and call
+ * AfterForkChild from their fork handler: the parent's thread doesn't exist in the child, the
+ * worker abandons it and can be restarted.
+ */
+class PeriodicWorker {
+public:
+  /* wakeup must outlive the worker, which has its own when it is null. */
+  explicit PeriodicWorker(WorkerWakeup* wakeup = nullptr);
+  ~PeriodicWorker();
+
+  PeriodicWorker(const PeriodicWorker&) = delete;
+  PeriodicWorker& operator=(const PeriodicWorker&) = delete;
+
+  /* Throws std::system_error when the thread can't be created. */
+  void Start(std::chrono::milliseconds interval, std::function<void()> tick);
+  /* Starts again with the interval and tick of the last Start. */
+  void Restart();
+  /* Waits for the tick in progress and for the thread to exit. */
+  void Stop();
+  /*
+   * Waits for the tick in progress only until deadline, then calls cancel, which must make the
+   * tick return soon, e.g. by cancelling its RPC, and waits for the thread to exit.
+   */
+  void Stop(std::chrono::steady_clock::time_point deadline, const std::function<void()>& cancel);
+
+  void AfterForkChild() noexcept;
+
+private:
+  struct Thread;
+
+  WorkerWakeup* const wakeup_;
+  std::chrono::milliseconds interval_{0};
+  std::function<void()> tick_;
+  /* Owned by pointer so the child of a fork can abandon the parent's thread. */
+  std::unique_ptr<Thread> thread_;
+};
+
+/*
+ * For the child of a fork of a component exporting over channel with worker: abandons the
+ * parent's thread and channel, which must not be used in the child, and unless the child
+ * doesn't export makes its own channel with reconnect(parentChannel) and restarts the worker.
+ * Returns whether the child exports.
+ */
+template <typename Channel, typename Reconnect>
+bool RestartInChild(
+  PeriodicWorker* worker, std::unique_ptr<Channel>* channel, bool exportFromChild,
+  Reconnect reconnect) noexcept {
+  std::unique_ptr<Channel> parentChannel(channel->release());
+  worker->AfterForkChild();
+
+  if (exportFromChild && parentChannel) {
+    try {
+      *channel = reconnect(*parentChannel);
+      worker->Restart();
+    } catch (const std::system_error&) {
+      channel->reset();
+    }
+  }
+
+  parentChannel.release();
+  return *channel != nullptr;
+}
+
+} // namespace splunk
@@ -0,0 +1,158 @@
+#include "pipeline_stats.h"
+
+#include <utility>
+
+namespace proto = opentelemetry::proto;
+
+namespace splunk {
+
+namespace {
+
+void ReadHistogram(const HistogramStorage& storage, PipelineHistogram* histogram) {
+  histogram->boundaries = storage.Boundaries();
+  storage.Read(&histogram->counts, &histogram->count, &histogram->sum);
+}
+
+class MetricWriter {
+public:
+  MetricWriter(
+    uint64_t startNanos, uint64_t nowNanos, proto::metrics::v1::ResourceMetrics* metrics)
+    : startNanos_(startNanos), nowNanos_(nowNanos),
+      library_(metrics->add_instrumentation_library_metrics()) {
+    library_->mutable_instrumentation_library()->set_name("splunk.otel.pipeline");
+  }
+
+  void Sum(const char* name, const char* description, const char* unit, uint64_t value) {
+    proto::metrics::v1::Metric* metric = AddMetric(name, description, unit);
+    metric->mutable_sum()->set_aggregation_temporality(
+      proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+    metric->mutable_sum()->set_is_monotonic(true);
+    proto::metrics::v1::NumberDataPoint* point = metric->mutable_sum()->add_data_points();
+    point->set_start_time_unix_nano(startNanos_);
+    point->set_time_unix_nano(nowNanos_);
+    point->set_as_int(static_cast<int64_t>(value));
+  }
+
+  void Gauge(const char* name, const char* description, const char* unit, uint64_t value) {
+    proto::metrics::v1::Metric* metric = AddMetric(name, description, unit);
+    proto::metrics::v1::NumberDataPoint* point = metric->mutable_gauge()->add_data_points();
+    point->set_time_unix_nano(nowNanos_);
+    point->set_as_int(static_cast<int64_t>(value));
+  }
+
+  void Histogram(
+    const char* name, const char* description, const char* unit,
+    const PipelineHistogram& histogram) {
+    proto::metrics::v1::Metric* metric = AddMetric(name, description, unit);
+    metric->mutable_histogram()->set_aggregation_temporality(
+      proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+    proto::metrics::v1::HistogramDataPoint* point =
+      metric->mutable_histogram()->add_data_points();
+    point->set_start_time_unix_nano(startNanos_);
+    point->set_time_unix_nano(nowNanos_);
+    point->set_count(histogram.count);
+    point->set_sum(histogram.sum);
+
+    for (uint64_t count : histogram.counts) {
+      point->add_bucket_counts(count);
+    }
+
+    for (double boundary : histogram.boundaries) {
+      point->add_explicit_bounds(boundary);
+    }
+  }
+
+private:
+  proto::metrics::v1::Metric*
+  AddMetric(const char* name, const char* description, const char* unit) {
+    proto::metrics::v1::Metric* metric = library_->add_metrics();
+    metric->set_name(name);
+    metric->set_description(description);
+    metric->set_unit(unit);
+    return metric;
+  }
+
+  const uint64_t startNanos_;
+  const uint64_t nowNanos_;
+  proto::metrics::v1::InstrumentationLibraryMetrics* library_;
+};
+
+} // namespace
+
+PipelineCounters::PipelineCounters()
+  : spansSampled(MetricDescriptor(), CellCount()),
+    spansNotSampled(MetricDescriptor(), CellCount()),
+    spansEnded(MetricDescriptor(), CellCount()),
+    spansDroppedQueueFull(MetricDescriptor(), CellCount()),
+    spansDroppedShutdown(MetricDescriptor(), CellCount()),
+    spansExported(MetricDescriptor(), CellCount()),
+    spansExportFailed(MetricDescriptor(), CellCount()),
+    bytesSent(MetricDescriptor(), CellCount()),
+    batchSize(MetricDescriptor(), {1, 8, 32, 64, 128, 256, 512, 1024}, CellCount()),
+    exportDuration(
+      MetricDescriptor(), {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000},
+      CellCount()) {}
+
+PipelineStats PipelineCounters::Load() const {
+  PipelineStats stats;
+  stats.spansNotSampled = spansNotSampled.Sum();
+  stats.spansStarted = spansSampled.Sum() + stats.spansNotSampled;
+  stats.spansEnded = spansEnded.Sum();
+  stats.spansDroppedQueueFull = spansDroppedQueueFull.Sum();
+  stats.spansDroppedShutdown = spansDroppedShutdown.Sum();
+  stats.spansExported = spansExported.Sum();
+  stats.spansExportFailed = spansExportFailed.Sum();
+  stats.bytesSent = bytesSent.Sum();
+  ReadHistogram(batchSize, &stats.batchSize);
+  ReadHistogram(exportDuration, &stats.exportDuration);
+  return stats;
+}
+
+void PipelineCounters::Reset() {
+  spansSampled.Reset();
+  spansNotSampled.Reset();
+  spansEnded.Reset();
+  spansDroppedQueueFull.Reset();
+  spansDroppedShutdown.Reset();
+  spansExported.Reset();
+  spansExportFailed.Reset();
+  bytesSent.Reset();
+  batchSize.Reset();
+  exportDuration.Reset();
+}
+
+PipelineMetricProducer::PipelineMetricProducer(
+  std::shared_ptr<PipelineCounters> counters, std::function<PipelineStats()> read)
+  : counters_(std::move(counters)), read_(std::move(read)) {}
+
+void PipelineMetricProducer::Collect(
+  uint64_t startNanos, uint64_t nowNanos, proto::metrics::v1::ResourceMetrics* metrics) {
+  PipelineStats stats = read_();
+  MetricWriter writer(startNanos, nowNanos, metrics);
+
+  writer.Sum("otel.sdk.span.started", "Spans started", "1", stats.spansStarted);
+  writer.Sum(
+    "otel.sdk.span.not_sampled", "Spans the sampler didn't sample", "1", stats.spansNotSampled);
+  writer.Sum("otel.sdk.span.ended", "Spans ended", "1", stats.spansEnded);
+  writer.Sum(
+    "otel.sdk.processor.span.dropped_queue_full", "Spans dropped because the queue was full",
+    "1", stats.spansDroppedQueueFull);
+  writer.Sum(
+    "otel.sdk.processor.span.dropped_shutdown", "Spans dropped by shutdown", "1",
+    stats.spansDroppedShutdown);
+  writer.Sum("otel.sdk.exporter.span.exported", "Spans exported", "1", stats.spansExported);
+  writer.Sum(
+    "otel.sdk.exporter.span.failed", "Spans of failed export calls", "1", stats.spansExportFailed);
+  writer.Sum(
+    "otel.sdk.exporter.bytes_sent", "Serialized size of exported spans", "By", stats.bytesSent);
+  writer.Gauge("otel.sdk.processor.queue.size", "Spans waiting for export", "1", stats.queueSize);
+  writer.Gauge("otel.sdk.processor.queue.capacity", "Queue limit", "1", stats.queueCapacity);
+  writer.Histogram("otel.sdk.processor.batch.size", "Spans per export call", "1", stats.batchSize);
+  writer.Histogram(
+    "otel.sdk.exporter.operation.duration", "Duration of export calls", "ms",
+    stats.exportDuration);
+}
+
+void PipelineMetricProducer::Reset() { counters_->Reset(); }
+
+} // namespace splunk
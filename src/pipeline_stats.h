@@ -0,0 +1,53 @@
+#pragma once
+
+#include "metrics.h"
+
+#include <splunk/opentelemetry.h>
+
+#include <functional>
+#include <memory>
+
+namespace splunk {
+
+/*
+ * Counters behind PipelineStats, shared by the sampler, the processor and the exporter. The
+ * ones updated for every span are striped by thread like the meter's counters, so the request
+ * path pays one relaxed atomic add on a cache line no other thread writes.
+ */
+struct PipelineCounters {
+  PipelineCounters();
+
+  CounterStorage spansSampled;
+  CounterStorage spansNotSampled;
+  CounterStorage spansEnded;
+  CounterStorage spansDroppedQueueFull;
+  CounterStorage spansDroppedShutdown;
+  CounterStorage spansExported;
+  CounterStorage spansExportFailed;
+  CounterStorage bytesSent;
+  HistogramStorage batchSize;
+  /* In milliseconds. */
+  HistogramStorage exportDuration;
+
+  /* Everything but the queue, which only the processor knows. */
+  PipelineStats Load() const;
+  void Reset();
+};
+
+/* Exports the PipelineStats returned by read as metrics of the "splunk.otel.pipeline" library. */
+class PipelineMetricProducer final : public MetricProducer {
+public:
+  PipelineMetricProducer(
+    std::shared_ptr<PipelineCounters> counters, std::function<PipelineStats()> read);
+
+  void Collect(
+    uint64_t startNanos, uint64_t nowNanos,
+    opentelemetry::proto::metrics::v1::ResourceMetrics* metrics) override;
+  void Reset() override;
+
+private:
+  std::shared_ptr<PipelineCounters> counters_;
+  std::function<PipelineStats()> read_;
+};
+
+} // namespace splunk
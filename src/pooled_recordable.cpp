@@ -0,0 +1,533 @@
+#include "pooled_recordable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+namespace common = opentelemetry::common;
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+/*
+ * Free list of one thread. Only the owner takes recordables, other threads hand them back
+ * through returned_, a lock-free stack which the owner empties in one exchange. Since nothing
+ * is ever popped from it individually there is no ABA problem.
+ */
+class RecordablePool {
+public:
+  /* Recordables created beyond this are not pooled and get deleted when released. */
+  static const size_t kMaxPooled = 4096;
+
+  static RecordablePool& ForThread();
+
+  PooledRecordable* Acquire();
+  void Return(PooledRecordable* recordable);
+
+private:
+  struct Handle {
+    RecordablePool* pool = nullptr;
+    ~Handle();
+  };
+
+  struct Idle {
+    std::mutex mutex;
+    std::vector<RecordablePool*> pools;
+  };
+
+  static PooledRecordable* Closed() {
+    return reinterpret_cast<PooledRecordable*>(static_cast<uintptr_t>(1));
+  }
+
+  static Idle& IdlePools();
+  /* Returns the number of recordables deleted. */
+  static size_t DeleteList(PooledRecordable* head);
+
+  /* Frees what the pool holds, recordables still in use are deleted as they come back. */
+  void Close();
+  void Open();
+
+  /* Owner only. */
+  PooledRecordable* free_ = nullptr;
+  std::atomic<PooledRecordable*> returned_{nullptr};
+  std::atomic<size_t> created_{0};
+};
+
+RecordablePool& RecordablePool::ForThread() {
+  static thread_local Handle handle;
+
+  if (!handle.pool) {
+    Idle& idle = IdlePools();
+    std::lock_guard<std::mutex> lock(idle.mutex);
+
+    if (idle.pools.empty()) {
+      handle.pool = new RecordablePool();
+    } else {
+      handle.pool = idle.pools.back();
+      idle.pools.pop_back();
+      handle.pool->Open();
+    }
+  }
+
+  return *handle.pool;
+}
+
+RecordablePool::Handle::~Handle() {
+  if (!pool) {
+    return;
+  }
+
+  /* Exported spans may still point at the pool, so it is kept around for the next thread. */
+  pool->Close();
+
+  Idle& idle = IdlePools();
+  std::lock_guard<std::mutex> lock(idle.mutex);
+  idle.pools.push_back(pool);
+}
+
+RecordablePool::Idle& RecordablePool::IdlePools() {
+  /* Leaked, threads may exit after static destructors have run. */
+  static Idle* idle = new Idle();
+  return *idle;
+}
+
+PooledRecordable* RecordablePool::Acquire() {
+  if (!free_) {
+    free_ = returned_.exchange(nullptr, std::memory_order_acquire);
+  }
+
+  if (free_) {
+    PooledRecordable* recordable = free_;
+    free_ = recordable->next_;
+    return recordable;
+  }
+
+  PooledRecordable* recordable = new PooledRecordable();
+
+  if (created_.load(std::memory_order_relaxed) < kMaxPooled) {
+    created_.fetch_add(1, std::memory_order_relaxed);
+    recordable->pool_ = this;
+  }
+
+  return recordable;
+}
+
+void RecordablePool::Return(PooledRecordable* recordable) {
+  PooledRecordable* head = returned_.load(std::memory_order_relaxed);
+
+  do {
+    if (head == Closed()) {
+      created_.fetch_sub(1, std::memory_order_relaxed);
+      delete recordable;
+      return;
+    }
+
+    recordable->next_ = head;
+  } while (!returned_.compare_exchange_weak(
+    head, recordable, std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t RecordablePool::DeleteList(PooledRecordable* head) {
+  size_t count = 0;
+
+  while (head) {
+    PooledRecordable* next = head->next_;
+    delete head;
+    head = next;
+    count++;
+  }
+
+  return count;
+}
+
+void RecordablePool::Close() {
+  size_t deleted =
+    DeleteList(free_) + DeleteList(returned_.exchange(Closed(), std::memory_order_acquire));
+  free_ = nullptr;
+  created_.fetch_sub(deleted, std::memory_order_relaxed);
+}
+
+void RecordablePool::Open() { returned_.store(nullptr, std::memory_order_relaxed); }
+
+namespace {
+
+/*
+ * Keys whose values come from a small set, the only ones whose values are interned. Values of
+ * other keys, like URLs or user agents, would fill the table with strings seen once and keep
+ * them forever, leaving no room for the common ones.
+ */
+const char* const kLowCardinalityKeys[] = {
+  "http.method", "http.scheme", "http.flavor", "http.route", "http.host", "net.transport",
+  "net.host.name", "net.peer.name", "peer.service", "db.system", "db.name", "db.operation",
+  "rpc.system", "rpc.service", "rpc.method", "messaging.system", "messaging.destination",
+  "exception.type", "thread.name", "code.function", "code.namespace"};
+
+const size_t kLowCardinalityKeyCount =
+  sizeof(kLowCardinalityKeys) / sizeof(kLowCardinalityKeys[0]);
+
+struct LowCardinalityKeyIds {
+  /* kNotInterned for keys the table didn't take. */
+  uint32_t ids[kLowCardinalityKeyCount];
+
+  LowCardinalityKeyIds() {
+    for (size_t i = 0; i < kLowCardinalityKeyCount; i++) {
+      ids[i] = InternTable::Names().Intern(kLowCardinalityKeys[i]);
+    }
+  }
+};
+
+/* keyId is the id of an attribute key in InternTable::Names(). */
+bool HasLowCardinality(uint32_t keyId) {
+  static const LowCardinalityKeyIds keys;
+
+  if (keyId == InternTable::kNotInterned) {
+    return false;
+  }
+
+  for (uint32_t id : keys.ids) {
+    if (id == keyId) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace
+
+/* Stores whichever alternative the value holds, picking the matching getter. */
+struct StoredValue::Setter {
+  StoredValue& stored;
+  size_t lengthLimit;
+  bool intern;
+
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value, bool>::type operator()(T value) {
+    static_assert(sizeof(T) <= sizeof(StoredValue::scalar_), "scalar does not fit");
+    std::memcpy(stored.scalar_, &value, sizeof(T));
+    stored.getter_ = &StoredValue::GetScalar<T>;
+    return false;
+  }
+
+  bool operator()(const char* value) { return (*this)(nostd::string_view(value)); }
+
+  bool operator()(nostd::string_view value) {
+    InternTable& values = InternTable::Values();
+    nostd::string_view text = value.substr(0, lengthLimit);
+    stored.string_.Assign(values, intern ? values.Intern(text) : InternTable::kNotInterned, text);
+    stored.getter_ = &StoredValue::GetString;
+    return value.size() > lengthLimit;
+  }
+
+  template <typename T>
+  bool operator()(nostd::span<const T> values) {
+    stored.bytes_.resize(values.size() * sizeof(T));
+
+    if (!values.empty()) {
+      std::memcpy(stored.bytes_.data(), values.data(), values.size() * sizeof(T));
+    }
+
+    stored.arraySize_ = values.size();
+    stored.getter_ = &StoredValue::GetArray<T>;
+    return false;
+  }
+
+  bool operator()(nostd::span<const nostd::string_view> values) {
+    bool truncated = false;
+
+    if (stored.strings_.size() < values.size()) {
+      stored.strings_.resize(values.size());
+    }
+
+    for (size_t i = 0; i < values.size(); i++) {
+      stored.strings_[i].assign(values[i].data(), std::min(values[i].size(), lengthLimit));
+      truncated = truncated || values[i].size() > lengthLimit;
+    }
+
+    stored.views_.clear();
+
+    for (size_t i = 0; i < values.size(); i++) {
+      stored.views_.emplace_back(stored.strings_[i]);
+    }
+
+    stored.getter_ = &StoredValue::GetStringArray;
+    return truncated;
+  }
+};
+
+bool StoredValue::Set(const common::AttributeValue& value, size_t lengthLimit, bool intern) {
+  return nostd::visit(Setter{*this, lengthLimit, intern}, value);
+}
+
+template <typename T>
+common::AttributeValue StoredValue::GetScalar(const StoredValue& value) {
+  T scalar;
+  std::memcpy(&scalar, value.scalar_, sizeof(T));
+  return scalar;
+}
+
+template <typename T>
+common::AttributeValue StoredValue::GetArray(const StoredValue& value) {
+  /* The vector's storage comes from operator new, aligned for any scalar. */
+  return nostd::span<const T>(
+    reinterpret_cast<const T*>(value.bytes_.data()), value.arraySize_);
+}
+
+common::AttributeValue StoredValue::GetString(const StoredValue& value) {
+  return value.string_.View();
+}
+
+common::AttributeValue StoredValue::GetStringArray(const StoredValue& value) {
+  return nostd::span<const nostd::string_view>(value.views_.data(), value.views_.size());
+}
+
+template <size_t InlineCapacity>
+void StoredAttributes<InlineCapacity>::Set(
+  nostd::string_view key, const common::AttributeValue& value, size_t countLimit,
+  size_t lengthLimit, SpanLimitCounters& counters) {
+  InternTable& names = InternTable::Names();
+  uint32_t id = names.Intern(key);
+
+  /* A key the table didn't take can't have been interned by an earlier attribute either. */
+  for (size_t i = 0; i < size_; i++) {
+    if (id != InternTable::kNotInterned ? attributes_[i].key.Id() == id
+                                        : attributes_[i].key.View() == key) {
+      SetValue(attributes_[i], value, lengthLimit, counters);
+      return;
+    }
+  }
+
+  if (size_ >= countLimit) {
+    counters.droppedAttributes.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Attribute& attribute = Append();
+  attribute.key.Assign(names, id, key);
+  SetValue(attribute, value, lengthLimit, counters);
+}
+
+template <size_t InlineCapacity>
+void StoredAttributes<InlineCapacity>::Add(
+  nostd::string_view key, const common::AttributeValue& value, size_t lengthLimit,
+  SpanLimitCounters& counters) {
+  Attribute& attribute = Append();
+  attribute.key.Assign(InternTable::Names(), key);
+  SetValue(attribute, value, lengthLimit, counters);
+}
+
+template <size_t InlineCapacity>
+void StoredAttributes<InlineCapacity>::SetValue(
+  Attribute& attribute, const common::AttributeValue& value, size_t lengthLimit,
+  SpanLimitCounters& counters) {
+  if (attribute.value.Set(value, lengthLimit, HasLowCardinality(attribute.key.Id()))) {
+    counters.truncatedAttributes.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+template <size_t InlineCapacity>
+typename StoredAttributes<InlineCapacity>::Attribute& StoredAttributes<InlineCapacity>::Append() {
+  if (size_ == attributes_.size()) {
+    attributes_.emplace_back();
+  }
+
+  return attributes_[size_++];
+}
+
+template <size_t InlineCapacity>
+bool StoredAttributes<InlineCapacity>::ForEachKeyValue(
+  nostd::function_ref<bool(nostd::string_view, common::AttributeValue)> callback) const noexcept {
+  for (size_t i = 0; i < size_; i++) {
+    if (!callback(attributes_[i].key.View(), attributes_[i].value.Get())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template class StoredAttributes<8>;
+template class StoredAttributes<2>;
+
+PooledRecordable*
+PooledRecordable::Acquire(const DynamicSettings& settings, SpanLimitCounters& counters) {
+  PooledRecordable* recordable = RecordablePool::ForThread().Acquire();
+  recordable->Reset(settings, counters);
+  return recordable;
+}
+
+void PooledRecordable::Release() {
+  if (pool_) {
+    pool_->Return(this);
+  } else {
+    delete this;
+  }
+}
+
+void PooledRecordable::Reset(const DynamicSettings& settings, SpanLimitCounters& counters) {
+  settings_ = &settings.Load();
+  counters_ = &counters;
+  spanContext_ = trace::SpanContext::GetInvalid();
+  parentSpanId_ = trace::SpanId();
+  sampled_ = true;
+  name_.Clear();
+  spanKind_ = trace::SpanKind::kInternal;
+  hasStatus_ = false;
+  statusCode_ = trace::StatusCode::kUnset;
+  statusDescription_.clear();
+  startTime_ = common::SystemTimestamp();
+  duration_ = std::chrono::nanoseconds(0);
+  usage_ = SpanUsage();
+  resource_ = nullptr;
+  instrumentationLibrary_ = nullptr;
+  attributes_.Clear();
+  eventCount_ = 0;
+  linkCount_ = 0;
+}
+
+void PooledRecordable::Replay(sdktrace::Recordable& target) const {
+  target.SetIdentity(spanContext_, parentSpanId_);
+  target.SetName(name_.View());
+  target.SetSpanKind(spanKind_);
+
+  if (resource_) {
+    target.SetResource(*resource_);
+  }
+
+  if (instrumentationLibrary_) {
+    target.SetInstrumentationLibrary(*instrumentationLibrary_);
+  }
+
+  target.SetStartTime(startTime_);
+
+  attributes_.ForEachKeyValue([&target](nostd::string_view key, common::AttributeValue value) {
+    target.SetAttribute(key, value);
+    return true;
+  });
+
+  for (size_t i = 0; i < eventCount_; i++) {
+    target.AddEvent(events_[i].name.View(), events_[i].timestamp, events_[i].attributes);
+  }
+
+  for (size_t i = 0; i < linkCount_; i++) {
+    target.AddLink(links_[i].spanContext, links_[i].attributes);
+  }
+
+  if (hasStatus_) {
+    target.SetStatus(statusCode_, statusDescription_);
+  }
+
+  target.SetDuration(duration_);
+}
+
+void PooledRecordable::SetIdentity(
+  const trace::SpanContext& spanContext, trace::SpanId parentSpanId) noexcept {
+  spanContext_ = spanContext;
+  parentSpanId_ = parentSpanId;
+  sampled_ = spanContext.IsSampled();
+}
+
+void PooledRecordable::SetAttribute(
+  nostd::string_view key, const common::AttributeValue& value) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  attributes_.Set(
+    key, value, settings_->attributeCountLimit,
+    settings_->attributeValueLengthLimit, *counters_);
+}
+
+void PooledRecordable::AddEvent(
+  nostd::string_view name, common::SystemTimestamp timestamp,
+  const common::KeyValueIterable& attributes) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  if (eventCount_ >= settings_->eventCountLimit) {
+    counters_->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (eventCount_ == events_.size()) {
+    events_.emplace_back();
+  }
+
+  Event& event = events_[eventCount_++];
+  InternTable& names = InternTable::Names();
+  event.name.Assign(names, names.InternRepeated(name), name);
+  event.timestamp = timestamp;
+  event.attributes.Clear();
+
+  size_t lengthLimit = settings_->attributeValueLengthLimit;
+  attributes.ForEachKeyValue([&](nostd::string_view key, common::AttributeValue value) {
+    event.attributes.Add(key, value, lengthLimit, *counters_);
+    return true;
+  });
+}
+
+void PooledRecordable::AddLink(
+  const trace::SpanContext& spanContext, const common::KeyValueIterable& attributes) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  if (linkCount_ >= settings_->linkCountLimit) {
+    counters_->droppedLinks.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (linkCount_ == links_.size()) {
+    links_.emplace_back();
+  }
+
+  Link& link = links_[linkCount_++];
+  link.spanContext = spanContext;
+  link.attributes.Clear();
+
+  size_t lengthLimit = settings_->attributeValueLengthLimit;
+  attributes.ForEachKeyValue([&](nostd::string_view key, common::AttributeValue value) {
+    link.attributes.Add(key, value, lengthLimit, *counters_);
+    return true;
+  });
+}
+
+void PooledRecordable::SetStatus(trace::StatusCode code, nostd::string_view description) noexcept {
+  hasStatus_ = true;
+  statusCode_ = code;
+  statusDescription_.assign(description.data(), description.size());
+}
+
+void PooledRecordable::SetName(nostd::string_view name) noexcept {
+  InternTable& names = InternTable::Names();
+  name_.Assign(names, names.InternRepeated(name), name);
+}
+
+void PooledRecordable::SetSpanKind(trace::SpanKind spanKind) noexcept { spanKind_ = spanKind; }
+
+void PooledRecordable::SetResource(
+  const opentelemetry::sdk::resource::Resource& resource) noexcept {
+  resource_ = &resource;
+}
+
+void PooledRecordable::SetStartTime(common::SystemTimestamp startTime) noexcept {
+  startTime_ = startTime;
+}
+
+void PooledRecordable::SetDuration(std::chrono::nanoseconds duration) noexcept {
+  duration_ = duration;
+}
+
+void PooledRecordable::SetInstrumentationLibrary(
+  const opentelemetry::sdk::instrumentationlibrary::InstrumentationLibrary&
+    instrumentationLibrary) noexcept {
+  instrumentationLibrary_ = &instrumentationLibrary;
+}
+
+} // namespace splunk
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "config.h"
+#include "intern_table.h"
+#include "resource_usage.h"
+#include "small_vector.h"
+#include "span_metrics.h"
+
+#include <opentelemetry/sdk/trace/recordable.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace splunk {
+
+class RecordablePool;
+
+/*
+ * Copy of an attribute value. Scalars are stored inline, short strings are interned when asked,
+ * other strings and arrays reuse buffers.
+ */
+class StoredValue {
+public:
+  /* Returns true when a string had to be cut to lengthLimit. */
+  bool Set(const opentelemetry::common::AttributeValue& value, size_t lengthLimit, bool intern);
+  opentelemetry::common::AttributeValue Get() const { return getter_(*this); }
+
+private:
+  struct Setter;
+
+  template <typename T>
+  static opentelemetry::common::AttributeValue GetScalar(const StoredValue& value);
+  template <typename T>
+  static opentelemetry::common::AttributeValue GetArray(const StoredValue& value);
+  static opentelemetry::common::AttributeValue GetString(const StoredValue& value);
+  static opentelemetry::common::AttributeValue GetStringArray(const StoredValue& value);
+
+  opentelemetry::common::AttributeValue (*getter_)(const StoredValue&) = nullptr;
+  alignas(8) unsigned char scalar_[8];
+  size_t arraySize_ = 0;
+  InternedString string_;
+  std::vector<unsigned char> bytes_;
+  std::vector<std::string> strings_;
+  std::vector<opentelemetry::nostd::string_view> views_;
+};
+
+/*
+ * Attribute list which keeps its values allocated between spans. The first InlineCapacity
+ * attributes are stored inside the list, in the order they were first set. Keys are interned,
+ * so looking up an attribute already set is a linear scan comparing ids.
+ */
+template <size_t InlineCapacity>
+class StoredAttributes final : public opentelemetry::common::KeyValueIterable {
+public:
+  /* Drops the attribute when the key is new and countLimit attributes are already set. */
+  void Set(
+    opentelemetry::nostd::string_view key, const opentelemetry::common::AttributeValue& value,
+    size_t countLimit, size_t lengthLimit, SpanLimitCounters& counters);
+  void Add(
+    opentelemetry::nostd::string_view key, const opentelemetry::common::AttributeValue& value,
+    size_t lengthLimit, SpanLimitCounters& counters);
+  void Clear() { size_ = 0; }
+
+  bool ForEachKeyValue(
+    opentelemetry::nostd::function_ref<
+      bool(opentelemetry::nostd::string_view, opentelemetry::common::AttributeValue)> callback)
+    const noexcept override;
+  size_t size() const noexcept override { return size_; }
+
+private:
+  struct Attribute {
+    InternedString key;
+    StoredValue value;
+  };
+
+  Attribute& Append();
+  static void SetValue(
+    Attribute& attribute, const opentelemetry::common::AttributeValue& value, size_t lengthLimit,
+    SpanLimitCounters& counters);
+
+  /* Elements past size_ are left over from previous spans, kept for their buffers. */
+  SmallVector<Attribute, InlineCapacity> attributes_;
+  size_t size_ = 0;
+};
+
+/* Enough for the attributes of typical HTTP and RPC spans. */
+using SpanAttributes = StoredAttributes<8>;
+using EventAttributes = StoredAttributes<2>;
+
+/*
+ * Recordable which keeps a copy of the span in buffers reused from span to span. Acquired
+ * from a pool owned by the calling thread; after export it is handed back to that pool
+ * through a lock-free return list, so memory is never freed on a thread other than the one
+ * which allocated it. The exporter specific recordable is only built at export time, on the
+ * export thread, by Replay. Attributes, events and links of spans which are recorded but not
+ * sampled are ignored.
+ */
+class PooledRecordable final : public opentelemetry::sdk::trace::Recordable {
+public:
+  static PooledRecordable* Acquire(const DynamicSettings& settings, SpanLimitCounters& counters);
+
+  /* Returns the recordable to its pool, may be called from any thread. */
+  void Release();
+
+  /* Copies the span into a recordable of the exporter. */
+  void Replay(opentelemetry::sdk::trace::Recordable& target) const;
+
+  /* Resource usage from start to end, only measured for sampled spans. */
+  void StartUsage() noexcept {
+    if (sampled_) {
+      usage_.Start();
+    }
+  }
+
+  void EndUsage() noexcept { usage_.End(*this); }
+
+  SpanSummary Summary() const {
+    return SpanSummary{
+      name_.View(), name_.Id(), spanKind_, statusCode_, duration_, sampled_,
+      spanContext_.span_id()};
+  }
+
+  void SetIdentity(
+    const opentelemetry::trace::SpanContext& spanContext,
+    opentelemetry::trace::SpanId parentSpanId) noexcept override;
+
+  void SetAttribute(
+    opentelemetry::nostd::string_view key,
+    const opentelemetry::common::AttributeValue& value) noexcept override;
+
+  void AddEvent(
+    opentelemetry::nostd::string_view name, opentelemetry::common::SystemTimestamp timestamp,
+    const opentelemetry::common::KeyValueIterable& attributes) noexcept override;
+
+  void AddLink(
+    const opentelemetry::trace::SpanContext& spanContext,
+    const opentelemetry::common::KeyValueIterable& attributes) noexcept override;
+
+  void SetStatus(
+    opentelemetry::trace::StatusCode code,
+    opentelemetry::nostd::string_view description) noexcept override;
+
+  void SetName(opentelemetry::nostd::string_view name) noexcept override;
+
+  void SetSpanKind(opentelemetry::trace::SpanKind spanKind) noexcept override;
+
+  void SetResource(const opentelemetry::sdk::resource::Resource& resource) noexcept override;
+
+  void SetStartTime(opentelemetry::common::SystemTimestamp startTime) noexcept override;
+
+  void SetDuration(std::chrono::nanoseconds duration) noexcept override;
+
+  void SetInstrumentationLibrary(
+    const opentelemetry::sdk::instrumentationlibrary::InstrumentationLibrary&
+      instrumentationLibrary) noexcept override;
+
+private:
+  friend class RecordablePool;
+
+  struct Event {
+    InternedString name;
+    opentelemetry::common::SystemTimestamp timestamp;
+    EventAttributes attributes;
+  };
+
+  struct Link {
+    opentelemetry::trace::SpanContext spanContext = opentelemetry::trace::SpanContext::GetInvalid();
+    EventAttributes attributes;
+  };
+
+  void Reset(const DynamicSettings& settings, SpanLimitCounters& counters);
+
+  /* Null for recordables allocated past the pool's limit, those are deleted on release. */
+  RecordablePool* pool_ = nullptr;
+  PooledRecordable* next_ = nullptr;
+  /* The limits current when the span started. */
+  const SettingsSnapshot* settings_ = nullptr;
+  SpanLimitCounters* counters_ = nullptr;
+
+  opentelemetry::trace::SpanContext spanContext_ = opentelemetry::trace::SpanContext::GetInvalid();
+  opentelemetry::trace::SpanId parentSpanId_;
+  bool sampled_ = true;
+  InternedString name_;
+  opentelemetry::trace::SpanKind spanKind_ = opentelemetry::trace::SpanKind::kInternal;
+  bool hasStatus_ = false;
+  opentelemetry::trace::StatusCode statusCode_ = opentelemetry::trace::StatusCode::kUnset;
+  std::string statusDescription_;
+  opentelemetry::common::SystemTimestamp startTime_;
+  std::chrono::nanoseconds duration_{0};
+  SpanUsage usage_;
+  const opentelemetry::sdk::resource::Resource* resource_ = nullptr;
+  const opentelemetry::sdk::instrumentationlibrary::InstrumentationLibrary*
+    instrumentationLibrary_ = nullptr;
+
+  SpanAttributes attributes_;
+  std::vector<Event> events_;
+  size_t eventCount_ = 0;
+  std::vector<Link> links_;
+  size_t linkCount_ = 0;
+};
+
+} // namespace splunk
@@ -0,0 +1,385 @@
+#include "profile_exporter.h"
+
+#include "grpc_deadline.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable_utils.h>
+#include <opentelemetry/proto/collector/logs/v1/logs_service.grpc.pb.h>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace logsservice = opentelemetry::proto::collector::logs::v1;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace proto = opentelemetry::proto;
+namespace sdkresource = opentelemetry::sdk::resource;
+
+namespace splunk {
+
+namespace {
+
+const auto kExportTimeout = std::chrono::seconds(10);
+
+uint64_t ToNanos(std::chrono::system_clock::time_point time) {
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count());
+}
+
+std::string ToHex(uintptr_t value) {
+  char hex[2 + sizeof(value) * 2 + 1];
+  snprintf(hex, sizeof(hex), "0x%llx", static_cast<unsigned long long>(value));
+  return hex;
+}
+
+std::string ToHex(const uint8_t* bytes, size_t size) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex(size * 2, '0');
+
+  for (size_t i = 0; i < size; i++) {
+    hex[i * 2] = kDigits[bytes[i] >> 4];
+    hex[i * 2 + 1] = kDigits[bytes[i] & 0xf];
+  }
+
+  return hex;
+}
+
+/* Protocol buffers wire format, enough of it for the few pprof messages. */
+class ProtoWriter {
+public:
+  void Varint(uint32_t field, uint64_t value) {
+    Key(field, 0);
+    Raw(value);
+  }
+
+  void Bytes(uint32_t field, const std::string& value) {
+    Key(field, 2);
+    Raw(value.size());
+    data_ += value;
+  }
+
+  void Packed(uint32_t field, const std::vector<uint64_t>& values) {
+    ProtoWriter packed;
+
+    for (uint64_t value : values) {
+      packed.Raw(value);
+    }
+
+    Bytes(field, packed.data_);
+  }
+
+  /* Fields already encoded by another writer. */
+  void Append(const ProtoWriter& fields) { data_ += fields.data_; }
+
+  const std::string& Data() const { return data_; }
+
+private:
+  void Key(uint32_t field, uint32_t wireType) { Raw(field << 3 | wireType); }
+
+  void Raw(uint64_t value) {
+    while (value >= 0x80) {
+      data_ += static_cast<char>(value | 0x80);
+      value >>= 7;
+    }
+
+    data_ += static_cast<char>(value);
+  }
+
+  std::string data_;
+};
+
+class StringTable {
+public:
+  StringTable() { Intern(""); }
+
+  uint64_t Intern(const std::string& value) {
+    auto it = indexes_.emplace(value, strings_.size());
+
+    if (it.second) {
+      strings_.push_back(value);
+    }
+
+    return it.first->second;
+  }
+
+  const std::vector<std::string>& Strings() const { return strings_; }
+
+private:
+  std::unordered_map<std::string, uint64_t> indexes_;
+  std::vector<std::string> strings_;
+};
+
+/* Function name and file of the code at address, from the dynamic symbol table. */
+std::pair<std::string, std::string> Symbolize(uintptr_t address) {
+  Dl_info info;
+
+  if (dladdr(reinterpret_cast<void*>(address), &info) == 0) {
+    return {ToHex(address), ""};
+  }
+
+  std::string file = info.dli_fname ? info.dli_fname : "";
+
+  if (!info.dli_sname) {
+    /* Not exported, e.g. static functions or executables linked without -rdynamic. */
+    uintptr_t offset = address - reinterpret_cast<uintptr_t>(info.dli_fbase);
+    return {file.substr(file.rfind('/') + 1) + "+" + ToHex(offset), file};
+  }
+
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+  std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+  free(demangled);
+  return {name, file};
+}
+
+bool Gzip(const std::string& input, std::string* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+
+  /* 16 more window bits selects the gzip wrapper. */
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) {
+    return false;
+  }
+
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+  stream.avail_out = static_cast<uInt>(output->size());
+
+  int result = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return result == Z_STREAM_END;
+}
+
+std::string Base64(const std::string& input) {
+  static const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string output;
+  output.reserve((input.size() + 2) / 3 * 4);
+
+  for (size_t i = 0; i < input.size(); i += 3) {
+    uint32_t chunk = static_cast<uint8_t>(input[i]) << 16;
+    size_t left = input.size() - i;
+
+    if (left > 1) {
+      chunk |= static_cast<uint8_t>(input[i + 1]) << 8;
+    }
+
+    if (left > 2) {
+      chunk |= static_cast<uint8_t>(input[i + 2]);
+    }
+
+    output += kAlphabet[chunk >> 18 & 0x3f];
+    output += kAlphabet[chunk >> 12 & 0x3f];
+    output += left > 1 ? kAlphabet[chunk >> 6 & 0x3f] : '=';
+    output += left > 2 ? kAlphabet[chunk & 0x3f] : '=';
+  }
+
+  return output;
+}
+
+void AddAttribute(proto::logs::v1::LogRecord* record, const char* key, const char* value) {
+  proto::common::v1::KeyValue* attribute = record->add_attributes();
+  attribute->set_key(key);
+  attribute->mutable_value()->set_string_value(value);
+}
+
+} // namespace
+
+struct PprofBuilder::State {
+  StringTable strings;
+  ProtoWriter profile;
+  ProtoWriter locations;
+  ProtoWriter functions;
+  std::unordered_map<uintptr_t, uint64_t> locationIds;
+  std::unordered_map<std::string, uint64_t> functionIds;
+  std::vector<ValueType> sampleTypes;
+  ValueType periodType;
+  uint64_t period;
+
+  std::string EncodeValueType(const ValueType& type) {
+    ProtoWriter valueType;
+    valueType.Varint(1, strings.Intern(type.first));
+    valueType.Varint(2, strings.Intern(type.second));
+    return valueType.Data();
+  }
+
+  uint64_t LocationId(uintptr_t address, bool leaf) {
+    uint64_t& locationId = locationIds[address];
+
+    if (locationId != 0) {
+      return locationId;
+    }
+
+    locationId = locationIds.size();
+
+    /* Return addresses point past the call, look up the call itself. */
+    auto symbol = Symbolize(leaf ? address : address - 1);
+    uint64_t& functionId = functionIds[symbol.first + '\0' + symbol.second];
+
+    if (functionId == 0) {
+      functionId = functionIds.size();
+      ProtoWriter function;
+      function.Varint(1, functionId);
+      function.Varint(2, strings.Intern(symbol.first));
+      function.Varint(3, strings.Intern(symbol.first));
+      function.Varint(4, strings.Intern(symbol.second));
+      functions.Bytes(5, function.Data());
+    }
+
+    ProtoWriter line;
+    line.Varint(1, functionId);
+    ProtoWriter location;
+    location.Varint(1, locationId);
+    location.Varint(3, address);
+    location.Bytes(4, line.Data());
+    locations.Bytes(4, location.Data());
+
+    return locationId;
+  }
+};
+
+PprofBuilder::PprofBuilder(
+  std::vector<ValueType> sampleTypes, ValueType periodType, uint64_t period)
+  : state_(new State()) {
+  state_->sampleTypes = std::move(sampleTypes);
+  state_->periodType = periodType;
+  state_->period = period;
+
+  for (const ValueType& type : state_->sampleTypes) {
+    state_->profile.Bytes(1, state_->EncodeValueType(type));
+  }
+}
+
+PprofBuilder::~PprofBuilder() = default;
+
+void PprofBuilder::AddSample(
+  const uintptr_t* frames, size_t depth, const ContextStorage::ActiveSpanIds* span,
+  const std::vector<uint64_t>& values) {
+  std::vector<uint64_t> locations;
+  locations.reserve(depth);
+
+  for (size_t i = 0; i < depth; i++) {
+    locations.push_back(state_->LocationId(frames[i], i == 0));
+  }
+
+  ProtoWriter sample;
+  sample.Packed(1, locations);
+  sample.Packed(2, values);
+
+  if (span) {
+    std::pair<const char*, std::string> labels[] = {
+      {"trace_id", ToHex(span->traceId, sizeof(span->traceId))},
+      {"span_id", ToHex(span->spanId, sizeof(span->spanId))},
+    };
+
+    for (const auto& label : labels) {
+      ProtoWriter encoded;
+      encoded.Varint(1, state_->strings.Intern(label.first));
+      encoded.Varint(2, state_->strings.Intern(label.second));
+      sample.Bytes(3, encoded.Data());
+    }
+  }
+
+  state_->profile.Bytes(2, sample.Data());
+}
+
+std::string PprofBuilder::Build(
+  std::chrono::system_clock::time_point start, std::chrono::system_clock::time_point end) {
+  ProtoWriter profile = state_->profile;
+  profile.Append(state_->locations);
+  profile.Append(state_->functions);
+  profile.Varint(9, ToNanos(start));
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+  profile.Varint(10, static_cast<uint64_t>(std::max<int64_t>(0, duration.count())));
+  profile.Bytes(11, state_->EncodeValueType(state_->periodType));
+  profile.Varint(12, state_->period);
+
+  /* Last, everything above interns its strings first. */
+  for (const std::string& value : state_->strings.Strings()) {
+    profile.Bytes(6, value);
+  }
+
+  return profile.Data();
+}
+
+struct ProfileExporter::Channel {
+  std::unique_ptr<logsservice::LogsService::Stub> stub;
+  proto::resource::v1::Resource resource;
+  RpcCanceller canceller;
+};
+
+ProfileExporter::ProfileExporter(
+  const std::string& otlpEndpoint, const sdkresource::Resource& resource)
+  : otlpEndpoint_(otlpEndpoint), channel_(new Channel()) {
+  channel_->stub = logsservice::LogsService::NewStub(
+    grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+
+  for (const auto& attribute : resource.GetAttributes()) {
+    otlp::OtlpRecordableUtils::PopulateAttribute(
+      channel_->resource.add_attributes(), attribute.first, attribute.second);
+  }
+}
+
+ProfileExporter::ProfileExporter(const std::string& otlpEndpoint, std::unique_ptr<Channel> channel)
+  : otlpEndpoint_(otlpEndpoint), channel_(std::move(channel)) {}
+
+ProfileExporter::~ProfileExporter() = default;
+
+std::unique_ptr<ProfileExporter> ProfileExporter::Reconnect() const {
+  std::unique_ptr<Channel> channel(new Channel());
+  channel->stub = logsservice::LogsService::NewStub(
+    grpc::CreateChannel(otlpEndpoint_, grpc::InsecureChannelCredentials()));
+  channel->resource = channel_->resource;
+  return std::unique_ptr<ProfileExporter>(new ProfileExporter(otlpEndpoint_, std::move(channel)));
+}
+
+bool ProfileExporter::Export(
+  const std::string& pprof, const char* dataType, std::chrono::system_clock::time_point time,
+  std::chrono::steady_clock::time_point deadline) {
+  std::string compressed;
+
+  if (!Gzip(pprof, &compressed)) {
+    return false;
+  }
+
+  logsservice::ExportLogsServiceRequest request;
+  proto::logs::v1::ResourceLogs* resourceLogs = request.add_resource_logs();
+  *resourceLogs->mutable_resource() = channel_->resource;
+  proto::logs::v1::InstrumentationLibraryLogs* library =
+    resourceLogs->add_instrumentation_library_logs();
+  library->mutable_instrumentation_library()->set_name("otel.profiling");
+  library->mutable_instrumentation_library()->set_version("0.1.0");
+
+  proto::logs::v1::LogRecord* record = library->add_logs();
+  record->set_time_unix_nano(ToNanos(time));
+  record->mutable_body()->set_string_value(Base64(compressed));
+  AddAttribute(record, "com.splunk.sourcetype", "otel.profiling");
+  AddAttribute(record, "profiling.data.format", "pprof-gzip-base64");
+  AddAttribute(record, "profiling.data.type", dataType);
+
+  grpc::ClientContext context;
+
+  if (!SetGrpcDeadline(&context, deadline, kExportTimeout) ||
+      !channel_->canceller.Begin(&context)) {
+    return false;
+  }
+
+  logsservice::ExportLogsServiceResponse response;
+  bool exported = channel_->stub->Export(&context, request, &response).ok();
+  channel_->canceller.End();
+  return exported;
+}
+
+void ProfileExporter::Cancel() { channel_->canceller.Cancel(); }
+
+} // namespace splunk
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "context_storage.h"
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace splunk {
+
+/*
+ * Encodes sampled call stacks as a pprof profile. Frames are symbolized from the dynamic symbol
+ * table, each sample has trace_id and span_id labels when it was taken in a span.
+ */
+class PprofBuilder {
+public:
+  using ValueType = std::pair<const char*, const char*>;
+
+  /* Each sample has a value for each of sampleTypes, (type, unit) pairs. */
+  PprofBuilder(std::vector<ValueType> sampleTypes, ValueType periodType, uint64_t period);
+  ~PprofBuilder();
+
+  /* frames are leaf first, return addresses except the leaf. */
+  void AddSample(
+    const uintptr_t* frames, size_t depth, const ContextStorage::ActiveSpanIds* span,
+    const std::vector<uint64_t>& values);
+
+  /* The serialized profile, uncompressed. */
+  std::string Build(
+    std::chrono::system_clock::time_point start, std::chrono::system_clock::time_point end);
+
+private:
+  struct State;
+
+  std::unique_ptr<State> state_;
+};
+
+/* Sends profiles to the OTLP endpoint as log records in the format of AlwaysOn Profiling. */
+class ProfileExporter {
+public:
+  ProfileExporter(
+    const std::string& otlpEndpoint, const opentelemetry::sdk::resource::Resource& resource);
+  ~ProfileExporter();
+
+  /* Connects again with the same resource, for the child of a fork. */
+  std::unique_ptr<ProfileExporter> Reconnect() const;
+
+  /* Gzips and sends pprof with profiling.data.type set to dataType, "cpu" or "allocation". */
+  bool Export(
+    const std::string& pprof, const char* dataType, std::chrono::system_clock::time_point time,
+    std::chrono::steady_clock::time_point deadline);
+  /* Cancels the export in progress on another thread, exports fail from then on. */
+  void Cancel();
+
+private:
+  struct Channel;
+
+  ProfileExporter(const std::string& otlpEndpoint, std::unique_ptr<Channel> channel);
+
+  const std::string otlpEndpoint_;
+  std::unique_ptr<Channel> channel_;
+};
+
+} // namespace splunk
@@ -0,0 +1,234 @@
+#include "recordable.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace common = opentelemetry::common;
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+size_t HashKey(nostd::string_view key) {
+  uint64_t hash = 14695981039346656037ull;
+
+  for (char c : key) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+
+  return static_cast<size_t>(hash);
+}
+
+nostd::string_view Truncate(nostd::string_view value, size_t limit) {
+  return value.size() > limit ? value.substr(0, limit) : value;
+}
+
+bool NeedsTruncation(const common::AttributeValue& value, size_t limit) {
+  if (nostd::holds_alternative<nostd::string_view>(value)) {
+    return nostd::get<nostd::string_view>(value).size() > limit;
+  }
+
+  if (nostd::holds_alternative<const char*>(value)) {
+    return nostd::string_view(nostd::get<const char*>(value)).size() > limit;
+  }
+
+  if (nostd::holds_alternative<nostd::span<const nostd::string_view>>(value)) {
+    auto values = nostd::get<nostd::span<const nostd::string_view>>(value);
+    return std::any_of(values.begin(), values.end(), [limit](nostd::string_view v) {
+      return v.size() > limit;
+    });
+  }
+
+  return false;
+}
+
+/* Calls f with value cut to limit, value must need truncation. Only the string views shrink. */
+template <typename F>
+bool WithTruncated(const common::AttributeValue& value, size_t limit, F f) {
+  if (nostd::holds_alternative<nostd::string_view>(value)) {
+    return f(Truncate(nostd::get<nostd::string_view>(value), limit));
+  }
+
+  if (nostd::holds_alternative<const char*>(value)) {
+    return f(Truncate(nostd::get<const char*>(value), limit));
+  }
+
+  auto values = nostd::get<nostd::span<const nostd::string_view>>(value);
+  std::vector<nostd::string_view> truncated;
+  truncated.reserve(values.size());
+
+  for (nostd::string_view v : values) {
+    truncated.push_back(Truncate(v, limit));
+  }
+
+  return f(nostd::span<const nostd::string_view>(truncated.data(), truncated.size()));
+}
+
+/* Event or link attributes, with the value length limit applied while they are iterated. */
+class LimitedAttributes final : public common::KeyValueIterable {
+public:
+  LimitedAttributes(
+    const common::KeyValueIterable& attributes, size_t lengthLimit, SpanLimitCounters& counters)
+    : attributes_(attributes), lengthLimit_(lengthLimit), counters_(counters) {}
+
+  bool ForEachKeyValue(nostd::function_ref<bool(nostd::string_view, common::AttributeValue)>
+                         callback) const noexcept override {
+    return attributes_.ForEachKeyValue([&](nostd::string_view key, common::AttributeValue value) {
+      if (!NeedsTruncation(value, lengthLimit_)) {
+        return callback(key, value);
+      }
+
+      counters_.truncatedAttributes.fetch_add(1, std::memory_order_relaxed);
+      return WithTruncated(value, lengthLimit_, [&](const common::AttributeValue& truncated) {
+        return callback(key, truncated);
+      });
+    });
+  }
+
+  size_t size() const noexcept override { return attributes_.size(); }
+
+private:
+  const common::KeyValueIterable& attributes_;
+  const size_t lengthLimit_;
+  SpanLimitCounters& counters_;
+};
+
+} // namespace
+
+SpanRecordable::SpanRecordable(
+  std::unique_ptr<sdktrace::Recordable> delegate, const DynamicSettings& settings,
+  SpanLimitCounters& counters, bool summarize)
+  : delegate_(std::move(delegate)), settings_(settings.Load()), counters_(counters),
+    summarize_(summarize) {}
+
+void SpanRecordable::SetIdentity(
+  const trace::SpanContext& spanContext, trace::SpanId parentSpanId) noexcept {
+  sampled_ = spanContext.IsSampled();
+
+  if (summarize_) {
+    spanId_ = spanContext.span_id();
+  }
+
+  delegate_->SetIdentity(spanContext, parentSpanId);
+}
+
+void SpanRecordable::SetAttribute(
+  nostd::string_view key, const common::AttributeValue& value) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  uint32_t countLimit = settings_.attributeCountLimit;
+
+  if (countLimit != kUnlimited) {
+    size_t keyHash = HashKey(key);
+
+    if (std::find(attributeKeys_.begin(), attributeKeys_.end(), keyHash) == attributeKeys_.end()) {
+      if (attributeKeys_.size() >= countLimit) {
+        counters_.droppedAttributes.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      attributeKeys_.push_back(keyHash);
+    }
+  }
+
+  uint32_t lengthLimit = settings_.attributeValueLengthLimit;
+
+  if (lengthLimit == kUnlimited || !NeedsTruncation(value, lengthLimit)) {
+    delegate_->SetAttribute(key, value);
+    return;
+  }
+
+  counters_.truncatedAttributes.fetch_add(1, std::memory_order_relaxed);
+  WithTruncated(value, lengthLimit, [&](const common::AttributeValue& truncated) {
+    delegate_->SetAttribute(key, truncated);
+    return true;
+  });
+}
+
+void SpanRecordable::AddEvent(
+  nostd::string_view name, common::SystemTimestamp timestamp,
+  const common::KeyValueIterable& attributes) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  if (eventCount_ >= settings_.eventCountLimit) {
+    counters_.droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  eventCount_++;
+  uint32_t lengthLimit = settings_.attributeValueLengthLimit;
+
+  if (lengthLimit == kUnlimited) {
+    delegate_->AddEvent(name, timestamp, attributes);
+  } else {
+    delegate_->AddEvent(name, timestamp, LimitedAttributes(attributes, lengthLimit, counters_));
+  }
+}
+
+void SpanRecordable::AddLink(
+  const trace::SpanContext& spanContext, const common::KeyValueIterable& attributes) noexcept {
+  if (!sampled_) {
+    return;
+  }
+
+  if (linkCount_ >= settings_.linkCountLimit) {
+    counters_.droppedLinks.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  linkCount_++;
+  uint32_t lengthLimit = settings_.attributeValueLengthLimit;
+
+  if (lengthLimit == kUnlimited) {
+    delegate_->AddLink(spanContext, attributes);
+  } else {
+    delegate_->AddLink(spanContext, LimitedAttributes(attributes, lengthLimit, counters_));
+  }
+}
+
+void SpanRecordable::SetStatus(trace::StatusCode code, nostd::string_view description) noexcept {
+  statusCode_ = code;
+  delegate_->SetStatus(code, description);
+}
+
+void SpanRecordable::SetName(nostd::string_view name) noexcept {
+  if (summarize_) {
+    InternTable& names = InternTable::Names();
+    name_.Assign(names, names.InternRepeated(name), name);
+  }
+
+  delegate_->SetName(name);
+}
+
+void SpanRecordable::SetSpanKind(trace::SpanKind spanKind) noexcept {
+  spanKind_ = spanKind;
+  delegate_->SetSpanKind(spanKind);
+}
+
+void SpanRecordable::SetResource(const opentelemetry::sdk::resource::Resource& resource) noexcept {
+  delegate_->SetResource(resource);
+}
+
+void SpanRecordable::SetStartTime(common::SystemTimestamp startTime) noexcept {
+  delegate_->SetStartTime(startTime);
+}
+
+void SpanRecordable::SetDuration(std::chrono::nanoseconds duration) noexcept {
+  duration_ = duration;
+  delegate_->SetDuration(duration);
+}
+
+void SpanRecordable::SetInstrumentationLibrary(
+  const opentelemetry::sdk::instrumentationlibrary::InstrumentationLibrary&
+    instrumentationLibrary) noexcept {
+  delegate_->SetInstrumentationLibrary(instrumentationLibrary);
+}
+
+} // namespace splunk
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "config.h"
+#include "intern_table.h"
+#include "resource_usage.h"
+#include "small_vector.h"
+#include "span_metrics.h"
+
+#include <opentelemetry/sdk/trace/recordable.h>
+
+#include <chrono>
+#include <memory>
+
+namespace splunk {
+
+/*
+ * Recordable handed out by the Splunk span processor. Applies the dynamic span limits
+ * before anything is copied into the exporter specific recordable it wraps, so dropped items
+ * and the cut off part of long values are never copied. With summarize the span name is also
+ * interned and the span ID kept, for Summary(). Attributes, events and links of spans which are
+ * recorded but not sampled are never exported, so they are ignored.
+ */
+class SpanRecordable final : public opentelemetry::sdk::trace::Recordable {
+public:
+  SpanRecordable(
+    std::unique_ptr<opentelemetry::sdk::trace::Recordable> delegate,
+    const DynamicSettings& settings, SpanLimitCounters& counters, bool summarize = false);
+
+  std::unique_ptr<opentelemetry::sdk::trace::Recordable> ReleaseDelegate() {
+    return std::move(delegate_);
+  }
+
+  /* Resource usage from start to end, only measured for sampled spans. */
+  void StartUsage() noexcept {
+    if (sampled_) {
+      usage_.Start();
+    }
+  }
+
+  void EndUsage() noexcept { usage_.End(*this); }
+
+  /* Requires summarize. */
+  SpanSummary Summary() const {
+    return SpanSummary{
+      name_.View(), name_.Id(), spanKind_, statusCode_, duration_, sampled_, spanId_};
+  }
+
+  void SetIdentity(
+    const opentelemetry::trace::SpanContext& spanContext,
+    opentelemetry::trace::SpanId parentSpanId) noexcept override;
+
+  void SetAttribute(
+    opentelemetry::nostd::string_view key,
+    const opentelemetry::common::AttributeValue& value) noexcept override;
+
+  void AddEvent(
+    opentelemetry::nostd::string_view name, opentelemetry::common::SystemTimestamp timestamp,
+    const opentelemetry::common::KeyValueIterable& attributes) noexcept override;
+
+  void AddLink(
+    const opentelemetry::trace::SpanContext& spanContext,
+    const opentelemetry::common::KeyValueIterable& attributes) noexcept override;
+
+  void SetStatus(
+    opentelemetry::trace::StatusCode code,
+    opentelemetry::nostd::string_view description) noexcept override;
+
+  void SetName(opentelemetry::nostd::string_view name) noexcept override;
+
+  void SetSpanKind(opentelemetry::trace::SpanKind spanKind) noexcept override;
+
+  void SetResource(const opentelemetry::sdk::resource::Resource& resource) noexcept override;
+
+  void SetStartTime(opentelemetry::common::SystemTimestamp startTime) noexcept override;
+
+  void SetDuration(std::chrono::nanoseconds duration) noexcept override;
+
+  void SetInstrumentationLibrary(
+    const opentelemetry::sdk::instrumentationlibrary::InstrumentationLibrary&
+      instrumentationLibrary) noexcept override;
+
+private:
+  std::unique_ptr<opentelemetry::sdk::trace::Recordable> delegate_;
+  /* The limits current when the span started. */
+  const SettingsSnapshot& settings_;
+  SpanLimitCounters& counters_;
+  const bool summarize_;
+  bool sampled_ = true;
+  InternedString name_;
+  opentelemetry::trace::SpanKind spanKind_ = opentelemetry::trace::SpanKind::kInternal;
+  opentelemetry::trace::StatusCode statusCode_ = opentelemetry::trace::StatusCode::kUnset;
+  std::chrono::nanoseconds duration_{0};
+  opentelemetry::trace::SpanId spanId_;
+  SpanUsage usage_;
+  uint32_t eventCount_ = 0;
+  uint32_t linkCount_ = 0;
+  /* Hashes of the attribute keys set so far, only tracked when the count is limited. */
+  SmallVector<size_t, 16> attributeKeys_;
+};
+
+} // namespace splunk
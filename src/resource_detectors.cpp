@@ -0,0 +1,375 @@
+#include "resource_detectors.h"
+
+#include <nlohmann/json.hpp>
+
+#include <limits.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace sdkresource = opentelemetry::sdk::resource;
+
+namespace splunk {
+
+namespace {
+
+using json = nlohmann::json;
+using Attributes = std::map<std::string, std::string>;
+using Detector = void (*)(Attributes*);
+
+const size_t kContainerIdLength = 64;
+const size_t kPodUidLength = 36;
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+std::string TrimLine(std::string value) {
+  while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+    value.pop_back();
+  }
+
+  return value;
+}
+
+/* Returns where the symbolic link at path points, or "". */
+std::string ReadLink(const char* path) {
+  char target[PATH_MAX];
+  ssize_t length = readlink(path, target, sizeof(target));
+
+  if (length <= 0 || static_cast<size_t>(length) >= sizeof(target)) {
+    return "";
+  }
+
+  return std::string(target, length);
+}
+
+std::string HostName() {
+  char name[HOST_NAME_MAX + 1] = {};
+
+  if (gethostname(name, sizeof(name) - 1) != 0) {
+    return "";
+  }
+
+  return name;
+}
+
+bool IsHex(char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; }
+
+/* Returns the last run of exactly kContainerIdLength hex digits in line. */
+std::string FindContainerId(const std::string& line) {
+  std::string found;
+  size_t i = 0;
+
+  while (i < line.size()) {
+    if (!IsHex(line[i])) {
+      i++;
+      continue;
+    }
+
+    size_t start = i;
+    while (i < line.size() && IsHex(line[i])) {
+      i++;
+    }
+
+    if (i - start == kContainerIdLength) {
+      found = line.substr(start, kContainerIdLength);
+    }
+  }
+
+  return found;
+}
+
+/* Pod UIDs appear in cgroup paths as "pod<uid>", with '_' instead of '-' under systemd. */
+std::string FindPodUid(const std::string& line) {
+  size_t pos = line.find("pod");
+
+  while (pos != std::string::npos) {
+    std::string uid = line.substr(pos + 3, kPodUidLength);
+
+    if (uid.size() == kPodUidLength && std::all_of(uid.begin(), uid.end(), [](char c) {
+          return IsHex(c) || c == '-' || c == '_';
+        })) {
+      std::replace(uid.begin(), uid.end(), '_', '-');
+      return uid;
+    }
+
+    pos = line.find("pod", pos + 3);
+  }
+
+  return "";
+}
+
+void DetectHost(Attributes* out) {
+  std::string hostName = HostName();
+
+  if (!hostName.empty()) {
+    (*out)["host.name"] = hostName;
+  }
+
+  struct utsname uts;
+  if (uname(&uts) != 0) {
+    return;
+  }
+
+  std::string machine = uts.machine;
+
+  if (machine == "x86_64") {
+    machine = "amd64";
+  } else if (machine == "aarch64") {
+    machine = "arm64";
+  }
+
+  (*out)["host.arch"] = machine;
+  (*out)["os.type"] = "linux";
+  (*out)["os.version"] = uts.release;
+}
+
+void DetectContainer(Attributes* out) {
+  std::istringstream cgroup(ReadFile("/proc/self/cgroup"));
+  std::string line;
+
+  while (std::getline(cgroup, line)) {
+    std::string id = FindContainerId(line);
+
+    if (!id.empty()) {
+      (*out)["container.id"] = id;
+      return;
+    }
+  }
+
+  /* cgroup v2 hides the path, but the runtime bind mounts files from the container dir. */
+  std::istringstream mounts(ReadFile("/proc/self/mountinfo"));
+
+  while (std::getline(mounts, line)) {
+    if (line.find("/containers/") == std::string::npos &&
+        line.find("/sandboxes/") == std::string::npos) {
+      continue;
+    }
+
+    std::string id = FindContainerId(line);
+
+    if (!id.empty()) {
+      (*out)["container.id"] = id;
+      return;
+    }
+  }
+}
+
+void DetectKubernetes(Attributes* out) {
+  if (std::getenv("KUBERNETES_SERVICE_HOST") == nullptr) {
+    return;
+  }
+
+  const char* podName = std::getenv("HOSTNAME");
+  (*out)["k8s.pod.name"] = podName != nullptr ? podName : HostName();
+
+  std::string ns =
+    TrimLine(ReadFile("/var/run/secrets/kubernetes.io/serviceaccount/namespace"));
+
+  if (!ns.empty()) {
+    (*out)["k8s.namespace.name"] = ns;
+  }
+
+  std::istringstream cgroup(ReadFile("/proc/self/cgroup"));
+  std::string line;
+
+  while (std::getline(cgroup, line)) {
+    std::string uid = FindPodUid(line);
+
+    if (!uid.empty()) {
+      (*out)["k8s.pod.uid"] = uid;
+      return;
+    }
+  }
+}
+
+void DetectProcess(Attributes* out) {
+  std::string executable = ReadLink("/proc/self/exe");
+
+  if (executable.empty()) {
+    return;
+  }
+
+  (*out)["process.executable.path"] = executable;
+  (*out)["process.executable.name"] = executable.substr(executable.rfind('/') + 1);
+}
+
+struct Detection {
+  std::mutex mutex;
+  std::condition_variable cv;
+  /* Guarded by mutex. */
+  std::vector<Attributes> results;
+  std::vector<bool> done;
+};
+
+/*
+ * Runs each detector on its own thread and waits for them until the deadline. The result of
+ * a detector which missed the deadline is left empty and its done flag unset.
+ */
+void RunDetectors(
+  const std::vector<Detector>& detectors, std::chrono::steady_clock::time_point deadline,
+  std::vector<Attributes>* results, std::vector<bool>* done) {
+  /* Shared with the threads, which outlive this call when they miss the deadline. */
+  auto detection = std::make_shared<Detection>();
+  detection->results.resize(detectors.size());
+  detection->done.resize(detectors.size());
+
+  for (size_t i = 0; i < detectors.size(); i++) {
+    Detector detector = detectors[i];
+    auto run = [detection, detector, i] {
+      Attributes result;
+      detector(&result);
+
+      std::lock_guard<std::mutex> lock(detection->mutex);
+      detection->results[i] = std::move(result);
+      detection->done[i] = true;
+      detection->cv.notify_one();
+    };
+
+    try {
+      std::thread(run).detach();
+    } catch (const std::system_error&) {
+      run();
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(detection->mutex);
+  detection->cv.wait_until(lock, deadline, [&detection] {
+    return std::all_of(detection->done.begin(), detection->done.end(), [](bool d) { return d; });
+  });
+
+  *results = detection->results;
+  *done = detection->done;
+}
+
+/*
+ * The cache is only valid for the boot, host and container it was written on. A container
+ * restarted in the same pod keeps the hostname, each gets its own mount namespace.
+ */
+json CacheKey() {
+  return {
+    {"boot_id", TrimLine(ReadFile("/proc/sys/kernel/random/boot_id"))},
+    {"host_name", HostName()},
+    {"mnt_ns", ReadLink("/proc/self/ns/mnt")},
+  };
+}
+
+bool ReadCache(const std::string& path, const json& key, Attributes* out) {
+  std::ifstream file(path);
+
+  if (!file) {
+    return false;
+  }
+
+  json root = json::parse(file, nullptr, false);
+
+  if (root.is_discarded() || !root.is_object() || root.value("key", json()) != key) {
+    return false;
+  }
+
+  auto attributes = root.find("attributes");
+  if (attributes == root.end() || !attributes->is_object()) {
+    return false;
+  }
+
+  for (auto it = attributes->begin(); it != attributes->end(); ++it) {
+    if (it.value().is_string()) {
+      (*out)[it.key()] = it.value().get<std::string>();
+    }
+  }
+
+  return true;
+}
+
+void WriteCache(const std::string& path, const json& key, const Attributes& attributes) {
+  json root = {{"key", key}, {"attributes", attributes}};
+
+  /* Written aside and renamed, concurrent launches never see a partial file. */
+  std::string tempPath = path + ".tmp." + std::to_string(getpid());
+
+  {
+    std::ofstream file(tempPath, std::ios::trunc);
+    file << root.dump();
+
+    if (!file) {
+      std::remove(tempPath.c_str());
+      return;
+    }
+  }
+
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+  }
+}
+
+} // namespace
+
+void DetectResource(
+  const std::string& cacheFile, std::chrono::milliseconds timeout,
+  sdkresource::ResourceAttributes* attributes) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  json cacheKey;
+  Attributes cached;
+  bool isCached = false;
+
+  if (!cacheFile.empty()) {
+    cacheKey = CacheKey();
+    isCached = ReadCache(cacheFile, cacheKey, &cached);
+  }
+
+  /* Process attributes come first, they are never cached. */
+  std::vector<Detector> detectors = {&DetectProcess};
+
+  if (!isCached) {
+    detectors.insert(detectors.end(), {&DetectHost, &DetectContainer, &DetectKubernetes});
+  }
+
+  std::vector<Attributes> results;
+  std::vector<bool> done;
+  RunDetectors(detectors, deadline, &results, &done);
+
+  if (!isCached) {
+    bool complete = std::all_of(done.begin() + 1, done.end(), [](bool d) { return d; });
+
+    for (size_t i = 1; i < results.size(); i++) {
+      cached.insert(results[i].begin(), results[i].end());
+    }
+
+    if (complete && !cacheFile.empty()) {
+      WriteCache(cacheFile, cacheKey, cached);
+    }
+  }
+
+  Attributes detected = results[0];
+  detected.insert(cached.begin(), cached.end());
+
+  for (const auto& attribute : detected) {
+    if (attributes->GetAttributes().count(attribute.first) == 0) {
+      attributes->SetAttribute(attribute.first, attribute.second);
+    }
+  }
+
+  if (attributes->GetAttributes().count("process.pid") == 0) {
+    attributes->SetAttribute("process.pid", static_cast<int64_t>(getpid()));
+  }
+}
+
+} // namespace splunk
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <chrono>
+#include <string>
+
+namespace splunk {
+
+/*
+ * Detects host, process, container and Kubernetes attributes and adds the ones not already
+ * present to attributes. Detectors run in parallel; the ones still running when the timeout
+ * expires are abandoned and contribute nothing.
+ *
+ * When cacheFile is set the host, container and Kubernetes attributes are read from it if
+ * it was written since the last boot by a process with the same host name, and written to it
+ * after a complete detection otherwise. Process attributes are never cached.
+ */
+void DetectResource(
+  const std::string& cacheFile, std::chrono::milliseconds timeout,
+  opentelemetry::sdk::resource::ResourceAttributes* attributes);
+
+} // namespace splunk
@@ -0,0 +1,78 @@
+#include "resource_usage.h"
+
+#include "allocation_hooks.h"
+
+#include <sys/resource.h>
+
+namespace splunk {
+
+namespace {
+
+thread_local uint64_t threadAllocatedBytes;
+std::atomic<int> allocationCounters{0};
+
+uint64_t ToMicros(const struct timeval& time) {
+  return static_cast<uint64_t>(time.tv_sec) * 1000000 + static_cast<uint64_t>(time.tv_usec);
+}
+
+} // namespace
+
+void CountAllocation(size_t size) noexcept { threadAllocatedBytes += size; }
+
+void CountAllocations(bool enabled) noexcept {
+  if (enabled) {
+    if (allocationCounters.fetch_add(1, std::memory_order_relaxed) == 0) {
+      allocationHooks.fetch_or(AllocationHook_Count, std::memory_order_relaxed);
+    }
+  } else if (allocationCounters.fetch_sub(1, std::memory_order_relaxed) == 1) {
+    allocationHooks.fetch_and(~AllocationHook_Count, std::memory_order_relaxed);
+  }
+}
+
+bool ReadThreadUsage(ThreadUsage* usage) noexcept {
+  /*
+   * CLOCK_THREAD_CPUTIME_ID has no vDSO fast path on Linux, getrusage returns the CPU times too
+   * and is the only system call of a reading.
+   */
+  struct rusage counters;
+
+  if (getrusage(RUSAGE_THREAD, &counters) != 0) {
+    usage->thread = 0;
+    return false;
+  }
+
+  usage->thread = reinterpret_cast<uintptr_t>(&threadAllocatedBytes);
+  usage->userMicros = ToMicros(counters.ru_utime);
+  usage->systemMicros = ToMicros(counters.ru_stime);
+  usage->voluntarySwitches = static_cast<uint64_t>(counters.ru_nvcsw);
+  usage->involuntarySwitches = static_cast<uint64_t>(counters.ru_nivcsw);
+  usage->allocatedBytes = threadAllocatedBytes;
+  return true;
+}
+
+void SpanUsage::End(opentelemetry::sdk::trace::Recordable& span) noexcept {
+  ThreadUsage end;
+
+  if (start_.thread == 0 || !ReadThreadUsage(&end) || end.thread != start_.thread) {
+    return;
+  }
+
+  span.SetAttribute("span.cpu.user_us", static_cast<int64_t>(end.userMicros - start_.userMicros));
+  span.SetAttribute(
+    "span.cpu.system_us", static_cast<int64_t>(end.systemMicros - start_.systemMicros));
+  span.SetAttribute(
+    "span.context_switches.voluntary",
+    static_cast<int64_t>(end.voluntarySwitches - start_.voluntarySwitches));
+  span.SetAttribute(
+    "span.context_switches.involuntary",
+    static_cast<int64_t>(end.involuntarySwitches - start_.involuntarySwitches));
+
+  if (allocationHooks.load(std::memory_order_relaxed) & AllocationHook_Count) {
+    span.SetAttribute(
+      "span.allocated_bytes", static_cast<int64_t>(end.allocatedBytes - start_.allocatedBytes));
+  }
+
+  start_.thread = 0;
+}
+
+} // namespace splunk
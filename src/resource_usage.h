@@ -0,0 +1,44 @@
+#pragma once
+
+#include <opentelemetry/sdk/trace/recordable.h>
+
+#include <cstdint>
+
+namespace splunk {
+
+/* Counters of the calling thread, from one getrusage(RUSAGE_THREAD) call. */
+struct ThreadUsage {
+  /* Address of a thread-local of the thread which read them, 0 until read. */
+  uintptr_t thread = 0;
+  uint64_t userMicros = 0;
+  uint64_t systemMicros = 0;
+  uint64_t voluntarySwitches = 0;
+  uint64_t involuntarySwitches = 0;
+  /* Through operator new, only counted while allocation counting is enabled. */
+  uint64_t allocatedBytes = 0;
+};
+
+bool ReadThreadUsage(ThreadUsage* usage) noexcept;
+
+/*
+ * Counts the bytes each thread allocates through operator new, in builds with
+ * SPLUNK_CPP_ALLOCATION_HOOKS. Calls nest like ContextStorage::TrackActiveSpanIds.
+ */
+void CountAllocations(bool enabled) noexcept;
+
+/*
+ * What a span's thread used between its start and end, added as span attributes on end:
+ * span.cpu.user_us, span.cpu.system_us, span.context_switches.voluntary and .involuntary, and
+ * span.allocated_bytes while allocations are counted. A span ended on another thread than the
+ * one which started it gets none, the counters are per thread.
+ */
+class SpanUsage {
+public:
+  void Start() noexcept { ReadThreadUsage(&start_); }
+  void End(opentelemetry::sdk::trace::Recordable& span) noexcept;
+
+private:
+  ThreadUsage start_;
+};
+
+} // namespace splunk
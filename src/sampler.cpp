@@ -0,0 +1,88 @@
+#include "sampler.h"
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+/* Interprets the first 8 bytes of the trace ID as a big-endian number. */
+uint64_t TraceIdPrefix(const trace::TraceId& traceId) {
+  nostd::span<const uint8_t, trace::TraceId::kSize> bytes = traceId.Id();
+  uint64_t result = 0;
+
+  for (size_t i = 0; i < 8; i++) {
+    result = (result << 8) | bytes[i];
+  }
+
+  return result;
+}
+
+} // namespace
+
+RatioSampler::RatioSampler(std::shared_ptr<const DynamicSettings> settings)
+  : settings_(std::move(settings)) {}
+
+sdktrace::SamplingResult RatioSampler::ShouldSample(
+  const trace::SpanContext& parentContext, trace::TraceId traceId, nostd::string_view name,
+  trace::SpanKind spanKind, const opentelemetry::common::KeyValueIterable& attributes,
+  const trace::SpanContextKeyValueIterable& links) noexcept {
+  uint64_t threshold = settings_->Load().samplerThreshold;
+
+  if (threshold != 0 && TraceIdPrefix(traceId) <= threshold) {
+    return {sdktrace::Decision::RECORD_AND_SAMPLE, nullptr};
+  }
+
+  return {sdktrace::Decision::DROP, nullptr};
+}
+
+nostd::string_view RatioSampler::GetDescription() const noexcept { return "SplunkRatioSampler"; }
+
+RecordUnsampledSampler::RecordUnsampledSampler(std::unique_ptr<sdktrace::Sampler> delegate)
+  : delegate_(std::move(delegate)) {}
+
+sdktrace::SamplingResult RecordUnsampledSampler::ShouldSample(
+  const trace::SpanContext& parentContext, trace::TraceId traceId, nostd::string_view name,
+  trace::SpanKind spanKind, const opentelemetry::common::KeyValueIterable& attributes,
+  const trace::SpanContextKeyValueIterable& links) noexcept {
+  sdktrace::SamplingResult result =
+    delegate_->ShouldSample(parentContext, traceId, name, spanKind, attributes, links);
+
+  if (result.decision == sdktrace::Decision::DROP) {
+    result.decision = sdktrace::Decision::RECORD_ONLY;
+  }
+
+  return result;
+}
+
+nostd::string_view RecordUnsampledSampler::GetDescription() const noexcept {
+  return "SplunkRecordUnsampledSampler";
+}
+
+CountingSampler::CountingSampler(
+  std::unique_ptr<sdktrace::Sampler> delegate, std::shared_ptr<PipelineCounters> counters)
+  : delegate_(std::move(delegate)), counters_(std::move(counters)) {}
+
+sdktrace::SamplingResult CountingSampler::ShouldSample(
+  const trace::SpanContext& parentContext, trace::TraceId traceId, nostd::string_view name,
+  trace::SpanKind spanKind, const opentelemetry::common::KeyValueIterable& attributes,
+  const trace::SpanContextKeyValueIterable& links) noexcept {
+  sdktrace::SamplingResult result =
+    delegate_->ShouldSample(parentContext, traceId, name, spanKind, attributes, links);
+
+  if (result.decision == sdktrace::Decision::RECORD_AND_SAMPLE) {
+    counters_->spansSampled.Add(1);
+  } else {
+    counters_->spansNotSampled.Add(1);
+  }
+
+  return result;
+}
+
+nostd::string_view CountingSampler::GetDescription() const noexcept {
+  return delegate_->GetDescription();
+}
+
+} // namespace splunk
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "config.h"
+#include "pipeline_stats.h"
+
+#include <opentelemetry/sdk/trace/sampler.h>
+
+#include <memory>
+
+namespace splunk {
+
+/*
+ * Trace ID ratio sampler whose ratio is read from DynamicSettings on every decision,
+ * so a config reload changes it without rebuilding the provider.
+ */
+class RatioSampler final : public opentelemetry::sdk::trace::Sampler {
+public:
+  explicit RatioSampler(std::shared_ptr<const DynamicSettings> settings);
+
+  opentelemetry::sdk::trace::SamplingResult ShouldSample(
+    const opentelemetry::trace::SpanContext& parentContext,
+    opentelemetry::trace::TraceId traceId, opentelemetry::nostd::string_view name,
+    opentelemetry::trace::SpanKind spanKind,
+    const opentelemetry::common::KeyValueIterable& attributes,
+    const opentelemetry::trace::SpanContextKeyValueIterable& links) noexcept override;
+
+  opentelemetry::nostd::string_view GetDescription() const noexcept override;
+
+private:
+  std::shared_ptr<const DynamicSettings> settings_;
+};
+
+/*
+ * Makes the spans the delegate drops RECORD_ONLY instead, so span metrics see every span. Such
+ * spans are recorded but not propagated as sampled, and never exported.
+ */
+class RecordUnsampledSampler final : public opentelemetry::sdk::trace::Sampler {
+public:
+  explicit RecordUnsampledSampler(std::unique_ptr<opentelemetry::sdk::trace::Sampler> delegate);
+
+  opentelemetry::sdk::trace::SamplingResult ShouldSample(
+    const opentelemetry::trace::SpanContext& parentContext,
+    opentelemetry::trace::TraceId traceId, opentelemetry::nostd::string_view name,
+    opentelemetry::trace::SpanKind spanKind,
+    const opentelemetry::common::KeyValueIterable& attributes,
+    const opentelemetry::trace::SpanContextKeyValueIterable& links) noexcept override;
+
+  opentelemetry::nostd::string_view GetDescription() const noexcept override;
+
+private:
+  std::unique_ptr<opentelemetry::sdk::trace::Sampler> delegate_;
+};
+
+/* Counts the decisions of the delegate, which is asked once for every span started. */
+class CountingSampler final : public opentelemetry::sdk::trace::Sampler {
+public:
+  CountingSampler(
+    std::unique_ptr<opentelemetry::sdk::trace::Sampler> delegate,
+    std::shared_ptr<PipelineCounters> counters);
+
+  opentelemetry::sdk::trace::SamplingResult ShouldSample(
+    const opentelemetry::trace::SpanContext& parentContext,
+    opentelemetry::trace::TraceId traceId, opentelemetry::nostd::string_view name,
+    opentelemetry::trace::SpanKind spanKind,
+    const opentelemetry::common::KeyValueIterable& attributes,
+    const opentelemetry::trace::SpanContextKeyValueIterable& links) noexcept override;
+
+  opentelemetry::nostd::string_view GetDescription() const noexcept override;
+
+private:
+  std::unique_ptr<opentelemetry::sdk::trace::Sampler> delegate_;
+  std::shared_ptr<PipelineCounters> counters_;
+};
+
+} // namespace splunk
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace splunk {
+
+/*
+ * Vector which keeps its first InlineCapacity elements inside the object and only moves them
+ * to the heap once it grows past that. Elements stay contiguous and in insertion order. Only
+ * what the recordables need is implemented: appending, indexing and clearing.
+ */
+template <typename T, size_t InlineCapacity>
+class SmallVector {
+public:
+  SmallVector() noexcept : data_(InlineData()), capacity_(InlineCapacity) {}
+
+  SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+    : SmallVector() {
+    MoveFrom(other);
+  }
+
+  SmallVector& operator=(SmallVector&& other) noexcept(
+    std::is_nothrow_move_constructible<T>::value) {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+
+    return *this;
+  }
+
+  SmallVector(const SmallVector&) = delete;
+  SmallVector& operator=(const SmallVector&) = delete;
+
+  ~SmallVector() { Reset(); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      Grow();
+    }
+
+    T* element = new (data_ + size_) T(std::forward<Args>(args)...);
+    size_++;
+    return *element;
+  }
+
+  void push_back(T value) { emplace_back(std::move(value)); }
+
+  void clear() noexcept {
+    for (size_t i = 0; i < size_; i++) {
+      data_[i].~T();
+    }
+
+    size_ = 0;
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  size_t capacity() const noexcept { return capacity_; }
+  bool IsInline() const noexcept { return data_ == InlineData(); }
+
+  T& operator[](size_t i) noexcept { return data_[i]; }
+  const T& operator[](size_t i) const noexcept { return data_[i]; }
+
+  T* begin() noexcept { return data_; }
+  T* end() noexcept { return data_ + size_; }
+  const T* begin() const noexcept { return data_; }
+  const T* end() const noexcept { return data_ + size_; }
+
+private:
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+  T* InlineData() noexcept { return reinterpret_cast<T*>(inline_); }
+  const T* InlineData() const noexcept { return reinterpret_cast<const T*>(inline_); }
+
+  void Grow() {
+    size_t capacity = capacity_ ? capacity_ * 2 : 4;
+    T* data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+
+    for (size_t i = 0; i < size_; i++) {
+      new (data + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+
+    if (!IsInline()) {
+      ::operator delete(data_);
+    }
+
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  void MoveFrom(SmallVector& other) {
+    if (!other.IsInline()) {
+      /* Heap storage changes owner, elements stay where they are. */
+      data_ = other.data_;
+      size_ = other.size_;
+      capacity_ = other.capacity_;
+      other.data_ = other.InlineData();
+      other.size_ = 0;
+      other.capacity_ = InlineCapacity;
+      return;
+    }
+
+    for (size_t i = 0; i < other.size_; i++) {
+      new (data_ + i) T(std::move(other.data_[i]));
+    }
+
+    size_ = other.size_;
+    other.clear();
+  }
+
+  void Reset() noexcept {
+    clear();
+
+    if (!IsInline()) {
+      ::operator delete(data_);
+      data_ = InlineData();
+      capacity_ = InlineCapacity;
+    }
+  }
+
+  /* At least one slot so the array is valid, unused when InlineCapacity is 0. */
+  Slot inline_[InlineCapacity ? InlineCapacity : 1];
+  T* data_;
+  size_t size_ = 0;
+  size_t capacity_;
+};
+
+} // namespace splunk
@@ -0,0 +1,342 @@
+#include "span_clock.h"
+
+#include <splunk/clock.h>
+
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace common = opentelemetry::common;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+#if defined(__x86_64__)
+
+bool HasInvariantTsc() {
+  unsigned int eax, ebx, ecx, edx;
+  /* CPUID.80000007H:EDX[8], the counter runs at the same rate in all P-, C- and T-states. */
+  return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+}
+
+uint64_t ReadTsc() { return __rdtsc(); }
+
+#elif defined(__aarch64__)
+
+/* The generic timer's virtual counter always runs at a fixed frequency. */
+bool HasInvariantTsc() { return true; }
+
+uint64_t ReadTsc() {
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+}
+
+#else
+
+bool HasInvariantTsc() { return false; }
+
+uint64_t ReadTsc() { return 0; }
+
+#endif
+
+int64_t ReadNanos(clockid_t id) {
+  timespec ts;
+  clock_gettime(id, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+const int64_t kRecalibrateNanos = 1000000000;
+/* Steady time is slewed by at most 1ms per recalibration, 0.1% of its rate. */
+const int64_t kMaxSlewNanos = kRecalibrateNanos / 1000;
+
+/*
+ * Converts counter ticks to nanoseconds as anchor + (ticks - anchor ticks) * scale / 2^32.
+ * The anchor is published through a seqlock so readers never block. The first reader finding
+ * it older than a second recalibrates against the kernel clocks: system time is re-anchored
+ * to CLOCK_REALTIME, steady time stays continuous and its rate is adjusted to converge on
+ * CLOCK_MONOTONIC, so spans ending across a recalibration don't see it jump.
+ */
+class TscClock {
+public:
+  /* Measures the counter frequency, false when the counter is unusable. */
+  bool Calibrate();
+  ClockReading Read();
+
+private:
+  struct Anchor {
+    uint64_t ticks;
+    int64_t systemNanos;
+    int64_t steadyNanos;
+    uint64_t scale;
+  };
+
+  struct Sample {
+    uint64_t ticks;
+    int64_t systemNanos;
+    int64_t steadyNanos;
+  };
+
+  static Sample TakeSample();
+  static int64_t Elapsed(const Anchor& anchor, uint64_t ticks);
+
+  Anchor Load() const;
+  void Store(const Anchor& anchor);
+  void Lock();
+  void Unlock() { recalibrating_.store(false, std::memory_order_release); }
+  /* Called with recalibrating_ held. */
+  void Recalibrate();
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> ticks_{0};
+  std::atomic<int64_t> systemNanos_{0};
+  std::atomic<int64_t> steadyNanos_{0};
+  std::atomic<uint64_t> scale_{0};
+  std::atomic<uint64_t> recalibrateAt_{UINT64_MAX};
+  std::atomic<bool> recalibrating_{false};
+
+  /* Guarded by recalibrating_, the kernel clocks at the last calibration. */
+  Sample last_{};
+};
+
+TscClock::Sample TscClock::TakeSample() {
+  uint64_t before = ReadTsc();
+  int64_t steadyNanos = ReadNanos(CLOCK_MONOTONIC);
+  int64_t systemNanos = ReadNanos(CLOCK_REALTIME);
+  uint64_t after = ReadTsc();
+  return Sample{before + (after - before) / 2, systemNanos, steadyNanos};
+}
+
+int64_t TscClock::Elapsed(const Anchor& anchor, uint64_t ticks) {
+  /* Negative only if the counters of two cores disagree. */
+  int64_t delta = static_cast<int64_t>(ticks - anchor.ticks);
+  uint64_t magnitude = static_cast<uint64_t>(delta < 0 ? -delta : delta);
+  int64_t nanos =
+    static_cast<int64_t>((static_cast<unsigned __int128>(magnitude) * anchor.scale) >> 32);
+  return delta < 0 ? -nanos : nanos;
+}
+
+TscClock::Anchor TscClock::Load() const {
+  Anchor anchor;
+  uint32_t sequence;
+
+  do {
+    sequence = sequence_.load(std::memory_order_acquire);
+    anchor.ticks = ticks_.load(std::memory_order_relaxed);
+    anchor.systemNanos = systemNanos_.load(std::memory_order_relaxed);
+    anchor.steadyNanos = steadyNanos_.load(std::memory_order_relaxed);
+    anchor.scale = scale_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) || sequence != sequence_.load(std::memory_order_relaxed));
+
+  return anchor;
+}
+
+void TscClock::Store(const Anchor& anchor) {
+  uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  ticks_.store(anchor.ticks, std::memory_order_relaxed);
+  systemNanos_.store(anchor.systemNanos, std::memory_order_relaxed);
+  steadyNanos_.store(anchor.steadyNanos, std::memory_order_relaxed);
+  scale_.store(anchor.scale, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void TscClock::Lock() {
+  while (recalibrating_.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+bool TscClock::Calibrate() {
+  if (!HasInvariantTsc()) {
+    return false;
+  }
+
+  Sample first = TakeSample();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  Sample second = TakeSample();
+
+  if (second.ticks <= first.ticks || second.steadyNanos <= first.steadyNanos) {
+    return false;
+  }
+
+  uint64_t scale = static_cast<uint64_t>(
+    (static_cast<unsigned __int128>(second.steadyNanos - first.steadyNanos) << 32) /
+    (second.ticks - first.ticks));
+
+  if (scale == 0) {
+    return false;
+  }
+
+  Lock();
+  Store(Anchor{second.ticks, second.systemNanos, second.steadyNanos, scale});
+  last_ = second;
+  recalibrateAt_.store(
+    second.ticks + (static_cast<uint64_t>(kRecalibrateNanos) << 32) / scale,
+    std::memory_order_relaxed);
+  Unlock();
+  return true;
+}
+
+void TscClock::Recalibrate() {
+  Sample now = TakeSample();
+  Anchor current = Load();
+  int64_t steadyNanos = current.steadyNanos + Elapsed(current, now.ticks);
+  int64_t offset = now.steadyNanos - steadyNanos;
+  uint64_t scale = current.scale;
+
+  if (now.ticks <= last_.ticks || offset > kRecalibrateNanos || offset < -kRecalibrateNanos) {
+    /* The counter was reset or jumped, e.g. on VM migration: start over from the kernel. */
+    steadyNanos = now.steadyNanos;
+  } else if (now.steadyNanos > last_.steadyNanos) {
+    uint64_t measured = static_cast<uint64_t>(
+      (static_cast<unsigned __int128>(now.steadyNanos - last_.steadyNanos) << 32) /
+      (now.ticks - last_.ticks));
+    int64_t slew = offset > kMaxSlewNanos ? kMaxSlewNanos
+                                          : (offset < -kMaxSlewNanos ? -kMaxSlewNanos : offset);
+    scale = static_cast<uint64_t>(
+      static_cast<int64_t>(measured) +
+      static_cast<int64_t>(measured) * slew / kRecalibrateNanos);
+  }
+
+  Store(Anchor{now.ticks, now.systemNanos, steadyNanos, scale});
+  last_ = now;
+  recalibrateAt_.store(
+    now.ticks + (static_cast<uint64_t>(kRecalibrateNanos) << 32) / scale,
+    std::memory_order_relaxed);
+}
+
+ClockReading TscClock::Read() {
+  /*
+   * The anchor is loaded first so it is never newer than ticks. A thread preempted in between
+   * keeps converting with the previous rate instead of extrapolating a newer anchor backwards.
+   */
+  Anchor anchor = Load();
+  uint64_t ticks = ReadTsc();
+
+  if (ticks >= recalibrateAt_.load(std::memory_order_relaxed) &&
+      !recalibrating_.exchange(true, std::memory_order_acquire)) {
+    Recalibrate();
+    Unlock();
+  }
+
+  int64_t elapsed = Elapsed(anchor, ticks);
+  return ClockReading{anchor.systemNanos + elapsed, anchor.steadyNanos + elapsed};
+}
+
+/* Leaked, spans may end while static destructors run. */
+TscClock& GetTscClock() {
+  static TscClock* clock = new TscClock();
+  return *clock;
+}
+
+#endif
+
+std::atomic<SpanClock> installedClock{SpanClock_Default};
+
+common::SystemTimestamp SystemTime(int64_t nanos) {
+  return common::SystemTimestamp(std::chrono::system_clock::time_point(
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::nanoseconds(nanos))));
+}
+
+common::SteadyTimestamp SteadyTime(int64_t nanos) {
+  return common::SteadyTimestamp(std::chrono::steady_clock::time_point(
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::nanoseconds(nanos))));
+}
+
+} // namespace
+
+SpanClock InstallSpanClock(SpanClock clock) {
+  if (clock == SpanClock_Tsc) {
+#if defined(__x86_64__) || defined(__aarch64__)
+    if (!GetTscClock().Calibrate()) {
+      clock = SpanClock_Default;
+    }
+#else
+    clock = SpanClock_Default;
+#endif
+  }
+
+#ifndef CLOCK_MONOTONIC_COARSE
+  if (clock == SpanClock_Coarse) {
+    clock = SpanClock_Default;
+  }
+#endif
+
+  installedClock.store(clock, std::memory_order_relaxed);
+  return clock;
+}
+
+SpanClock InstalledSpanClock() { return installedClock.load(std::memory_order_relaxed); }
+
+ClockReading ReadSpanClock() {
+  switch (InstalledSpanClock()) {
+  case SpanClock_Tsc:
+    return ReadTscClock();
+  case SpanClock_Coarse:
+    return ReadCoarseClock();
+  default:
+    return ReadDefaultClock();
+  }
+}
+
+ClockReading ReadDefaultClock() {
+  return ClockReading{
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch())
+      .count(),
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count()};
+}
+
+ClockReading ReadTscClock() {
+#if defined(__x86_64__) || defined(__aarch64__)
+  return GetTscClock().Read();
+#else
+  return ReadDefaultClock();
+#endif
+}
+
+ClockReading ReadCoarseClock() {
+#ifdef CLOCK_MONOTONIC_COARSE
+  return ClockReading{ReadNanos(CLOCK_REALTIME_COARSE), ReadNanos(CLOCK_MONOTONIC_COARSE)};
+#else
+  return ReadDefaultClock();
+#endif
+}
+
+void SetStartTime(trace::StartSpanOptions& options) noexcept {
+  if (InstalledSpanClock() == SpanClock_Default) {
+    return;
+  }
+
+  ClockReading now = ReadSpanClock();
+  options.start_system_time = SystemTime(now.systemNanos);
+  options.start_steady_time = SteadyTime(now.steadyNanos);
+}
+
+void SetEndTime(trace::EndSpanOptions& options) noexcept {
+  if (InstalledSpanClock() == SpanClock_Default) {
+    return;
+  }
+
+  options.end_steady_time = SteadyTime(ReadSpanClock().steadyNanos);
+}
+
+} // namespace splunk
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <splunk/opentelemetry.h>
+
+#include <cstdint>
+
+namespace splunk {
+
+/* Nanoseconds since the epoch of std::chrono::system_clock and std::chrono::steady_clock. */
+struct ClockReading {
+  int64_t systemNanos;
+  int64_t steadyNanos;
+};
+
+/*
+ * Selects the clock read by SetStartTime and SetEndTime. The TSC clock is calibrated first,
+ * which blocks for about 10ms. Returns the clock installed, SpanClock_Default when the
+ * requested one isn't available on this machine.
+ */
+SpanClock InstallSpanClock(SpanClock clock);
+
+SpanClock InstalledSpanClock();
+
+ClockReading ReadSpanClock();
+
+/* The clocks themselves, for benchmarks. ReadTscClock requires InstallSpanClock(SpanClock_Tsc). */
+ClockReading ReadDefaultClock();
+ClockReading ReadTscClock();
+ClockReading ReadCoarseClock();
+
+} // namespace splunk
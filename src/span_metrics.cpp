@@ -0,0 +1,341 @@
+#include "span_metrics.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace proto = opentelemetry::proto;
+namespace trace = opentelemetry::trace;
+
+namespace splunk {
+
+namespace {
+
+const size_t kSlotBits = 11;
+const size_t kSlots = size_t(1) << kSlotBits;
+const size_t kMaxShards = 16;
+
+/*
+ * Bucket i < 4 counts durations of i nanoseconds. Above, each power of two is split into 4
+ * buckets by the two bits after the most significant one. Durations of 2^42ns (73 minutes)
+ * and more share the last bucket.
+ */
+const int kSubBucketBits = 2;
+const size_t kSubBuckets = size_t(1) << kSubBucketBits;
+const int kMaxExponent = 42;
+const size_t kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+size_t BucketIndex(uint64_t nanos) {
+  if (nanos < kSubBuckets) {
+    return static_cast<size_t>(nanos);
+  }
+
+  int msb = 63 - __builtin_clzll(nanos);
+
+  if (msb >= kMaxExponent) {
+    return kBucketCount - 1;
+  }
+
+  int shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((nanos >> shift) & (kSubBuckets - 1));
+}
+
+/* Smallest duration counted in bucket index. */
+uint64_t BucketLowerBound(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  return (kSubBuckets + index % kSubBuckets) << (index / kSubBuckets - 1);
+}
+
+uint64_t SeriesKey(uint32_t nameId, trace::SpanKind kind, trace::StatusCode status) {
+  return (static_cast<uint64_t>(nameId) << 32) | (static_cast<uint64_t>(kind) << 16) |
+         (static_cast<uint64_t>(status) << 8) | 1;
+}
+
+/* Values of the spanmetrics connector of the OpenTelemetry Collector. */
+const char* KindName(trace::SpanKind kind) {
+  switch (kind) {
+  case trace::SpanKind::kServer:
+    return "SPAN_KIND_SERVER";
+  case trace::SpanKind::kClient:
+    return "SPAN_KIND_CLIENT";
+  case trace::SpanKind::kProducer:
+    return "SPAN_KIND_PRODUCER";
+  case trace::SpanKind::kConsumer:
+    return "SPAN_KIND_CONSUMER";
+  default:
+    return "SPAN_KIND_INTERNAL";
+  }
+}
+
+const char* StatusName(trace::StatusCode status) {
+  switch (status) {
+  case trace::StatusCode::kOk:
+    return "STATUS_CODE_OK";
+  case trace::StatusCode::kError:
+    return "STATUS_CODE_ERROR";
+  default:
+    return "STATUS_CODE_UNSET";
+  }
+}
+
+void AddAttribute(
+  google::protobuf::RepeatedPtrField<proto::common::v1::KeyValue>* attributes,
+  const std::string& key, opentelemetry::nostd::string_view value) {
+  proto::common::v1::KeyValue* keyValue = attributes->Add();
+  keyValue->set_key(key);
+  keyValue->mutable_value()->set_string_value(value.data(), value.size());
+}
+
+} // namespace
+
+struct SpanMetricsAggregator::Shard {
+  std::atomic<uint64_t> buckets[kBucketCount];
+  std::atomic<uint64_t> sumNanos;
+
+  void Clear() {
+    for (auto& bucket : buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+
+    sumNanos.store(0, std::memory_order_relaxed);
+  }
+};
+
+struct SpanMetricsAggregator::Series {
+  /* Allocated by the first span recorded from each cell, never freed before the aggregator. */
+  std::atomic<Shard*> shards[kMaxShards];
+};
+
+SpanMetricsAggregator::SpanMetricsAggregator(std::string serviceName)
+  : serviceName_(std::move(serviceName)),
+    shardMask_([] {
+      size_t count = 1;
+
+      while (count < kMaxShards && count < std::thread::hardware_concurrency()) {
+        count *= 2;
+      }
+
+      return count - 1;
+    }()),
+    keys_(new std::atomic<uint64_t>[kSlots]), series_(new Series[kSlots + 1]) {
+  for (size_t i = 0; i < kSlots; i++) {
+    keys_[i].store(0, std::memory_order_relaxed);
+  }
+
+  for (size_t i = 0; i <= kSlots; i++) {
+    for (auto& shard : series_[i].shards) {
+      shard.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+SpanMetricsAggregator::~SpanMetricsAggregator() {
+  for (size_t i = 0; i <= kSlots; i++) {
+    for (auto& shard : series_[i].shards) {
+      delete shard.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void SpanMetricsAggregator::Record(const SpanSummary& span) noexcept {
+  Series* series = span.nameId == InternTable::kNotInterned
+                     ? &series_[kSlots]
+                     : FindSeries(SeriesKey(span.nameId, span.kind, span.status));
+  Shard* shard = GetShard(*series);
+
+  if (!shard) {
+    return;
+  }
+
+  uint64_t nanos = span.duration.count() > 0 ? static_cast<uint64_t>(span.duration.count()) : 0;
+  shard->buckets[BucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+  shard->sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+SpanMetricsAggregator::Series* SpanMetricsAggregator::FindSeries(uint64_t key) noexcept {
+  size_t slot = static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> (64 - kSlotBits));
+
+  for (size_t probe = 0; probe < kSlots; probe++, slot = (slot + 1) & (kSlots - 1)) {
+    uint64_t current = keys_[slot].load(std::memory_order_acquire);
+
+    if (current == key) {
+      return &series_[slot];
+    }
+
+    if (current != 0) {
+      continue;
+    }
+
+    /* The key isn't in the table, the first free slot ends the probe. */
+    if (seriesCount_.load(std::memory_order_relaxed) >= kMaxSeries) {
+      break;
+    }
+
+    if (keys_[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      seriesCount_.fetch_add(1, std::memory_order_relaxed);
+      return &series_[slot];
+    }
+
+    if (current == key) {
+      return &series_[slot];
+    }
+  }
+
+  return &series_[kSlots];
+}
+
+SpanMetricsAggregator::Shard* SpanMetricsAggregator::GetShard(Series& series) noexcept {
+  std::atomic<Shard*>& entry = series.shards[ThreadCell() & shardMask_];
+  Shard* shard = entry.load(std::memory_order_acquire);
+
+  if (shard) {
+    return shard;
+  }
+
+  Shard* created = new (std::nothrow) Shard();
+
+  if (!created) {
+    return nullptr;
+  }
+
+  created->Clear();
+
+  if (entry.compare_exchange_strong(shard, created, std::memory_order_acq_rel)) {
+    return created;
+  }
+
+  delete created;
+  return shard;
+}
+
+void SpanMetricsAggregator::Collect(
+  uint64_t startNanos, uint64_t nowNanos, proto::metrics::v1::ResourceMetrics* metrics) {
+  proto::metrics::v1::Metric* calls = nullptr;
+  proto::metrics::v1::Metric* duration = nullptr;
+  std::vector<uint64_t> counts(kBucketCount);
+
+  for (size_t slot = 0; slot <= kSlots; slot++) {
+    uint64_t key = slot < kSlots ? keys_[slot].load(std::memory_order_acquire) : 0;
+
+    if (slot < kSlots && key == 0) {
+      continue;
+    }
+
+    std::fill(counts.begin(), counts.end(), 0);
+    uint64_t count = 0;
+    uint64_t sumNanos = 0;
+
+    for (auto& entry : series_[slot].shards) {
+      const Shard* shard = entry.load(std::memory_order_acquire);
+
+      if (!shard) {
+        continue;
+      }
+
+      for (size_t i = 0; i < kBucketCount; i++) {
+        uint64_t n = shard->buckets[i].load(std::memory_order_relaxed);
+        counts[i] += n;
+        count += n;
+      }
+
+      sumNanos += shard->sumNanos.load(std::memory_order_relaxed);
+    }
+
+    if (count == 0) {
+      continue;
+    }
+
+    if (!calls) {
+      auto* library = metrics->add_instrumentation_library_metrics();
+      library->mutable_instrumentation_library()->set_name("splunk.span_metrics");
+
+      calls = library->add_metrics();
+      calls->set_name("traces.span.metrics.calls");
+      calls->set_description("Spans ended, sampled or not");
+      calls->set_unit("1");
+      calls->mutable_sum()->set_aggregation_temporality(
+        proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+      calls->mutable_sum()->set_is_monotonic(true);
+
+      duration = library->add_metrics();
+      duration->set_name("traces.span.metrics.duration");
+      duration->set_description("Duration of spans, sampled or not");
+      duration->set_unit("ms");
+      duration->mutable_histogram()->set_aggregation_temporality(
+        proto::metrics::v1::AGGREGATION_TEMPORALITY_CUMULATIVE);
+    }
+
+    proto::metrics::v1::NumberDataPoint* callsPoint = calls->mutable_sum()->add_data_points();
+    AddAttribute(callsPoint->mutable_attributes(), "service.name", serviceName_);
+
+    if (slot < kSlots) {
+      AddAttribute(
+        callsPoint->mutable_attributes(), "span.name",
+        InternTable::Names().Get(static_cast<uint32_t>(key >> 32)));
+      AddAttribute(
+        callsPoint->mutable_attributes(), "span.kind",
+        KindName(static_cast<trace::SpanKind>((key >> 16) & 0xff)));
+      AddAttribute(
+        callsPoint->mutable_attributes(), "status.code",
+        StatusName(static_cast<trace::StatusCode>((key >> 8) & 0xff)));
+    } else {
+      AddAttribute(callsPoint->mutable_attributes(), "otel.metric.overflow", "true");
+    }
+
+    callsPoint->set_start_time_unix_nano(startNanos);
+    callsPoint->set_time_unix_nano(nowNanos);
+    callsPoint->set_as_int(static_cast<int64_t>(count));
+
+    proto::metrics::v1::HistogramDataPoint* durationPoint =
+      duration->mutable_histogram()->add_data_points();
+    *durationPoint->mutable_attributes() = callsPoint->attributes();
+    durationPoint->set_start_time_unix_nano(startNanos);
+    durationPoint->set_time_unix_nano(nowNanos);
+    durationPoint->set_count(count);
+    durationPoint->set_sum(static_cast<double>(sumNanos) / 1e6);
+
+    /* Only the range of non-empty buckets, between two empty open ended ones. */
+    size_t first = 0;
+    size_t last = kBucketCount - 1;
+
+    while (counts[first] == 0) {
+      first++;
+    }
+
+    while (counts[last] == 0) {
+      last--;
+    }
+
+    durationPoint->add_bucket_counts(0);
+    durationPoint->add_explicit_bounds(static_cast<double>(BucketLowerBound(first)) / 1e6);
+
+    for (size_t i = first; i <= last; i++) {
+      durationPoint->add_bucket_counts(counts[i]);
+
+      if (i + 1 < kBucketCount) {
+        durationPoint->add_explicit_bounds(static_cast<double>(BucketLowerBound(i + 1)) / 1e6);
+      }
+    }
+
+    if (last + 1 < kBucketCount) {
+      durationPoint->add_bucket_counts(0);
+    }
+  }
+}
+
+void SpanMetricsAggregator::Reset() {
+  for (size_t i = 0; i <= kSlots; i++) {
+    for (auto& entry : series_[i].shards) {
+      if (Shard* shard = entry.load(std::memory_order_acquire)) {
+        shard->Clear();
+      }
+    }
+  }
+}
+
+} // namespace splunk
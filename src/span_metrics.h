@@ -0,0 +1,75 @@
+#pragma once
+
+#include "intern_table.h"
+#include "metrics.h"
+
+#include <opentelemetry/nostd/string_view.h>
+#include <opentelemetry/trace/span_id.h>
+#include <opentelemetry/trace/span_metadata.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace splunk {
+
+/*
+ * What span metrics and the allocation sampler need of an ended span, name is only valid until
+ * the span is released.
+ */
+struct SpanSummary {
+  opentelemetry::nostd::string_view name;
+  /* Id of name in InternTable::Names(), kNotInterned when the table couldn't take it. */
+  uint32_t nameId;
+  opentelemetry::trace::SpanKind kind;
+  opentelemetry::trace::StatusCode status;
+  std::chrono::nanoseconds duration;
+  bool sampled;
+  opentelemetry::trace::SpanId spanId;
+};
+
+/*
+ * Request rate, error rate and duration of every span, sampled or not, per span name, kind and
+ * status. Each series keeps a log-linear histogram of durations with 4 buckets per power of two
+ * (at most 25% wide) in shards allocated on first use by the threads of each cell, so Record
+ * takes no lock and threads on different cells never share a cache line.
+ *
+ * Series are found by a lock-free open addressed lookup of the interned span name. Past
+ * kMaxSeries series, and for names the intern table couldn't take, spans are counted in a
+ * single overflow series.
+ */
+class SpanMetricsAggregator final : public MetricProducer {
+public:
+  static const size_t kMaxSeries = 1024;
+
+  explicit SpanMetricsAggregator(std::string serviceName);
+  ~SpanMetricsAggregator() override;
+
+  void Record(const SpanSummary& span) noexcept;
+
+  /* Emits the series as a calls sum and a duration histogram in milliseconds. */
+  void Collect(
+    uint64_t startNanos, uint64_t nowNanos,
+    opentelemetry::proto::metrics::v1::ResourceMetrics* metrics) override;
+  void Reset() override;
+
+private:
+  struct Shard;
+  struct Series;
+
+  Series* FindSeries(uint64_t key) noexcept;
+  Shard* GetShard(Series& series) noexcept;
+
+  const std::string serviceName_;
+  const size_t shardMask_;
+  /* Packed name id, kind and status of each slot's series, 0 for free slots. */
+  std::unique_ptr<std::atomic<uint64_t>[]> keys_;
+  /* One per slot plus the overflow series at the end. */
+  std::unique_ptr<Series[]> series_;
+  std::atomic<size_t> seriesCount_{0};
+};
+
+} // namespace splunk
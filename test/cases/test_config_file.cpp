@@ -0,0 +1,59 @@
+#include <opentelemetry/sdk/resource/resource.h>
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace sdkresource = opentelemetry::sdk::resource;
+
+const char* kConfig = R"({
+  "service_name": "Config File Service",
+  "resource_attributes": {
+    "deployment.environment": "Test Env"
+  },
+  "sampler": { "ratio": 1.0 },
+  "batch": { "max_queue_size": 128, "schedule_delay_millis": 100, "max_export_batch_size": 16 },
+  "reload_interval_millis": 100
+})";
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  char configPath[] = "/tmp/splunk-otel-config-XXXXXX";
+  int fd = mkstemp(configPath);
+  FILE* configFile = fdopen(fd, "w");
+  fputs(kConfig, configFile);
+  fclose(configFile);
+
+  auto verification = VerifyBegin(argv[1]);
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions().WithServiceVersion("1.7").WithConfigFile(configPath);
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span =
+    tracer->StartSpan("config-file-span");
+
+  span->End();
+
+  provider.Flush(std::chrono::seconds(1));
+
+  auto resource = sdkresource::Resource::Create({
+    {"service.name", "Config File Service"},
+    {"service.version", "1.7"},
+    {"deployment.environment", "Test Env"},
+  });
+  verification.resource = &resource;
+  verification.spans = {span.get()};
+
+  VerifyTraces(verification);
+
+  remove(configPath);
+
+  return 0;
+}
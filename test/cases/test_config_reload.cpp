@@ -0,0 +1,100 @@
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+const char* kSampledConfig = R"({ "sampler": { "ratio": 1.0 }, "reload_interval_millis": 20 })";
+const char* kUnsampledConfig = R"({ "sampler": { "ratio": 0.0 }, "reload_interval_millis": 20 })";
+const char* kInvalidConfig = R"({ "sampler": { "ratio": )";
+
+/* Written aside and renamed, so the watcher never reads a partial file. */
+bool WriteConfig(const std::string& path, const char* config) {
+  std::string tempPath = path + ".tmp";
+  FILE* file = fopen(tempPath.c_str(), "w");
+
+  if (!file) {
+    return false;
+  }
+
+  bool written = fputs(config, file) >= 0;
+  written = fclose(file) == 0 && written;
+  return written && rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool StartsSampled(opentelemetry::trace::Tracer& tracer) {
+  auto span = tracer.StartSpan("reload-span");
+  bool sampled = span->GetContext().IsSampled();
+  span->End();
+  return sampled;
+}
+
+/* Returns whether new spans were sampled as expected before the timeout. */
+bool WaitForSampling(opentelemetry::trace::Tracer& tracer, bool sampled) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (StartsSampled(tracer) == sampled) {
+      return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  return false;
+}
+
+int main(int argc, char** argv) {
+  char configPath[] = "/tmp/splunk-otel-reload-XXXXXX";
+  close(mkstemp(configPath));
+
+  if (!WriteConfig(configPath, kSampledConfig)) {
+    fprintf(stderr, "Failed to write the config file\n");
+    return 1;
+  }
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("reload-service").WithConfigFile(configPath));
+  auto tracer = provider->GetTracer("sample");
+  int status = 0;
+
+  if (!StartsSampled(*tracer)) {
+    fprintf(stderr, "Spans are not sampled with the initial config\n");
+    status = 1;
+  }
+
+  /* A rewrite after Init takes effect once the watcher reloads the file. */
+  if (status == 0 &&
+      (!WriteConfig(configPath, kUnsampledConfig) || !WaitForSampling(*tracer, false))) {
+    fprintf(stderr, "The new sampler ratio was not applied\n");
+    status = 1;
+  }
+
+  /* An invalid rewrite is ignored, the last valid settings stay in effect. */
+  if (status == 0 && WriteConfig(configPath, kInvalidConfig)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < 100 && status == 0; i++) {
+      if (StartsSampled(*tracer)) {
+        fprintf(stderr, "An invalid config replaced the previous settings\n");
+        status = 1;
+      }
+    }
+  }
+
+  /* Fixing the file is picked up again. */
+  if (status == 0 &&
+      (!WriteConfig(configPath, kSampledConfig) || !WaitForSampling(*tracer, true))) {
+    fprintf(stderr, "The config was not reloaded after an invalid rewrite\n");
+    status = 1;
+  }
+
+  provider.Shutdown(std::chrono::seconds(1));
+  remove(configPath);
+
+  return status;
+}
@@ -0,0 +1,70 @@
+#include <splunk/context.h>
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+#include <thread>
+
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+bool IsCurrent(const nostd::shared_ptr<trace::Tracer>& tracer, const trace::Span& span) {
+  return tracer->GetCurrentSpan()->GetContext().span_id() == span.GetContext().span_id();
+}
+
+int main(int argc, char** argv) {
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("context-service"));
+  auto tracer = provider->GetTracer("sample");
+
+  auto outer = tracer->StartSpan("outer");
+  auto inner = tracer->StartSpan("inner");
+
+  {
+    splunk::ContextScope outerScope(outer);
+
+    /* Deeper than the preallocated slots, mixed with the regular API. */
+    for (int i = 0; i < 100; i++) {
+      splunk::ContextScope scope(inner);
+      auto token = opentelemetry::context::RuntimeContext::Attach(
+        opentelemetry::context::RuntimeContext::GetCurrent());
+      opentelemetry::context::RuntimeContext::Detach(*token);
+    }
+
+    if (!IsCurrent(tracer, *outer)) {
+      fprintf(stderr, "Outer span is not current after nested scopes\n");
+      return 1;
+    }
+
+    {
+      auto scope = tracer->WithActiveSpan(inner);
+      splunk::ContextScope nested(outer);
+
+      if (!IsCurrent(tracer, *outer)) {
+        fprintf(stderr, "Nested scope is not current\n");
+        return 1;
+      }
+    }
+
+    /* Context is thread-local, other threads don't see the scope. */
+    bool otherThreadHasSpan = true;
+    std::thread([&] { otherThreadHasSpan = tracer->GetCurrentSpan()->GetContext().IsValid(); })
+      .join();
+
+    if (otherThreadHasSpan) {
+      fprintf(stderr, "Scope leaked into another thread\n");
+      return 1;
+    }
+  }
+
+  if (tracer->GetCurrentSpan()->GetContext().IsValid()) {
+    fprintf(stderr, "Span is still current after its scope ended\n");
+    return 1;
+  }
+
+  inner->End();
+  outer->End();
+
+  provider.Shutdown(std::chrono::seconds(1));
+
+  return 0;
+}
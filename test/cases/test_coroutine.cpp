@@ -0,0 +1,102 @@
+#include <splunk/coroutine.h>
+#include <splunk/opentelemetry.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+struct Task {
+  struct promise_type : splunk::ContextPromise {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/* Resumes the coroutine on a new thread, like an I/O completion would. */
+struct ResumeOnNewThread {
+  std::thread* thread;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    *thread = std::thread([handle] { handle.resume(); });
+  }
+  void await_resume() {}
+};
+
+nostd::shared_ptr<trace::Tracer> tracer;
+trace::SpanId parentId;
+trace::SpanId childId;
+int failures = 0;
+
+bool IsCurrent(trace::SpanId id) { return tracer->GetCurrentSpan()->GetContext().span_id() == id; }
+
+Task Handler(std::thread* first, std::thread* second, nostd::shared_ptr<trace::Span> child) {
+  co_await ResumeOnNewThread{first};
+
+  if (!IsCurrent(parentId)) {
+    fprintf(stderr, "Parent span lost after the first hop\n");
+    failures++;
+  }
+
+  co_await splunk::ActivateSpan{child};
+  co_await ResumeOnNewThread{second};
+
+  if (!IsCurrent(childId)) {
+    fprintf(stderr, "Child span lost after the second hop\n");
+    failures++;
+  }
+}
+
+int main(int argc, char** argv) {
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("coroutine-service"));
+  tracer = provider->GetTracer("sample");
+
+  auto parent = tracer->StartSpan("parent");
+  auto child = tracer->StartSpan("child");
+  parentId = parent->GetContext().span_id();
+  childId = child->GetContext().span_id();
+
+  std::thread first;
+  std::thread second;
+  Task task;
+
+  {
+    splunk::ContextScope scope(parent);
+    task = Handler(&first, &second, child);
+  }
+
+  task.handle.resume();
+
+  /* The coroutine took its context with it when it suspended. */
+  if (tracer->GetCurrentSpan()->GetContext().IsValid()) {
+    fprintf(stderr, "Coroutine context leaked into the resuming thread\n");
+    failures++;
+  }
+
+  first.join();
+  second.join();
+
+  if (!task.handle.done()) {
+    fprintf(stderr, "Coroutine did not finish\n");
+    failures++;
+  }
+
+  task.handle.destroy();
+  child->End();
+  parent->End();
+  provider.Shutdown(std::chrono::seconds(1));
+
+  return failures == 0 ? 0 : 1;
+}
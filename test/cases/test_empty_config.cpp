@@ -1,10 +1,7 @@
-#include <opentelemetry/sdk/trace/tracer_provider.h>
 #include <splunk/opentelemetry.h>
 
 #include "../common/verify.h"
 
-namespace sdktrace = opentelemetry::sdk::trace;
-
 int main(int argc, char** argv) {
   if (argc < 2) {
     return 1;
@@ -21,10 +18,9 @@ int main(int argc, char** argv) {
 
   span->End();
 
-  auto sdkProvider = dynamic_cast<sdktrace::TracerProvider*>(provider.get());
-  sdkProvider->ForceFlush(std::chrono::seconds(1));
+  provider.Flush(std::chrono::seconds(1));
 
-  verification.resource = &sdkProvider->GetResource();
+  verification.resource = &provider.GetResource();
   verification.spans = {span.get()};
 
   VerifyTraces(verification);
@@ -1,10 +1,8 @@
-#include <opentelemetry/sdk/trace/tracer_provider.h>
 #include <opentelemetry/sdk/resource/resource.h>
 #include <splunk/opentelemetry.h>
 
 #include "../common/verify.h"
 
-namespace sdktrace = opentelemetry::sdk::trace;
 namespace sdkresource = opentelemetry::sdk::resource;
 
 int main(int argc, char** argv) {
@@ -23,8 +21,7 @@ int main(int argc, char** argv) {
 
   span->End();
 
-  auto sdkProvider = dynamic_cast<sdktrace::TracerProvider*>(provider.get());
-  sdkProvider->ForceFlush(std::chrono::seconds(1));
+  provider.Flush(std::chrono::seconds(1));
 
   auto resource = sdkresource::Resource::Create({
     { "service.name", "envs" },
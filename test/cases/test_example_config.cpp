@@ -1,10 +1,7 @@
-#include <opentelemetry/sdk/trace/tracer_provider.h>
 #include <splunk/opentelemetry.h>
 
 #include "../common/verify.h"
 
-namespace sdktrace = opentelemetry::sdk::trace;
-
 int main(int argc, char** argv) {
   if (argc < 2) {
     return 1;
@@ -32,10 +29,9 @@ int main(int argc, char** argv) {
   span->End();
   parentSpan->End();
 
-  auto sdkProvider = dynamic_cast<sdktrace::TracerProvider*>(provider.get());
-  sdkProvider->ForceFlush(std::chrono::seconds(1));
+  provider.Flush(std::chrono::seconds(1));
 
-  verification.resource = &sdkProvider->GetResource();
+  verification.resource = &provider.GetResource();
   verification.spans = {span.get(), parentSpan.get()};
 
   VerifyTraces(verification);
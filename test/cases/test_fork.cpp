@@ -0,0 +1,121 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+const int kChildCount = 32;
+const int kThreadsPerChild = 4;
+const size_t kSpansPerThread = 250;
+
+int RunChild(splunk::OpenTelemetryHandle& provider) {
+  auto tracer = provider->GetTracer("child");
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadsPerChild; i++) {
+    threads.emplace_back([&tracer] {
+      for (size_t j = 0; j < kSpansPerThread; j++) {
+        tracer->StartSpan("child-span")->End();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  splunk::FlushResult result = provider.Shutdown(std::chrono::seconds(10));
+  size_t expected = kThreadsPerChild * kSpansPerThread;
+
+  if (!result.completed || result.exportedSpans != expected || result.droppedSpans != 0) {
+    fprintf(
+      stderr, "Child %d: completed=%d exported=%zu dropped=%zu, expected %zu\n", getpid(),
+      result.completed, result.exportedSpans, result.droppedSpans, expected);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  /* Children only check what they handed over, the collector shows what arrived. */
+  TraceVerification verification = VerifyBegin(argv[1]);
+  splunk::ForkMode forkMode = splunk::ForkMode_Reinitialize;
+
+  if (argc > 2 && strcmp(argv[2], "parent") == 0) {
+    forkMode = splunk::ForkMode_ParentExporter;
+  }
+
+  auto provider = splunk::InitOpentelemetry(splunk::OpenTelemetryOptions()
+                                              .WithServiceName("fork-service")
+                                              .WithExporter(splunk::ExporterType_Otlp)
+                                              .WithForkMode(forkMode));
+  auto tracer = provider->GetTracer("parent");
+
+  /* Keeps the parent's queue and exporter busy while the children are forked. */
+  std::atomic<bool> stopLoad(false);
+  std::thread load([&] {
+    while (!stopLoad.load()) {
+      tracer->StartSpan("parent-span")->End();
+    }
+  });
+
+  std::vector<pid_t> children;
+  for (int i = 0; i < kChildCount; i++) {
+    pid_t pid = fork();
+
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+
+    if (pid == 0) {
+      _exit(RunChild(provider));
+    }
+
+    children.push_back(pid);
+  }
+
+  stopLoad.store(true);
+  load.join();
+
+  int failures = 0;
+  for (pid_t child : children) {
+    int status = 0;
+
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failures++;
+    }
+  }
+
+  /* With ForkMode_ParentExporter these include the spans relayed for the children. */
+  splunk::FlushResult result = provider.Shutdown(std::chrono::seconds(10));
+  splunk::PipelineStats stats = provider.GetPipelineStats();
+
+  if (failures > 0) {
+    fprintf(stderr, "%d of %d children failed\n", failures, kChildCount);
+    return 1;
+  }
+
+  if (!result.completed || result.droppedSpans != 0 || stats.spansExportFailed != 0) {
+    fprintf(
+      stderr, "Parent: completed=%d dropped=%zu export failed=%llu\n", result.completed,
+      result.droppedSpans, static_cast<unsigned long long>(stats.spansExportFailed));
+    return 1;
+  }
+
+  VerifySpanCount(verification, "child-span", kChildCount * kThreadsPerChild * kSpansPerThread);
+
+  return 0;
+}
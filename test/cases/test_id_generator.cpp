@@ -0,0 +1,93 @@
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t kThreadCount = 16;
+const size_t kSpansPerThread = 20000;
+
+std::string SpanIdOf(const opentelemetry::trace::Span& span) {
+  auto id = span.GetContext().span_id().Id();
+  return std::string(reinterpret_cast<const char*>(id.data()), id.size());
+}
+
+std::string TraceIdOf(const opentelemetry::trace::Span& span) {
+  auto id = span.GetContext().trace_id().Id();
+  return std::string(reinterpret_cast<const char*>(id.data()), id.size());
+}
+
+int main(int argc, char** argv) {
+  auto provider =
+    splunk::InitOpentelemetry(splunk::OpenTelemetryOptions().WithServiceName("id-service"));
+  auto tracer = provider->GetTracer("sample");
+
+  std::mutex mutex;
+  std::set<std::string> spanIds;
+  std::set<std::string> traceIds;
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < kThreadCount; i++) {
+    threads.emplace_back([&] {
+      std::vector<std::string> threadSpanIds;
+      std::vector<std::string> threadTraceIds;
+
+      for (size_t j = 0; j < kSpansPerThread; j++) {
+        auto span = tracer->StartSpan("root-span");
+        threadSpanIds.push_back(SpanIdOf(*span));
+        threadTraceIds.push_back(TraceIdOf(*span));
+        span->End();
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      spanIds.insert(threadSpanIds.begin(), threadSpanIds.end());
+      traceIds.insert(threadTraceIds.begin(), threadTraceIds.end());
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  printf("IDs: spanIds=%zu traceIds=%zu\n", spanIds.size(), traceIds.size());
+
+  if (spanIds.size() != kThreadCount * kSpansPerThread ||
+      traceIds.size() != kThreadCount * kSpansPerThread) {
+    fprintf(stderr, "Duplicate IDs generated\n");
+    return 1;
+  }
+
+  /* The child must not continue the sequence of the thread which forked. */
+  int fds[2];
+
+  if (pipe(fds) != 0) {
+    return 1;
+  }
+
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    std::string childId = SpanIdOf(*tracer->StartSpan("child-span"));
+    ssize_t written = write(fds[1], childId.data(), childId.size());
+    _exit(written == static_cast<ssize_t>(childId.size()) ? 0 : 1);
+  }
+
+  std::string parentId = SpanIdOf(*tracer->StartSpan("parent-span"));
+  char childId[8];
+  ssize_t received = read(fds[0], childId, sizeof(childId));
+  waitpid(pid, nullptr, 0);
+  provider.Shutdown(std::chrono::seconds(5));
+
+  if (received != sizeof(childId) || parentId == std::string(childId, sizeof(childId))) {
+    fprintf(stderr, "Child of fork generated the parent's span ID\n");
+    return 1;
+  }
+
+  return 0;
+}
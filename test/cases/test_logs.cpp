@@ -0,0 +1,91 @@
+#include <splunk/context.h>
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <stdio.h>
+
+#include <thread>
+
+const int kRecordsInSpan = 10;
+const int kRecordsOutsideSpan = 5;
+
+/* Logs from its destructor, which runs after the one of the thread's log buffer. */
+struct ExitLogger {
+  splunk::Logger* logger = nullptr;
+
+  ~ExitLogger() {
+    if (logger) {
+      logger->Emit(splunk::LogSeverity::Warn, "after thread exit");
+    }
+  }
+};
+
+thread_local ExitLogger exitLogger;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  LogVerification verification = VerifyLogsBegin(argv[1]);
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("logs-service")
+      .WithLogsExporter(splunk::LogsExporter_Otlp)
+      .WithLogScheduleDelay(std::chrono::minutes(10)));
+  auto tracer = provider->GetTracer("sample");
+  splunk::Logger logger = provider.GetLoggerProvider().GetLogger("sample", "1.0");
+
+  if (!logger.IsEnabled(splunk::LogSeverity::Info)) {
+    fprintf(stderr, "Logger is disabled with the OTLP logs exporter\n");
+    return 1;
+  }
+
+  auto span = tracer->StartSpan("logged");
+
+  {
+    splunk::ContextScope scope(span);
+
+    for (int i = 0; i < kRecordsInSpan; i++) {
+      logger.Emit(splunk::LogSeverity::Info, "in span", {{"iteration", "in"}});
+    }
+  }
+
+  span->End();
+
+  for (int i = 0; i < kRecordsOutsideSpan; i++) {
+    logger.Emit(splunk::LogSeverity::Warn, "outside span");
+  }
+
+  /* A record logged after the thread's buffer is gone is dropped. */
+  uint64_t droppedBefore = provider.GetLoggerProvider().DroppedRecords();
+  std::thread([&logger] {
+    exitLogger.logger = &logger;
+    logger.Emit(splunk::LogSeverity::Info, "exiting thread");
+  }).join();
+
+  if (provider.GetLoggerProvider().DroppedRecords() != droppedBefore + 1) {
+    fprintf(stderr, "Record logged after thread exit wasn't dropped\n");
+    return 1;
+  }
+
+  /* The only export is the one on shutdown. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  if (logger.IsEnabled(splunk::LogSeverity::Fatal)) {
+    fprintf(stderr, "Logger is still enabled after shutdown\n");
+    return 1;
+  }
+
+  char traceId[32];
+  span->GetContext().trace_id().ToLowerBase16(traceId);
+
+  verification.records = kRecordsInSpan + kRecordsOutsideSpan + 1;
+  verification.correlatedRecords = kRecordsInSpan;
+  verification.traceId = std::string(traceId, sizeof(traceId));
+  VerifyLogs(verification);
+
+  return 0;
+}
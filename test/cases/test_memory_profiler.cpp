@@ -0,0 +1,58 @@
+#include <splunk/context.h>
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+/* Not inlined, so the profile has a frame of the test's own. */
+__attribute__((noinline)) std::vector<std::unique_ptr<char[]>> Allocate(size_t count) {
+  std::vector<std::unique_ptr<char[]>> kept;
+
+  for (size_t i = 0; i < count; i++) {
+    std::unique_ptr<char[]> bytes(new char[1024]);
+
+    if (i % 16 == 0) {
+      kept.push_back(std::move(bytes));
+    }
+  }
+
+  return kept;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  LogVerification verification = VerifyLogsBegin(argv[1]);
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("memory-profiler-service")
+      .WithMemoryProfiler(splunk::MemoryProfiler_Enabled)
+      .WithMemoryProfilerSampleBytes(4096));
+  auto tracer = provider->GetTracer("sample");
+
+  auto span = tracer->StartSpan("allocating");
+  std::vector<std::unique_ptr<char[]>> kept;
+
+  {
+    splunk::ContextScope scope(span);
+    kept = Allocate(10000);
+  }
+
+  span->End();
+
+  /* The only export is the one on shutdown. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  VerifyProfiles(verification);
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <new>
+
+/*
+ * Built with -fomit-frame-pointer, like most code the memory profiler samples. Such code keeps
+ * anything in the frame pointer register: CallWithFramePointer calls function with the register
+ * holding fp, which here is the first byte of an unreadable page right above the stack of the
+ * allocating thread, within the distance a frame walk accepts.
+ */
+extern "C" void* CallWithFramePointer(void* (*function)(size_t), size_t size, uintptr_t fp);
+
+#if defined(__x86_64__)
+asm(R"(
+  .pushsection .text
+  .p2align 4
+  .type CallWithFramePointer, @function
+CallWithFramePointer:
+  push %rbp
+  mov %rdx, %rbp
+  mov %rdi, %rax
+  mov %rsi, %rdi
+  call *%rax
+  pop %rbp
+  ret
+  .size CallWithFramePointer, .-CallWithFramePointer
+  .popsection
+)");
+#elif defined(__aarch64__)
+asm(R"(
+  .pushsection .text
+  .p2align 4
+  .type CallWithFramePointer, %function
+CallWithFramePointer:
+  stp x29, x30, [sp, #-16]!
+  mov x29, x2
+  mov x3, x0
+  mov x0, x1
+  blr x3
+  ldp x29, x30, [sp], #16
+  ret
+  .size CallWithFramePointer, .-CallWithFramePointer
+  .popsection
+)");
+#else
+extern "C" void* CallWithFramePointer(void* (*function)(size_t), size_t size, uintptr_t) {
+  return function(size);
+}
+#endif
+
+namespace {
+
+const size_t kStackSize = 256 * 1024;
+
+void* Allocate(size_t size) { return ::operator new(size); }
+
+void* AllocateBelowUnreadablePage(void* unreadable) {
+  for (size_t i = 0; i < 10000; i++) {
+    ::operator delete(
+      CallWithFramePointer(Allocate, 1024, reinterpret_cast<uintptr_t>(unreadable)));
+  }
+
+  return nullptr;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  LogVerification verification = VerifyLogsBegin(argv[1]);
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("memory-profiler-frame-pointer-service")
+      .WithMemoryProfiler(splunk::MemoryProfiler_Enabled)
+      .WithMemoryProfilerSampleBytes(4096));
+
+  /* The thread's stack ends where the unreadable page starts. */
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  char* stack = static_cast<char*>(mmap(
+    nullptr, kStackSize + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+    -1, 0));
+
+  if (stack == MAP_FAILED || mprotect(stack + kStackSize, page, PROT_NONE) != 0) {
+    return 1;
+  }
+
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstack(&attributes, stack, kStackSize);
+
+  pthread_t thread;
+
+  if (pthread_create(
+        &thread, &attributes, AllocateBelowUnreadablePage, stack + kStackSize) != 0) {
+    return 1;
+  }
+
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attributes);
+  munmap(stack, kStackSize + page);
+
+  /* Reaching the export means no walk faulted, it has the samples of the thread. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  VerifyProfiles(verification);
+
+  return 0;
+}
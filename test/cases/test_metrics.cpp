@@ -0,0 +1,57 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <thread>
+#include <vector>
+
+const int kThreads = 8;
+const int kIterations = 10000;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  MetricVerification verification = VerifyMetricsBegin(argv[1]);
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("metrics-service")
+      .WithMetricsExporter(splunk::MetricsExporter_Otlp)
+      .WithMetricExportInterval(std::chrono::minutes(10));
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+
+  splunk::Meter meter = provider.GetMeterProvider().GetMeter("sample", "1.0");
+  splunk::Counter requests = meter.CreateCounter("requests", "Requests handled", "1");
+  splunk::Counter errors =
+    meter.CreateCounter("requests", "Requests handled", "1", {{"status", "error"}});
+  splunk::Histogram latency = meter.CreateHistogram("latency", {1, 10, 100}, "Latency", "ms");
+
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < kIterations; i++) {
+        requests.Add(1);
+        latency.Record(i % 200);
+
+        if (i % 10 == 0) {
+          errors.Add(1);
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  /* The only export is the one on shutdown. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  verification.counters["requests"] = kThreads * kIterations + kThreads * kIterations / 10;
+  verification.histogramCounts["latency"] = kThreads * kIterations;
+  VerifyMetrics(verification);
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+#include "../mock_collector/mock_collector.h"
+
+#include <grpcpp/grpcpp.h>
+#include <opentelemetry/proto/collector/trace/v1/trace_service.grpc.pb.h>
+
+#include <stdio.h>
+
+namespace traceservice = opentelemetry::proto::collector::trace::v1;
+
+/* Runs without the docker-compose collector: argv[1] is a scratch file for the JSON lines. */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  MockCollectorOptions collectorOptions;
+  collectorOptions.jaegerAddress = "";
+  collectorOptions.traceFile = argv[1];
+  MockCollector collector(collectorOptions);
+
+  auto verification = VerifyBegin(argv[1]);
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("mock-collector-service")
+      .WithExporter(splunk::ExporterType_Otlp)
+      .WithOtlpEndpoint("127.0.0.1:" + std::to_string(collector.OtlpPort()));
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  auto parentSpan = tracer->StartSpan("parent-op");
+  opentelemetry::trace::StartSpanOptions startOptions;
+  startOptions.parent = parentSpan->GetContext();
+  auto span = tracer->StartSpan("child-op", {}, startOptions);
+  span->End();
+  parentSpan->End();
+
+  provider.Flush(std::chrono::seconds(5));
+
+  /* The same file format as the collector's, so the usual verification applies. */
+  verification.resource = &provider.GetResource();
+  verification.spans = {span.get(), parentSpan.get()};
+  VerifyTraces(verification);
+
+  size_t spans = 0;
+
+  for (const auto& received : collector.TraceRequests()) {
+    for (const auto& resourceSpans : received.resource_spans()) {
+      for (const auto& librarySpans : resourceSpans.instrumentation_library_spans()) {
+        spans += static_cast<size_t>(librarySpans.spans_size());
+      }
+    }
+  }
+
+  bool ok = collector.WaitForSpans(2, std::chrono::seconds(5)) && spans == 2 &&
+            collector.GetStats().spans == 2;
+
+  /* Injected failures are answered with their status and not recorded. */
+  MockCollectorOptions failingOptions;
+  failingOptions.jaegerAddress = "";
+  failingOptions.errorRate = 1;
+  MockCollector failing(failingOptions);
+
+  traceservice::TraceService::Stub stub(grpc::CreateChannel(
+    "127.0.0.1:" + std::to_string(failing.OtlpPort()), grpc::InsecureChannelCredentials()));
+  grpc::ClientContext context;
+  traceservice::ExportTraceServiceRequest request;
+  request.add_resource_spans()->add_instrumentation_library_spans()->add_spans();
+  traceservice::ExportTraceServiceResponse response;
+  grpc::Status status = stub.Export(&context, request, &response);
+
+  MockCollectorStats stats = failing.GetStats();
+  ok = ok && status.error_code() == grpc::StatusCode::UNAVAILABLE && stats.failedRequests == 1 &&
+       stats.spans == 0 && failing.TraceRequests().empty();
+
+  provider.Shutdown(std::chrono::seconds(5));
+
+  if (!ok) {
+    fprintf(stderr, "Unexpected mock collector contents\n");
+    return 1;
+  }
+
+  return 0;
+}
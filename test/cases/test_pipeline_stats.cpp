@@ -0,0 +1,48 @@
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+
+const int kSpans = 100;
+
+int main(int argc, char** argv) {
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions().WithServiceName("pipeline-service");
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  for (int i = 0; i < kSpans; i++) {
+    tracer->StartSpan("pipeline-span")->End();
+  }
+
+  provider.Flush(std::chrono::seconds(5));
+  splunk::PipelineStats stats = provider.GetPipelineStats();
+
+  printf(
+    "Pipeline: started=%llu ended=%llu exported=%llu failed=%llu bytes=%llu batches=%llu\n",
+    static_cast<unsigned long long>(stats.spansStarted),
+    static_cast<unsigned long long>(stats.spansEnded),
+    static_cast<unsigned long long>(stats.spansExported),
+    static_cast<unsigned long long>(stats.spansExportFailed),
+    static_cast<unsigned long long>(stats.bytesSent),
+    static_cast<unsigned long long>(stats.batchSize.count));
+
+  bool ok = stats.spansStarted == kSpans && stats.spansNotSampled == 0 &&
+            stats.spansEnded == kSpans && stats.spansExported == kSpans &&
+            stats.spansExportFailed == 0 && stats.spansDroppedQueueFull == 0 &&
+            stats.bytesSent > 0 && stats.queueSize == 0 && stats.batchSize.count > 0 &&
+            stats.batchSize.sum == kSpans && stats.exportDuration.count == stats.batchSize.count;
+
+  /* Ended after shutdown, so dropped. */
+  auto late = tracer->StartSpan("late-span");
+  provider.Shutdown(std::chrono::seconds(5));
+  late->End();
+  stats = provider.GetPipelineStats();
+  ok = ok && stats.spansDroppedShutdown == 1 && stats.spansEnded == kSpans + 1;
+
+  if (!ok) {
+    fprintf(stderr, "Unexpected pipeline stats\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <thread>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  auto verification = VerifyBegin(argv[1]);
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("pooled-service")
+      .WithSpanAllocation(splunk::SpanAllocation_Pooled);
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> parentSpan =
+    tracer->StartSpan("parent-op");
+
+  opentelemetry::trace::StartSpanOptions startOptions;
+  startOptions.kind = opentelemetry::trace::SpanKind::kServer;
+  startOptions.parent = parentSpan->GetContext();
+
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span;
+
+  /* The thread's pool is closed while its span is still queued. */
+  std::thread thread([&] {
+    span = tracer->StartSpan("child-op", {{"http.method", "GET"}}, startOptions);
+    span->AddEvent("event", {{"attempt", 1}});
+    span->End();
+  });
+  thread.join();
+
+  parentSpan->SetStatus(opentelemetry::trace::StatusCode::kOk, "");
+  parentSpan->End();
+
+  provider.Flush(std::chrono::seconds(1));
+
+  verification.resource = &provider.GetResource();
+  verification.spans = {span.get(), parentSpan.get()};
+
+  VerifyTraces(verification);
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <splunk/context.h>
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <chrono>
+
+namespace {
+
+/* Not inlined, so the profile has a frame of the test's own. */
+__attribute__((noinline)) double Spin(std::chrono::milliseconds duration) {
+  auto end = std::chrono::steady_clock::now() + duration;
+  volatile double sink = 0;
+
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 1; i < 1000; i++) {
+      sink = sink + 1.0 / i;
+    }
+  }
+
+  return sink;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  LogVerification verification = VerifyLogsBegin(argv[1]);
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("profiler-service")
+      .WithCpuProfiler(splunk::CpuProfiler_Enabled)
+      .WithProfilerSamplingInterval(std::chrono::milliseconds(1)));
+  auto tracer = provider->GetTracer("sample");
+
+  auto span = tracer->StartSpan("busy");
+
+  {
+    splunk::ContextScope scope(span);
+    Spin(std::chrono::milliseconds(300));
+  }
+
+  span->End();
+
+  /* The only export is the one on shutdown. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  VerifyProfiles(verification);
+
+  return 0;
+}
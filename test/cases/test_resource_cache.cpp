@@ -0,0 +1,107 @@
+#include <opentelemetry/sdk/resource/resource.h>
+#include <splunk/opentelemetry.h>
+
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+std::string ReadLine(const char* path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+std::string ReadLink(const char* path) {
+  char target[4096];
+  ssize_t length = readlink(path, target, sizeof(target));
+  return length > 0 ? std::string(target, length) : "";
+}
+
+std::string GetStringAttribute(const splunk::OpenTelemetryHandle& provider, const char* key) {
+  const auto& attributes = provider.GetResource().GetAttributes();
+  auto it = attributes.find(key);
+
+  if (it == attributes.end() ||
+      !opentelemetry::nostd::holds_alternative<std::string>(it->second)) {
+    return "";
+  }
+
+  return opentelemetry::nostd::get<std::string>(it->second);
+}
+
+int main(int argc, char** argv) {
+  char cachePath[] = "/tmp/splunk-otel-resource-XXXXXX";
+  close(mkstemp(cachePath));
+
+  char hostName[256] = {};
+  gethostname(hostName, sizeof(hostName) - 1);
+
+  std::string bootId = ReadLine("/proc/sys/kernel/random/boot_id");
+  std::string mountNamespace = ReadLink("/proc/self/ns/mnt");
+
+  /* A cache written on this boot, host and container is used instead of running detectors. */
+  {
+    std::ofstream cache(cachePath, std::ios::trunc);
+    cache << R"({"key": {"boot_id": ")" << bootId << R"(", "host_name": ")" << hostName
+          << R"(", "mnt_ns": ")" << mountNamespace
+          << R"("}, "attributes": {"host.name": "cached-host", "container.id": "cached"}})";
+  }
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("resource-service").WithResourceCacheFile(
+      cachePath));
+
+  if (GetStringAttribute(provider, "host.name") != "cached-host" ||
+      GetStringAttribute(provider, "container.id") != "cached") {
+    fprintf(stderr, "Cached resource attributes were not used\n");
+    return 1;
+  }
+
+  auto pid = provider.GetResource().GetAttributes().find("process.pid");
+  if (pid == provider.GetResource().GetAttributes().end() ||
+      opentelemetry::nostd::get<int64_t>(pid->second) != getpid()) {
+    fprintf(stderr, "process.pid is missing\n");
+    return 1;
+  }
+
+  provider.Shutdown(std::chrono::seconds(1));
+
+  /*
+   * A cache written by another container, as one restarted in the same pod would find it, is
+   * replaced with freshly detected attributes.
+   */
+  {
+    std::ofstream cache(cachePath, std::ios::trunc);
+    cache << R"({"key": {"boot_id": ")" << bootId << R"(", "host_name": ")" << hostName
+          << R"(", "mnt_ns": "mnt:[0]"}, "attributes": {"host.name": "cached-host"}})";
+  }
+
+  provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("resource-service")
+      .WithResourceCacheFile(cachePath)
+      .WithResourceDetectionTimeout(std::chrono::seconds(5)));
+
+  if (GetStringAttribute(provider, "host.name") != hostName) {
+    fprintf(stderr, "host.name was not detected\n");
+    return 1;
+  }
+
+  std::stringstream rewritten;
+  rewritten << std::ifstream(cachePath).rdbuf();
+
+  if (rewritten.str().find(hostName) == std::string::npos) {
+    fprintf(stderr, "Resource cache was not rewritten\n");
+    return 1;
+  }
+
+  provider.Shutdown(std::chrono::seconds(1));
+  remove(cachePath);
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <splunk/opentelemetry.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include <string>
+
+const size_t kSpanCount = 5000;
+
+/* Returns the endpoint of a socket which accepts connections but never answers, or "". */
+std::string StalledCollector() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(fd, 16) != 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+    return "";
+  }
+
+  return "127.0.0.1:" + std::to_string(ntohs(address.sin_port));
+}
+
+int main(int argc, char** argv) {
+  /* A handle without a pipeline is usable, it just has nothing to flush. */
+  splunk::OpenTelemetryHandle empty;
+  empty->GetTracer("sample")->StartSpan("empty-span")->End();
+
+  if (empty || empty.Flush(std::chrono::seconds(1)).completed ||
+      empty.Shutdown(std::chrono::seconds(1)).completed ||
+      empty.GetPipelineStats().spansExported != 0) {
+    fprintf(stderr, "Unexpected empty handle\n");
+    return 1;
+  }
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions().WithServiceName("shutdown-service");
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  for (size_t i = 0; i < kSpanCount; i++) {
+    tracer->StartSpan("shutdown-span")->End();
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  splunk::FlushResult result = provider.Shutdown(deadline);
+
+  printf(
+    "Shutdown: completed=%d exported=%zu dropped=%zu\n", result.completed, result.exportedSpans,
+    result.droppedSpans);
+
+  if (std::chrono::steady_clock::now() > deadline + std::chrono::seconds(1)) {
+    fprintf(stderr, "Shutdown overran its deadline\n");
+    return 1;
+  }
+
+  /* The default queue holds 2048 spans, the rest were dropped when they ended. */
+  if (!result.completed || result.exportedSpans == 0 || result.exportedSpans > kSpanCount) {
+    fprintf(stderr, "Unexpected shutdown result\n");
+    return 1;
+  }
+
+  /* Exports to a collector which never answers are abandoned at the deadline. */
+  std::string endpoint = StalledCollector();
+  if (endpoint.empty()) {
+    fprintf(stderr, "Failed to listen\n");
+    return 1;
+  }
+
+  auto stalled = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("stalled-service").WithOtlpEndpoint(endpoint));
+  auto stalledTracer = stalled->GetTracer("sample");
+
+  for (size_t i = 0; i < kSpanCount; i++) {
+    stalledTracer->StartSpan("stalled-span")->End();
+  }
+
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  result = stalled.Shutdown(deadline);
+
+  printf(
+    "Stalled shutdown: completed=%d exported=%zu dropped=%zu\n", result.completed,
+    result.exportedSpans, result.droppedSpans);
+
+  if (std::chrono::steady_clock::now() > deadline + std::chrono::seconds(1)) {
+    fprintf(stderr, "Stalled shutdown overran its deadline\n");
+    return 1;
+  }
+
+  if (result.completed || result.exportedSpans != 0 || result.droppedSpans == 0) {
+    fprintf(stderr, "Unexpected stalled shutdown result\n");
+    return 1;
+  }
+
+  return 0;
+}
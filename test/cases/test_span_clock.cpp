@@ -0,0 +1,62 @@
+#include <splunk/clock.h>
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono;
+
+bool Near(nanoseconds a, nanoseconds b, milliseconds tolerance) {
+  return a - b < tolerance && b - a < tolerance;
+}
+
+bool Check(splunk::SpanClock clock) {
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions().WithServiceName("clock-service").WithSpanClock(clock));
+
+  opentelemetry::trace::StartSpanOptions startOptions;
+  splunk::SetStartTime(startOptions);
+  auto span = provider->GetTracer("sample")->StartSpan("timed-span", startOptions);
+
+  /* Fell back to the default clock, which leaves the timestamps to the SDK. */
+  if (startOptions.start_steady_time.time_since_epoch() == nanoseconds(0)) {
+    printf("Clock %d: not available\n", clock);
+    span->End();
+    provider.Shutdown(seconds(5));
+    return true;
+  }
+
+  /* The coarse clocks lag by up to a kernel tick. */
+  if (!Near(
+        startOptions.start_system_time.time_since_epoch(),
+        system_clock::now().time_since_epoch(), milliseconds(50)) ||
+      !Near(
+        startOptions.start_steady_time.time_since_epoch(),
+        steady_clock::now().time_since_epoch(), milliseconds(50))) {
+    fprintf(stderr, "Start time of clock %d is off\n", clock);
+    return false;
+  }
+
+  std::this_thread::sleep_for(milliseconds(100));
+
+  opentelemetry::trace::EndSpanOptions endOptions;
+  splunk::SetEndTime(endOptions);
+  span->End(endOptions);
+
+  nanoseconds duration = endOptions.end_steady_time.time_since_epoch() -
+                         startOptions.start_steady_time.time_since_epoch();
+  printf("Clock %d: duration=%lldns\n", clock, static_cast<long long>(duration.count()));
+  provider.Shutdown(seconds(5));
+
+  if (!Near(duration, milliseconds(100), milliseconds(50))) {
+    fprintf(stderr, "Duration of clock %d is off\n", clock);
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  return Check(splunk::SpanClock_Tsc) && Check(splunk::SpanClock_Coarse) ? 0 : 1;
+}
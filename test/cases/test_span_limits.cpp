@@ -0,0 +1,52 @@
+#include <splunk/opentelemetry.h>
+
+#include <stdio.h>
+#include <string>
+
+bool Check(splunk::SpanAllocation allocation) {
+  splunk::SpanLimits limits;
+  limits.attributeCount = 2;
+  limits.attributeValueLength = 8;
+  limits.eventCount = 1;
+
+  splunk::OpenTelemetryOptions otelOptions = splunk::OpenTelemetryOptions()
+                                               .WithServiceName("limits-service")
+                                               .WithSpanAllocation(allocation)
+                                               .WithSpanLimits(limits);
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  std::string longValue(1024, 'x');
+  auto span = tracer->StartSpan("limited-span");
+  span->SetAttribute("short", "value");
+  span->SetAttribute("long", longValue);
+  span->SetAttribute("dropped", 1);
+
+  for (int i = 0; i < 3; i++) {
+    span->AddEvent("event", {{"payload", longValue}});
+  }
+
+  span->End();
+
+  splunk::SpanLimitStats stats = provider.GetSpanLimitStats();
+  provider.Shutdown(std::chrono::seconds(5));
+
+  printf(
+    "Span limits: droppedAttributes=%llu truncatedAttributes=%llu droppedEvents=%llu\n",
+    static_cast<unsigned long long>(stats.droppedAttributes),
+    static_cast<unsigned long long>(stats.truncatedAttributes),
+    static_cast<unsigned long long>(stats.droppedEvents));
+
+  /* One attribute of the span and the payload of the only recorded event were truncated. */
+  return stats.droppedAttributes == 1 && stats.truncatedAttributes == 2 &&
+         stats.droppedEvents == 2 && stats.droppedLinks == 0;
+}
+
+int main(int argc, char** argv) {
+  if (!Check(splunk::SpanAllocation_Default) || !Check(splunk::SpanAllocation_Pooled)) {
+    fprintf(stderr, "Unexpected span limit stats\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Nothing is sampled, span metrics still count every span. */
+const char* kConfig = R"({
+  "sampler": { "ratio": 0.0 }
+})";
+
+const int kSpans = 100;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  char configPath[] = "/tmp/splunk-otel-config-XXXXXX";
+  int fd = mkstemp(configPath);
+  FILE* configFile = fdopen(fd, "w");
+  fputs(kConfig, configFile);
+  fclose(configFile);
+
+  MetricVerification verification = VerifyMetricsBegin(argv[1]);
+
+  splunk::OpenTelemetryOptions otelOptions =
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("span-metrics-service")
+      .WithConfigFile(configPath)
+      .WithSpanMetrics(splunk::SpanMetrics_Enabled)
+      .WithMetricExportInterval(std::chrono::minutes(10));
+  auto provider = splunk::InitOpentelemetry(otelOptions);
+  auto tracer = provider->GetTracer("sample");
+
+  for (int i = 0; i < kSpans; i++) {
+    auto span = tracer->StartSpan(i % 2 == 0 ? "GET /items" : "GET /users");
+
+    if (i % 10 == 0) {
+      span->SetStatus(opentelemetry::trace::StatusCode::kError, "failed");
+    }
+
+    span->End();
+  }
+
+  /* The only export is the one on shutdown. */
+  provider.Shutdown(std::chrono::seconds(5));
+
+  verification.counters["traces.span.metrics.calls"] = kSpans;
+  verification.histogramCounts["traces.span.metrics.duration"] = kSpans;
+  VerifyMetrics(verification);
+
+  remove(configPath);
+
+  return 0;
+}
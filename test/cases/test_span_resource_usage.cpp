@@ -0,0 +1,41 @@
+#include <splunk/opentelemetry.h>
+
+#include "../common/verify.h"
+
+#include <chrono>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  auto verification = VerifyBegin(argv[1]);
+
+  auto provider = splunk::InitOpentelemetry(
+    splunk::OpenTelemetryOptions()
+      .WithServiceName("resource-usage-service")
+      .WithSpanResourceUsage(splunk::SpanResourceUsage_Enabled));
+  auto tracer = provider->GetTracer("sample");
+
+  auto span = tracer->StartSpan("busy-op");
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+  volatile double sink = 0;
+
+  while (std::chrono::steady_clock::now() < end) {
+    sink = sink + 1.0;
+  }
+
+  span->End();
+
+  provider.Flush(std::chrono::seconds(1));
+
+  verification.resource = &provider.GetResource();
+  verification.spans = {span.get()};
+  verification.spanAttributeKeys = {
+    "span.cpu.user_us", "span.cpu.system_us", "span.context_switches.voluntary",
+    "span.context_switches.involuntary"};
+
+  VerifyTraces(verification);
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <splunk/context.h>
+#include <splunk/opentelemetry.h>
+#include <splunk/task.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+/* Minimal single worker pool with a queue of move-only tasks. */
+class Pool {
+public:
+  Pool() : worker_([this] { Run(); }) {}
+
+  ~Pool() {
+    Submit(splunk::ContextTask());
+    worker_.join();
+  }
+
+  void Submit(splunk::ContextTask task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    cv_.notify_one();
+  }
+
+private:
+  void Run() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return !tasks_.empty(); });
+      splunk::ContextTask task = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+
+      if (!task) {
+        return;
+      }
+
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<splunk::ContextTask> tasks_;
+  std::thread worker_;
+};
+
+int main(int argc, char** argv) {
+  auto provider =
+    splunk::InitOpentelemetry(splunk::OpenTelemetryOptions().WithServiceName("task-service"));
+  auto tracer = provider->GetTracer("sample");
+  auto parent = tracer->StartSpan("parent");
+  trace::SpanId parentId = parent->GetContext().span_id();
+
+  int matches = 0;
+  const int kTaskCount = 3;
+
+  {
+    Pool pool;
+    char padding[128] = {};
+    std::function<void(std::function<void()>)> spawn = [](std::function<void()> f) {
+      std::thread(std::move(f)).join();
+    };
+
+    splunk::ContextScope scope(parent);
+    auto check = [&] { matches += tracer->GetCurrentSpan()->GetContext().span_id() == parentId; };
+
+    pool.Submit(check);
+    /* Too large to be stored inline. */
+    pool.Submit([&, padding] { check(); });
+    splunk::MakeContextExecutor(spawn)(check);
+  }
+
+  if (matches != kTaskCount) {
+    fprintf(stderr, "%d of %d tasks ran with the parent span\n", matches, kTaskCount);
+    return 1;
+  }
+
+  parent->End();
+  provider.Shutdown(std::chrono::seconds(1));
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <splunk/opentelemetry.h>
+#include <splunk/tracing.h>
+
+#include "../common/verify.h"
+
+#include <stdio.h>
+
+namespace nostd = opentelemetry::nostd;
+namespace trace = opentelemetry::trace;
+
+static_assert(splunk::semconv::kHttpMethod.size() == 11, "key length is precomputed");
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return 1;
+  }
+
+  auto verification = VerifyBegin(argv[1]);
+
+  auto provider =
+    splunk::InitOpentelemetry(splunk::OpenTelemetryOptions().WithServiceName("macro-service"));
+  auto tracer = provider->GetTracer("sample");
+
+  nostd::shared_ptr<trace::Span> parentSpan;
+  nostd::shared_ptr<trace::Span> childSpan;
+
+  {
+    SPLUNK_SCOPED_SPAN(parent, tracer, "parent-op", trace::SpanKind::kServer);
+    SPLUNK_SPAN_ATTRIBUTE(parent, splunk::semconv::kHttpMethod, "GET");
+    parentSpan = tracer->GetCurrentSpan();
+
+    {
+      SPLUNK_SCOPED_SPAN(child, tracer, "child-op");
+      SPLUNK_SPAN_EVENT(child, "started");
+      childSpan = tracer->GetCurrentSpan();
+    }
+
+    if (tracer->GetCurrentSpan()->GetContext().span_id() != parentSpan->GetContext().span_id()) {
+      fprintf(stderr, "Parent span is not active again after the child scope\n");
+      return 1;
+    }
+  }
+
+  if (childSpan->GetContext().trace_id() != parentSpan->GetContext().trace_id()) {
+    fprintf(stderr, "Child span is not part of the parent's trace\n");
+    return 1;
+  }
+
+  provider.Flush(std::chrono::seconds(1));
+
+  verification.resource = &provider.GetResource();
+  verification.spans = {childSpan.get(), parentSpan.get()};
+
+  VerifyTraces(verification);
+
+  return 0;
+}
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <string>
 #include <thread>
+#include <unordered_set>
 
 namespace {
 
@@ -45,13 +46,13 @@ std::string LoadFileContent(FILE* f) {
   return data;
 }
 
-std::string LoadTraces(FILE* file) {
+std::string LoadExport(FILE* file, const char* what) {
   auto timeout = std::chrono::system_clock::now() + std::chrono::seconds(10);
 
   std::string content;
   while (content.empty()) {
     if (std::chrono::system_clock::now() > timeout) {
-      fprintf(stderr, "Timed out waiting for traces\n");
+      fprintf(stderr, "Timed out waiting for %s\n", what);
       abort();
     }
 
@@ -67,6 +68,15 @@ std::string LoadTraces(FILE* file) {
   return "";
 }
 
+/* The JSON encoding of protobuf writes 64 bit integers as strings. */
+uint64_t ToUint64(const picojson::value& value) {
+  if (value.is<std::string>()) {
+    return std::stoull(value.get<std::string>());
+  }
+
+  return value.is<double>() ? static_cast<uint64_t>(value.get<double>()) : 0;
+}
+
 } // namespace
 
 #define check(v, fmt, ...)                                                                         \
@@ -89,7 +99,7 @@ TraceVerification VerifyBegin(const char* tracesPath) {
 }
 
 void VerifyTraces(const TraceVerification& verification) {
-  std::string content = LoadTraces(verification.traceFile);
+  std::string content = LoadExport(verification.traceFile, "traces");
 
   picojson::value json;
   std::string err = picojson::parse(json, content);
@@ -173,5 +183,224 @@ void VerifyTraces(const TraceVerification& verification) {
     check(
       actualSpanId == spanId, "Span ID mismatch. Expected '%s', got '%s'", actualSpanId.c_str(),
       spanId.c_str());
+
+    for (const std::string& key : verification.spanAttributeKeys) {
+      bool found = false;
+
+      if (obj["attributes"].is<picojson::array>()) {
+        for (auto& attribute : obj["attributes"].get<picojson::array>()) {
+          found = found || attribute.get("key").get<std::string>() == key;
+        }
+      }
+
+      check(found, "Span %s has no attribute %s", spanId.c_str(), key.c_str());
+    }
+  }
+}
+
+void VerifySpanCount(const TraceVerification& verification, const std::string& name, size_t count) {
+  check(verification.traceFile, "No trace file");
+
+  auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  std::string pending;
+  std::unordered_set<std::string> spanIds;
+  size_t spans = 0;
+  bool settling = false;
+
+  for (;;) {
+    char buffer[1 << 16];
+    size_t bytes;
+
+    while ((bytes = fread(buffer, 1, sizeof(buffer), verification.traceFile)) > 0) {
+      pending.append(buffer, bytes);
+    }
+
+    /* Requests written later are read on the next round. */
+    clearerr(verification.traceFile);
+
+    size_t lineEnd;
+
+    while ((lineEnd = pending.find('\n')) != std::string::npos) {
+      picojson::value json;
+      std::string err = picojson::parse(json, pending.substr(0, lineEnd));
+      pending.erase(0, lineEnd + 1);
+
+      check(err.empty(), "Unable to parse trace JSON: %s", err.c_str());
+
+      if (!json.get("resourceSpans").is<picojson::array>()) {
+        continue;
+      }
+
+      for (auto& resourceSpans : json.get("resourceSpans").get<picojson::array>()) {
+        for (auto& librarySpans :
+             resourceSpans.get("instrumentationLibrarySpans").get<picojson::array>()) {
+          for (auto& span : librarySpans.get("spans").get<picojson::array>()) {
+            if (span.get("name").get<std::string>() == name) {
+              spans++;
+              spanIds.insert(span.get("spanId").get<std::string>());
+            }
+          }
+        }
+      }
+    }
+
+    /* Once there are enough, one more round catches duplicates still on their way. */
+    if (settling || std::chrono::steady_clock::now() > timeout) {
+      break;
+    }
+
+    settling = spans >= count;
+    std::this_thread::sleep_for(std::chrono::milliseconds(settling ? 1000 : 200));
+  }
+
+  check(
+    spans == count && spanIds.size() == count,
+    "Spans named %s mismatch. Expected %zu, got %zu with %zu distinct span IDs", name.c_str(),
+    count, spans, spanIds.size());
+}
+
+MetricVerification VerifyMetricsBegin(const char* metricsPath) {
+  MetricVerification verification;
+  verification.metricsFile = fopen(metricsPath, "rb");
+
+  if (verification.metricsFile) {
+    fseek(verification.metricsFile, 0, SEEK_END);
+  }
+
+  return verification;
+}
+
+void VerifyMetrics(const MetricVerification& verification) {
+  std::string content = LoadExport(verification.metricsFile, "metrics");
+
+  picojson::value json;
+  std::string err = picojson::parse(json, content);
+
+  printf("Verifying metrics:\n%s\n", content.c_str());
+
+  check(err.empty(), "Unable to parse metrics JSON: %s", err.c_str());
+  check(json.is<picojson::object>(), "Invalid metrics JSON");
+
+  std::unordered_map<std::string, uint64_t> counters;
+  std::unordered_map<std::string, uint64_t> histogramCounts;
+
+  for (auto& resourceMetrics : json.get("resourceMetrics").get<picojson::array>()) {
+    for (auto& libraryMetrics :
+         resourceMetrics.get("instrumentationLibraryMetrics").get<picojson::array>()) {
+      for (auto& metric : libraryMetrics.get("metrics").get<picojson::array>()) {
+        std::string name = metric.get("name").get<std::string>();
+
+        if (metric.contains("sum")) {
+          for (auto& point : metric.get("sum").get("dataPoints").get<picojson::array>()) {
+            counters[name] += ToUint64(point.get("asInt"));
+          }
+        }
+
+        if (metric.contains("histogram")) {
+          for (auto& point : metric.get("histogram").get("dataPoints").get<picojson::array>()) {
+            histogramCounts[name] += ToUint64(point.get("count"));
+          }
+        }
+      }
+    }
   }
+
+  for (const auto& counter : verification.counters) {
+    check(
+      counters[counter.first] == counter.second, "Counter %s mismatch. Expected %llu, got %llu",
+      counter.first.c_str(), static_cast<unsigned long long>(counter.second),
+      static_cast<unsigned long long>(counters[counter.first]));
+  }
+
+  for (const auto& histogram : verification.histogramCounts) {
+    check(
+      histogramCounts[histogram.first] == histogram.second,
+      "Histogram %s count mismatch. Expected %llu, got %llu", histogram.first.c_str(),
+      static_cast<unsigned long long>(histogram.second),
+      static_cast<unsigned long long>(histogramCounts[histogram.first]));
+  }
+}
+
+LogVerification VerifyLogsBegin(const char* logsPath) {
+  LogVerification verification;
+  verification.logsFile = fopen(logsPath, "rb");
+
+  if (verification.logsFile) {
+    fseek(verification.logsFile, 0, SEEK_END);
+  }
+
+  return verification;
+}
+
+void VerifyLogs(const LogVerification& verification) {
+  std::string content = LoadExport(verification.logsFile, "logs");
+
+  picojson::value json;
+  std::string err = picojson::parse(json, content);
+
+  printf("Verifying logs:\n%s\n", content.c_str());
+
+  check(err.empty(), "Unable to parse logs JSON: %s", err.c_str());
+  check(json.is<picojson::object>(), "Invalid logs JSON");
+
+  size_t records = 0;
+  size_t correlatedRecords = 0;
+
+  for (auto& resourceLogs : json.get("resourceLogs").get<picojson::array>()) {
+    for (auto& libraryLogs :
+         resourceLogs.get("instrumentationLibraryLogs").get<picojson::array>()) {
+      for (auto& record : libraryLogs.get("logs").get<picojson::array>()) {
+        records++;
+
+        if (record.contains("traceId") &&
+            record.get("traceId").get<std::string>() == verification.traceId) {
+          correlatedRecords++;
+        }
+      }
+    }
+  }
+
+  check(
+    records == verification.records, "Record count mismatch. Expected %zu, got %zu",
+    verification.records, records);
+  check(
+    correlatedRecords == verification.correlatedRecords,
+    "Records with trace ID %s mismatch. Expected %zu, got %zu", verification.traceId.c_str(),
+    verification.correlatedRecords, correlatedRecords);
+}
+
+void VerifyProfiles(const LogVerification& verification) {
+  std::string content = LoadExport(verification.logsFile, "profiles");
+
+  picojson::value json;
+  std::string err = picojson::parse(json, content);
+
+  printf("Verifying profiles:\n%s\n", content.c_str());
+
+  check(err.empty(), "Unable to parse logs JSON: %s", err.c_str());
+  check(json.is<picojson::object>(), "Invalid logs JSON");
+
+  size_t profiles = 0;
+
+  for (auto& resourceLogs : json.get("resourceLogs").get<picojson::array>()) {
+    for (auto& libraryLogs :
+         resourceLogs.get("instrumentationLibraryLogs").get<picojson::array>()) {
+      for (auto& record : libraryLogs.get("logs").get<picojson::array>()) {
+        auto attributes = ExtractStringAttributes(record.get("attributes").get<picojson::array>());
+
+        if (attributes["profiling.data.format"] != "pprof-gzip-base64") {
+          continue;
+        }
+
+        check(
+          attributes["com.splunk.sourcetype"] == "otel.profiling", "Unexpected source type '%s'",
+          attributes["com.splunk.sourcetype"].c_str());
+        check(
+          !record.get("body").get("stringValue").get<std::string>().empty(), "Empty profile");
+        profiles++;
+      }
+    }
+  }
+
+  check(profiles > 0, "No profile exported");
 }
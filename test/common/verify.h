@@ -4,12 +4,46 @@
 #include <opentelemetry/trace/span.h>
 #include <stdio.h>
 #include <string>
+#include <unordered_map>
 
 struct TraceVerification {
   FILE* traceFile = nullptr;
   const opentelemetry::sdk::resource::Resource* resource = nullptr;
   std::vector<const opentelemetry::trace::Span*> spans;
+  /* Attributes every span must have, whatever their value. */
+  std::vector<std::string> spanAttributeKeys;
 };
 
 TraceVerification VerifyBegin(const char* tracesPath);
 void VerifyTraces(const TraceVerification& args);
+
+/*
+ * Reads every request written since VerifyBegin until the spans named name add up to count,
+ * for at most 30 seconds, then checks there are exactly count of them with distinct span IDs.
+ */
+void VerifySpanCount(const TraceVerification& args, const std::string& name, size_t count);
+
+struct MetricVerification {
+  FILE* metricsFile = nullptr;
+  /* Expected value of each counter by metric name, summed over its data points. */
+  std::unordered_map<std::string, uint64_t> counters;
+  /* Expected number of values recorded by each histogram. */
+  std::unordered_map<std::string, uint64_t> histogramCounts;
+};
+
+MetricVerification VerifyMetricsBegin(const char* metricsPath);
+void VerifyMetrics(const MetricVerification& args);
+
+struct LogVerification {
+  FILE* logsFile = nullptr;
+  /* Expected number of records, and how many of them carry traceId (lowercase hex). */
+  size_t records = 0;
+  size_t correlatedRecords = 0;
+  std::string traceId;
+};
+
+LogVerification VerifyLogsBegin(const char* logsPath);
+void VerifyLogs(const LogVerification& args);
+
+/* At least one CPU or memory profile record with a pprof body. */
+void VerifyProfiles(const LogVerification& args);
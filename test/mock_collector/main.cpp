@@ -0,0 +1,220 @@
+#include "mock_collector.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+/*
+ * Runs the mock collector until SIGINT or SIGTERM, in place of the docker-compose collector:
+ * the defaults listen on its ports and the file options take the files of test/data. With
+ * --daemon it returns once listening and --stop ends it, for the CTest fixture.
+ */
+
+namespace {
+
+const char* kUsage =
+  "usage: mock_collector [--otlp=0.0.0.0:4317] [--jaeger=0.0.0.0:9080] [--latency-ms=0]\n"
+  "                      [--error-rate=0] [--throttle-rate=0] [--trace-file=]\n"
+  "                      [--metrics-file=] [--logs-file=] [--pid-file=]\n"
+  "\n"
+  "  --otlp           OTLP gRPC address, empty to disable\n"
+  "  --jaeger         Jaeger Thrift HTTP address, empty to disable\n"
+  "  --latency-ms     delay before answering each export\n"
+  "  --error-rate     fraction of exports failed with UNAVAILABLE or HTTP 503\n"
+  "  --throttle-rate  fraction of exports throttled with RESOURCE_EXHAUSTED or HTTP 429\n"
+  "  --*-file         appends each accepted request as a line of JSON\n"
+  "  --pid-file       written once listening\n"
+  "  --daemon         runs in the background, exits once listening, needs --pid-file\n"
+  "  --stop           terminates the collector of --pid-file\n";
+
+struct Mode {
+  std::string pidFile;
+  bool daemon = false;
+  bool stop = false;
+};
+
+bool ParseOption(const char* arg, const char* name, std::string* value) {
+  size_t length = strlen(name);
+
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+
+  *value = arg + length + 1;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, MockCollectorOptions* options, Mode* mode) {
+  options->otlpAddress = "0.0.0.0:4317";
+  options->jaegerAddress = "0.0.0.0:9080";
+  options->keepTraces = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string value;
+
+    if (ParseOption(argv[i], "--otlp", &value)) {
+      options->otlpAddress = value;
+    } else if (ParseOption(argv[i], "--jaeger", &value)) {
+      options->jaegerAddress = value;
+    } else if (ParseOption(argv[i], "--latency-ms", &value)) {
+      options->latency = std::chrono::milliseconds(strtol(value.c_str(), nullptr, 10));
+    } else if (ParseOption(argv[i], "--error-rate", &value)) {
+      options->errorRate = strtod(value.c_str(), nullptr);
+    } else if (ParseOption(argv[i], "--throttle-rate", &value)) {
+      options->throttleRate = strtod(value.c_str(), nullptr);
+    } else if (ParseOption(argv[i], "--trace-file", &value)) {
+      options->traceFile = value;
+    } else if (ParseOption(argv[i], "--metrics-file", &value)) {
+      options->metricsFile = value;
+    } else if (ParseOption(argv[i], "--logs-file", &value)) {
+      options->logsFile = value;
+    } else if (ParseOption(argv[i], "--pid-file", &value)) {
+      mode->pidFile = value;
+    } else if (strcmp(argv[i], "--daemon") == 0) {
+      mode->daemon = true;
+    } else if (strcmp(argv[i], "--stop") == 0) {
+      mode->stop = true;
+    } else {
+      return false;
+    }
+  }
+
+  return !mode->pidFile.empty() || (!mode->daemon && !mode->stop);
+}
+
+/* Sends SIGTERM and waits for the collector to exit, so its files are complete. */
+int Stop(const std::string& pidFile) {
+  FILE* file = fopen(pidFile.c_str(), "r");
+  int pid = 0;
+
+  if (!file || fscanf(file, "%d", &pid) != 1 || pid <= 0) {
+    fprintf(stderr, "mock_collector: no pid in %s\n", pidFile.c_str());
+
+    if (file) {
+      fclose(file);
+    }
+
+    return 1;
+  }
+
+  fclose(file);
+  kill(pid, SIGTERM);
+
+  for (int i = 0; i < 100 && kill(pid, 0) == 0; i++) {
+    usleep(50000);
+  }
+
+  unlink(pidFile.c_str());
+  return 0;
+}
+
+/*
+ * Forks before any thread exists. The parent returns when the child reports on the pipe that
+ * it listens, the child returns the pipe's write end.
+ */
+int Daemonize() {
+  int ready[2];
+
+  if (pipe(ready) != 0) {
+    return -1;
+  }
+
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    return -1;
+  }
+
+  if (pid != 0) {
+    close(ready[1]);
+    char status = 1;
+    ssize_t bytes = read(ready[0], &status, 1);
+    _exit(bytes == 1 && status == 0 ? 0 : 1);
+  }
+
+  close(ready[0]);
+  setsid();
+
+  int devNull = open("/dev/null", O_RDWR);
+  dup2(devNull, STDIN_FILENO);
+  dup2(devNull, STDOUT_FILENO);
+  dup2(devNull, STDERR_FILENO);
+  close(devNull);
+  return ready[1];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  MockCollectorOptions options;
+  Mode mode;
+
+  if (!ParseOptions(argc, argv, &options, &mode)) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  if (mode.stop) {
+    return Stop(mode.pidFile);
+  }
+
+  int ready = -1;
+
+  if (mode.daemon && (ready = Daemonize()) == -1) {
+    perror("mock_collector: fork");
+    return 1;
+  }
+
+  /* Blocked before any thread starts, so only sigwait receives them. */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  try {
+    MockCollector collector(options);
+    printf(
+      "mock_collector: OTLP on %d, Jaeger on %d\n", collector.OtlpPort(), collector.JaegerPort());
+    fflush(stdout);
+
+    if (!mode.pidFile.empty()) {
+      FILE* file = fopen(mode.pidFile.c_str(), "w");
+
+      if (file) {
+        fprintf(file, "%d\n", static_cast<int>(getpid()));
+        fclose(file);
+      }
+    }
+
+    if (ready != -1) {
+      char status = 0;
+      write(ready, &status, 1);
+      close(ready);
+    }
+
+    int signal;
+    sigwait(&signals, &signal);
+
+    MockCollectorStats stats = collector.GetStats();
+    printf(
+      "mock_collector: %llu requests accepted, %llu failed, %llu throttled, %llu spans, "
+      "%llu metrics, %llu log records\n",
+      static_cast<unsigned long long>(stats.acceptedRequests),
+      static_cast<unsigned long long>(stats.failedRequests),
+      static_cast<unsigned long long>(stats.throttledRequests),
+      static_cast<unsigned long long>(stats.spans), static_cast<unsigned long long>(stats.metrics),
+      static_cast<unsigned long long>(stats.logRecords));
+  } catch (const std::system_error& error) {
+    fprintf(stderr, "mock_collector: %s\n", error.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,974 @@
+#include "mock_collector.h"
+
+#include <google/protobuf/util/json_util.h>
+#include <grpcpp/grpcpp.h>
+#include <nlohmann/json.hpp>
+#include <opentelemetry/proto/collector/logs/v1/logs_service.grpc.pb.h>
+#include <opentelemetry/proto/collector/metrics/v1/metrics_service.grpc.pb.h>
+#include <opentelemetry/proto/collector/trace/v1/trace_service.grpc.pb.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <random>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace commonproto = opentelemetry::proto::common::v1;
+namespace logsservice = opentelemetry::proto::collector::logs::v1;
+namespace metricsservice = opentelemetry::proto::collector::metrics::v1;
+namespace traceproto = opentelemetry::proto::trace::v1;
+namespace traceservice = opentelemetry::proto::collector::trace::v1;
+
+using json = nlohmann::json;
+
+namespace {
+
+enum Outcome {
+  Outcome_Accept,
+  Outcome_Error,
+  Outcome_Throttle,
+};
+
+/* The collector's JSON has IDs in hex where the protobuf mapping has base64. */
+std::string Base64ToHex(const std::string& base64) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  uint32_t bits = 0;
+  int count = 0;
+
+  for (char c : base64) {
+    int value;
+
+    if (c >= 'A' && c <= 'Z') {
+      value = c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+      value = c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+      value = c - '0' + 52;
+    } else if (c == '+' || c == '-') {
+      value = 62;
+    } else if (c == '/' || c == '_') {
+      value = 63;
+    } else {
+      continue;
+    }
+
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    count += 6;
+
+    if (count >= 8) {
+      count -= 8;
+      uint8_t byte = static_cast<uint8_t>(bits >> count);
+      hex += kDigits[byte >> 4];
+      hex += kDigits[byte & 15];
+    }
+  }
+
+  return hex;
+}
+
+void HexIds(json& value) {
+  if (value.is_object()) {
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      if ((it.key() == "traceId" || it.key() == "spanId" || it.key() == "parentSpanId") &&
+          it->is_string()) {
+        *it = Base64ToHex(it->get<std::string>());
+      } else {
+        HexIds(*it);
+      }
+    }
+  } else if (value.is_array()) {
+    for (auto& element : value) {
+      HexIds(element);
+    }
+  }
+}
+
+/* Reads the structures of the Thrift binary protocol, every read fails past the end. */
+class ThriftReader {
+public:
+  enum Type : uint8_t {
+    Type_Stop = 0,
+    Type_Bool = 2,
+    Type_Byte = 3,
+    Type_Double = 4,
+    Type_I16 = 6,
+    Type_I32 = 8,
+    Type_I64 = 10,
+    Type_String = 11,
+    Type_Struct = 12,
+    Type_Map = 13,
+    Type_Set = 14,
+    Type_List = 15,
+  };
+
+  explicit ThriftReader(const std::string& data) : data_(data) {}
+
+  bool ReadByte(uint8_t* value) { return ReadBigEndian(1, value); }
+  bool ReadI16(int16_t* value) { return ReadBigEndian(2, value); }
+  bool ReadI32(int32_t* value) { return ReadBigEndian(4, value); }
+  bool ReadI64(int64_t* value) { return ReadBigEndian(8, value); }
+
+  bool ReadDouble(double* value) {
+    uint64_t bits;
+
+    if (!ReadBigEndian(8, &bits)) {
+      return false;
+    }
+
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    int32_t size;
+
+    if (!ReadI32(&size) || size < 0 || static_cast<size_t>(size) > data_.size() - offset_) {
+      return false;
+    }
+
+    value->assign(data_, offset_, static_cast<size_t>(size));
+    offset_ += static_cast<size_t>(size);
+    return true;
+  }
+
+  /* Calls onField(type, id) for each field, which reads or skips it. */
+  template <class OnField>
+  bool ReadStruct(OnField onField) {
+    for (;;) {
+      uint8_t type;
+      int16_t id;
+
+      if (!ReadByte(&type)) {
+        return false;
+      }
+
+      if (type == Type_Stop) {
+        return true;
+      }
+
+      if (!ReadI16(&id) || !onField(type, id)) {
+        return false;
+      }
+    }
+  }
+
+  /* Calls onElement() for each element, which reads it. */
+  template <class OnElement>
+  bool ReadList(uint8_t elementType, OnElement onElement) {
+    uint8_t type;
+    int32_t size;
+
+    if (!ReadByte(&type) || !ReadI32(&size) || type != elementType || size < 0) {
+      return false;
+    }
+
+    for (int32_t i = 0; i < size; i++) {
+      if (!onElement()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool Skip(uint8_t type, int depth = 0) {
+    if (depth > 16) {
+      return false;
+    }
+
+    switch (type) {
+      case Type_Bool:
+      case Type_Byte:
+        return Advance(1);
+      case Type_I16:
+        return Advance(2);
+      case Type_I32:
+        return Advance(4);
+      case Type_Double:
+      case Type_I64:
+        return Advance(8);
+      case Type_String: {
+        std::string value;
+        return ReadString(&value);
+      }
+      case Type_Struct:
+        return ReadStruct([&](uint8_t fieldType, int16_t) { return Skip(fieldType, depth + 1); });
+      case Type_Map: {
+        uint8_t keyType, valueType;
+        int32_t size;
+
+        if (!ReadByte(&keyType) || !ReadByte(&valueType) || !ReadI32(&size) || size < 0) {
+          return false;
+        }
+
+        for (int32_t i = 0; i < size; i++) {
+          if (!Skip(keyType, depth + 1) || !Skip(valueType, depth + 1)) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+      case Type_Set:
+      case Type_List: {
+        uint8_t elementType;
+        int32_t size;
+
+        if (!ReadByte(&elementType) || !ReadI32(&size) || size < 0) {
+          return false;
+        }
+
+        for (int32_t i = 0; i < size; i++) {
+          if (!Skip(elementType, depth + 1)) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+private:
+  template <class T>
+  bool ReadBigEndian(size_t size, T* value) {
+    if (data_.size() - offset_ < size) {
+      return false;
+    }
+
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < size; i++) {
+      result = (result << 8) | static_cast<uint8_t>(data_[offset_ + i]);
+    }
+
+    offset_ += size;
+    *value = static_cast<T>(result);
+    return true;
+  }
+
+  bool Advance(size_t size) {
+    if (data_.size() - offset_ < size) {
+      return false;
+    }
+
+    offset_ += size;
+    return true;
+  }
+
+  const std::string& data_;
+  size_t offset_ = 0;
+};
+
+/* A jaeger.thrift Tag, its type picks which of the values is set. */
+bool ReadTag(ThriftReader& reader, commonproto::KeyValue* attribute) {
+  enum TagType { TagType_String, TagType_Double, TagType_Bool, TagType_Long, TagType_Binary };
+  int32_t tagType = TagType_String;
+  std::string stringValue;
+  double doubleValue = 0;
+  uint8_t boolValue = 0;
+  int64_t longValue = 0;
+
+  bool ok = reader.ReadStruct([&](uint8_t type, int16_t id) {
+    switch (id) {
+      case 1:
+        return type == ThriftReader::Type_String && reader.ReadString(attribute->mutable_key());
+      case 2:
+        return type == ThriftReader::Type_I32 && reader.ReadI32(&tagType);
+      case 3:
+      case 7:
+        return type == ThriftReader::Type_String && reader.ReadString(&stringValue);
+      case 4:
+        return type == ThriftReader::Type_Double && reader.ReadDouble(&doubleValue);
+      case 5:
+        return type == ThriftReader::Type_Bool && reader.ReadByte(&boolValue);
+      case 6:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&longValue);
+      default:
+        return reader.Skip(type);
+    }
+  });
+
+  commonproto::AnyValue* value = attribute->mutable_value();
+
+  switch (tagType) {
+    case TagType_Double:
+      value->set_double_value(doubleValue);
+      break;
+    case TagType_Bool:
+      value->set_bool_value(boolValue != 0);
+      break;
+    case TagType_Long:
+      value->set_int_value(longValue);
+      break;
+    case TagType_Binary:
+      value->set_bytes_value(stringValue);
+      break;
+    default:
+      value->set_string_value(stringValue);
+  }
+
+  return ok;
+}
+
+bool ReadTags(
+  ThriftReader& reader,
+  google::protobuf::RepeatedPtrField<commonproto::KeyValue>* attributes) {
+  return reader.ReadList(
+    ThriftReader::Type_Struct, [&] { return ReadTag(reader, attributes->Add()); });
+}
+
+void AppendId(uint64_t id, std::string* bytes) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    bytes->push_back(static_cast<char>(id >> shift));
+  }
+}
+
+/* Tags the collector's Jaeger receiver turns into span fields rather than attributes. */
+void ApplySpecialTags(traceproto::Span* span, std::pair<std::string, std::string>* library) {
+  auto* attributes = span->mutable_attributes();
+
+  for (int i = 0; i < attributes->size();) {
+    const commonproto::KeyValue& attribute = attributes->Get(i);
+    const std::string& key = attribute.key();
+    const std::string& value = attribute.value().string_value();
+
+    if (key == "span.kind") {
+      if (value == "client") {
+        span->set_kind(traceproto::Span::SPAN_KIND_CLIENT);
+      } else if (value == "server") {
+        span->set_kind(traceproto::Span::SPAN_KIND_SERVER);
+      } else if (value == "producer") {
+        span->set_kind(traceproto::Span::SPAN_KIND_PRODUCER);
+      } else if (value == "consumer") {
+        span->set_kind(traceproto::Span::SPAN_KIND_CONSUMER);
+      } else {
+        span->set_kind(traceproto::Span::SPAN_KIND_INTERNAL);
+      }
+    } else if (key == "otel.library.name") {
+      library->first = value;
+    } else if (key == "otel.library.version") {
+      library->second = value;
+    } else if (key == "otel.status_code") {
+      span->mutable_status()->set_code(
+        value == "ERROR" ? traceproto::Status::STATUS_CODE_ERROR
+                         : traceproto::Status::STATUS_CODE_OK);
+    } else if (key == "otel.status_description") {
+      span->mutable_status()->set_message(value);
+    } else if (key == "error" && attribute.value().bool_value()) {
+      span->mutable_status()->set_code(traceproto::Status::STATUS_CODE_ERROR);
+    } else {
+      i++;
+      continue;
+    }
+
+    attributes->DeleteSubrange(i, 1);
+  }
+}
+
+bool ReadSpan(
+  ThriftReader& reader, traceproto::Span* span, std::pair<std::string, std::string>* library) {
+  int64_t traceIdLow = 0, traceIdHigh = 0, spanId = 0, parentSpanId = 0;
+  int64_t startMicros = 0, durationMicros = 0;
+
+  bool ok = reader.ReadStruct([&](uint8_t type, int16_t id) {
+    switch (id) {
+      case 1:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&traceIdLow);
+      case 2:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&traceIdHigh);
+      case 3:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&spanId);
+      case 4:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&parentSpanId);
+      case 5:
+        return type == ThriftReader::Type_String && reader.ReadString(span->mutable_name());
+      case 8:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&startMicros);
+      case 9:
+        return type == ThriftReader::Type_I64 && reader.ReadI64(&durationMicros);
+      case 10:
+        return type == ThriftReader::Type_List && ReadTags(reader, span->mutable_attributes());
+      case 11:
+        /* Logs, which become events named by their "event" field. */
+        return type == ThriftReader::Type_List &&
+               reader.ReadList(ThriftReader::Type_Struct, [&] {
+                 traceproto::Span::Event* event = span->add_events();
+                 return reader.ReadStruct([&](uint8_t fieldType, int16_t fieldId) {
+                   if (fieldId == 1 && fieldType == ThriftReader::Type_I64) {
+                     int64_t micros;
+                     bool read = reader.ReadI64(&micros);
+                     event->set_time_unix_nano(static_cast<uint64_t>(micros) * 1000);
+                     return read;
+                   }
+
+                   if (fieldId == 2 && fieldType == ThriftReader::Type_List) {
+                     return ReadTags(reader, event->mutable_attributes());
+                   }
+
+                   return reader.Skip(fieldType);
+                 });
+               });
+      default:
+        return reader.Skip(type);
+    }
+  });
+
+  AppendId(static_cast<uint64_t>(traceIdHigh), span->mutable_trace_id());
+  AppendId(static_cast<uint64_t>(traceIdLow), span->mutable_trace_id());
+  AppendId(static_cast<uint64_t>(spanId), span->mutable_span_id());
+
+  if (parentSpanId != 0) {
+    AppendId(static_cast<uint64_t>(parentSpanId), span->mutable_parent_span_id());
+  }
+
+  span->set_start_time_unix_nano(static_cast<uint64_t>(startMicros) * 1000);
+  span->set_end_time_unix_nano(static_cast<uint64_t>(startMicros + durationMicros) * 1000);
+
+  for (auto& event : *span->mutable_events()) {
+    auto* attributes = event.mutable_attributes();
+
+    for (int i = 0; i < attributes->size(); i++) {
+      if (attributes->Get(i).key() == "event") {
+        event.set_name(attributes->Get(i).value().string_value());
+        attributes->DeleteSubrange(i, 1);
+        break;
+      }
+    }
+  }
+
+  ApplySpecialTags(span, library);
+  return ok;
+}
+
+/* A jaeger.thrift Batch as one resource, its spans grouped by instrumentation library. */
+bool ParseJaegerBatch(const std::string& body, traceservice::ExportTraceServiceRequest* request) {
+  ThriftReader reader(body);
+  traceproto::ResourceSpans* resourceSpans = request->add_resource_spans();
+  std::vector<std::pair<std::string, std::string>> libraries;
+
+  return reader.ReadStruct([&](uint8_t type, int16_t id) {
+    if (id == 1 && type == ThriftReader::Type_Struct) {
+      auto* attributes = resourceSpans->mutable_resource()->mutable_attributes();
+
+      return reader.ReadStruct([&](uint8_t fieldType, int16_t fieldId) {
+        if (fieldId == 1 && fieldType == ThriftReader::Type_String) {
+          commonproto::KeyValue* serviceName = attributes->Add();
+          serviceName->set_key("service.name");
+          return reader.ReadString(serviceName->mutable_value()->mutable_string_value());
+        }
+
+        if (fieldId == 2 && fieldType == ThriftReader::Type_List) {
+          return ReadTags(reader, attributes);
+        }
+
+        return reader.Skip(fieldType);
+      });
+    }
+
+    if (id == 2 && type == ThriftReader::Type_List) {
+      return reader.ReadList(ThriftReader::Type_Struct, [&] {
+        traceproto::Span span;
+        std::pair<std::string, std::string> library;
+
+        if (!ReadSpan(reader, &span, &library)) {
+          return false;
+        }
+
+        size_t index =
+          std::find(libraries.begin(), libraries.end(), library) - libraries.begin();
+
+        if (index == libraries.size()) {
+          libraries.push_back(library);
+          auto* librarySpans = resourceSpans->add_instrumentation_library_spans();
+          librarySpans->mutable_instrumentation_library()->set_name(library.first);
+          librarySpans->mutable_instrumentation_library()->set_version(library.second);
+        }
+
+        resourceSpans->mutable_instrumentation_library_spans(static_cast<int>(index))
+          ->add_spans()
+          ->Swap(&span);
+        return true;
+      });
+    }
+
+    return reader.Skip(type);
+  });
+}
+
+uint64_t CountSpans(const traceservice::ExportTraceServiceRequest& request) {
+  uint64_t spans = 0;
+
+  for (const auto& resourceSpans : request.resource_spans()) {
+    for (const auto& librarySpans : resourceSpans.instrumentation_library_spans()) {
+      spans += static_cast<uint64_t>(librarySpans.spans_size());
+    }
+  }
+
+  return spans;
+}
+
+/* Binds a TCP socket to host:port and listens, returns the bound port. */
+int Listen(const std::string& address, int* fd) {
+  size_t colon = address.rfind(':');
+  std::string host = colon == std::string::npos ? "0.0.0.0" : address.substr(0, colon);
+  int port = atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+
+  struct sockaddr_in bindAddress;
+  memset(&bindAddress, 0, sizeof(bindAddress));
+  bindAddress.sin_family = AF_INET;
+  bindAddress.sin_port = htons(static_cast<uint16_t>(port));
+
+  if (inet_pton(AF_INET, host == "localhost" ? "127.0.0.1" : host.c_str(), &bindAddress.sin_addr) !=
+      1) {
+    throw std::system_error(EINVAL, std::generic_category(), "Invalid address " + address);
+  }
+
+  *fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (*fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+
+  int enable = 1;
+  setsockopt(*fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  socklen_t length = sizeof(bindAddress);
+
+  if (bind(*fd, reinterpret_cast<struct sockaddr*>(&bindAddress), sizeof(bindAddress)) != 0 ||
+      listen(*fd, 128) != 0 ||
+      getsockname(*fd, reinterpret_cast<struct sockaddr*>(&bindAddress), &length) != 0) {
+    int error = errno;
+    close(*fd);
+    *fd = -1;
+    throw std::system_error(error, std::generic_category(), "Could not listen on " + address);
+  }
+
+  return ntohs(bindAddress.sin_port);
+}
+
+bool WriteAll(int fd, const std::string& data) {
+  size_t written = 0;
+
+  while (written < data.size()) {
+    ssize_t result = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+
+    if (result <= 0) {
+      return false;
+    }
+
+    written += static_cast<size_t>(result);
+  }
+
+  return true;
+}
+
+std::string ToLower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), [](char c) {
+    return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  });
+  return value;
+}
+
+} // namespace
+
+struct MockCollector::State {
+  class TraceService final : public traceservice::TraceService::Service {
+  public:
+    explicit TraceService(State& state) : state_(state) {}
+
+    grpc::Status Export(
+      grpc::ServerContext*, const traceservice::ExportTraceServiceRequest* request,
+      traceservice::ExportTraceServiceResponse*) override {
+      return state_.Respond(state_.AcceptTraces(*request, request->ByteSizeLong()));
+    }
+
+  private:
+    State& state_;
+  };
+
+  class MetricsService final : public metricsservice::MetricsService::Service {
+  public:
+    explicit MetricsService(State& state) : state_(state) {}
+
+    grpc::Status Export(
+      grpc::ServerContext*, const metricsservice::ExportMetricsServiceRequest* request,
+      metricsservice::ExportMetricsServiceResponse*) override {
+      Outcome outcome = state_.Decide();
+
+      if (outcome == Outcome_Accept) {
+        uint64_t metrics = 0;
+
+        for (const auto& resourceMetrics : request->resource_metrics()) {
+          for (const auto& libraryMetrics : resourceMetrics.instrumentation_library_metrics()) {
+            metrics += static_cast<uint64_t>(libraryMetrics.metrics_size());
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(state_.mutex);
+        state_.stats.metrics += metrics;
+        state_.stats.bytes += request->ByteSizeLong();
+        state_.Append(state_.metricsFile, *request);
+      }
+
+      return state_.Respond(outcome);
+    }
+
+  private:
+    State& state_;
+  };
+
+  class LogsService final : public logsservice::LogsService::Service {
+  public:
+    explicit LogsService(State& state) : state_(state) {}
+
+    grpc::Status Export(
+      grpc::ServerContext*, const logsservice::ExportLogsServiceRequest* request,
+      logsservice::ExportLogsServiceResponse*) override {
+      Outcome outcome = state_.Decide();
+
+      if (outcome == Outcome_Accept) {
+        uint64_t records = 0;
+
+        for (const auto& resourceLogs : request->resource_logs()) {
+          for (const auto& libraryLogs : resourceLogs.instrumentation_library_logs()) {
+            records += static_cast<uint64_t>(libraryLogs.logs_size());
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(state_.mutex);
+        state_.stats.logRecords += records;
+        state_.stats.bytes += request->ByteSizeLong();
+        state_.Append(state_.logsFile, *request);
+      }
+
+      return state_.Respond(outcome);
+    }
+
+  private:
+    State& state_;
+  };
+
+  explicit State(const MockCollectorOptions& options)
+    : options(options), traceService(*this), metricsService(*this), logsService(*this) {}
+
+  /* Waits the configured latency, then draws whether the export fails. */
+  Outcome Decide() {
+    if (options.latency.count() > 0) {
+      std::this_thread::sleep_for(options.latency);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    double draw = std::uniform_real_distribution<double>(0, 1)(random);
+
+    if (draw < options.errorRate) {
+      stats.failedRequests++;
+      return Outcome_Error;
+    }
+
+    if (draw < options.errorRate + options.throttleRate) {
+      stats.throttledRequests++;
+      return Outcome_Throttle;
+    }
+
+    stats.acceptedRequests++;
+    return Outcome_Accept;
+  }
+
+  Outcome AcceptTraces(const traceservice::ExportTraceServiceRequest& request, size_t bytes) {
+    Outcome outcome = Decide();
+
+    if (outcome != Outcome_Accept) {
+      return outcome;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.spans += CountSpans(request);
+      stats.bytes += bytes;
+      Append(traceFile, request);
+
+      if (options.keepTraces) {
+        traces.push_back(request);
+      }
+    }
+
+    spansChanged.notify_all();
+    return outcome;
+  }
+
+  grpc::Status Respond(Outcome outcome) {
+    switch (outcome) {
+      case Outcome_Error:
+        return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Injected error");
+      case Outcome_Throttle:
+        return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Injected throttling");
+      default:
+        return grpc::Status::OK;
+    }
+  }
+
+  /* Writes the request as one line of JSON, like the collector's file exporter. Holds mutex. */
+  void Append(FILE* file, const google::protobuf::Message& message) {
+    if (!file) {
+      return;
+    }
+
+    std::string encoded;
+    google::protobuf::util::MessageToJsonString(message, &encoded);
+    json value = json::parse(encoded, nullptr, false);
+    HexIds(value);
+    std::string line = value.dump() + "\n";
+    fwrite(line.data(), 1, line.size(), file);
+    fflush(file);
+  }
+
+  void RunJaeger() {
+    for (;;) {
+      int fd = accept4(jaegerFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+      if (fd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(connectionMutex);
+
+      if (stopping) {
+        close(fd);
+        return;
+      }
+
+      connectionFds.push_back(fd);
+      connections.emplace_back([this, fd] {
+        ServeJaeger(fd);
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        connectionFds.erase(std::find(connectionFds.begin(), connectionFds.end(), fd));
+        close(fd);
+      });
+    }
+  }
+
+  /* HTTP/1.1 with keep-alive, enough for the Jaeger exporter's POSTs of Thrift batches. */
+  void ServeJaeger(int fd) {
+    std::string buffer;
+    char chunk[16384];
+
+    auto fill = [&](size_t size) {
+      while (buffer.size() < size) {
+        ssize_t bytes = recv(fd, chunk, sizeof(chunk), 0);
+
+        if (bytes <= 0) {
+          return false;
+        }
+
+        buffer.append(chunk, static_cast<size_t>(bytes));
+      }
+
+      return true;
+    };
+
+    for (;;) {
+      size_t headerEnd;
+
+      while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > 65536 || !fill(buffer.size() + 1)) {
+          return;
+        }
+      }
+
+      std::string head = ToLower(buffer.substr(0, headerEnd));
+      buffer.erase(0, headerEnd + 4);
+
+      auto header = [&](const std::string& name) {
+        size_t start = head.find("\r\n" + name + ":");
+
+        if (start == std::string::npos) {
+          return std::string();
+        }
+
+        start += name.size() + 3;
+        size_t end = head.find("\r\n", start);
+        std::string value = head.substr(start, end == std::string::npos ? end : end - start);
+        value.erase(0, value.find_first_not_of(' '));
+        return value;
+      };
+
+      std::string contentLength = header("content-length");
+      bool keepAlive = header("connection") != "close";
+
+      if (contentLength.empty()) {
+        WriteAll(fd, "HTTP/1.1 411 Length Required\r\nContent-Length: 0\r\n\r\n");
+        return;
+      }
+
+      if (header("expect") == "100-continue" &&
+          !WriteAll(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+        return;
+      }
+
+      size_t length = strtoul(contentLength.c_str(), nullptr, 10);
+
+      if (!fill(length)) {
+        return;
+      }
+
+      std::string body = buffer.substr(0, length);
+      buffer.erase(0, length);
+
+      const char* status = "202 Accepted";
+
+      if (head.compare(0, 5, "post ") != 0) {
+        status = "405 Method Not Allowed";
+      } else {
+        traceservice::ExportTraceServiceRequest request;
+
+        if (!ParseJaegerBatch(body, &request)) {
+          status = "400 Bad Request";
+        } else {
+          switch (AcceptTraces(request, body.size())) {
+            case Outcome_Error:
+              status = "503 Service Unavailable";
+              break;
+            case Outcome_Throttle:
+              status = "429 Too Many Requests";
+              break;
+            default:
+              break;
+          }
+        }
+      }
+
+      if (!WriteAll(fd, std::string("HTTP/1.1 ") + status + "\r\nContent-Length: 0\r\n\r\n") ||
+          !keepAlive) {
+        return;
+      }
+    }
+  }
+
+  const MockCollectorOptions options;
+  TraceService traceService;
+  MetricsService metricsService;
+  LogsService logsService;
+  std::unique_ptr<grpc::Server> server;
+  int otlpPort = 0;
+
+  int jaegerFd = -1;
+  int jaegerPort = 0;
+  std::thread jaegerThread;
+  std::mutex connectionMutex;
+  /* Guarded by connectionMutex. Open connections, each closed by its thread. */
+  bool stopping = false;
+  std::vector<int> connectionFds;
+  std::list<std::thread> connections;
+
+  mutable std::mutex mutex;
+  mutable std::condition_variable spansChanged;
+  /* Guarded by mutex. */
+  std::mt19937_64 random{std::random_device()()};
+  MockCollectorStats stats;
+  std::vector<traceservice::ExportTraceServiceRequest> traces;
+  FILE* traceFile = nullptr;
+  FILE* metricsFile = nullptr;
+  FILE* logsFile = nullptr;
+};
+
+MockCollector::MockCollector(const MockCollectorOptions& options) : state_(new State(options)) {
+  auto open = [](const std::string& path) {
+    return path.empty() ? nullptr : fopen(path.c_str(), "ab");
+  };
+
+  state_->traceFile = open(options.traceFile);
+  state_->metricsFile = open(options.metricsFile);
+  state_->logsFile = open(options.logsFile);
+
+  if (!options.otlpAddress.empty()) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(
+      options.otlpAddress, grpc::InsecureServerCredentials(), &state_->otlpPort);
+    builder.RegisterService(&state_->traceService);
+    builder.RegisterService(&state_->metricsService);
+    builder.RegisterService(&state_->logsService);
+    state_->server = builder.BuildAndStart();
+
+    if (!state_->server || state_->otlpPort == 0) {
+      throw std::system_error(
+        EADDRINUSE, std::generic_category(), "Could not listen on " + options.otlpAddress);
+    }
+  }
+
+  if (!options.jaegerAddress.empty()) {
+    state_->jaegerPort = Listen(options.jaegerAddress, &state_->jaegerFd);
+    state_->jaegerThread = std::thread(&State::RunJaeger, state_.get());
+  }
+}
+
+MockCollector::~MockCollector() {
+  if (state_->server) {
+    state_->server->Shutdown();
+  }
+
+  if (state_->jaegerFd != -1) {
+    {
+      std::lock_guard<std::mutex> lock(state_->connectionMutex);
+      state_->stopping = true;
+
+      for (int fd : state_->connectionFds) {
+        shutdown(fd, SHUT_RDWR);
+      }
+    }
+
+    /* Wakes up the accept. */
+    shutdown(state_->jaegerFd, SHUT_RDWR);
+    state_->jaegerThread.join();
+    close(state_->jaegerFd);
+
+    for (std::thread& connection : state_->connections) {
+      connection.join();
+    }
+  }
+
+  for (FILE* file : {state_->traceFile, state_->metricsFile, state_->logsFile}) {
+    if (file) {
+      fclose(file);
+    }
+  }
+}
+
+int MockCollector::OtlpPort() const { return state_->otlpPort; }
+
+int MockCollector::JaegerPort() const { return state_->jaegerPort; }
+
+MockCollectorStats MockCollector::GetStats() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->stats;
+}
+
+std::vector<traceservice::ExportTraceServiceRequest> MockCollector::TraceRequests() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->traces;
+}
+
+bool MockCollector::WaitForSpans(uint64_t count, std::chrono::milliseconds timeout) const {
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  return state_->spansChanged.wait_for(
+    lock, timeout, [&] { return state_->stats.spans >= count; });
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <opentelemetry/proto/collector/trace/v1/trace_service.pb.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * A collector for tests and benchmarks which needs no container or network: OTLP gRPC traces,
+ * metrics and logs, and Jaeger Thrift over HTTP, answered in-process. It can delay, fail and
+ * throttle exports, keeps the trace requests it accepted in memory and, like the file exporter
+ * of test/collector/conf.yml, appends each accepted request as a JSON line to a file so the
+ * verifications of test/common read it unchanged. Jaeger batches are converted to OTLP the way
+ * the collector's receiver does.
+ */
+struct MockCollectorOptions {
+  /* host:port, port 0 picks a free one, empty doesn't listen. */
+  std::string otlpAddress = "127.0.0.1:0";
+  std::string jaegerAddress = "127.0.0.1:0";
+  /* Added to every export before it is answered. */
+  std::chrono::milliseconds latency{0};
+  /* Fractions of exports answered UNAVAILABLE (HTTP 503) and RESOURCE_EXHAUSTED (HTTP 429). */
+  double errorRate = 0;
+  double throttleRate = 0;
+  /* Empty doesn't write the signal. */
+  std::string traceFile;
+  std::string metricsFile;
+  std::string logsFile;
+  /* Counts only when false, for load tests. */
+  bool keepTraces = true;
+};
+
+struct MockCollectorStats {
+  uint64_t acceptedRequests = 0;
+  uint64_t failedRequests = 0;
+  uint64_t throttledRequests = 0;
+  uint64_t spans = 0;
+  uint64_t metrics = 0;
+  uint64_t logRecords = 0;
+  /* Serialized size of the accepted requests, Jaeger batches as received. */
+  uint64_t bytes = 0;
+};
+
+class MockCollector {
+public:
+  /* Listens right away, throws std::system_error when an address can't be bound. */
+  explicit MockCollector(const MockCollectorOptions& options);
+  ~MockCollector();
+
+  /* The bound ports, 0 when not listening. */
+  int OtlpPort() const;
+  int JaegerPort() const;
+
+  MockCollectorStats GetStats() const;
+
+  /* Accepted trace requests in the order they arrived, Jaeger ones converted. */
+  std::vector<opentelemetry::proto::collector::trace::v1::ExportTraceServiceRequest>
+  TraceRequests() const;
+
+  /* Waits until at least count spans were accepted, false on timeout. */
+  bool WaitForSpans(uint64_t count, std::chrono::milliseconds timeout) const;
+
+private:
+  struct State;
+
+  std::unique_ptr<State> state_;
+};